@@ -46,6 +46,9 @@ using namespace std;
 /* The task that implements the command console processing. */
 static void prvCommandConsoleTask( void * pvParameters );
 
+/* read and write interaction used by the console */
+static cli_t * pxCLIInterface = nullptr;
+
 /*-----------------------------------------------------------*/
 
 /* Const messages output by the command console. */
@@ -183,6 +186,9 @@ BaseType_t xCLIStart( void * const pvParameters, TaskHandle_t * const pxCreatedT
         return pdFAIL;
     }
 
+    /* Remember the interaction, commands may stream binary data through it. */
+    pxCLIInterface = (cli_t *)pvParameters;
+
     /* Register all the command line commands defined immediately above. */
     extern void vCommandRegister(void);
     vCommandRegister();
@@ -196,4 +202,49 @@ BaseType_t xCLIStart( void * const pvParameters, TaskHandle_t * const pxCreatedT
                         pxCreatedTask );
 }
 
-/*-----------------------------------------------------------*/
\ No newline at end of file
+/*-----------------------------------------------------------*/
+
+/*-----------------------------------------------------------*/
+
+/// @brief write raw (binary) data to the cli interface, bypassing the string output buffer
+/// @param puc : data pointer
+/// @param lSize : data bytes
+/// @return -1 : cli not started; other : write interface return value
+int lCLIWriteBinary( uint8_t * puc, int lSize )
+{
+    if(nullptr == pxCLIInterface)
+    {
+        return -1;
+    }
+    return pxCLIInterface->w(puc, lSize);
+}
+
+/// @brief read raw (binary) data from the cli interface, waits until all bytes are in
+/// @param puc : data pointer
+/// @param lSize : data bytes
+/// @param xTimeout : longest wait for the next data
+/// @return -1 : cli not started or read error; other : bytes read, less than lSize on timeout
+int lCLIReadBinary( uint8_t * puc, int lSize, TickType_t xTimeout )
+{
+    int lRead = 0;
+
+    if((nullptr == pxCLIInterface) || (nullptr == pxCLIInterface->rt))
+    {
+        return -1;
+    }
+    while(lRead < lSize)
+    {
+        int lRxSize = pxCLIInterface->rt(puc + lRead, lSize - lRead, xTimeout);
+        if(0 > lRxSize)
+        {
+            return -1;
+        }
+        // the sender stopped
+        if(0 == lRxSize)
+        {
+            break;
+        }
+        lRead += lRxSize;
+    }
+    return lRead;
+}
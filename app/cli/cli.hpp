@@ -27,12 +27,15 @@
 
 /* Prototype of data interaction function */
 typedef int (* DataInteraction_t)(uint8_t *, int);
+/* Prototype of the timed read function: buffer, size, timeout; returns bytes read */
+typedef int (* DataReadTimeout_t)(uint8_t *, int, TickType_t);
 
 /* read and write interaction */
 typedef struct cli_t
 {
     DataInteraction_t r;    // read, if return -1, it represents overflow.
     DataInteraction_t w;    // write
+    DataReadTimeout_t rt;   // read with a timeout, for binary data behind a command
 } cli_t;
 
 
@@ -46,6 +49,19 @@ typedef struct cli_t
 /// @return the resualt of Task creation
 BaseType_t xCLIStart( void * const pvParameters, TaskHandle_t * const pxCreatedTask, UBaseType_t uxPriority );
 
+/// @brief write raw (binary) data to the cli interface, bypassing the string output buffer
+/// @param puc : data pointer
+/// @param lSize : data bytes
+/// @return -1 : cli not started; other : write interface return value
+int lCLIWriteBinary( uint8_t * puc, int lSize );
+
+/// @brief read raw (binary) data from the cli interface, waits until all bytes are in
+/// @param puc : data pointer
+/// @param lSize : data bytes
+/// @param xTimeout : longest wait for the next data
+/// @return -1 : cli not started or read error; other : bytes read, less than lSize on timeout
+int lCLIReadBinary( uint8_t * puc, int lSize, TickType_t xTimeout );
+
 
 /*-----------------------------------------------------------*/
 
@@ -1,5 +1,17 @@
 #include "cli.hpp"
 #include <inttypes.h>
+#include "dap/dapStats.h"
+#include "dap/dapRecorder.h"
+#include "dap/dapReadAhead.h"
+#include "prog/programmer.h"
+#include "fault/faultWatch.h"
+#include "fault/coreDump.h"
+#include "watch/memWatch.h"
+#include "semihost/semihost.h"
+#include "trace/swo.h"
+#include "trace/excTrace.h"
+#include "target/swclkTune.h"
+#include "tusb_edpt_handler.h"
 
 /*-----------------------------------------------------------*/
 
@@ -16,6 +28,9 @@
 /* The location where Declaration CLI_Command_Definition_t is stored */
 #define commandREGISTER __attribute__((used, section("xCLICommand")))
 
+/* 'prog load' gives up when the image data stops for this long (ms) */
+#define commandLOAD_TIMEOUT_MS  2000U
+
 /*-----------------------------------------------------------*/
 
 /* Linker-provided section boundaries for commands.
@@ -569,4 +584,1247 @@ commandREGISTER static const CLI_Command_Definition_t xClock =
     0                   /* The user can enter any number of commands. */
 };
 
-/*-----------------------------------------------------------*/
\ No newline at end of file
+/*-----------------------------------------------------------*/
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the dap-stats command.
+ */
+static BaseType_t prvDapStatsCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+
+    const char * const pcHeader = "Command\t\t\tCalls\tIn\tOut\tWait\tFault\tParity\tAvg(us)\r\n";
+    const char * const pcGap = "------------------------------------------------------------------------------------\r\n";
+    const char * const pcHistName[DAP_STATS_HIST_COUNT] = { "queue", "exec", "usb-in" };
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* The only (optional) parameter is "reset" */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL != pcParameter )
+    {
+        if( strncmp( pcParameter, "reset", strlen( "reset" ) ) == 0 )
+        {
+            vDapStatsReset();
+            memset( &xDapReadAheadStats, 0x00, sizeof( xDapReadAheadStats ) );
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP statistics cleared.\r\n" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameter is 'reset'.\r\n" );
+        }
+        return pdFALSE;
+    }
+
+    /* per-command counters */
+    ( void ) strncpy( pcWriteBuffer, pcHeader, xWriteBufferLen );
+    /* Note: When used continuously, Pay attention to the remaining length!!!!! */
+    ( void ) strncpy( pcWriteBuffer + strlen( pcWriteBuffer ), pcGap, xWriteBufferLen - strlen(pcWriteBuffer) );
+    for( size_t i = 0; i < sizeof( xDapStats.xCmd ) / sizeof( xDapStats.xCmd[0] ); i++ )
+    {
+        dap_stats_cmd_t xCmd;
+        const dap_stats_cmd_t * px = &xCmd;
+        char cName[24];
+
+        vDapStatsCmdGet( (uint8_t)i, &xCmd );
+        if( 0U == px->ulCalls )
+        {
+            continue;
+        }
+        /* known commands by name, the others (vendor commands) by id */
+        if( ( i <= ID_DAP_ExecuteCommands ) && ( NULL != dap_cmd_string[i] ) )
+        {
+            ( void ) snprintf( cName, sizeof( cName ), "%s", dap_cmd_string[i] );
+        }
+        else
+        {
+            ( void ) snprintf( cName, sizeof( cName ), "DAP_0x%02X", (unsigned int)i );
+        }
+        ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                           "%-24s%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\r\n",
+                           cName, (unsigned long)px->ulCalls, (unsigned long)px->ulBytesIn, (unsigned long)px->ulBytesOut,
+                           (unsigned long)px->ulWait, (unsigned long)px->ulFault, (unsigned long)px->ulParity,
+                           (unsigned long)( px->ullExecUs / px->ulCalls ) );
+    }
+    ( void ) strncpy( pcWriteBuffer + strlen( pcWriteBuffer ), pcGap, xWriteBufferLen - strlen(pcWriteBuffer) );
+
+    /* latency histograms, bucket n holds samples below 2^n us */
+    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "\r\nLatency(us)\t%s\t\t%s\t\t%s\r\n", pcHistName[0], pcHistName[1], pcHistName[2] );
+    ( void ) strncpy( pcWriteBuffer + strlen( pcWriteBuffer ), pcGap, xWriteBufferLen - strlen(pcWriteBuffer) );
+    for( uint32_t b = 0; b < DAP_STATS_HIST_BUCKETS; b++ )
+    {
+        if( b < DAP_STATS_HIST_BUCKETS - 1U )
+        {
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "<%lu\t\t", (unsigned long)( 1UL << b ) );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), ">=%lu\t\t", (unsigned long)( 1UL << ( b - 1U ) ) );
+        }
+        for( uint32_t h = 0; h < DAP_STATS_HIST_COUNT; h++ )
+        {
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "%lu\t\t", (unsigned long)ulDapStatsHistGet( (dap_stats_hist_t)h, b ) );
+        }
+        ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "\r\n" );
+    }
+    ( void ) strncpy( pcWriteBuffer + strlen( pcWriteBuffer ), pcGap, xWriteBufferLen - strlen(pcWriteBuffer) );
+
+    /* link utilization: swd busy against waiting for usb */
+    uint64_t ullBusy, ullIdle;
+    uint32_t ulProtocolErr;
+    vDapStatsLinkGet( &ullBusy, &ullIdle, &ulProtocolErr );
+    uint64_t ullTotal = ullBusy + ullIdle;
+    unsigned int uxPercent = ( 0U == ullTotal ) ? 0U : (unsigned int)( ( ullBusy * 100U ) / ullTotal );
+    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                       "\r\nSWD busy %" PRIu64 " ms, waiting for USB %" PRIu64 " ms, utilization %u%% (%s bound)\r\n",
+                       ullBusy / 1000U, ullIdle / 1000U, uxPercent, ( uxPercent >= 50U ) ? "wire" : "USB" );
+    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                       "SWD protocol errors %lu\r\n", (unsigned long)ulProtocolErr );
+
+    /* sequential read-ahead */
+    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                       "Read-ahead words %lu, hit %lu, dropped %lu, TAR restored %lu times\r\n",
+                       (unsigned long)xDapReadAheadStats.ulPrefetched, (unsigned long)xDapReadAheadStats.ulHit,
+                       (unsigned long)xDapReadAheadStats.ulDropped, (unsigned long)xDapReadAheadStats.ulTarRestore );
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "dap-stats" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xDapStatsCmd =
+{
+    "dap-stats",
+    "\r\ndap-stats [reset]:\r\n Displays per-command DAP counters, latency histograms and SWD link utilization, or clears them.\r\n",
+    prvDapStatsCommand, /* The function to run. */
+    -1                  /* Zero or one parameter is expected. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the dap-rec command.
+ */
+static BaseType_t prvDapRecorderCommand( char * pcWriteBuffer,
+                                         size_t xWriteBufferLen,
+                                         const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "start", strlen( "start" ) ) == 0 )
+    {
+        vDapRecorderRun( true );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder started.\r\n" );
+    }
+    else if( strncmp( pcParameter, "stop", strlen( "stop" ) ) == 0 )
+    {
+        vDapRecorderRun( false );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder stopped.\r\n" );
+    }
+    else if( strncmp( pcParameter, "clear", strlen( "clear" ) ) == 0 )
+    {
+        vDapRecorderClear();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder cleared.\r\n" );
+    }
+    else if( strncmp( pcParameter, "size", strlen( "size" ) ) == 0 )
+    {
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcParameter );
+        if( ( (int)BASE_INVALID == ucNumberBase ) ||
+            ( pdPASS != xDapRecorderSetSize( (size_t)strtoul( pcParameter, &ptr, ucNumberBase ) ) ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'dap-rec size' : size must be %u..%u bytes!!!\r\n",
+                               (unsigned int)DAP_RECORDER_MIN_SIZE, (unsigned int)PSRAM_RECORDER_SIZE );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder resized and cleared.\r\n" );
+        }
+    }
+    else if( strncmp( pcParameter, "filter", strlen( "filter" ) ) == 0 )
+    {
+        /* "filter all" or "filter <id> [<id> ...]" */
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        if( ( NULL == pcParameter ) || ( strncmp( pcParameter, "all", strlen( "all" ) ) == 0 ) )
+        {
+            vDapRecorderFilterAll( true );
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder records all commands.\r\n" );
+        }
+        else
+        {
+            vDapRecorderFilterAll( false );
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "DAP recorder records:" );
+            for( UBaseType_t n = 2; NULL != pcParameter; n++ )
+            {
+                int ucNumberBase = (int)eUtilGetNumberBase( pcParameter );
+                if( (int)BASE_INVALID != ucNumberBase )
+                {
+                    uint8_t ucId = (uint8_t)strtoul( pcParameter, &ptr, ucNumberBase );
+                    vDapRecorderFilter( ucId, true );
+                    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), " 0x%02X", ucId );
+                }
+                pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, n + 1, &lParameterStringLength );
+            }
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "\r\n" );
+        }
+    }
+    else if( strncmp( pcParameter, "export", strlen( "export" ) ) == 0 )
+    {
+        /* The binary dump goes straight to the cli interface, the host tool
+         * synchronises on the magic in the header. */
+        size_t xBytes = xDapRecorderExport( lCLIWriteBinary );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nDAP recorder exported %u bytes.\r\n", (unsigned int)xBytes );
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        dap_recorder_status_t xStatus;
+        vDapRecorderStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                           "DAP recorder %s: %lu records, %u of %u bytes used, %lu dropped\r\n",
+                           xStatus.xRunning ? "running" : "stopped", (unsigned long)xStatus.ulRecords,
+                           (unsigned int)xStatus.xUsed, (unsigned int)xStatus.xSize, (unsigned long)xStatus.ulDropped );
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'start', 'stop', 'clear', 'status', 'size', 'filter' and 'export'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "dap-rec" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xDapRecorderCmd =
+{
+    "dap-rec",
+    "\r\ndap-rec <start | stop | clear | status | size <bytes> | filter <all | id ...> | export>:\r\n Controls the DAP request/response flight recorder in psram, 'export' dumps it in binary.\r\n",
+    prvDapRecorderCommand, /* The function to run. */
+    -1                     /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the prog command.
+ */
+static BaseType_t prvProgCommand( char * pcWriteBuffer,
+                                  size_t xWriteBufferLen,
+                                  const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    const char * const pcResult[] = { "none", "busy", "pass", "FAIL" };
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "load", strlen( "load" ) ) == 0 )
+    {
+        /* "load <addr> <size> <crc32>", the raw image follows once "ready" is out */
+        uint32_t ulArg[3];
+        uint8_t ucChunk[128];
+
+        for( UBaseType_t n = 0; n < 3; n++ )
+        {
+            pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, n + 2, &lParameterStringLength );
+            int ucNumberBase = (int)eUtilGetNumberBase( pcParameter );
+            if( ( NULL == pcParameter ) || ( (int)BASE_INVALID == ucNumberBase ) )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'prog load' : <addr> <size> <crc32> expected!!!\r\n" );
+                return pdFALSE;
+            }
+            ulArg[n] = (uint32_t)strtoul( pcParameter, &ptr, ucNumberBase );
+        }
+        if( pdPASS != xProgImageBegin( ulArg[0], ulArg[1] ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'prog load' : the image must start sector aligned and fit into 0x%08lX..0x%08lX!!!\r\n",
+                               (unsigned long)PROG_FLASH_BASE, (unsigned long)( PROG_FLASH_BASE + PSRAM_IMAGE_SIZE ) );
+            return pdFALSE;
+        }
+        ( void ) lCLIWriteBinary( (uint8_t *)"ready\r\n", 7 );
+        uint32_t ulOffset = 0;
+        uint32_t ulFailed = ulArg[1];
+        while( ulOffset < ulArg[1] )
+        {
+            int lLen = ( ( ulArg[1] - ulOffset ) < sizeof( ucChunk ) ) ? (int)( ulArg[1] - ulOffset ) : (int)sizeof( ucChunk );
+            if( lLen != lCLIReadBinary( ucChunk, lLen, pdMS_TO_TICKS( commandLOAD_TIMEOUT_MS ) ) )
+            {
+                break;
+            }
+            /* after a failed write the rest is only drained, it must not reach the console */
+            if( ( ulFailed == ulArg[1] ) && ( pdPASS != xProgImageWrite( ulOffset, ucChunk, (size_t)lLen ) ) )
+            {
+                ulFailed = ulOffset;
+            }
+            ulOffset += (uint32_t)lLen;
+        }
+        if( ulFailed < ulArg[1] )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image write failed at offset %lu, nothing staged.\r\n", (unsigned long)ulFailed );
+        }
+        else if( ulOffset < ulArg[1] )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image data stopped after %lu of %lu bytes, nothing staged.\r\n",
+                               (unsigned long)ulOffset, (unsigned long)ulArg[1] );
+        }
+        else if( pdPASS != xProgImageCommit( ulArg[2] ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image crc mismatch, nothing staged.\r\n" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image staged: %lu bytes at 0x%08lX.\r\n",
+                               (unsigned long)ulArg[1], (unsigned long)ulArg[0] );
+        }
+    }
+    else if( strncmp( pcParameter, "run", strlen( "run" ) ) == 0 )
+    {
+        if( pdPASS != xProgStart() )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "No staged image or a run is in progress.\r\n" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Programming started.\r\n" );
+        }
+    }
+    else if( strncmp( pcParameter, "verify", strlen( "verify" ) ) == 0 )
+    {
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        bool xVerify = ( NULL == pcParameter ) || ( strncmp( pcParameter, "off", strlen( "off" ) ) != 0 );
+        vProgSetVerify( xVerify );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Verify %s.\r\n", xVerify ? "on" : "off" );
+    }
+    else if( strncmp( pcParameter, "delta", strlen( "delta" ) ) == 0 )
+    {
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        bool xDelta = ( NULL == pcParameter ) || ( strncmp( pcParameter, "off", strlen( "off" ) ) != 0 );
+        vProgSetDelta( xDelta );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Delta %s.\r\n", xDelta ? "on" : "off" );
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        prog_status_t xStatus;
+        vProgStatus( &xStatus );
+        if( xStatus.xImageValid )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image: %lu bytes at 0x%08lX, crc32 0x%08lX, verify %s, delta %s\r\n",
+                               (unsigned long)xStatus.ulImageSize, (unsigned long)xStatus.ulImageAddr,
+                               (unsigned long)xStatus.ulImageCrc, xStatus.xVerify ? "on" : "off", xStatus.xDelta ? "on" : "off" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Image: none, verify %s, delta %s\r\n",
+                               xStatus.xVerify ? "on" : "off", xStatus.xDelta ? "on" : "off" );
+        }
+        ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                           "Last run: %s", pcResult[xStatus.eResult] );
+        if( PROG_RESULT_FAIL == xStatus.eResult )
+        {
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                               " (%s)", ( NULL != xStatus.pcError ) ? xStatus.pcError : "?" );
+        }
+        ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                           ", %lu ms, %lu sectors unchanged\r\nPassed: %lu, failed: %lu\r\n", (unsigned long)xStatus.ulLastMs,
+                           (unsigned long)xStatus.ulSkipped, (unsigned long)xStatus.ulPassed, (unsigned long)xStatus.ulFailed );
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'load', 'run', 'verify', 'delta' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "prog" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xProgCmd =
+{
+    "prog",
+    "\r\nprog <load <addr> <size> <crc32> | run | verify <on | off> | delta <on | off> | status>:\r\n Stand-alone programmer. 'load' stages a raw image in psram (send it after \"ready\"), 'run' or the button flashes it. 'delta' skips sectors the target holds already.\r\n",
+    prvProgCommand, /* The function to run. */
+    -1              /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the fault command.
+ */
+static BaseType_t prvFaultCommand( char * pcWriteBuffer,
+                                   size_t xWriteBufferLen,
+                                   const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+    uint32_t ulIndex = 0;
+
+    const char * const pcRegName[FAULT_REGS] =
+    {
+        "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12",
+        "sp", "lr", "pc", "xpsr", "msp", "psp", "ctrl"
+    };
+    const char * const pcStatusName[FAULT_STATUS_REGS] = { "cfsr", "hfsr", "dfsr", "mmfar", "bfar", "afsr" };
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "on", strlen( "on" ) ) == 0 )
+    {
+        /* "on [stack bytes]" */
+        fault_status_t xStatus;
+        vFaultStatus( &xStatus );
+        uint32_t ulStack = xStatus.ulStackSize;
+        const char * pcStack = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcStack );
+        if( ( NULL != pcStack ) && ( (int)BASE_INVALID != ucNumberBase ) )
+        {
+            ulStack = (uint32_t)strtoul( pcStack, &ptr, ucNumberBase );
+        }
+        vFaultWatch( true, ulStack );
+        vFaultStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Fault watch on, %lu stack bytes per snapshot.\r\n",
+                           (unsigned long)xStatus.ulStackSize );
+    }
+    else if( strncmp( pcParameter, "off", strlen( "off" ) ) == 0 )
+    {
+        fault_status_t xStatus;
+        vFaultStatus( &xStatus );
+        vFaultWatch( false, xStatus.ulStackSize );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Fault watch off.\r\n" );
+    }
+    else if( strncmp( pcParameter, "clear", strlen( "clear" ) ) == 0 )
+    {
+        vFaultClear();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Fault snapshots cleared.\r\n" );
+    }
+    else if( ( strncmp( pcParameter, "show", strlen( "show" ) ) == 0 ) ||
+             ( strncmp( pcParameter, "stack", strlen( "stack" ) ) == 0 ) )
+    {
+        /* "show [n]" / "stack [n]", 0 is the newest */
+        bool xStack = ( pcParameter[1] == 't' );
+        const char * pcIndex = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcIndex );
+        if( ( NULL != pcIndex ) && ( (int)BASE_INVALID != ucNumberBase ) )
+        {
+            ulIndex = (uint32_t)strtoul( pcIndex, &ptr, ucNumberBase );
+        }
+        const fault_snapshot_t * px = pxFaultSnapshot( ulIndex );
+        if( NULL == px )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "No fault snapshot %lu.\r\n", (unsigned long)ulIndex );
+            return pdFALSE;
+        }
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Fault #%lu at %lu ms, exception %lu\r\n", (unsigned long)px->ulNumber,
+                           (unsigned long)px->ulTimeMs, (unsigned long)( px->ulReg[16] & 0x1FFU ) );
+        if( !xStack )
+        {
+            for( uint32_t i = 0; i < FAULT_REGS; i++ )
+            {
+                ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                                   "%5s 0x%08lX%s", pcRegName[i], (unsigned long)px->ulReg[i], ( ( i % 4U ) == 3U ) ? "\r\n" : "  " );
+            }
+            for( uint32_t i = 0; i < FAULT_STATUS_REGS; i++ )
+            {
+                ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                                   "%5s 0x%08lX%s", pcStatusName[i], (unsigned long)px->ulStatus[i], ( ( i % 4U ) == 3U ) ? "\r\n" : "  " );
+            }
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                               "\r\nStack: %lu bytes at 0x%08lX\r\n", (unsigned long)px->ulStackSize, (unsigned long)px->ulStackAddr );
+        }
+        else
+        {
+            for( uint32_t i = 0; i < ( px->ulStackSize / 4U ); i++ )
+            {
+                /* keep room for the last line */
+                if( ( xWriteBufferLen - strlen( pcWriteBuffer ) ) < 128U )
+                {
+                    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "...\r\n" );
+                    break;
+                }
+                if( ( i % 8U ) == 0U )
+                {
+                    ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                                       "%08lX:", (unsigned long)( px->ulStackAddr + ( i * 4U ) ) );
+                }
+                ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                                   " %08lX%s", (unsigned long)px->ulStack[i], ( ( i % 8U ) == 7U ) ? "\r\n" : "" );
+            }
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer), "\r\n" );
+        }
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        fault_status_t xStatus;
+        vFaultStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                           "Fault watch %s, target %s, %lu stack bytes per snapshot\r\nPolls: %lu, faults: %lu, snapshots: %lu\r\n",
+                           xStatus.xArmed ? "on" : "off", xStatus.xLinkUp ? "connected" : "not connected",
+                           (unsigned long)xStatus.ulStackSize, (unsigned long)xStatus.ulPolls,
+                           (unsigned long)xStatus.ulFaults, (unsigned long)xStatus.ulStored );
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'on', 'off', 'show', 'stack', 'clear' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "fault" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xFaultCmd =
+{
+    "fault",
+    "\r\nfault <on [stack bytes] | off | show [n] | stack [n] | clear | status>:\r\n Fault watch. 'on' catches the fault vectors and records registers, fault status and stack of a faulting target into psram; 'show' and 'stack' print snapshot n (0 = newest).\r\n",
+    prvFaultCommand, /* The function to run. */
+    -1               /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the core command.
+ */
+static BaseType_t prvCoreCommand( char * pcWriteBuffer,
+                                  size_t xWriteBufferLen,
+                                  const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "export", strlen( "export" ) ) == 0 )
+    {
+        /* The binary file goes straight to the cli interface, the host tool
+         * synchronises on the ELF magic. */
+        size_t xBytes = xCoreExport( lCLIWriteBinary );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nCore backup exported %u bytes.\r\n", (unsigned int)xBytes );
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        core_status_t xStatus;
+        vCoreStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Last core file: %lu bytes, backup %lu bytes%s\r\n",
+                           (unsigned long)xStatus.ulBytes, (unsigned long)xStatus.ulStored, xStatus.xComplete ? "" : " (incomplete)" );
+    }
+    else
+    {
+        /* "<addr> <size> [<addr> <size> ...]" */
+        core_region_t xRegion[CORE_REGIONS_MAX];
+        size_t xRegions = 0;
+        uint32_t ulBytes;
+
+        for( UBaseType_t n = 1; xRegions < CORE_REGIONS_MAX; n += 2 )
+        {
+            const char * pcAddr = FreeRTOS_CLIGetParameter( pcCommandString, n, &lParameterStringLength );
+            const char * pcSize = FreeRTOS_CLIGetParameter( pcCommandString, n + 1, &lParameterStringLength );
+            if( NULL == pcAddr )
+            {
+                break;
+            }
+            int lAddrBase = (int)eUtilGetNumberBase( pcAddr );
+            int lSizeBase = (int)eUtilGetNumberBase( pcSize );
+            if( ( NULL == pcSize ) || ( (int)BASE_INVALID == lAddrBase ) || ( (int)BASE_INVALID == lSizeBase ) )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'core' : <addr> <size> pairs expected!!!\r\n" );
+                return pdFALSE;
+            }
+            xRegion[xRegions].ulAddr = (uint32_t)strtoul( pcAddr, &ptr, lAddrBase );
+            xRegion[xRegions].ulSize = (uint32_t)strtoul( pcSize, &ptr, lSizeBase );
+            xRegions++;
+        }
+        uint8_t ucAck = ucCoreDump( xRegion, xRegions, lCLIWriteBinary, &ulBytes );
+        if( DAP_TRANSFER_OK != ucAck )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nCore dump failed (ack %u) after %lu bytes.\r\n",
+                               (unsigned int)ucAck, (unsigned long)ulBytes );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "\r\nCore dump written: %lu bytes.\r\n", (unsigned long)ulBytes );
+        }
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "core" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xCoreCmd =
+{
+    "core",
+    "\r\ncore <<addr> <size> [<addr> <size> ...] | export | status>:\r\n ELF core dump. Halts the target and streams a core file of registers and the given regions (up to 8), a copy is kept in psram for 'export'.\r\n",
+    prvCoreCommand, /* The function to run. */
+    -1              /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the mwatch command.
+ */
+static BaseType_t prvMemWatchCommand( char * pcWriteBuffer,
+                                      size_t xWriteBufferLen,
+                                      const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "add", strlen( "add" ) ) == 0 )
+    {
+        /* "add <addr> <size>" */
+        const char * pcAddr = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        const char * pcSize = FreeRTOS_CLIGetParameter( pcCommandString, 3, &lParameterStringLength );
+        int lAddrBase = (int)eUtilGetNumberBase( pcAddr );
+        int lSizeBase = (int)eUtilGetNumberBase( pcSize );
+        if( ( NULL == pcAddr ) || ( NULL == pcSize ) || ( (int)BASE_INVALID == lAddrBase ) || ( (int)BASE_INVALID == lSizeBase ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'mwatch add' : <addr> <size> expected!!!\r\n" );
+            return pdFALSE;
+        }
+        uint32_t ulAddr = (uint32_t)strtoul( pcAddr, &ptr, lAddrBase );
+        uint32_t ulSize = (uint32_t)strtoul( pcSize, &ptr, lSizeBase );
+        if( pdPASS != xMemWatchAdd( ulAddr, ulSize ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "No room for the region (%u regions, %u KB baseline at most).\r\n",
+                               (unsigned int)MWATCH_REGIONS, (unsigned int)( PSRAM_MWATCH_SIZE / 1024U ) );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Watching 0x%08lX, %lu bytes.\r\n", (unsigned long)ulAddr, (unsigned long)ulSize );
+        }
+    }
+    else if( strncmp( pcParameter, "clear", strlen( "clear" ) ) == 0 )
+    {
+        vMemWatchClear();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Memory watch regions and log cleared.\r\n" );
+    }
+    else if( strncmp( pcParameter, "on", strlen( "on" ) ) == 0 )
+    {
+        /* "on [period ms]" */
+        mwatch_status_t xStatus;
+        vMemWatchStatus( &xStatus );
+        uint32_t ulPeriod = xStatus.ulPeriodMs;
+        const char * pcPeriod = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcPeriod );
+        if( ( NULL != pcPeriod ) && ( (int)BASE_INVALID != ucNumberBase ) )
+        {
+            ulPeriod = (uint32_t)strtoul( pcPeriod, &ptr, ucNumberBase );
+        }
+        vMemWatchRun( true, ulPeriod );
+        vMemWatchStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Memory watch on, every %lu ms.\r\n", (unsigned long)xStatus.ulPeriodMs );
+    }
+    else if( strncmp( pcParameter, "off", strlen( "off" ) ) == 0 )
+    {
+        mwatch_status_t xStatus;
+        vMemWatchStatus( &xStatus );
+        vMemWatchRun( false, xStatus.ulPeriodMs );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Memory watch off.\r\n" );
+    }
+    else if( strncmp( pcParameter, "log", strlen( "log" ) ) == 0 )
+    {
+        /* take only what fits, the rest stays for the next 'log' */
+        mwatch_change_t xChange[16];
+        mwatch_status_t xStatus;
+        size_t xLines = ( xWriteBufferLen - 64U ) / 64U;
+        size_t n;
+
+        do
+        {
+            n = xMemWatchRead( xChange, ( xLines < 16U ) ? xLines : 16U );
+            for( size_t i = 0; i < n; i++ )
+            {
+                ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                                   "%10lu ms  %08lX: %08lX -> %08lX\r\n", (unsigned long)xChange[i].ulTimeMs,
+                                   (unsigned long)xChange[i].ulAddr, (unsigned long)xChange[i].ulOld, (unsigned long)xChange[i].ulNew );
+            }
+            xLines -= n;
+        } while( ( n != 0U ) && ( xLines != 0U ) );
+        vMemWatchStatus( &xStatus );
+        if( 0U != xStatus.ulPending )
+        {
+            ( void ) snprintf( pcWriteBuffer + strlen( pcWriteBuffer ), xWriteBufferLen - strlen(pcWriteBuffer),
+                               "... %lu more\r\n", (unsigned long)xStatus.ulPending );
+        }
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        mwatch_status_t xStatus;
+        vMemWatchStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                           "Memory watch %s, target %s, every %lu ms\r\nRegions: %lu, bytes: %lu, passes: %lu, last pass: %lu ms\r\nChanges: %lu, pending: %lu, dropped: %lu\r\n",
+                           xStatus.xRunning ? "on" : "off", xStatus.xLinkUp ? "connected" : "not connected",
+                           (unsigned long)xStatus.ulPeriodMs, (unsigned long)xStatus.ulRegions, (unsigned long)xStatus.ulBytes,
+                           (unsigned long)xStatus.ulPasses, (unsigned long)xStatus.ulLastPassMs, (unsigned long)xStatus.ulChanges,
+                           (unsigned long)xStatus.ulPending, (unsigned long)xStatus.ulDropped );
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'add', 'clear', 'on', 'off', 'log' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "mwatch" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xMemWatchCmd =
+{
+    "mwatch",
+    "\r\nmwatch <add <addr> <size> | clear | on [period ms] | off | log | status>:\r\n Memory watch. Reads the regions every period and logs only the words that changed against a psram baseline; 'log' prints and takes the logged changes.\r\n",
+    prvMemWatchCommand, /* The function to run. */
+    -1                  /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the semi command.
+ */
+static BaseType_t prvSemiCommand( char * pcWriteBuffer,
+                                  size_t xWriteBufferLen,
+                                  const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "on", strlen( "on" ) ) == 0 )
+    {
+        vSemiRun( true );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Semihosting on, console on cdc 2.\r\n" );
+    }
+    else if( strncmp( pcParameter, "off", strlen( "off" ) ) == 0 )
+    {
+        vSemiRun( false );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Semihosting off.\r\n" );
+    }
+    else if( strncmp( pcParameter, "time", strlen( "time" ) ) == 0 )
+    {
+        /* "time <seconds since 1970>" */
+        const char * pcTime = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcTime );
+        if( ( NULL == pcTime ) || ( (int)BASE_INVALID == ucNumberBase ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'semi time' : <seconds since 1970> expected!!!\r\n" );
+            return pdFALSE;
+        }
+        vSemiSetTime( (uint32_t)strtoul( pcTime, &ptr, ucNumberBase ) );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "SYS_TIME set.\r\n" );
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        semi_status_t xStatus;
+        vSemiStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                           "Semihosting %s, target %s\r\nCalls: %lu, console bytes: %lu, left to host: %lu, SYS_TIME: %lu\r\n",
+                           xStatus.xRunning ? "on" : "off", xStatus.xLinkUp ? "connected" : "not connected",
+                           (unsigned long)xStatus.ulCalls, (unsigned long)xStatus.ulBytes,
+                           (unsigned long)xStatus.ulPassed, (unsigned long)xStatus.ulTime );
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'on', 'off', 'time' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "semi" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xSemiCmd =
+{
+    "semi",
+    "\r\nsemi <on | off | time <seconds since 1970> | status>:\r\n Semihosting service. 'on' lets the probe service BKPT 0xAB console and clock calls itself and resume the core at once, console output goes to cdc 2.\r\n",
+    prvSemiCommand, /* The function to run. */
+    -1              /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the swo command.
+ */
+static BaseType_t prvSwoCommand( char * pcWriteBuffer,
+                                 size_t xWriteBufferLen,
+                                 const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "on", strlen( "on" ) ) == 0 )
+    {
+        /* "on <baud> [cpu hz]" */
+        const char * pcBaud = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        const char * pcCpu = FreeRTOS_CLIGetParameter( pcCommandString, 3, &lParameterStringLength );
+        int ucNumberBase = (int)eUtilGetNumberBase( pcBaud );
+        uint32_t ulCpuHz = 0U;
+        if( ( NULL == pcBaud ) || ( (int)BASE_INVALID == ucNumberBase ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swo on' : <baud> expected!!!\r\n" );
+            return pdFALSE;
+        }
+        uint32_t ulBaud = (uint32_t)strtoul( pcBaud, &ptr, ucNumberBase );
+        if( NULL != pcCpu )
+        {
+            ucNumberBase = (int)eUtilGetNumberBase( pcCpu );
+            if( (int)BASE_INVALID == ucNumberBase )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swo on' : [cpu hz] must be a number!!!\r\n" );
+                return pdFALSE;
+            }
+            ulCpuHz = (uint32_t)strtoul( pcCpu, &ptr, ucNumberBase );
+        }
+        if( xSwoStart( ulBaud, ulCpuHz ) == pdPASS )
+        {
+            swo_status_t xStatus;
+            vSwoStatus( &xStatus );
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "SWO on at %lu baud%s, port 0 on cdc 2.\r\n",
+                               (unsigned long)xStatus.ulBaud, ( ulCpuHz != 0U ) ? ", target set up" : "" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "SWO not started: no SWO_PIN on this board, baud rate above %lu or target not reachable.\r\n",
+                               (unsigned long)SWO_BAUD_MAX );
+        }
+    }
+    else if( strncmp( pcParameter, "off", strlen( "off" ) ) == 0 )
+    {
+        vSwoStop();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "SWO off.\r\n" );
+    }
+    else if( strncmp( pcParameter, "stream", strlen( "stream" ) ) == 0 )
+    {
+        /* "stream <n> <port | off>" */
+        const char * pcStream = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        const char * pcPort = FreeRTOS_CLIGetParameter( pcCommandString, 3, &lParameterStringLength );
+        int ucStreamBase = (int)eUtilGetNumberBase( pcStream );
+        int ucPortBase = (int)eUtilGetNumberBase( pcPort );
+        uint32_t ulPort;
+        if( ( NULL == pcStream ) || ( NULL == pcPort ) || ( (int)BASE_INVALID == ucStreamBase ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swo stream' : <n> <port | off> expected!!!\r\n" );
+            return pdFALSE;
+        }
+        if( strncmp( pcPort, "off", strlen( "off" ) ) == 0 )
+        {
+            ulPort = ITM_STREAM_OFF;
+        }
+        else if( (int)BASE_INVALID != ucPortBase )
+        {
+            ulPort = (uint32_t)strtoul( pcPort, &ptr, ucPortBase );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swo stream' : <port> must be a number or 'off'!!!\r\n" );
+            return pdFALSE;
+        }
+        if( xItmStream( (uint32_t)strtoul( pcStream, &ptr, ucStreamBase ), ulPort ) == pdPASS )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Stream set.\r\n" );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Streams are 0 to %u, ports 0 to %u!!!\r\n",
+                               (unsigned)( ITM_STREAMS - 1U ), (unsigned)( ITM_PORTS - 1U ) );
+        }
+    }
+    else if( strncmp( pcParameter, "clear", strlen( "clear" ) ) == 0 )
+    {
+        vItmClear();
+        vExcTraceClear();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Counters cleared.\r\n" );
+    }
+    else if( strncmp( pcParameter, "exc", strlen( "exc" ) ) == 0 )
+    {
+        /* "exc [number]" */
+        const char * pcNumber = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        exc_trace_status_t xStatus;
+        exc_trace_stats_t xStats;
+        int lLen;
+        vExcTraceStatus( &xStatus );
+        lLen = snprintf( pcWriteBuffer, xWriteBufferLen,
+                         "Exception trace packets: %lu, unmatched: %lu, lost stacks: %lu, untracked: %lu, deepest nesting: %lu\r\n",
+                         (unsigned long)xStatus.ulEvents, (unsigned long)xStatus.ulUnmatched, (unsigned long)xStatus.ulLost,
+                         (unsigned long)xStatus.ulUntracked, (unsigned long)xStatus.ulMaxDepth );
+        if( NULL != pcNumber )
+        {
+            int ucNumberBase = (int)eUtilGetNumberBase( pcNumber );
+            uint32_t ulNumber = ( (int)BASE_INVALID == ucNumberBase ) ? EXC_TRACE_NUMBERS : (uint32_t)strtoul( pcNumber, &ptr, ucNumberBase );
+            if( xExcTraceGet( ulNumber, &xStats ) != pdPASS )
+            {
+                ( void ) snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "'swo exc' : <number> 0 to %u expected!!!\r\n",
+                                   (unsigned)( EXC_TRACE_NUMBERS - 1U ) );
+                return pdFALSE;
+            }
+            lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "Exception %lu residence (cycles):\r\n", (unsigned long)ulNumber );
+            for( uint32_t b = 0U; b < EXC_TRACE_BINS; b++ )
+            {
+                lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "  %s %8lu : %lu\r\n",
+                                  ( b == ( EXC_TRACE_BINS - 1U ) ) ? ">=" : "< ",
+                                  (unsigned long)( 1UL << ( EXC_TRACE_BIN_SHIFT + b - ( ( b == ( EXC_TRACE_BINS - 1U ) ) ? 1U : 0U ) ) ),
+                                  (unsigned long)xStats.ulBin[b] );
+            }
+            return pdFALSE;
+        }
+        lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "  exc    entries      min     mean      max  depth\r\n" );
+        for( uint32_t n = 0U; n < EXC_TRACE_NUMBERS; n++ )
+        {
+            if( ( xExcTraceGet( n, &xStats ) == pdPASS ) && ( xStats.ulEntries != 0U ) )
+            {
+                lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "  %3lu %10lu %8lu %8lu %8lu %6lu\r\n",
+                                  (unsigned long)n, (unsigned long)xStats.ulEntries, (unsigned long)xStats.ulMin,
+                                  (unsigned long)( xStats.ullSum / xStats.ulEntries ), (unsigned long)xStats.ulMax,
+                                  (unsigned long)xStats.ulMaxDepth );
+            }
+        }
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        swo_status_t xStatus;
+        itm_stats_t xStats;
+        int lLen;
+        vSwoStatus( &xStatus );
+        vItmStats( &xStats );
+        lLen = snprintf( pcWriteBuffer, xWriteBufferLen,
+                         "SWO %s, %lu baud, captured: %lu, overrun: %lu\r\n"
+                         "Parsed: %lu, sync: %lu, overflow: %lu, timestamp: %lu, extension: %lu, reserved: %lu\r\n"
+                         "Console: %lu, stream dropped: %lu, exception: %lu, pc sample: %lu, data trace: %lu\r\n"
+                         "Events cpi: %lu, exc: %lu, sleep: %lu, lsu: %lu, fold: %lu, cyc: %lu\r\n",
+                         xStatus.xRunning ? "on" : "off", (unsigned long)xStatus.ulBaud,
+                         (unsigned long)xStatus.ulBytes, (unsigned long)xStatus.ulOverrun,
+                         (unsigned long)xStats.ulBytes, (unsigned long)xStats.ulSync, (unsigned long)xStats.ulOverflow,
+                         (unsigned long)xStats.ulTimestamp, (unsigned long)xStats.ulExtension, (unsigned long)xStats.ulReserved,
+                         (unsigned long)xStats.ulConsole, (unsigned long)xStats.ulDropped, (unsigned long)xStats.ulException,
+                         (unsigned long)xStats.ulPcSample, (unsigned long)xStats.ulDataTrace,
+                         (unsigned long)xStats.ulEvent[ITM_EVENT_CPI], (unsigned long)xStats.ulEvent[ITM_EVENT_EXC],
+                         (unsigned long)xStats.ulEvent[ITM_EVENT_SLEEP], (unsigned long)xStats.ulEvent[ITM_EVENT_LSU],
+                         (unsigned long)xStats.ulEvent[ITM_EVENT_FOLD], (unsigned long)xStats.ulEvent[ITM_EVENT_CYC] );
+        for( uint32_t s = 0U; s < ITM_STREAMS; s++ )
+        {
+            uint32_t ulPort = ulItmStreamPort( s );
+            if( ulPort != ITM_STREAM_OFF )
+            {
+                lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen, "Stream %lu: port %lu, packets: %lu, pending: %lu\r\n",
+                                  (unsigned long)s, (unsigned long)ulPort, (unsigned long)xStats.ulPort[ulPort],
+                                  (unsigned long)xItmPending( s ) );
+            }
+        }
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'on', 'off', 'stream', 'clear', 'exc' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "swo" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xSwoCmd =
+{
+    "swo",
+    "\r\nswo <on <baud> [cpu hz] | off | stream <n> <port | off> | clear | exc [number] | status>:\r\n SWO capture and ITM demultiplexer. Stimulus port 0 goes to cdc 2, a port mapped to a stream is kept in psram for the host; with [cpu hz] 'on' sets up the target TPIU, ITM and exception trace as well. 'exc' lists entries, residence and nesting per exception, with a number its residence histogram.\r\n",
+    prvSwoCommand,  /* The function to run. */
+    -1              /* The user can enter any number of commands. */
+};
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Implements the swclk command.
+ */
+static BaseType_t prvSwclkCommand( char * pcWriteBuffer,
+                                   size_t xWriteBufferLen,
+                                   const char * pcCommandString )
+{
+    const char * pcParameter;
+    BaseType_t lParameterStringLength;
+    char * ptr;
+
+    /* Remove compile time warnings about unused parameters, and check the
+        * write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+        * write buffer length is adequate, so does not check for buffer overflows. */
+    configASSERT( pcWriteBuffer );
+
+    /* clear write buffer */
+    memset( pcWriteBuffer, 0x00, xWriteBufferLen );
+
+    /* Obtain the sub command. */
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &lParameterStringLength );
+    if( NULL == pcParameter )
+    {
+        pcParameter = "status";
+    }
+
+    if( strncmp( pcParameter, "tune", strlen( "tune" ) ) == 0 )
+    {
+        /* "tune [ram addr]" */
+        const char * pcAddr = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        swclk_tune_entry_t xEntry;
+        swclk_tune_status_t xStatus;
+        uint32_t ulAddr = 0U;
+        uint8_t ucAck;
+        if( NULL != pcAddr )
+        {
+            int ucNumberBase = (int)eUtilGetNumberBase( pcAddr );
+            if( (int)BASE_INVALID == ucNumberBase )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swclk tune' : [ram addr] must be a number!!!\r\n" );
+                return pdFALSE;
+            }
+            ulAddr = (uint32_t)strtoul( pcAddr, &ptr, ucNumberBase );
+        }
+        ucAck = ucSwclkTune( NULL != pcAddr, ulAddr, &xEntry );
+        vSwclkTuneStatus( &xStatus );
+        if( DAP_TRANSFER_OK == ucAck )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                               "DPIDR 0x%08lx TARGETID 0x%08lx: fastest %lu kHz, settled on %lu kHz (delay %lu), %lu steps, %lu failed.\r\n",
+                               (unsigned long)xEntry.ulDpidr, (unsigned long)xEntry.ulTargetId,
+                               (unsigned long)ulSwclkTuneKhz( xEntry.ulFastest ), (unsigned long)ulSwclkTuneKhz( xEntry.ulDelay ),
+                               (unsigned long)xEntry.ulDelay, (unsigned long)xStatus.ulSteps, (unsigned long)xStatus.ulFailed );
+        }
+        else
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Tune failed (ack 0x%02x): no target, or the clock in use fails the pattern already.\r\n",
+                               (unsigned)ucAck );
+        }
+    }
+    else if( strncmp( pcParameter, "auto", strlen( "auto" ) ) == 0 )
+    {
+        /* "auto <on | off>" */
+        const char * pcMode = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        if( ( NULL == pcMode ) || ( ( strncmp( pcMode, "on", strlen( "on" ) ) != 0 ) && ( strncmp( pcMode, "off", strlen( "off" ) ) != 0 ) ) )
+        {
+            ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swclk auto' : <on | off> expected!!!\r\n" );
+            return pdFALSE;
+        }
+        vSwclkTuneAuto( strncmp( pcMode, "on", strlen( "on" ) ) == 0 );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Cached clocks %s on connect.\r\n",
+                           ( strncmp( pcMode, "on", strlen( "on" ) ) == 0 ) ? "used" : "not used" );
+    }
+    else if( strncmp( pcParameter, "sample", strlen( "sample" ) ) == 0 )
+    {
+        /* "sample [cal [ram addr] | <point>]" */
+        const char * pcArg = FreeRTOS_CLIGetParameter( pcCommandString, 2, &lParameterStringLength );
+        swclk_tune_status_t xStatus;
+        if( ( NULL != pcArg ) && ( strncmp( pcArg, "cal", strlen( "cal" ) ) == 0 ) )
+        {
+            const char * pcAddr = FreeRTOS_CLIGetParameter( pcCommandString, 3, &lParameterStringLength );
+            swclk_sample_t xSample;
+            uint32_t ulAddr = 0U;
+            uint8_t ucAck;
+            if( NULL != pcAddr )
+            {
+                int ucNumberBase = (int)eUtilGetNumberBase( pcAddr );
+                if( (int)BASE_INVALID == ucNumberBase )
+                {
+                    ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swclk sample cal' : [ram addr] must be a number!!!\r\n" );
+                    return pdFALSE;
+                }
+                ulAddr = (uint32_t)strtoul( pcAddr, &ptr, ucNumberBase );
+            }
+            ucAck = ucSwclkSample( NULL != pcAddr, ulAddr, &xSample );
+            if( DAP_TRANSFER_OK == ucAck )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                                   "%lu kHz: points passed 0x%02lx, settled on point %lu%s.\r\n",
+                                   (unsigned long)ulSwclkTuneKhz( xSample.ulDelay ), (unsigned long)xSample.ulPass,
+                                   (unsigned long)xSample.ulPoint, xSample.xCached ? ", cached with the clock" : "" );
+            }
+            else if( DAP_TRANSFER_ERROR == ucAck )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "The sample point needs the pio swd engine.\r\n" );
+            }
+            else
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Calibration failed (ack 0x%02x, points passed 0x%02lx): no target, or no point passes at this clock.\r\n",
+                                   (unsigned)ucAck, (unsigned long)xSample.ulPass );
+            }
+            return pdFALSE;
+        }
+        if( NULL != pcArg )
+        {
+            int ucNumberBase = (int)eUtilGetNumberBase( pcArg );
+            if( ( (int)BASE_INVALID == ucNumberBase ) || ( xSwclkSampleSet( (uint32_t)strtoul( pcArg, &ptr, ucNumberBase ) ) != pdPASS ) )
+            {
+                ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "'swclk sample' : <point> must be 0 to %u, on the pio swd engine!!!\r\n",
+                                   (unsigned)( PROBE_SAMPLE_POINTS - 1 ) );
+                return pdFALSE;
+            }
+        }
+        vSwclkTuneStatus( &xStatus );
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen,
+                           "SWDIO sample point %lu of 0..%u (%u is the posedge, a step is a quarter SWCLK period or 2 clk_sys), last calibration passed 0x%02lx.\r\n",
+                           (unsigned long)xStatus.ulSample, (unsigned)( PROBE_SAMPLE_POINTS - 1 ), (unsigned)PROBE_SAMPLE_DEFAULT,
+                           (unsigned long)xStatus.ulEye );
+    }
+    else if( strncmp( pcParameter, "clear", strlen( "clear" ) ) == 0 )
+    {
+        vSwclkTuneClear();
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Cache cleared.\r\n" );
+    }
+    else if( strncmp( pcParameter, "status", strlen( "status" ) ) == 0 )
+    {
+        swclk_tune_status_t xStatus;
+        swclk_tune_entry_t xEntry;
+        int lLen;
+        vSwclkTuneStatus( &xStatus );
+        lLen = snprintf( pcWriteBuffer, xWriteBufferLen, "SWCLK now %lu kHz (delay %lu, sample point %lu), cached clocks %s on connect, applied %lu times\r\n",
+                         (unsigned long)ulSwclkTuneKhz( DAP_Data.clock_delay ), (unsigned long)DAP_Data.clock_delay, (unsigned long)xStatus.ulSample,
+                         xStatus.xAuto ? "used" : "not used", (unsigned long)xStatus.ulApplied );
+        for( uint32_t i = 0U; xSwclkTuneEntry( i, &xEntry ) == pdPASS; i++ )
+        {
+            lLen += snprintf( &pcWriteBuffer[lLen], xWriteBufferLen - (size_t)lLen,
+                              "  DPIDR 0x%08lx TARGETID 0x%08lx: %lu kHz (delay %lu, sample point %lu), fastest passed %lu kHz\r\n",
+                              (unsigned long)xEntry.ulDpidr, (unsigned long)xEntry.ulTargetId,
+                              (unsigned long)ulSwclkTuneKhz( xEntry.ulDelay ), (unsigned long)xEntry.ulDelay, (unsigned long)xEntry.ulSample,
+                              (unsigned long)ulSwclkTuneKhz( xEntry.ulFastest ) );
+        }
+    }
+    else
+    {
+        ( void ) snprintf( pcWriteBuffer, xWriteBufferLen, "Valid parameters are 'tune', 'auto', 'sample', 'clear' and 'status'.\r\n" );
+    }
+
+    /* There is no more data to return after this single string, so return
+     * pdFALSE. */
+    return pdFALSE;
+}
+
+/* Structure that defines the "swclk" command line command. */
+commandREGISTER static const CLI_Command_Definition_t xSwclkCmd =
+{
+    "swclk",
+    "\r\nswclk <tune [ram addr] | auto <on | off> | sample [cal [ram addr] | <point>] | clear | status>:\r\n SWCLK auto-tune. 'tune' binary searches the fastest clock that passes DPIDR reads (and a write/read back pattern at [ram addr]) and caches it, with a margin, by DPIDR and TARGETID; probe connects switch to the cached clock while 'auto' is on. 'sample cal' runs the pattern at every SWDIO sample point and settles on the middle of the passing ones.\r\n",
+    prvSwclkCommand,    /* The function to run. */
+    -1                  /* The user can enter any number of commands. */
+};
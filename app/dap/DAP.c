@@ -28,6 +28,8 @@
 #include <string.h>
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dapStats.h"
+#include "dapReadAhead.h"
 #include "rp2350.h"
 
 #if (DAP_PACKET_SIZE < 64U)
@@ -52,6 +54,9 @@
          DAP_Data_t DAP_Data;           // DAP Data
 volatile uint8_t    DAP_TransferAbort;  // Transfer Abort Flag
 
+static const uint8_t *DAP_RequestHead;  // Start of the request packet being executed
+static       uint8_t *DAP_ResponseHead; // Start of its response packet
+
 
 static const char DAP_FW_Ver [] = DAP_FW_VER;
 
@@ -265,6 +270,8 @@ static unsigned int DAP_Connect(const uint8_t *request, uint8_t *response) {
       port = DAP_PORT_DISABLED;
       break;
   }
+  // the probe services leave the connect sequence to the host from here on
+  vTargetHostPort(port != DAP_PORT_DISABLED);
 
   *response = (uint8_t)port;
   return ((1U << 16) | 1U);
@@ -278,6 +285,7 @@ static unsigned int DAP_Disconnect(uint8_t *response) {
 
   DAP_Data.debug_port = DAP_PORT_DISABLED;
   PORT_OFF();
+  vTargetHostPort(false);
 
   *response = DAP_OK;
   return (1U);
@@ -716,6 +724,9 @@ static unsigned int DAP_SWD_Transfer(const uint8_t *request, uint8_t *response)
   while (request_count != 0) {
     request_count--;
     request_value = *request++;
+#if (DAP_READAHEAD != 0)
+    vDapReadAheadBefore(request_value);
+#endif
     if ((request_value & DAP_TRANSFER_RnW) != 0U) {
       // Read register
       if (post_read) {
@@ -889,11 +900,19 @@ static unsigned int DAP_SWD_Transfer(const uint8_t *request, uint8_t *response)
         check_write = 1U;
       }
     }
+#if (DAP_READAHEAD != 0)
+    vDapReadAheadAfter(request_value, data, DAP_TRANSFER_OK);
+#endif
     response_count++;
     if (DAP_TransferAbort) {
       break;
     }
   }
+#if (DAP_READAHEAD != 0)
+  if (response_value != DAP_TRANSFER_OK) {
+    vDapReadAheadAfter(request_value, data, response_value);
+  }
+#endif
 
   while (request_count != 0) {
     // Process canceled requests
@@ -1301,11 +1320,17 @@ static unsigned int DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *respo
   uint8_t  *response_head;
   unsigned int  retry;
   unsigned int  data;
+#if (DAP_READAHEAD != 0)
+  unsigned int  served = 0U;
+#endif
 
   response_count = 0U;
   response_value = 0U;
   response_head  = response;
   response      += 3;
+#if (DAP_READAHEAD != 0)
+  request_value  = 0U;
+#endif
 
   DAP_TransferAbort = 0U;
 
@@ -1321,6 +1346,18 @@ static unsigned int DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *respo
   request_value = *request++;
   if ((request_value & DAP_TRANSFER_RnW) != 0U) {
     // Read register block
+#if (DAP_READAHEAD != 0)
+    // Serve the head from data read ahead, the rest comes from the target
+    served = ulDapReadAheadTake(request_value, request_count, response);
+    response      += served * 4U;
+    response_count = served;
+    request_count -= served;
+    response_value = DAP_TRANSFER_OK;
+    if (request_count == 0U) {
+      goto end;
+    }
+    vDapReadAheadBefore(request_value);
+#endif
     if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
       // Post AP read
       retry = DAP_Data.transfer.retry_count;
@@ -1353,6 +1390,9 @@ static unsigned int DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *respo
     }
   } else {
     // Write register block
+#if (DAP_READAHEAD != 0)
+    vDapReadAheadBefore(request_value);
+#endif
     while (request_count--) {
       // Load data
       data = (unsigned int)(*(request+0) <<  0) |
@@ -1365,6 +1405,9 @@ static unsigned int DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *respo
       do {
         response_value = SWD_Transfer(request_value, &data);
       } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+#if (DAP_READAHEAD != 0)
+      vDapReadAheadAfter(request_value, data, response_value);
+#endif
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
@@ -1378,6 +1421,11 @@ static unsigned int DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *respo
   }
 
 end:
+#if (DAP_READAHEAD != 0)
+  if ((request_value & DAP_TRANSFER_RnW) != 0U) {
+    vDapReadAheadBlockEnd(request_value, served, response_count - served, response_value);
+  }
+#endif
   *(response_head+0) = (uint8_t)(response_count >> 0);
   *(response_head+1) = (uint8_t)(response_count >> 8);
   *(response_head+2) = (uint8_t) response_value;
@@ -1636,6 +1684,19 @@ __attribute__((weak)) unsigned int DAP_ProcessVendorCommand(const uint8_t *reque
 }
 
 
+// Get the request length of a DAP Vendor command from its leading bytes
+// Default function (can be overridden)
+//   request: pointer to request data
+//   count:   number of request bytes received
+//   return:  number of bytes in request, more than count when the received bytes
+//            do not tell yet, 0 for a command of unknown length
+__attribute__((weak)) unsigned int DAP_VendorRequestLength(const uint8_t *request, unsigned int count) {
+  (void)request;
+  (void)count;
+  return (1U);
+}
+
+
 // Process DAP command request and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -1644,6 +1705,10 @@ __attribute__((weak)) unsigned int DAP_ProcessVendorCommand(const uint8_t *reque
 unsigned int DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
   unsigned int num;
 
+#if (DAP_READAHEAD != 0)
+  vDapReadAheadCommand(*request);
+#endif
+
   if ((*request >= ID_DAP_Vendor0) && (*request <= ID_DAP_Vendor31)) {
     return DAP_ProcessVendorCommand(request, response);
   }
@@ -1775,21 +1840,179 @@ unsigned int DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
 unsigned int DAP_ExecuteCommand(const uint8_t *request, uint8_t *response) {
   unsigned int cnt, num, n;
 
+  // Commands of a batch measure their room from here, not from their own pointers
+  DAP_RequestHead  = request;
+  DAP_ResponseHead = response;
+
   if (*request == ID_DAP_ExecuteCommands) {
+    // Batch header is accounted separately from the commands it carries
+    vDapStatsBegin(ID_DAP_ExecuteCommands);
+    vDapStatsEnd((2U << 16) | 2U);
     *response++ = *request++;
     cnt = *request++;
     *response++ = (uint8_t)cnt;
     num = (2U << 16) | 2U;
     while (cnt--) {
+      vDapStatsBegin(*request);
       n = DAP_ProcessCommand(request, response);
+      vDapStatsEnd(n);
       num += n;
       request  += (uint16_t)(n >> 16);
       response += (uint16_t) n;
+#if (DAP_RESPONSE_STREAM != 0)
+      // Everything up to here is final, let the transport send it
+      DAP_ResponseProgress(response);
+#endif
     }
     return (num);
   }
 
-  return DAP_ProcessCommand(request, response);
+  vDapStatsBegin(*request);
+  num = DAP_ProcessCommand(request, response);
+  vDapStatsEnd(num);
+  return (num);
+}
+
+
+// Get the room left in the request packet being executed
+//   request: pointer into the request packet
+//   return:  number of bytes from request to the end of the packet
+unsigned int DAP_RequestRoom(const uint8_t *request) {
+  return (DAP_PACKET_SIZE - (unsigned int)(request - DAP_RequestHead));
+}
+
+
+// Get the room left in the response packet being built
+//   response: pointer into the response packet
+//   return:   number of bytes from response to the end of the packet
+unsigned int DAP_ResponseRoom(const uint8_t *response) {
+  return (DAP_PACKET_SIZE - (unsigned int)(response - DAP_ResponseHead));
+}
+
+
+// Get the request length of a DAP command from its leading bytes, the transport
+// uses it to find the end of a request that fills whole USB packets
+//   request: pointer to request data
+//   count:   number of request bytes received
+//   return:  number of bytes in request, more than count when the received bytes
+//            do not tell yet, 0 for a command of unknown length
+unsigned int DAP_RequestLength(const uint8_t *request, unsigned int count) {
+  unsigned int num, n, info, bits;
+
+  if (count == 0U) {
+    return (1U);
+  }
+  if ((*request >= ID_DAP_Vendor0) && (*request <= ID_DAP_Vendor31)) {
+    return DAP_VendorRequestLength(request, count);
+  }
+
+  switch (*request) {
+    case ID_DAP_Disconnect:
+    case ID_DAP_TransferAbort:
+    case ID_DAP_ResetTarget:
+    case ID_DAP_SWO_Status:
+      return (1U);
+    case ID_DAP_Info:
+    case ID_DAP_Connect:
+    case ID_DAP_SWD_Configure:
+    case ID_DAP_JTAG_IDCODE:
+    case ID_DAP_SWO_Transport:
+    case ID_DAP_SWO_Mode:
+    case ID_DAP_SWO_Control:
+    case ID_DAP_SWO_ExtendedStatus:
+      return (2U);
+    case ID_DAP_HostStatus:
+    case ID_DAP_Delay:
+    case ID_DAP_SWO_Data:
+      return (3U);
+    case ID_DAP_SWJ_Clock:
+    case ID_DAP_SWO_Baudrate:
+      return (5U);
+    case ID_DAP_TransferConfigure:
+    case ID_DAP_WriteABORT:
+      return (6U);
+    case ID_DAP_SWJ_Pins:
+      return (7U);
+    case ID_DAP_SWJ_Sequence:
+      if (count < 2U) {
+        return (count + 1U);
+      }
+      bits = request[1];
+      if (bits == 0U) {
+        bits = 256U;
+      }
+      return (2U + ((bits + 7U) / 8U));
+    case ID_DAP_JTAG_Configure:
+      if (count < 2U) {
+        return (count + 1U);
+      }
+      return (2U + request[1]);
+    case ID_DAP_SWD_Sequence:
+    case ID_DAP_JTAG_Sequence:
+      if (count < 2U) {
+        return (count + 1U);
+      }
+      num = 2U;
+      for (n = request[1]; n != 0U; n--) {
+        if (num >= count) {
+          return (count + 1U);
+        }
+        info = request[num++];
+        bits = info & SWD_SEQUENCE_CLK;
+        if (bits == 0U) {
+          bits = 64U;
+        }
+        // SWD captures instead of sending, JTAG always sends TDI
+        if ((*request == ID_DAP_JTAG_Sequence) || ((info & SWD_SEQUENCE_DIN) == 0U)) {
+          num += (bits + 7U) / 8U;
+        }
+      }
+      return (num);
+    case ID_DAP_Transfer:
+      if (count < 3U) {
+        return (count + 1U);
+      }
+      num = 3U;
+      for (n = request[2]; n != 0U; n--) {
+        if (num >= count) {
+          return (count + 1U);
+        }
+        info = request[num++];
+        if (((info & DAP_TRANSFER_RnW) == 0U) || ((info & DAP_TRANSFER_MATCH_VALUE) != 0U)) {
+          num += 4U;
+        }
+      }
+      return (num);
+    case ID_DAP_TransferBlock:
+      if (count < 5U) {
+        return (count + 1U);
+      }
+      if ((request[4] & DAP_TRANSFER_RnW) != 0U) {
+        return (5U);
+      }
+      return (5U + (((unsigned int)request[2] | ((unsigned int)request[3] << 8)) * 4U));
+    case ID_DAP_QueueCommands:
+    case ID_DAP_ExecuteCommands:
+      if (count < 2U) {
+        return (count + 1U);
+      }
+      num = 2U;
+      for (n = request[1]; n != 0U; n--) {
+        if (num >= count) {
+          return (count + 1U);
+        }
+        bits = DAP_RequestLength(request + num, count - num);
+        if (bits == 0U) {
+          // a command of unknown length ends the batch parsing as well
+          return (0U);
+        }
+        num += bits;
+      }
+      return (num);
+    default:
+      // UART and unknown commands: the packet they are in ends them
+      return (0U);
+  }
 }
 
 
@@ -316,8 +316,13 @@ extern unsigned int UART_Transfer  (const uint8_t *request, uint8_t *response);
 extern uint8_t  USB_COM_PORT_Activate (unsigned int cmd);
 
 extern unsigned int DAP_ProcessVendorCommand (const uint8_t *request, uint8_t *response);
+extern unsigned int DAP_VendorRequestLength  (const uint8_t *request, unsigned int count);
 extern unsigned int DAP_ProcessCommand       (const uint8_t *request, uint8_t *response);
 extern unsigned int DAP_ExecuteCommand       (const uint8_t *request, uint8_t *response);
+extern unsigned int DAP_RequestLength        (const uint8_t *request, unsigned int count);
+extern unsigned int DAP_RequestRoom          (const uint8_t *request);
+extern unsigned int DAP_ResponseRoom         (const uint8_t *response);
+extern void         DAP_ResponseProgress     (const uint8_t *response);
 
 extern void     DAP_Setup (void);
 
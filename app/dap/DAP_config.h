@@ -90,13 +90,23 @@ This information includes:
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. Typical vales are 64 for Full-speed USB HID or WinUSB,
 /// 1024 for High-speed USB HID and 512 for High-speed USB WinUSB.
-#define DAP_PACKET_SIZE         64U            ///< Specifies Packet Size in bytes.
+/// Larger than the endpoint here: a response spans several USB packets, so it can be streamed
+/// while the commands behind it run, requests are assembled from packets by the transport.
+#define DAP_PACKET_SIZE         256U           ///< Specifies Packet Size in bytes.
 
 /// Maximum Package Buffers for Command and Response data.
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. For devices with limited RAM or USB buffer the
 /// setting can be reduced (valid range is 1 .. 255).
-#define DAP_PACKET_COUNT        1U              ///< Specifies number of packets buffered.
+#define DAP_PACKET_COUNT        2U              ///< Specifies number of packets buffered.
+
+/// Release the response of a command batch in USB packet sized chunks while it is being built.
+/// Bytes are only released once they are final, so SWD execution of the following commands
+/// overlaps with the USB transmission. Has an effect when DAP_PACKET_SIZE exceeds DAP_USB_EP_SIZE.
+#define DAP_RESPONSE_STREAM     1U              ///< Response streaming: 1 = enabled, 0 = disabled.
+
+/// Max packet size of the USB bulk IN endpoint, granularity of response streaming.
+#define DAP_USB_EP_SIZE         64U             ///< Endpoint size in bytes (power of 2).
 
 /// Indicate that UART Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
@@ -29,6 +29,8 @@
 
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dapStats.h"
+#include "target/target.h"
 #include "FreeRTOS.h"
 #include "task.h"
 
@@ -288,11 +290,15 @@ SWD_TransferFunction(Slow)
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  SWD_Transfer(unsigned int request, unsigned int *data) {
+  uint8_t ack;
   if (DAP_Data.fast_clock) {
-    return SWD_TransferFast(request, data);
+    ack = SWD_TransferFast(request, data);
   } else {
-    return SWD_TransferSlow(request, data);
+    ack = SWD_TransferSlow(request, data);
   }
+  vDapStatsSwdAck(ack);
+  vTargetWire(request, (data != NULL) ? *data : 0U, ack);
+  return ack;
 }
 
 
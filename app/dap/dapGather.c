@@ -0,0 +1,180 @@
+#include <string.h>
+#include "dapGather.h"
+#include "dapVendor.h"
+#include "target/target.h"
+
+#if (DAP_GATHER != 0)
+
+/*-----------------------------------------------------------*/
+
+/* item size byte */
+#define GATHER_SIZE_MASK        0x3FU
+#define GATHER_OFFSET           0x80U
+
+/* requested item */
+typedef struct gather_item_t
+{
+    uint32_t ulAddr;
+    uint8_t ucSize;             // bytes
+    uint8_t ucOut;              // offset in the response data
+} gather_item_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief read one span and hand its bytes to the items in it
+/// @param pxItem : items
+/// @param pucOrder : item indices sorted by address
+/// @param xFirst : first item of the span (sorted index)
+/// @param xLast : behind the last item
+/// @param ulStart : first byte
+/// @param ulEnd : behind the last byte
+/// @param pucData : response data
+/// @return acknowledge
+static uint8_t prvGatherSpan(const gather_item_t * pxItem, const uint8_t * pucOrder, size_t xFirst, size_t xLast,
+                             uint32_t ulStart, uint32_t ulEnd, uint8_t * pucData)
+{
+    uint32_t ulSpan[(DAP_GATHER_SPAN_MAX / 4U) + 2U];
+    const uint8_t * pucSpan = (const uint8_t *)ulSpan;
+
+    if (ulStart < DAP_GATHER_MERGE_LIMIT)
+    {
+        uint32_t ulFrom = ulStart & ~3UL;
+        TARGET_TRY(ucTargetReadBlock(ulFrom, ulSpan, (((ulEnd + 3U) & ~3UL) - ulFrom) / 4U));
+        pucSpan += ulStart - ulFrom;
+    }
+    else
+    {
+        // peripherals: no byte outside the items, no access wider than they are
+        TARGET_TRY(ucTargetReadExact(ulStart, (uint8_t *)ulSpan, ulEnd - ulStart));
+    }
+    for (size_t i = xFirst; i < xLast; i++)
+    {
+        const gather_item_t * px = &pxItem[pucOrder[i]];
+        memcpy(&pucData[px->ucOut], &pucSpan[px->ulAddr - ulStart], px->ucSize);
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief request length of a scatter-gather read command
+/// @param request : request data
+/// @param ulCount : request bytes received
+/// @return number of bytes in request, more than ulCount when the received bytes do not tell yet
+uint32_t ulDapGatherLength(const uint8_t * request, uint32_t ulCount)
+{
+    uint32_t ulLen = 2U;
+
+    if (ulCount < 2U)
+    {
+        return ulCount + 1U;
+    }
+    for (uint32_t i = request[1]; i != 0U; i--)
+    {
+        if (ulLen >= ulCount)
+        {
+            return ulCount + 1U;
+        }
+        ulLen += ((request[ulLen] & GATHER_OFFSET) != 0U) ? 3U : 5U;
+    }
+    return ulLen;
+}
+
+/// @brief process a scatter-gather read command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapGatherCommand(const uint8_t * request, uint8_t * response)
+{
+    gather_item_t xItem[DAP_GATHER_ITEMS];
+    uint8_t ucOrder[DAP_GATHER_ITEMS];
+    const uint8_t * puc = &request[2];
+    uint32_t ulCount = request[1];
+    uint32_t ulPrev = 0U, ulTotal = 0U;
+    uint8_t ucAck = DAP_TRANSFER_OK;
+    // inside a batch both start part-way into their packets
+    uint32_t ulRequestRoom = DAP_RequestRoom(request);
+    uint32_t ulResponseRoom = DAP_ResponseRoom(response);
+
+    // a batch that leaves no room for the header gets nothing
+    if (ulResponseRoom < 2U)
+    {
+        return (2U << 16);
+    }
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+    if (ulCount > DAP_GATHER_ITEMS)
+    {
+        return ((2U << 16) | 2U);
+    }
+    for (uint32_t i = 0U; i < ulCount; i++)
+    {
+        gather_item_t * px = &xItem[i];
+        size_t xLen = ((puc[0] & GATHER_OFFSET) != 0U) ? 3U : 5U;
+        uint32_t j;
+
+        if ((puc + xLen) > &request[ulRequestRoom])
+        {
+            return (((uint32_t)(puc - request) << 16) | 2U);
+        }
+        px->ucSize = (uint8_t)((puc[0] & GATHER_SIZE_MASK) + 1U);
+        if (xLen == 3U)
+            px->ulAddr = ulPrev + ((uint32_t)puc[1] | ((uint32_t)puc[2] << 8));
+        else
+            px->ulAddr = (uint32_t)puc[1] | ((uint32_t)puc[2] << 8) | ((uint32_t)puc[3] << 16) | ((uint32_t)puc[4] << 24);
+        px->ucOut = (uint8_t)ulTotal;
+        ulPrev = px->ulAddr;
+        ulTotal += px->ucSize;
+        puc += xLen;
+        // sorted by address, items usually arrive in order already
+        for (j = i; (j > 0U) && (xItem[ucOrder[j - 1U]].ulAddr > px->ulAddr); j--)
+        {
+            ucOrder[j] = ucOrder[j - 1U];
+        }
+        ucOrder[j] = (uint8_t)i;
+    }
+    if (ulTotal > (ulResponseRoom - 2U))
+    {
+        return (((uint32_t)(puc - request) << 16) | 2U);
+    }
+    memset(&response[2], 0x00, ulTotal);
+
+    vTargetClaim();
+    for (size_t i = 0U, j; i < ulCount; i = j)
+    {
+        uint32_t ulStart = xItem[ucOrder[i]].ulAddr;
+        uint32_t ulEnd = ulStart + xItem[ucOrder[i]].ucSize;
+        bool xMemory = (ulStart < DAP_GATHER_MERGE_LIMIT);
+
+        // join the following items while the span stays small and free of side effects
+        for (j = i + 1U; j < ulCount; j++)
+        {
+            const gather_item_t * px = &xItem[ucOrder[j]];
+            uint32_t ulNewEnd = ((px->ulAddr + px->ucSize) > ulEnd) ? (px->ulAddr + px->ucSize) : ulEnd;
+
+            if ((xMemory != (px->ulAddr < DAP_GATHER_MERGE_LIMIT)) ||
+                (px->ulAddr > (ulEnd + (xMemory ? DAP_GATHER_GAP : 0U))) ||
+                ((((ulNewEnd + 3U) & ~3UL) - (ulStart & ~3UL)) > DAP_GATHER_SPAN_MAX))
+            {
+                break;
+            }
+            ulEnd = ulNewEnd;
+        }
+        ucAck = prvGatherSpan(xItem, ucOrder, i, j, ulStart, ulEnd, &response[2]);
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            break;
+        }
+#if (DAP_RESPONSE_STREAM != 0)
+        // the status is only final at the end, but the responses before this
+        // one in a batch are, they go out while the spans are read
+        DAP_ResponseProgress(response);
+#endif
+    }
+    response[1] = (ucAck == DAP_TRANSFER_OK) ? DAP_OK : DAP_ERROR;
+    return (((uint32_t)(puc - request) << 16) | (2U + ulTotal));
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
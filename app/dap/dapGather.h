@@ -0,0 +1,69 @@
+#ifndef DAP_GATHER_H_
+#define DAP_GATHER_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Scatter-gather memory read (vendor command ID_DAP_VENDOR_GATHER).
+ *
+ *  request  : id count item[count]
+ *  item     : size addr[4]         absolute address
+ *             size|0x80 offset[2]  address = previous item address + offset
+ *  response : id status data (the items' bytes packed in request order)
+ *
+ * size is the number of bytes - 1 (1 .. 64 bytes). The probe sorts the items
+ * by address and merges neighbours into spans. Memory below
+ * DAP_GATHER_MERGE_LIMIT is read in whole words with auto increment, one TAR
+ * write per span, and gaps up to DAP_GATHER_GAP bytes are read through;
+ * above it (peripherals) only touching items are merged and exactly their
+ * bytes are read, with byte and halfword accesses where alignment or size
+ * call for them.
+ *
+ * All items go through the probe's MEM-AP (vTargetSetAp), so there is no AP
+ * switch inside a command. A failing read answers DAP_ERROR, the data is
+ * zero from the failing span on. SELECT, CSW and TAR are as the host left
+ * them afterwards.
+ */
+
+/* 1: scatter-gather command; 0: not built */
+#ifndef DAP_GATHER
+    #define DAP_GATHER              1
+#endif
+
+/* items in one request, the smallest item is 3 bytes */
+#define DAP_GATHER_ITEMS            ((DAP_PACKET_SIZE - 2U) / 3U)
+/* unrequested bytes read through to join two items into one span */
+#define DAP_GATHER_GAP              16U
+/* no read through at and above this address, reads may have side effects */
+#define DAP_GATHER_MERGE_LIMIT      0x40000000UL
+/* largest span (bytes) */
+#define DAP_GATHER_SPAN_MAX         256U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a scatter-gather read command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapGatherCommand(const uint8_t * request, uint8_t * response);
+
+/// @brief request length of a scatter-gather read command
+/// @param request : request data
+/// @param ulCount : request bytes received
+/// @return number of bytes in request, more than ulCount when the received bytes do not tell yet
+uint32_t ulDapGatherLength(const uint8_t * request, uint32_t ulCount);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_GATHER_H_ */
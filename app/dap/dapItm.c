@@ -0,0 +1,105 @@
+#include <string.h>
+#include "dapItm.h"
+#include "dapVendor.h"
+#include "trace/itm.h"
+#include "trace/excTrace.h"
+
+#if (DAP_ITM != 0)
+
+/*-----------------------------------------------------------*/
+
+/* READ response: id status len */
+#define ITM_READ_HEADER         3U
+/* EXC response */
+#define ITM_EXC_SIZE            23U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process an itm stream command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapItmCommand(const uint8_t * request, uint8_t * response)
+{
+    response[0] = request[0];
+
+    switch (request[1])
+    {
+        case DAP_ITM_CONFIG:
+            response[1] = (xItmStream(request[2], request[3]) == pdPASS) ? DAP_OK : DAP_ERROR;
+            return ((4U << 16) | 2U);
+        case DAP_ITM_READ:
+        {
+            // inside a batch the response starts part-way into the packet
+            uint32_t ulRoom = DAP_ResponseRoom(response);
+            size_t xLen;
+
+            if (ulRoom < ITM_READ_HEADER)
+            {
+                return (3U << 16);
+            }
+            xLen = xItmRead(request[2], &response[ITM_READ_HEADER], ulRoom - ITM_READ_HEADER);
+
+            response[1] = (request[2] < ITM_STREAMS) ? DAP_OK : DAP_ERROR;
+            response[2] = (uint8_t)xLen;
+            return ((3U << 16) | (ITM_READ_HEADER + xLen));
+        }
+        case DAP_ITM_STATS:
+        {
+            itm_stats_t xStats;
+            uint32_t ulWord[DAP_ITM_STATS_WORDS];
+
+            vItmStats(&xStats);
+            ulWord[0] = xStats.ulBytes;
+            ulWord[1] = xStats.ulSync;
+            ulWord[2] = xStats.ulOverflow;
+            ulWord[3] = xStats.ulTimestamp;
+            ulWord[4] = xStats.ulExtension;
+            ulWord[5] = xStats.ulReserved;
+            ulWord[6] = xStats.ulConsole;
+            ulWord[7] = xStats.ulDropped;
+            ulWord[8] = xStats.ulException;
+            ulWord[9] = xStats.ulPcSample;
+            ulWord[10] = xStats.ulDataTrace;
+            // target byte order is little endian, as is ours
+            memcpy(&response[2], ulWord, sizeof(ulWord));
+            response[1] = DAP_OK;
+            return ((2U << 16) | (2U + sizeof(ulWord)));
+        }
+        case DAP_ITM_EXC:
+        case DAP_ITM_HIST:
+        {
+            exc_trace_stats_t xStats;
+            uint32_t ulNumber = (uint32_t)request[2] | ((uint32_t)request[3] << 8);
+
+            if (xExcTraceGet(ulNumber, &xStats) != pdPASS)
+            {
+                response[1] = DAP_ERROR;
+                return ((4U << 16) | 2U);
+            }
+            response[1] = DAP_OK;
+            if (request[1] == DAP_ITM_HIST)
+            {
+                memcpy(&response[2], xStats.ulBin, sizeof(xStats.ulBin));
+                return ((4U << 16) | (2U + sizeof(xStats.ulBin)));
+            }
+            memcpy(&response[2], &xStats.ulEntries, 4U);
+            response[6] = (uint8_t)xStats.ulMaxDepth;
+            memcpy(&response[7], &xStats.ulMin, 4U);
+            memcpy(&response[11], &xStats.ulMax, 4U);
+            memcpy(&response[15], &xStats.ullSum, 8U);
+            return ((4U << 16) | ITM_EXC_SIZE);
+        }
+        case DAP_ITM_EXC_CLEAR:
+            vExcTraceClear();
+            response[1] = DAP_OK;
+            return ((2U << 16) | 2U);
+        default:
+            response[0] = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DAP_ITM_H_
+#define DAP_ITM_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * ITM stimulus port streams (vendor command ID_DAP_VENDOR_ITM).
+ *
+ *  CONFIG : id 0x00 stream port                -> id status
+ *  READ   : id 0x01 stream                     -> id status len data[len]
+ *  STATS  : id 0x02                            -> id status word[11]
+ *  EXC    : id 0x03 number[2]                  -> id status entries[4] depth min[4] max[4] sum[8]
+ *  HIST   : id 0x04 number[2]                  -> id status word[EXC_TRACE_BINS]
+ *  EXC_CLEAR : id 0x05                         -> id status
+ *
+ * CONFIG maps a stream to a stimulus port (0xFF unmaps it) and empties it.
+ * READ takes the bytes the SWO capture demultiplexed into the stream since
+ * the last READ, len 0 when there are none. STATS words, little endian:
+ * bytes parsed, sync, overflow, timestamp, extension, reserved headers,
+ * console bytes, stream bytes dropped, exception trace, PC samples, data
+ * trace. EXC and HIST give the exception trace statistics of an exception
+ * number (excTrace.h): residence times in timestamp clock cycles, depth the
+ * deepest nesting at entry; DAP_ERROR for a number that is not tracked.
+ * EXC_CLEAR clears them. None of them touches the target.
+ */
+
+/* 1: itm stream command; 0: not built */
+#ifndef DAP_ITM
+    #define DAP_ITM                 1
+#endif
+
+/* sub commands */
+#define DAP_ITM_CONFIG              0x00U
+#define DAP_ITM_READ                0x01U
+#define DAP_ITM_STATS               0x02U
+#define DAP_ITM_EXC                 0x03U
+#define DAP_ITM_HIST                0x04U
+#define DAP_ITM_EXC_CLEAR           0x05U
+
+/* STATS words */
+#define DAP_ITM_STATS_WORDS         11U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process an itm stream command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapItmCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_ITM_H_ */
@@ -0,0 +1,359 @@
+#include "dapReadAhead.h"
+#include "DAP.h"
+#include "pico/time.h"
+
+/*-----------------------------------------------------------*/
+
+/* MEM-AP registers (bank 0) */
+#define AP_CSW                  0x00U
+#define AP_TAR                  0x04U
+#define AP_DRW                  0x0CU
+
+/* CSW: Size = word, AddrInc = single */
+#define AP_CSW_MASK             0x37UL
+#define AP_CSW_WORD_INC         0x12UL
+
+/* SELECT fields: the AP is APSEL (31:24) on ADIv5 and the AP base address (31:12) on ADIv6,
+ * any change above the bank fields counts as another AP (ADIv5 keeps bits 23:8 zero) */
+#define DP_SELECT_AP            0xFFFFFF00UL
+#define DP_SELECT_APBANKSEL     0x000000F0UL
+
+/* TAR auto increment is only guaranteed inside 1k */
+#define TAR_PAGE                0x400UL
+
+/* transfer request of a DRW read */
+#define REQUEST_DRW_READ        (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW)
+
+/* ABORT: DAPABORT | STKERRCLR */
+#define DP_ABORT_CLEAR          0x05UL
+
+// read-ahead counters
+dap_readahead_stats_t xDapReadAheadStats;
+
+/* link state seen by the host and parked data */
+typedef struct dap_readahead_t
+{
+    bool xSelectKnown;
+    uint32_t ulSelect;          // last SELECT written
+    bool xCswOk;                // last CSW written: word size, single increment
+    bool xTarKnown;
+    uint32_t ulTarHost;         // TAR as the host sees it
+    uint32_t ulTarTarget;       // TAR in the target, runs ahead after a read-ahead
+    uint32_t ulNext;            // words of the predicted block, 0: none
+    uint32_t ulAddr;            // address of the first parked word
+    uint32_t ulCount;           // parked words
+    uint32_t ulIndex;           // first parked word in ulData
+    uint32_t ulStampUs;         // time of the read-ahead
+    uint32_t ulData[DAP_READAHEAD_WORDS];
+} dap_readahead_t;
+
+static dap_readahead_t xReadAhead;
+
+/*-----------------------------------------------------------*/
+
+/// @brief drop parked data
+static void prvDrop(void)
+{
+    xDapReadAheadStats.ulDropped += xReadAhead.ulCount;
+    xReadAhead.ulCount = 0U;
+}
+
+/// @brief drop parked data and forget the link state
+static void prvForget(void)
+{
+    prvDrop();
+    xReadAhead.xSelectKnown = false;
+    xReadAhead.xCswOk = false;
+    xReadAhead.xTarKnown = false;
+    xReadAhead.ulNext = 0U;
+}
+
+/// @brief single swd transfer with the configured WAIT retries
+/// @param ulRequest : transfer request
+/// @param pulData : data
+/// @return acknowledge
+static uint8_t prvTransfer(uint32_t ulRequest, uint32_t * pulData)
+{
+    unsigned int retry = DAP_Data.transfer.retry_count;
+    uint8_t ucAck;
+
+    do {
+        ucAck = SWD_Transfer(ulRequest, (unsigned int *)pulData);
+    } while ((ucAck == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+
+    return ucAck;
+}
+
+/// @brief write the host's TAR back if the target ran ahead
+static void prvSync(void)
+{
+    uint32_t ulTar;
+
+    if (!xReadAhead.xTarKnown || (xReadAhead.ulTarTarget == xReadAhead.ulTarHost))
+    {
+        return;
+    }
+    ulTar = xReadAhead.ulTarHost;
+    if (DAP_TRANSFER_OK == prvTransfer(DAP_TRANSFER_APnDP | AP_TAR, &ulTar))
+    {
+        xReadAhead.ulTarTarget = xReadAhead.ulTarHost;
+        xDapReadAheadStats.ulTarRestore += 1U;
+    }
+    else
+    {
+        prvForget();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief a DAP command is about to run, commands other than transfers flush the read-ahead
+/// @param ucId : command id
+void vDapReadAheadCommand(uint8_t ucId)
+{
+    switch (ucId)
+    {
+        case ID_DAP_Info:
+        case ID_DAP_HostStatus:
+        case ID_DAP_Delay:
+        case ID_DAP_TransferConfigure:
+        case ID_DAP_Transfer:
+        case ID_DAP_TransferBlock:
+        case ID_DAP_SWO_Transport:
+        case ID_DAP_SWO_Mode:
+        case ID_DAP_SWO_Baudrate:
+        case ID_DAP_SWO_Control:
+        case ID_DAP_SWO_Status:
+        case ID_DAP_SWO_ExtendedStatus:
+        case ID_DAP_SWO_Data:
+            break;
+        default:
+            vDapReadAheadFlush();
+            break;
+    }
+}
+
+/// @brief put the host's TAR back and forget all state, before someone else uses the link
+void vDapReadAheadFlush(void)
+{
+    if (DAP_Data.debug_port == DAP_PORT_SWD)
+    {
+        prvSync();
+    }
+    prvForget();
+}
+
+/// @brief called before a swd register access of a transfer command, restores TAR if needed
+/// @param ulRequest : transfer request (APnDP, RnW, A2, A3)
+void vDapReadAheadBefore(uint32_t ulRequest)
+{
+    // DP reads do not depend on TAR, a TAR write replaces it
+    if ((ulRequest & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW)) == DAP_TRANSFER_RnW)
+    {
+        return;
+    }
+    if ((ulRequest & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == (DAP_TRANSFER_APnDP | AP_TAR))
+    {
+        return;
+    }
+    prvSync();
+}
+
+/// @brief called after a register access of a transfer command, tracks SELECT/CSW/TAR
+/// @param ulRequest : transfer request
+/// @param ulData : written data
+/// @param ulAck : transfer result
+void vDapReadAheadAfter(uint32_t ulRequest, uint32_t ulData, uint32_t ulAck)
+{
+    uint32_t ulReg = ulRequest & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+
+    // match mask writes do not reach the target
+    if ((ulRequest & (DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_MASK)) == DAP_TRANSFER_MATCH_MASK)
+    {
+        return;
+    }
+    if ((ulRequest & DAP_TRANSFER_APnDP) == 0U)
+    {
+        if ((ulRequest & DAP_TRANSFER_RnW) != 0U)
+        {
+            return;
+        }
+        if ((ulAck != DAP_TRANSFER_OK) || (ulReg != DP_SELECT))
+        {
+            // ABORT, CTRL/STAT: the AP transaction may be gone
+            prvForget();
+            return;
+        }
+        prvDrop();
+        if (!xReadAhead.xSelectKnown || ((xReadAhead.ulSelect ^ ulData) & DP_SELECT_AP))
+        {
+            // another AP
+            xReadAhead.xCswOk = false;
+            xReadAhead.xTarKnown = false;
+            xReadAhead.ulNext = 0U;
+        }
+        xReadAhead.xSelectKnown = true;
+        xReadAhead.ulSelect = ulData;
+        return;
+    }
+
+    if (ulAck != DAP_TRANSFER_OK)
+    {
+        prvForget();
+        return;
+    }
+    if (!xReadAhead.xSelectKnown || ((xReadAhead.ulSelect & DP_SELECT_APBANKSEL) != 0U))
+    {
+        // other banks do not move TAR, banked data writes change memory
+        if ((ulRequest & DAP_TRANSFER_RnW) == 0U)
+        {
+            prvDrop();
+        }
+        return;
+    }
+    if ((ulRequest & DAP_TRANSFER_RnW) != 0U)
+    {
+        if (ulReg == AP_DRW)
+        {
+            // single DRW reads are not followed
+            prvDrop();
+            xReadAhead.xTarKnown = false;
+            xReadAhead.ulNext = 0U;
+        }
+        return;
+    }
+    switch (ulReg)
+    {
+        case AP_CSW:
+            prvDrop();
+            xReadAhead.xCswOk = ((ulData & AP_CSW_MASK) == AP_CSW_WORD_INC);
+            break;
+        case AP_TAR:
+            // parked data stays valid when the host points TAR at it
+            if (ulData != xReadAhead.ulAddr)
+            {
+                prvDrop();
+            }
+            xReadAhead.xTarKnown = true;
+            xReadAhead.ulTarHost = ulData;
+            xReadAhead.ulTarTarget = ulData;
+            break;
+        default:
+            prvDrop();
+            xReadAhead.xTarKnown = false;
+            xReadAhead.ulNext = 0U;
+            break;
+    }
+}
+
+/// @brief serve the head of a block read from parked data
+/// @param ulRequest : transfer request of the block
+/// @param ulCount : words requested
+/// @param pucResponse : response data (little endian words)
+/// @return words served
+uint32_t ulDapReadAheadTake(uint32_t ulRequest, uint32_t ulCount, uint8_t * pucResponse)
+{
+    uint32_t ulTake, ulData;
+
+    if ((xReadAhead.ulCount == 0U) || ((ulRequest & 0x0FU) != REQUEST_DRW_READ))
+    {
+        return 0U;
+    }
+    if (!xReadAhead.xTarKnown || (xReadAhead.ulTarHost != xReadAhead.ulAddr) ||
+        ((time_us_32() - xReadAhead.ulStampUs) > DAP_READAHEAD_TIMEOUT_US))
+    {
+        prvDrop();
+        return 0U;
+    }
+    ulTake = (ulCount < xReadAhead.ulCount) ? ulCount : xReadAhead.ulCount;
+    for (uint32_t i = 0U; i < ulTake; i++)
+    {
+        ulData = xReadAhead.ulData[xReadAhead.ulIndex++];
+        *pucResponse++ = (uint8_t) ulData;
+        *pucResponse++ = (uint8_t)(ulData >>  8);
+        *pucResponse++ = (uint8_t)(ulData >> 16);
+        *pucResponse++ = (uint8_t)(ulData >> 24);
+    }
+    xReadAhead.ulCount -= ulTake;
+    xReadAhead.ulAddr += ulTake * 4U;
+    xReadAhead.ulTarHost += ulTake * 4U;
+    xDapReadAheadStats.ulHit += ulTake;
+
+    return ulTake;
+}
+
+/// @brief a block read ended, remembers the pattern for the next read-ahead
+/// @param ulRequest : transfer request of the block
+/// @param ulServed : words served from parked data
+/// @param ulRead : words read from the target
+/// @param ulAck : transfer result
+void vDapReadAheadBlockEnd(uint32_t ulRequest, uint32_t ulServed, uint32_t ulRead, uint32_t ulAck)
+{
+    if ((ulRequest & 0x0FU) != REQUEST_DRW_READ)
+    {
+        return;
+    }
+    if (ulAck != DAP_TRANSFER_OK)
+    {
+        prvForget();
+        return;
+    }
+    if (xReadAhead.xTarKnown && (ulRead != 0U))
+    {
+        // the target was in sync before reading
+        xReadAhead.ulTarHost += ulRead * 4U;
+        xReadAhead.ulTarTarget = xReadAhead.ulTarHost;
+    }
+    xReadAhead.ulNext = ulServed + ulRead;
+}
+
+/// @brief read the predicted next block, called by the dap thread when it is idle
+/// @param xPending : returns true when the host sent a request, read-ahead stops then
+void vDapReadAheadRun(DapReadAheadPending_t xPending)
+{
+    uint32_t ulAddr = xReadAhead.ulTarHost;
+    uint32_t ulWords = (xReadAhead.ulNext < DAP_READAHEAD_WORDS) ? xReadAhead.ulNext : DAP_READAHEAD_WORDS;
+    uint32_t ulData;
+    uint8_t ucAck;
+
+    if ((DAP_Data.debug_port != DAP_PORT_SWD) || (ulWords == 0U) || (xReadAhead.ulCount != 0U) ||
+        !xReadAhead.xSelectKnown || ((xReadAhead.ulSelect & DP_SELECT_APBANKSEL) != 0U) ||
+        !xReadAhead.xCswOk || !xReadAhead.xTarKnown || (ulAddr >= DAP_READAHEAD_LIMIT) ||
+        (((ulAddr & (TAR_PAGE - 1U)) + (ulWords * 4U)) > TAR_PAGE))
+    {
+        return;
+    }
+    // one read-ahead per block read by the host
+    xReadAhead.ulNext = 0U;
+
+    prvSync();
+    if (!xReadAhead.xTarKnown)
+    {
+        return;
+    }
+    // post the first read, then read until done or the host wants the link
+    ucAck = prvTransfer(REQUEST_DRW_READ, NULL);
+    for (uint32_t i = 0U; (ucAck == DAP_TRANSFER_OK) && (i < ulWords); i++)
+    {
+        bool xLast = (i == (ulWords - 1U)) || xPending() || DAP_TransferAbort;
+        ucAck = prvTransfer(xLast ? (DP_RDBUFF | DAP_TRANSFER_RnW) : REQUEST_DRW_READ, &ulData);
+        xReadAhead.ulData[i] = ulData;
+        if (xLast && (ucAck == DAP_TRANSFER_OK))
+        {
+            xReadAhead.ulAddr = ulAddr;
+            xReadAhead.ulCount = i + 1U;
+            xReadAhead.ulIndex = 0U;
+            xReadAhead.ulStampUs = time_us_32();
+            xReadAhead.ulTarTarget = ulAddr + (xReadAhead.ulCount * 4U);
+            xDapReadAheadStats.ulPrefetched += xReadAhead.ulCount;
+            return;
+        }
+    }
+    // the host must not see errors it did not cause: clear them and put TAR back
+    ulData = DP_ABORT_CLEAR;
+    (void)prvTransfer(DP_ABORT, &ulData);
+    xReadAhead.ulTarTarget = ~xReadAhead.ulTarHost;
+    prvSync();
+}
+
+/*-----------------------------------------------------------*/
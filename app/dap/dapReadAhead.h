@@ -0,0 +1,96 @@
+#ifndef DAP_READAHEAD_H_
+#define DAP_READAHEAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Sequential read-ahead for MEM-AP block reads.
+ *
+ * When DAP_TransferBlock reads DRW and the following block is likely to be
+ * the next one (word size, single auto increment, same 1k TAR page, memory
+ * region), the dap thread reads it while the response is on usb. The next
+ * block read from the same address is then served from the buffer.
+ *
+ * The target TAR may run ahead of the host's TAR while data is parked, it is
+ * written back before any access that depends on it. The data is dropped on
+ * any write, a TAR change elsewhere, a SELECT change or a timeout.
+ */
+
+/* 1: read ahead; 0: DAP.c does not call the hooks */
+#ifndef DAP_READAHEAD
+    #define DAP_READAHEAD               1
+#endif
+
+/* largest block read ahead (words), as much as one block read response holds */
+#define DAP_READAHEAD_WORDS             ((DAP_PACKET_SIZE - 4U) / 4U)
+/* parked data is dropped after this time (us), the target may be running */
+#define DAP_READAHEAD_TIMEOUT_US        2000U
+/* only addresses below are read ahead, no peripherals with read side effects */
+#define DAP_READAHEAD_LIMIT             0x40000000UL
+
+/* read-ahead counters */
+typedef struct dap_readahead_stats_t
+{
+    uint32_t ulPrefetched;      // words read ahead
+    uint32_t ulHit;             // words served from the buffer
+    uint32_t ulDropped;         // words dropped unused
+    uint32_t ulTarRestore;      // TAR written back
+} dap_readahead_stats_t;
+
+extern dap_readahead_stats_t xDapReadAheadStats;
+
+/* Prototype of the "host sent a request" check */
+typedef bool (* DapReadAheadPending_t)(void);
+
+/*-----------------------------------------------------------*/
+
+/// @brief a DAP command is about to run, commands other than transfers flush the read-ahead
+/// @param ucId : command id
+void vDapReadAheadCommand(uint8_t ucId);
+
+/// @brief put the host's TAR back and forget all state, before someone else uses the link
+void vDapReadAheadFlush(void);
+
+/// @brief called before a swd register access of a transfer command, restores TAR if needed
+/// @param ulRequest : transfer request (APnDP, RnW, A2, A3)
+void vDapReadAheadBefore(uint32_t ulRequest);
+
+/// @brief called after a register access of a transfer command, tracks SELECT/CSW/TAR
+/// @param ulRequest : transfer request
+/// @param ulData : written data
+/// @param ulAck : transfer result
+void vDapReadAheadAfter(uint32_t ulRequest, uint32_t ulData, uint32_t ulAck);
+
+/// @brief serve the head of a block read from parked data
+/// @param ulRequest : transfer request of the block
+/// @param ulCount : words requested
+/// @param pucResponse : response data (little endian words)
+/// @return words served
+uint32_t ulDapReadAheadTake(uint32_t ulRequest, uint32_t ulCount, uint8_t * pucResponse);
+
+/// @brief a block read ended, remembers the pattern for the next read-ahead
+/// @param ulRequest : transfer request of the block
+/// @param ulServed : words served from parked data
+/// @param ulRead : words read from the target
+/// @param ulAck : transfer result
+void vDapReadAheadBlockEnd(uint32_t ulRequest, uint32_t ulServed, uint32_t ulRead, uint32_t ulAck);
+
+/// @brief read the predicted next block, called by the dap thread when it is idle
+/// @param xPending : returns true when the host sent a request, read-ahead stops then
+void vDapReadAheadRun(DapReadAheadPending_t xPending);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_READAHEAD_H_ */
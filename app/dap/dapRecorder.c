@@ -0,0 +1,250 @@
+#include "dapRecorder.h"
+#include "DAP_config.h"
+#include "rp2350.h"
+#include "semphr.h"
+
+/*-----------------------------------------------------------*/
+
+/* ring buffer in psram */
+typedef struct dap_recorder_t
+{
+    uint8_t * pucRing;          // ring base
+    size_t xSize;               // ring size
+    size_t xHead;               // next write offset
+    size_t xTail;               // oldest record offset
+    size_t xUsed;               // bytes in use
+    uint32_t ulRecords;         // records in the ring
+    uint32_t ulDropped;         // records overwritten (or lost during export)
+    uint32_t ulFilter[256 / 32];// selected command ids
+    volatile bool xRunning;
+    SemaphoreHandle_t xLock;    // dap thread against export/configuration
+} dap_recorder_t;
+
+static dap_recorder_t xRecorder;
+
+/*-----------------------------------------------------------*/
+
+/// @brief copy into the ring at an offset, wrapping at the end
+/// @param xOffset : ring offset
+/// @param pv : source
+/// @param xLen : bytes
+/// @return offset behind the copied data
+static size_t prvRingWrite(size_t xOffset, const void * pv, size_t xLen)
+{
+    const uint8_t * puc = (const uint8_t *)pv;
+    size_t xFirst = xRecorder.xSize - xOffset;
+
+    if(xLen < xFirst)
+    {
+        memcpy(xRecorder.pucRing + xOffset, puc, xLen);
+        return xOffset + xLen;
+    }
+    memcpy(xRecorder.pucRing + xOffset, puc, xFirst);
+    memcpy(xRecorder.pucRing, puc + xFirst, xLen - xFirst);
+    return xLen - xFirst;
+}
+
+/// @brief copy out of the ring at an offset, wrapping at the end
+/// @param xOffset : ring offset
+/// @param pv : destination
+/// @param xLen : bytes
+static void prvRingRead(size_t xOffset, void * pv, size_t xLen)
+{
+    uint8_t * puc = (uint8_t *)pv;
+    size_t xFirst = xRecorder.xSize - xOffset;
+
+    if(xLen <= xFirst)
+    {
+        memcpy(puc, xRecorder.pucRing + xOffset, xLen);
+        return;
+    }
+    memcpy(puc, xRecorder.pucRing + xOffset, xFirst);
+    memcpy(puc + xFirst, xRecorder.pucRing, xLen - xFirst);
+}
+
+/// @brief drop the oldest record
+static void prvRingDropOldest(void)
+{
+    dap_recorder_record_t xRecord;
+    size_t xLen;
+
+    prvRingRead(xRecorder.xTail, &xRecord, sizeof(xRecord));
+    xLen = sizeof(xRecord) + xRecord.usRequestLen + xRecord.usResponseLen;
+    xRecorder.xTail = (xRecorder.xTail + xLen) % xRecorder.xSize;
+    xRecorder.xUsed -= xLen;
+    xRecorder.ulRecords -= 1U;
+    xRecorder.ulDropped += 1U;
+}
+
+/// @brief forget all records, lock must be held
+static void prvRingReset(void)
+{
+    xRecorder.xHead = 0U;
+    xRecorder.xTail = 0U;
+    xRecorder.xUsed = 0U;
+    xRecorder.ulRecords = 0U;
+    xRecorder.ulDropped = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the recorder (stopped, all commands selected)
+void vDapRecorderInit(void)
+{
+    xRecorder.pucRing = (uint8_t *)PSRAM_RECORDER_BASE;
+    xRecorder.xSize = DAP_RECORDER_DEFAULT_SIZE;
+    xRecorder.xRunning = false;
+    xRecorder.xLock = xSemaphoreCreateMutex();
+    prvRingReset();
+    vDapRecorderFilterAll(true);
+}
+
+/// @brief start or stop recording
+/// @param xRun : true to record
+void vDapRecorderRun(bool xRun)
+{
+    xRecorder.xRunning = xRun;
+}
+
+/// @brief drop all records
+void vDapRecorderClear(void)
+{
+    xSemaphoreTake(xRecorder.xLock, portMAX_DELAY);
+    prvRingReset();
+    xSemaphoreGive(xRecorder.xLock);
+}
+
+/// @brief change the ring size, drops all records
+/// @param xSize : ring size in byte
+/// @return pdPASS : done; pdFAIL : size out of range
+BaseType_t xDapRecorderSetSize(size_t xSize)
+{
+    if((xSize < DAP_RECORDER_MIN_SIZE) || (xSize > PSRAM_RECORDER_SIZE))
+    {
+        return pdFAIL;
+    }
+    xSemaphoreTake(xRecorder.xLock, portMAX_DELAY);
+    xRecorder.xSize = xSize;
+    prvRingReset();
+    xSemaphoreGive(xRecorder.xLock);
+    return pdPASS;
+}
+
+/// @brief select which commands are recorded (by the first byte of the request)
+/// @param ucId : command id
+/// @param xEnable : true to record it
+void vDapRecorderFilter(uint8_t ucId, bool xEnable)
+{
+    if(xEnable)
+        xRecorder.ulFilter[ucId / 32U] |= (1UL << (ucId % 32U));
+    else
+        xRecorder.ulFilter[ucId / 32U] &= ~(1UL << (ucId % 32U));
+}
+
+/// @brief select or deselect all commands
+/// @param xEnable : true to record all
+void vDapRecorderFilterAll(bool xEnable)
+{
+    memset(xRecorder.ulFilter, xEnable ? 0xFF : 0x00, sizeof(xRecorder.ulFilter));
+}
+
+/// @brief append a request/response pair, called by the dap thread
+/// @param ulStampUs : request arrival time
+/// @param ulExecUs : execution time
+/// @param pucRequest : request
+/// @param usRequestLen : request bytes
+/// @param pucResponse : response
+/// @param usResponseLen : response bytes
+void vDapRecorderAppend(uint32_t ulStampUs, uint32_t ulExecUs,
+                        const uint8_t * pucRequest, uint16_t usRequestLen,
+                        const uint8_t * pucResponse, uint16_t usResponseLen)
+{
+    dap_recorder_record_t xRecord;
+    size_t xLen = sizeof(xRecord) + usRequestLen + usResponseLen;
+    uint8_t ucId = pucRequest[0];
+
+    // cheap checks first, this runs for every packet
+    if(!xRecorder.xRunning || !(xRecorder.ulFilter[ucId / 32U] & (1UL << (ucId % 32U))))
+    {
+        return;
+    }
+    // never wait for the exporter, the record is lost instead
+    if(pdTRUE != xSemaphoreTake(xRecorder.xLock, 0))
+    {
+        xRecorder.ulDropped += 1U;
+        return;
+    }
+    if(xLen <= xRecorder.xSize)
+    {
+        // make room by dropping the oldest records
+        while((xRecorder.xSize - xRecorder.xUsed) < xLen)
+        {
+            prvRingDropOldest();
+        }
+        xRecord.ulStampUs = ulStampUs;
+        xRecord.usExecUs = (ulExecUs > 0xFFFFU) ? 0xFFFFU : (uint16_t)ulExecUs;
+        xRecord.usRequestLen = usRequestLen;
+        xRecord.usResponseLen = usResponseLen;
+        xRecorder.xHead = prvRingWrite(xRecorder.xHead, &xRecord, sizeof(xRecord));
+        xRecorder.xHead = prvRingWrite(xRecorder.xHead, pucRequest, usRequestLen);
+        xRecorder.xHead = prvRingWrite(xRecorder.xHead, pucResponse, usResponseLen);
+        xRecorder.xHead %= xRecorder.xSize;
+        xRecorder.xUsed += xLen;
+        xRecorder.ulRecords += 1U;
+    }
+    xSemaphoreGive(xRecorder.xLock);
+}
+
+/// @brief get the recorder state
+/// @param px : output
+void vDapRecorderStatus(dap_recorder_status_t * px)
+{
+    px->xRunning = xRecorder.xRunning;
+    px->xSize = xRecorder.xSize;
+    px->xUsed = xRecorder.xUsed;
+    px->ulRecords = xRecorder.ulRecords;
+    px->ulDropped = xRecorder.ulDropped;
+}
+
+/// @brief write header, records and crc through an output function, recording is paused meanwhile
+/// @param xWrite : output function
+/// @return bytes written
+size_t xDapRecorderExport(DapRecorderWrite_t xWrite)
+{
+    dap_recorder_header_t xHeader;
+    uint32_t ulCrc;
+    size_t xFirst;
+
+    xSemaphoreTake(xRecorder.xLock, portMAX_DELAY);
+
+    xHeader.ulMagic = DAP_RECORDER_MAGIC;
+    xHeader.usVersion = DAP_RECORDER_VERSION;
+    xHeader.usPacketSize = DAP_PACKET_SIZE;
+    xHeader.ulRecords = xRecorder.ulRecords;
+    xHeader.ulBytes = (uint32_t)xRecorder.xUsed;
+    xHeader.ulDropped = xRecorder.ulDropped;
+    ulCrc = ulUtilCrc32(0U, &xHeader, sizeof(xHeader));
+    xWrite((uint8_t *)&xHeader, sizeof(xHeader));
+
+    // the used area is at most two pieces: tail..end and start..head
+    xFirst = xRecorder.xSize - xRecorder.xTail;
+    if(xRecorder.xUsed <= xFirst)
+    {
+        ulCrc = ulUtilCrc32(ulCrc, xRecorder.pucRing + xRecorder.xTail, xRecorder.xUsed);
+        xWrite(xRecorder.pucRing + xRecorder.xTail, (int)xRecorder.xUsed);
+    }
+    else
+    {
+        ulCrc = ulUtilCrc32(ulCrc, xRecorder.pucRing + xRecorder.xTail, xFirst);
+        xWrite(xRecorder.pucRing + xRecorder.xTail, (int)xFirst);
+        ulCrc = ulUtilCrc32(ulCrc, xRecorder.pucRing, xRecorder.xUsed - xFirst);
+        xWrite(xRecorder.pucRing, (int)(xRecorder.xUsed - xFirst));
+    }
+    xWrite((uint8_t *)&ulCrc, sizeof(ulCrc));
+
+    xSemaphoreGive(xRecorder.xLock);
+
+    return sizeof(xHeader) + xHeader.ulBytes + sizeof(ulCrc);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,119 @@
+#ifndef DAP_RECORDER_H_
+#define DAP_RECORDER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * DAP flight recorder: every request/response pair handled by the dap thread
+ * is appended to a ring in psram, the oldest records are dropped when it is full.
+ *
+ * Export format (little endian):
+ *      dap_recorder_header_t
+ *      records, oldest first:  dap_recorder_record_t | request bytes | response bytes
+ *      uint32_t crc32 of header and records (util ulUtilCrc32)
+ */
+
+/* export magic: "DREC" */
+#define DAP_RECORDER_MAGIC          0x43455244UL
+/* export format version */
+#define DAP_RECORDER_VERSION        1U
+/* default ring size (byte) */
+#define DAP_RECORDER_DEFAULT_SIZE   (256U * 1024U)
+/* smallest ring size (byte) */
+#define DAP_RECORDER_MIN_SIZE       1024U
+
+/* export header */
+typedef struct __attribute__((packed)) dap_recorder_header_t
+{
+    uint32_t ulMagic;           // DAP_RECORDER_MAGIC
+    uint16_t usVersion;         // DAP_RECORDER_VERSION
+    uint16_t usPacketSize;      // DAP_PACKET_SIZE of the recording probe
+    uint32_t ulRecords;         // number of records that follow
+    uint32_t ulBytes;           // number of record bytes that follow
+    uint32_t ulDropped;         // records overwritten since the last clear
+} dap_recorder_header_t;
+
+/* record header, followed by the request and response bytes */
+typedef struct __attribute__((packed)) dap_recorder_record_t
+{
+    uint32_t ulStampUs;         // request arrival time [us]
+    uint16_t usExecUs;          // execution time [us], saturated
+    uint16_t usRequestLen;      // request bytes
+    uint16_t usResponseLen;     // response bytes
+} dap_recorder_record_t;
+
+/* recorder state, for display */
+typedef struct dap_recorder_status_t
+{
+    bool xRunning;
+    size_t xSize;               // ring size
+    size_t xUsed;               // bytes in use
+    uint32_t ulRecords;         // records in the ring
+    uint32_t ulDropped;         // records overwritten
+} dap_recorder_status_t;
+
+/* Prototype of the export output function */
+typedef int (* DapRecorderWrite_t)(uint8_t *, int);
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the recorder (stopped, all commands selected)
+void vDapRecorderInit(void);
+
+/// @brief start or stop recording
+/// @param xRun : true to record
+void vDapRecorderRun(bool xRun);
+
+/// @brief drop all records
+void vDapRecorderClear(void);
+
+/// @brief change the ring size, drops all records
+/// @param xSize : ring size in byte
+/// @return pdPASS : done; pdFAIL : size out of range
+BaseType_t xDapRecorderSetSize(size_t xSize);
+
+/// @brief select which commands are recorded (by the first byte of the request)
+/// @param ucId : command id
+/// @param xEnable : true to record it
+void vDapRecorderFilter(uint8_t ucId, bool xEnable);
+
+/// @brief select or deselect all commands
+/// @param xEnable : true to record all
+void vDapRecorderFilterAll(bool xEnable);
+
+/// @brief append a request/response pair, called by the dap thread
+/// @param ulStampUs : request arrival time
+/// @param ulExecUs : execution time
+/// @param pucRequest : request
+/// @param usRequestLen : request bytes
+/// @param pucResponse : response
+/// @param usResponseLen : response bytes
+void vDapRecorderAppend(uint32_t ulStampUs, uint32_t ulExecUs,
+                        const uint8_t * pucRequest, uint16_t usRequestLen,
+                        const uint8_t * pucResponse, uint16_t usResponseLen);
+
+/// @brief get the recorder state
+/// @param px : output
+void vDapRecorderStatus(dap_recorder_status_t * px);
+
+/// @brief write header, records and crc through an output function, recording is paused meanwhile
+/// @param xWrite : output function
+/// @return bytes written
+size_t xDapRecorderExport(DapRecorderWrite_t xWrite);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_RECORDER_H_ */
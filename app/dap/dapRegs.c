@@ -0,0 +1,120 @@
+#include <string.h>
+#include "dapRegs.h"
+#include "dapVendor.h"
+#include "target/target.h"
+
+#if (DAP_REGS != 0)
+
+/*-----------------------------------------------------------*/
+
+/* media and FP feature register 0, zero without FPU */
+#define REGS_MVFR0              0xE000EF40UL
+
+/* READ response: id status count */
+#define REGS_READ_HEADER        3U
+
+/* snapshot */
+typedef struct dap_regs_t
+{
+    uint32_t ulCount;                   // words captured
+    uint32_t ulData[DAP_REGS_MAX];
+} dap_regs_t;
+
+static dap_regs_t xRegs;
+
+/*-----------------------------------------------------------*/
+
+/// @brief capture the registers
+/// @param ucFlags : DAP_REGS_x
+/// @return acknowledge
+static uint8_t prvRegsSnapshot(uint8_t ucFlags)
+{
+    uint8_t ucReg[DAP_REGS_MAX];
+    uint32_t ulCount = DAP_REGS_CORE;
+    uint32_t ulMvfr0 = 0U;
+    uint32_t ulDhcsr;
+
+    xRegs.ulCount = 0U;
+    // a running core answers DCRSR with stale or no data
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulDhcsr));
+    if ((ulDhcsr & TARGET_DHCSR_S_HALT) == 0U)
+    {
+        return DAP_TRANSFER_ERROR;
+    }
+    for (uint32_t i = 0U; i <= TARGET_REG_PSP; i++)
+    {
+        ucReg[i] = (uint8_t)i;
+    }
+    ucReg[DAP_REGS_CORE - 1U] = TARGET_REG_SPECIAL;
+    if ((ucFlags & DAP_REGS_FPU) != 0U)
+    {
+        TARGET_TRY(ucTargetReadWord(REGS_MVFR0, &ulMvfr0));
+    }
+    if (ulMvfr0 != 0U)
+    {
+        ucReg[ulCount++] = TARGET_REG_FPSCR;
+        for (uint32_t i = 0U; i < 32U; i++)
+        {
+            ucReg[ulCount++] = (uint8_t)TARGET_REG_S(i);
+        }
+    }
+    TARGET_TRY(ucTargetReadRegs(ucReg, ulCount, xRegs.ulData));
+    xRegs.ulCount = ulCount;
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a register snapshot command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapRegsCommand(const uint8_t * request, uint8_t * response)
+{
+    response[0] = request[0];
+
+    switch (request[1])
+    {
+        case DAP_REGS_SNAPSHOT:
+            vTargetClaim();
+            response[1] = (prvRegsSnapshot(request[2]) == DAP_TRANSFER_OK) ? DAP_OK : DAP_ERROR;
+            response[2] = (uint8_t)xRegs.ulCount;
+            return ((3U << 16) | 3U);
+        case DAP_REGS_READ:
+        {
+            uint32_t ulIndex = request[2];
+            uint32_t ulCount = request[3];
+            // inside a batch the response starts part-way into the packet
+            uint32_t ulRoom = DAP_ResponseRoom(response);
+
+            if (ulRoom < REGS_READ_HEADER)
+            {
+                return (4U << 16);
+            }
+            if (ulCount > ((ulRoom - REGS_READ_HEADER) / 4U))
+            {
+                ulCount = (ulRoom - REGS_READ_HEADER) / 4U;
+            }
+            if (ulIndex > xRegs.ulCount)
+            {
+                ulIndex = xRegs.ulCount;
+            }
+            if (ulCount > (xRegs.ulCount - ulIndex))
+            {
+                ulCount = xRegs.ulCount - ulIndex;
+            }
+            // target byte order is little endian, as is ours
+            memcpy(&response[REGS_READ_HEADER], &xRegs.ulData[ulIndex], ulCount * 4U);
+            response[1] = DAP_OK;
+            response[2] = (uint8_t)ulCount;
+            return ((4U << 16) | (REGS_READ_HEADER + (ulCount * 4U)));
+        }
+        default:
+            response[0] = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
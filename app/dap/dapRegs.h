@@ -0,0 +1,62 @@
+#ifndef DAP_REGS_H_
+#define DAP_REGS_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Bulk core register snapshot (vendor command ID_DAP_VENDOR_REGS).
+ *
+ *  SNAPSHOT : id 0x00 flags                    -> id status count
+ *  READ     : id 0x01 index count              -> id status count word[count]
+ *
+ * SNAPSHOT reads the whole register set of the halted core in one probe
+ * side sequence into a buffer (DCRSR/DHCSR/DCRDR over the MEM-AP banked data
+ * registers, no TAR write per register), READ hands out words of it without
+ * touching the target, so the host can queue all READs at once.
+ *
+ * Buffer layout: 0..15 R0..R15 (R15 = debug return address), 16 xPSR,
+ * 17 MSP, 18 PSP, 19 CONTROL[31:24] FAULTMASK[23:16] BASEPRI[15:8]
+ * PRIMASK[7:0]; with DAP_REGS_FPU and an FPU present (MVFR0 != 0) 20 FPSCR
+ * and 21..52 S0..S31. count is the number of words captured.
+ * SNAPSHOT answers DAP_ERROR when the core is not halted or a transfer
+ * failed. The host's SELECT, CSW and TAR are put back afterwards.
+ */
+
+/* 1: register snapshot command; 0: not built */
+#ifndef DAP_REGS
+    #define DAP_REGS                1
+#endif
+
+/* snapshot size in words */
+#define DAP_REGS_CORE               20U
+#define DAP_REGS_MAX                (DAP_REGS_CORE + 33U)
+
+/* sub commands */
+#define DAP_REGS_SNAPSHOT           0x00U
+#define DAP_REGS_READ               0x01U
+
+/* SNAPSHOT flags */
+#define DAP_REGS_FPU                0x01U   // FPSCR and S0..S31 as well
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a register snapshot command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapRegsCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_REGS_H_ */
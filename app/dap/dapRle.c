@@ -0,0 +1,177 @@
+#include "dapRle.h"
+#include "dapVendor.h"
+#include "target/target.h"
+
+#if (DAP_RLE != 0)
+
+/*-----------------------------------------------------------*/
+
+/* token tags */
+#define RLE_LITERAL             0x00U
+#define RLE_RUN_ONES            0x40U
+#define RLE_RUN_ZERO            0x80U
+#define RLE_RUN_WORD            0xC0U
+#define RLE_LITERAL_MAX         64U
+
+/* longest token: run of a word */
+#define RLE_TOKEN_MAX           6
+
+/* response being built */
+typedef struct rle_out_t
+{
+    uint8_t * puc;              // next token
+    uint8_t * pucEnd;
+    uint8_t * pucLiteral;       // header of the open literal token, NULL if none
+    uint32_t ulWords;           // words described so far
+} rle_out_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief store a little endian word
+/// @param puc : destination
+/// @param ulWord : value
+static void prvRlePut32(uint8_t * puc, uint32_t ulWord)
+{
+    puc[0] = (uint8_t)ulWord;
+    puc[1] = (uint8_t)(ulWord >> 8);
+    puc[2] = (uint8_t)(ulWord >> 16);
+    puc[3] = (uint8_t)(ulWord >> 24);
+}
+
+/// @brief add a word to the open literal token or start one
+/// @param px : response
+/// @param ulWord : word
+/// @return false if it does not fit
+static bool prvRleLiteral(rle_out_t * px, uint32_t ulWord)
+{
+    if ((px->pucLiteral == NULL) || ((*px->pucLiteral & 0x3FU) == (RLE_LITERAL_MAX - 1U)))
+    {
+        if ((px->pucEnd - px->puc) < 5)
+        {
+            return false;
+        }
+        px->pucLiteral = px->puc++;
+        *px->pucLiteral = RLE_LITERAL;
+    }
+    else
+    {
+        if ((px->pucEnd - px->puc) < 4)
+        {
+            return false;
+        }
+        *px->pucLiteral += 1U;
+    }
+    prvRlePut32(px->puc, ulWord);
+    px->puc += 4;
+    px->ulWords += 1U;
+    return true;
+}
+
+/// @brief add a run
+/// @param px : response
+/// @param ulWord : repeated word
+/// @param ulCount : words (1 .. DAP_RLE_MAX_WORDS)
+/// @return false if it does not fit
+static bool prvRleRun(rle_out_t * px, uint32_t ulWord, uint32_t ulCount)
+{
+    uint8_t ucTag = (ulWord == 0xFFFFFFFFUL) ? RLE_RUN_ONES : ((ulWord == 0U) ? RLE_RUN_ZERO : RLE_RUN_WORD);
+
+    // a single word is cheaper in a literal
+    if (ulCount == 1U)
+    {
+        return prvRleLiteral(px, ulWord);
+    }
+    if ((px->pucEnd - px->puc) < ((ucTag == RLE_RUN_WORD) ? 6 : 2))
+    {
+        return false;
+    }
+    px->puc[0] = (uint8_t)(ucTag | ((ulCount - 1U) >> 8));
+    px->puc[1] = (uint8_t)(ulCount - 1U);
+    px->puc += 2;
+    if (ucTag == RLE_RUN_WORD)
+    {
+        prvRlePut32(px->puc, ulWord);
+        px->puc += 4;
+    }
+    px->pucLiteral = NULL;
+    px->ulWords += ulCount;
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a run length encoded read command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapRleCommand(const uint8_t * request, uint8_t * response)
+{
+    uint32_t ulBuffer[DAP_RLE_CHUNK_WORDS];
+    uint32_t ulAddr = (uint32_t)request[1] | ((uint32_t)request[2] << 8) | ((uint32_t)request[3] << 16) | ((uint32_t)request[4] << 24);
+    uint32_t ulCount = (uint32_t)request[5] | ((uint32_t)request[6] << 8);
+    uint32_t ulRunWord = 0U, ulRunLen = 0U;
+    // inside a batch the response starts part-way into the packet
+    rle_out_t xOut = { &response[4], &response[DAP_ResponseRoom(response)], NULL, 0U };
+    uint8_t ucAck = DAP_TRANSFER_OK;
+    bool xFull = false;
+
+    // a batch that leaves no room for the header gets nothing
+    if (DAP_ResponseRoom(response) < 4U)
+    {
+        return (7U << 16);
+    }
+    if (ulCount > DAP_RLE_MAX_WORDS)
+    {
+        ulCount = DAP_RLE_MAX_WORDS;
+    }
+    vTargetClaim();
+    for (uint32_t ulRead = 0U, n; (ulRead < ulCount) && !xFull; ulRead += n)
+    {
+        // stop reading once any further token might not fit
+        if ((xOut.pucEnd - xOut.puc) < RLE_TOKEN_MAX)
+        {
+            break;
+        }
+        n = ((ulCount - ulRead) < DAP_RLE_CHUNK_WORDS) ? (ulCount - ulRead) : DAP_RLE_CHUNK_WORDS;
+        ucAck = ucTargetReadBlock(ulAddr + (ulRead * 4U), ulBuffer, n);
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            break;
+        }
+        for (uint32_t i = 0U; i < n; i++)
+        {
+            if ((ulRunLen != 0U) && (ulBuffer[i] == ulRunWord))
+            {
+                ulRunLen += 1U;
+                continue;
+            }
+            if ((ulRunLen != 0U) && !prvRleRun(&xOut, ulRunWord, ulRunLen))
+            {
+                xFull = true;
+                break;
+            }
+            ulRunWord = ulBuffer[i];
+            ulRunLen = 1U;
+        }
+#if (DAP_RESPONSE_STREAM != 0)
+        // the header is only final at the end, but the responses before this
+        // one in a batch are, they go out while the reads continue
+        DAP_ResponseProgress(response);
+#endif
+    }
+    // the run read last is still pending, also when a read failed behind it
+    if (!xFull && (ulRunLen != 0U))
+    {
+        (void)prvRleRun(&xOut, ulRunWord, ulRunLen);
+    }
+
+    response[0] = request[0];
+    response[1] = (ucAck == DAP_TRANSFER_OK) ? DAP_OK : DAP_ERROR;
+    response[2] = (uint8_t)xOut.ulWords;
+    response[3] = (uint8_t)(xOut.ulWords >> 8);
+    return ((7U << 16) | (uint32_t)(xOut.puc - response));
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
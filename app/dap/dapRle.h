@@ -0,0 +1,57 @@
+#ifndef DAP_RLE_H_
+#define DAP_RLE_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Run length encoded memory read (vendor command ID_DAP_VENDOR_RLE_READ).
+ *
+ *  request  : id addr[4] words[2]
+ *  response : id status words[2] tokens...
+ *
+ * The probe reads words from addr (word aligned) over the MEM-AP and encodes
+ * them while it reads, until the response is full or the requested words are
+ * done. "words" in the response is the number of words the tokens describe,
+ * the host continues behind them. Tokens (counts are n + 1):
+ *
+ *  00nnnnnn                    : n + 1 literal words follow (little endian)
+ *  01nnnnnn nnnnnnnn           : run of 0xFFFFFFFF words (erased flash)
+ *  10nnnnnn nnnnnnnn           : run of zero words
+ *  11nnnnnn nnnnnnnn word[4]   : run of the given word
+ *
+ * A failing read answers DAP_ERROR, the tokens up to it are valid.
+ * SELECT, CSW and TAR are restored when the command ends.
+ */
+
+/* 1: run length encoded read command; 0: not built */
+#ifndef DAP_RLE
+    #define DAP_RLE                 1
+#endif
+
+/* most words one command reads (the longest run) */
+#define DAP_RLE_MAX_WORDS           16384U
+/* words read from the target at once */
+#define DAP_RLE_CHUNK_WORDS         64U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a run length encoded read command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapRleCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_RLE_H_ */
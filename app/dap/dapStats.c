@@ -0,0 +1,154 @@
+#include "dapStats.h"
+#include <string.h>
+
+/*-----------------------------------------------------------*/
+
+// dap statistics, written by the dap thread and the usb thread
+dap_stats_t xDapStats;
+
+// values at the last reset, the readers subtract them
+static dap_stats_t xDapStatsBase;
+
+/*-----------------------------------------------------------*/
+
+/// @brief read a 64-bit sum of the dap thread, retried while it is being updated
+/// @param pull : sum
+/// @return value
+static uint64_t prvRead64(const uint64_t * pull)
+{
+    uint32_t ulSeq;
+    uint64_t ull;
+
+    do
+    {
+        ulSeq = xDapStats.ulSeq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        ull = *(const volatile uint64_t *)pull;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (((ulSeq & 1U) != 0U) || (ulSeq != xDapStats.ulSeq));
+    return ull;
+}
+
+/// @brief copy one command's counters
+/// @param pxOut : copy
+/// @param pxIn : counters
+static void prvCmdCopy(dap_stats_cmd_t * pxOut, const dap_stats_cmd_t * pxIn)
+{
+    const volatile dap_stats_cmd_t * px = pxIn;
+
+    pxOut->ulCalls = px->ulCalls;
+    pxOut->ulBytesIn = px->ulBytesIn;
+    pxOut->ulBytesOut = px->ulBytesOut;
+    pxOut->ulWait = px->ulWait;
+    pxOut->ulFault = px->ulFault;
+    pxOut->ulParity = px->ulParity;
+    pxOut->ullExecUs = prvRead64(&pxIn->ullExecUs);
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief clear all statistics
+void vDapStatsReset(void)
+{
+    // the counters keep running, the current values become the new zero
+    for (uint32_t i = 0U; i < (sizeof(xDapStats.xCmd) / sizeof(xDapStats.xCmd[0])); i++)
+    {
+        prvCmdCopy(&xDapStatsBase.xCmd[i], &xDapStats.xCmd[i]);
+    }
+    for (uint32_t h = 0U; h < DAP_STATS_HIST_COUNT; h++)
+    {
+        for (uint32_t b = 0U; b < DAP_STATS_HIST_BUCKETS; b++)
+        {
+            xDapStatsBase.ulHist[h][b] = ((const volatile uint32_t *)xDapStats.ulHist[h])[b];
+        }
+    }
+    xDapStatsBase.ullBusyUs = prvRead64(&xDapStats.ullBusyUs);
+    xDapStatsBase.ullIdleUs = prvRead64(&xDapStats.ullIdleUs);
+    xDapStatsBase.ulProtocolErr = *(const volatile uint32_t *)&xDapStats.ulProtocolErr;
+    xDapStatsBase.ulAborts = *(const volatile uint32_t *)&xDapStats.ulAborts;
+}
+
+/// @brief counters of one command since the last reset
+/// @param ucId : command id
+/// @param px : counters output
+void vDapStatsCmdGet(uint8_t ucId, dap_stats_cmd_t * px)
+{
+    prvCmdCopy(px, &xDapStats.xCmd[ucId]);
+    px->ulCalls -= xDapStatsBase.xCmd[ucId].ulCalls;
+    px->ulBytesIn -= xDapStatsBase.xCmd[ucId].ulBytesIn;
+    px->ulBytesOut -= xDapStatsBase.xCmd[ucId].ulBytesOut;
+    px->ulWait -= xDapStatsBase.xCmd[ucId].ulWait;
+    px->ulFault -= xDapStatsBase.xCmd[ucId].ulFault;
+    px->ulParity -= xDapStatsBase.xCmd[ucId].ulParity;
+    px->ullExecUs -= xDapStatsBase.xCmd[ucId].ullExecUs;
+    // the out-of-band aborts are one byte requests without a response
+    if (ID_DAP_TransferAbort == ucId)
+    {
+        uint32_t ulAborts = *(const volatile uint32_t *)&xDapStats.ulAborts - xDapStatsBase.ulAborts;
+
+        px->ulCalls += ulAborts;
+        px->ulBytesIn += ulAborts;
+    }
+}
+
+/// @brief one histogram bucket since the last reset
+/// @param eHist : histogram
+/// @param ulBucket : bucket
+/// @return samples
+uint32_t ulDapStatsHistGet(dap_stats_hist_t eHist, uint32_t ulBucket)
+{
+    return ((const volatile uint32_t *)xDapStats.ulHist[eHist])[ulBucket] - xDapStatsBase.ulHist[eHist][ulBucket];
+}
+
+/// @brief link totals since the last reset
+/// @param pullBusyUs : time spent executing commands output [us]
+/// @param pullIdleUs : time spent waiting for usb output [us]
+/// @param pulProtocolErr : protocol errors output
+void vDapStatsLinkGet(uint64_t * pullBusyUs, uint64_t * pullIdleUs, uint32_t * pulProtocolErr)
+{
+    *pullBusyUs = prvRead64(&xDapStats.ullBusyUs) - xDapStatsBase.ullBusyUs;
+    *pullIdleUs = prvRead64(&xDapStats.ullIdleUs) - xDapStatsBase.ullIdleUs;
+    *pulProtocolErr = *(const volatile uint32_t *)&xDapStats.ulProtocolErr - xDapStatsBase.ulProtocolErr;
+}
+
+/// @brief account a DAP_TransferAbort taken out of band by the usb thread
+void vDapStatsAbort(void)
+{
+#if (DAP_STATS != 0)
+    xDapStats.ulAborts += 1U;
+#endif
+}
+
+/// @brief account the time of one request
+/// @param ulIdleUs : waiting for the request [us]
+/// @param ulBusyUs : executing it [us]
+void vDapStatsLink(uint32_t ulIdleUs, uint32_t ulBusyUs)
+{
+#if (DAP_STATS != 0)
+    xDapStats.ulSeq += 1U;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    xDapStats.ullIdleUs += ulIdleUs;
+    xDapStats.ullBusyUs += ulBusyUs;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    xDapStats.ulSeq += 1U;
+#else
+    (void)ulIdleUs;
+    (void)ulBusyUs;
+#endif
+}
+
+/// @brief put a latency sample into one histogram
+/// @param eHist : histogram
+/// @param ulUs : latency [us]
+void vDapStatsHistogram(dap_stats_hist_t eHist, uint32_t ulUs)
+{
+#if (DAP_STATS != 0)
+    // each histogram has one writer: queue and exec the dap thread, usb-in the usb thread
+    xDapStats.ulHist[eHist][ulDapStatsBucket(ulUs)] += 1U;
+#else
+    (void)eHist;
+    (void)ulUs;
+#endif
+}
+
+/*-----------------------------------------------------------*/
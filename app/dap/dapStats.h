@@ -0,0 +1,181 @@
+#ifndef DAP_STATS_H_
+#define DAP_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/time.h"
+#include "DAP.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* 1: collect per-command statistics; 0: all hooks compile to nothing */
+#ifndef DAP_STATS
+    #define DAP_STATS               1
+#endif
+
+/* number of log2 latency buckets, last bucket collects everything above */
+#define DAP_STATS_HIST_BUCKETS      16U
+
+/* every counter has a single writer, the dap thread or (out-of-band aborts, IN
+   latency) the usb thread, so no lock is taken on the hot path; a reset takes a
+   baseline that the readers subtract, the 64-bit sums are read under ulSeq */
+
+/*-----------------------------------------------------------*/
+
+/* per-command counters (indexed by the command id) */
+typedef struct dap_stats_cmd_t
+{
+    uint32_t ulCalls;       // number of executions
+    uint32_t ulBytesIn;     // request bytes consumed
+    uint32_t ulBytesOut;    // response bytes produced
+    uint32_t ulWait;        // WAIT acknowledges seen while executing
+    uint32_t ulFault;       // FAULT acknowledges seen while executing
+    uint32_t ulParity;      // read data parity errors
+    uint64_t ullExecUs;     // accumulated execution time [us]
+} dap_stats_cmd_t;
+
+/* latency histograms */
+typedef enum dap_stats_hist_t
+{
+    DAP_STATS_HIST_QUEUE = 0,   // OUT packet received -> dap thread picked it up
+    DAP_STATS_HIST_EXEC,        // DAP_ExecuteCommand duration
+    DAP_STATS_HIST_USB_IN,      // IN transfer queued -> IN transfer completed
+    DAP_STATS_HIST_COUNT
+} dap_stats_hist_t;
+
+/* all statistics */
+typedef struct dap_stats_t
+{
+    dap_stats_cmd_t xCmd[256];
+    uint32_t ulHist[DAP_STATS_HIST_COUNT][DAP_STATS_HIST_BUCKETS];
+    uint64_t ullBusyUs;         // time spent executing commands (swd link busy)
+    uint64_t ullIdleUs;         // time spent waiting for the next usb packet
+    uint32_t ulProtocolErr;     // swd acknowledges that are neither OK/WAIT/FAULT
+    uint32_t ulAborts;          // DAP_TransferAbort taken out of band by the usb thread
+    volatile uint32_t ulSeq;    // odd while the dap thread updates a 64-bit sum
+    uint32_t ulStartUs;         // start time of the current command
+    uint8_t ucCurrent;          // id of the command being executed
+    bool xActive;               // a host command is executing, acknowledges belong to it
+} dap_stats_t;
+
+extern dap_stats_t xDapStats;
+
+/*-----------------------------------------------------------*/
+
+/// @brief clear all statistics
+void vDapStatsReset(void);
+
+/// @brief counters of one command since the last reset
+/// @param ucId : command id
+/// @param px : counters output
+void vDapStatsCmdGet(uint8_t ucId, dap_stats_cmd_t * px);
+
+/// @brief one histogram bucket since the last reset
+/// @param eHist : histogram
+/// @param ulBucket : bucket
+/// @return samples
+uint32_t ulDapStatsHistGet(dap_stats_hist_t eHist, uint32_t ulBucket);
+
+/// @brief link totals since the last reset
+/// @param pullBusyUs : time spent executing commands output [us]
+/// @param pullIdleUs : time spent waiting for usb output [us]
+/// @param pulProtocolErr : protocol errors output
+void vDapStatsLinkGet(uint64_t * pullBusyUs, uint64_t * pullIdleUs, uint32_t * pulProtocolErr);
+
+/// @brief account a DAP_TransferAbort taken out of band by the usb thread
+void vDapStatsAbort(void);
+
+/// @brief account the time of one request
+/// @param ulIdleUs : waiting for the request [us]
+/// @param ulBusyUs : executing it [us]
+void vDapStatsLink(uint32_t ulIdleUs, uint32_t ulBusyUs);
+
+/// @brief put a latency sample into one histogram
+/// @param eHist : histogram
+/// @param ulUs : latency [us]
+void vDapStatsHistogram(dap_stats_hist_t eHist, uint32_t ulUs);
+
+/// @brief bucket index for a latency
+/// @param ulUs : latency [us]
+/// @return 0 : 0us; n : [2^(n-1), 2^n) us, saturated at the last bucket
+static inline uint32_t ulDapStatsBucket(uint32_t ulUs)
+{
+    uint32_t ulBucket = (0U == ulUs) ? 0U : (32U - (uint32_t)__builtin_clz(ulUs));
+    return (ulBucket < DAP_STATS_HIST_BUCKETS) ? ulBucket : (DAP_STATS_HIST_BUCKETS - 1U);
+}
+
+/// @brief mark the beginning of a single (non batch) command
+/// @param ucId : command id
+static inline void vDapStatsBegin(uint8_t ucId)
+{
+#if (DAP_STATS != 0)
+    xDapStats.ucCurrent = ucId;
+    xDapStats.ulStartUs = time_us_32();
+    xDapStats.xActive = true;
+#else
+    (void)ucId;
+#endif
+}
+
+/// @brief mark the end of the command started by vDapStatsBegin
+/// @param ulNum : return value of DAP_ProcessCommand (request bytes << 16 | response bytes)
+static inline void vDapStatsEnd(uint32_t ulNum)
+{
+#if (DAP_STATS != 0)
+    dap_stats_cmd_t * px = &xDapStats.xCmd[xDapStats.ucCurrent];
+
+    px->ulCalls += 1U;
+    px->ulBytesIn += (ulNum >> 16);
+    px->ulBytesOut += (ulNum & 0xFFFFU);
+    xDapStats.ulSeq += 1U;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    px->ullExecUs += time_us_32() - xDapStats.ulStartUs;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    xDapStats.ulSeq += 1U;
+    xDapStats.xActive = false;
+#else
+    (void)ulNum;
+#endif
+}
+
+/// @brief account a swd acknowledge to the current command, acknowledges of the
+///        probe services and the read-ahead run outside a host command and are not counted
+/// @param ucAck : SWD_Transfer return value
+static inline void vDapStatsSwdAck(uint8_t ucAck)
+{
+#if (DAP_STATS != 0)
+    if ((ucAck == DAP_TRANSFER_OK) || !xDapStats.xActive)
+    {
+        return;
+    }
+    switch (ucAck)
+    {
+        case DAP_TRANSFER_WAIT:
+            xDapStats.xCmd[xDapStats.ucCurrent].ulWait += 1U;
+            break;
+        case DAP_TRANSFER_FAULT:
+            xDapStats.xCmd[xDapStats.ucCurrent].ulFault += 1U;
+            break;
+        case DAP_TRANSFER_ERROR:
+            xDapStats.xCmd[xDapStats.ucCurrent].ulParity += 1U;
+            break;
+        default:
+            xDapStats.ulProtocolErr += 1U;
+            break;
+    }
+#else
+    (void)ucAck;
+#endif
+}
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_STATS_H_ */
@@ -0,0 +1,175 @@
+#include <string.h>
+#include "dapStep.h"
+#include "dapVendor.h"
+#include "target/target.h"
+#include "rp2350.h"
+#include "pico/time.h"
+
+#if (DAP_STEP != 0)
+
+/*-----------------------------------------------------------*/
+
+/* READ response: id status len */
+#define STEP_READ_HEADER        3U
+/* READ copies out of psram in endpoint sized pieces */
+#define STEP_READ_CHUNK         DAP_USB_EP_SIZE
+
+/* trace state */
+typedef struct dap_step_t
+{
+    uint8_t ucReg[1U + DAP_STEP_REGS_MAX];  // sampled registers, PC first
+    size_t xRegs;                           // words per sample, 0 before START
+    uint32_t ulSamples;                     // samples in the buffer
+    uint32_t * pulBuffer;
+} dap_step_t;
+
+static dap_step_t xStep;
+
+/*-----------------------------------------------------------*/
+
+/// @brief load a little endian word
+/// @param puc : source
+/// @return value
+static uint32_t prvStepGet32(const uint8_t * puc)
+{
+    return (uint32_t)puc[0] | ((uint32_t)puc[1] << 8) | ((uint32_t)puc[2] << 16) | ((uint32_t)puc[3] << 24);
+}
+
+/// @brief store a little endian word
+/// @param puc : destination
+/// @param ulWord : value
+static void prvStepPut32(uint8_t * puc, uint32_t ulWord)
+{
+    puc[0] = (uint8_t)ulWord;
+    puc[1] = (uint8_t)(ulWord >> 8);
+    puc[2] = (uint8_t)(ulWord >> 16);
+    puc[3] = (uint8_t)(ulWord >> 24);
+}
+
+/// @brief step and sample until done, the buffer is full or the time is up
+/// @param ulSteps : steps requested
+/// @param pulDone : steps done output
+/// @return acknowledge, DAP_TRANSFER_ERROR when the buffer is full
+static uint8_t prvStepRun(uint32_t ulSteps, uint32_t * pulDone)
+{
+    uint32_t ulCapacity = PSRAM_STEP_SIZE / (xStep.xRegs * 4U);
+    uint32_t ulStartUs = time_us_32();
+
+    *pulDone = 0U;
+    while (*pulDone < ulSteps)
+    {
+        uint32_t n = ulSteps - *pulDone;
+        size_t xDone;
+        uint8_t ucAck;
+
+        if (xStep.ulSamples >= ulCapacity)
+        {
+            return DAP_TRANSFER_ERROR;
+        }
+        if ((time_us_32() - ulStartUs) >= DAP_STEP_TIME_MAX_US)
+        {
+            break;
+        }
+        if (n > DAP_STEP_CHUNK)
+        {
+            n = DAP_STEP_CHUNK;
+        }
+        if (n > (ulCapacity - xStep.ulSamples))
+        {
+            n = ulCapacity - xStep.ulSamples;
+        }
+        ucAck = ucTargetStepTrace(xStep.ucReg, xStep.xRegs, &xStep.pulBuffer[xStep.ulSamples * xStep.xRegs], n, &xDone);
+        xStep.ulSamples += xDone;
+        *pulDone += xDone;
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            return ucAck;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a step trace command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapStepCommand(const uint8_t * request, uint8_t * response)
+{
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+
+    switch (request[1])
+    {
+        case DAP_STEP_START:
+        {
+            uint32_t ulCount = request[2];
+
+            if (ulCount > DAP_STEP_REGS_MAX)
+            {
+                return ((3U << 16) | 2U);
+            }
+            xStep.ucReg[0] = TARGET_REG_PC;
+            memcpy(&xStep.ucReg[1], &request[3], ulCount);
+            xStep.xRegs = 1U + ulCount;
+            xStep.ulSamples = 0U;
+            xStep.pulBuffer = (uint32_t *)PSRAM_STEP_BASE;
+            response[1] = DAP_OK;
+            return (((3U + ulCount) << 16) | 2U);
+        }
+        case DAP_STEP_STEP:
+        {
+            uint32_t ulDone = 0U;
+
+            if (xStep.xRegs != 0U)
+            {
+                vTargetClaim();
+                response[1] = (prvStepRun(prvStepGet32(&request[2]), &ulDone) == DAP_TRANSFER_OK) ? DAP_OK : DAP_ERROR;
+            }
+            prvStepPut32(&response[2], ulDone);
+            prvStepPut32(&response[6], xStep.ulSamples);
+            return ((6U << 16) | 10U);
+        }
+        case DAP_STEP_READ:
+        {
+            uint32_t ulOffset = prvStepGet32(&request[2]);
+            uint32_t ulSize = xStep.ulSamples * xStep.xRegs * 4U;
+            uint32_t ulLen = 0U;
+            // inside a batch the response starts part-way into the packet
+            uint32_t ulRoom = DAP_ResponseRoom(response);
+
+            if (ulRoom < STEP_READ_HEADER)
+            {
+                return (6U << 16);
+            }
+            if (ulOffset <= ulSize)
+            {
+                ulLen = ulSize - ulOffset;
+                if (ulLen > (ulRoom - STEP_READ_HEADER))
+                {
+                    ulLen = ulRoom - STEP_READ_HEADER;
+                }
+                response[1] = DAP_OK;
+            }
+            response[2] = (uint8_t)ulLen;
+            // header first, so every copied chunk is final and can go out
+            for (uint32_t ulDone = 0U, n; ulDone < ulLen; ulDone += n)
+            {
+                n = ((ulLen - ulDone) < STEP_READ_CHUNK) ? (ulLen - ulDone) : STEP_READ_CHUNK;
+                memcpy(&response[STEP_READ_HEADER + ulDone], (const uint8_t *)xStep.pulBuffer + ulOffset + ulDone, n);
+#if (DAP_RESPONSE_STREAM != 0)
+                DAP_ResponseProgress(&response[STEP_READ_HEADER + ulDone + n]);
+#endif
+            }
+            return ((6U << 16) | (STEP_READ_HEADER + ulLen));
+        }
+        default:
+            response[0] = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
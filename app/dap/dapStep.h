@@ -0,0 +1,67 @@
+#ifndef DAP_STEP_H_
+#define DAP_STEP_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Instruction step trace (vendor command ID_DAP_VENDOR_STEP).
+ *
+ * For targets without ETM: the probe single-steps the halted core through
+ * DHCSR (interrupts masked) and samples the PC and up to DAP_STEP_REGS_MAX
+ * further core registers after every step into a PSRAM buffer, the host
+ * fetches the samples in bulk afterwards.
+ *
+ *  START : id 0x00 count regsel[count]        -> id status
+ *  STEP  : id 0x01 steps[4]                   -> id status done[4] total[4]
+ *  READ  : id 0x02 offset[4]                  -> id status len data[len]
+ *
+ * START empties the buffer and sets the registers sampled behind the PC.
+ * STEP steps up to steps instructions, a command stops after
+ * DAP_STEP_TIME_MAX_US so the host repeats it for long traces; done is the
+ * number of steps of this command, total the samples in the buffer. A
+ * sample is (1 + count) little endian words: PC after the step, then the
+ * registers in START order. READ returns buffer bytes from offset on.
+ * STEP answers DAP_ERROR when a transfer failed, the core did not halt
+ * after a step or the buffer is full. The host's SELECT, CSW and TAR are
+ * restored afterwards.
+ */
+
+/* 1: step trace command; 0: not built */
+#ifndef DAP_STEP
+    #define DAP_STEP                1
+#endif
+
+/* registers sampled besides the PC */
+#define DAP_STEP_REGS_MAX           8U
+/* steps between two checks of the time budget */
+#define DAP_STEP_CHUNK              64U
+/* time budget of one STEP command, the dap thread does nothing else meanwhile */
+#define DAP_STEP_TIME_MAX_US        500000UL
+
+/* sub commands */
+#define DAP_STEP_START              0x00U
+#define DAP_STEP_STEP               0x01U
+#define DAP_STEP_READ               0x02U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a step trace command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapStepCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_STEP_H_ */
@@ -0,0 +1,135 @@
+#include "dapVendor.h"
+#include "dapZip.h"
+#include "dapRle.h"
+#include "dapGather.h"
+#include "dapVm.h"
+#include "dapStep.h"
+#include "dapRegs.h"
+#include "dapItm.h"
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a vendor command (overrides the weak default of DAP.c)
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+unsigned int DAP_ProcessVendorCommand(const uint8_t * request, uint8_t * response)
+{
+    switch (*request)
+    {
+#if (DAP_ZIP != 0)
+        case ID_DAP_VENDOR_ZIP:
+            return ulDapZipCommand(request, response);
+#endif
+#if (DAP_RLE != 0)
+        case ID_DAP_VENDOR_RLE_READ:
+            return ulDapRleCommand(request, response);
+#endif
+#if (DAP_GATHER != 0)
+        case ID_DAP_VENDOR_GATHER:
+            return ulDapGatherCommand(request, response);
+#endif
+#if (DAP_VM != 0)
+        case ID_DAP_VENDOR_VM:
+            return ulDapVmCommand(request, response);
+#endif
+#if (DAP_STEP != 0)
+        case ID_DAP_VENDOR_STEP:
+            return ulDapStepCommand(request, response);
+#endif
+#if (DAP_REGS != 0)
+        case ID_DAP_VENDOR_REGS:
+            return ulDapRegsCommand(request, response);
+#endif
+#if (DAP_ITM != 0)
+        case ID_DAP_VENDOR_ITM:
+            return ulDapItmCommand(request, response);
+#endif
+        default:
+            *response = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief request length of a vendor command (overrides the weak default of DAP.c),
+///        the layouts are the ones in the command headers
+/// @param request : request data
+/// @param count : request bytes received
+/// @return number of bytes in request, more than count when the received bytes do not tell yet
+unsigned int DAP_VendorRequestLength(const uint8_t * request, unsigned int count)
+{
+    // unknown ids and sub commands take the id byte only, as in the dispatch above
+    if (count < 2U)
+    {
+        return count + 1U;
+    }
+    switch (*request)
+    {
+#if (DAP_ZIP != 0)
+        case ID_DAP_VENDOR_ZIP:
+            switch (request[1])
+            {
+                case DAP_ZIP_OPEN:      return 14U;
+                case DAP_ZIP_DATA:      return (count < 3U) ? (count + 1U) : (3U + request[2]);
+                case DAP_ZIP_CLOSE:
+                case DAP_ZIP_STATUS:    return 2U;
+                default:                return 1U;
+            }
+#endif
+#if (DAP_RLE != 0)
+        case ID_DAP_VENDOR_RLE_READ:
+            return 7U;
+#endif
+#if (DAP_GATHER != 0)
+        case ID_DAP_VENDOR_GATHER:
+            return ulDapGatherLength(request, count);
+#endif
+#if (DAP_VM != 0)
+        case ID_DAP_VENDOR_VM:
+            switch (request[1])
+            {
+                case DAP_VM_LOAD:       return (count < 5U) ? (count + 1U) : (5U + request[4]);
+                case DAP_VM_RUN:        return (count < 9U) ? (count + 1U) : (9U + (request[8] * 4U));
+                default:                return 1U;
+            }
+#endif
+#if (DAP_STEP != 0)
+        case ID_DAP_VENDOR_STEP:
+            switch (request[1])
+            {
+                case DAP_STEP_START:    return (count < 3U) ? (count + 1U) : (3U + request[2]);
+                case DAP_STEP_STEP:
+                case DAP_STEP_READ:     return 6U;
+                default:                return 1U;
+            }
+#endif
+#if (DAP_REGS != 0)
+        case ID_DAP_VENDOR_REGS:
+            switch (request[1])
+            {
+                case DAP_REGS_SNAPSHOT: return 3U;
+                case DAP_REGS_READ:     return 4U;
+                default:                return 1U;
+            }
+#endif
+#if (DAP_ITM != 0)
+        case ID_DAP_VENDOR_ITM:
+            switch (request[1])
+            {
+                case DAP_ITM_CONFIG:
+                case DAP_ITM_EXC:
+                case DAP_ITM_HIST:      return 4U;
+                case DAP_ITM_READ:      return 3U;
+                case DAP_ITM_STATS:
+                case DAP_ITM_EXC_CLEAR: return 2U;
+                default:                return 1U;
+            }
+#endif
+        default:
+            return 1U;
+    }
+}
+
+/*-----------------------------------------------------------*/
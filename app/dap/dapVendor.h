@@ -0,0 +1,51 @@
+#ifndef DAP_VENDOR_H_
+#define DAP_VENDOR_H_
+
+#include <stdint.h>
+#include "DAP.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Probe specific vendor commands, dispatched from DAP_ProcessVendorCommand.
+ * Every command answers with its id and a status byte (DAP_OK / DAP_ERROR)
+ * first; an unknown id or sub command answers ID_DAP_Invalid.
+ *
+ * The ids start at Vendor16, the lower ones are left to tools that use them
+ * for their own purposes.
+ */
+
+/* vendor command ids */
+#define ID_DAP_VENDOR_ZIP           ID_DAP_Vendor16     // compressed upload (dapZip.h)
+#define ID_DAP_VENDOR_RLE_READ      ID_DAP_Vendor17     // run length encoded memory read (dapRle.h)
+#define ID_DAP_VENDOR_GATHER        ID_DAP_Vendor18     // scatter-gather memory read (dapGather.h)
+#define ID_DAP_VENDOR_VM            ID_DAP_Vendor19     // micro-op interpreter (dapVm.h)
+#define ID_DAP_VENDOR_STEP          ID_DAP_Vendor20     // instruction step trace (dapStep.h)
+#define ID_DAP_VENDOR_REGS          ID_DAP_Vendor21     // core register snapshot (dapRegs.h)
+#define ID_DAP_VENDOR_ITM           ID_DAP_Vendor22     // itm stimulus port streams (dapItm.h)
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a vendor command (overrides the weak default of DAP.c)
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+unsigned int DAP_ProcessVendorCommand(const uint8_t * request, uint8_t * response);
+
+/// @brief request length of a vendor command (overrides the weak default of DAP.c)
+/// @param request : request data
+/// @param count : request bytes received
+/// @return number of bytes in request, more than count when the received bytes do not tell yet
+unsigned int DAP_VendorRequestLength(const uint8_t * request, unsigned int count);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_VENDOR_H_ */
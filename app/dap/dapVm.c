@@ -0,0 +1,307 @@
+#include <string.h>
+#include "dapVm.h"
+#include "dapVendor.h"
+#include "target/target.h"
+#include "pico/time.h"
+
+#if (DAP_VM != 0)
+
+/*-----------------------------------------------------------*/
+
+/* op: second operand is an immediate */
+#define VM_IMM                  0x80U
+
+/* opcodes */
+#define VM_END                  0x00U
+#define VM_FAIL                 0x01U
+#define VM_MOV                  0x02U
+#define VM_ADD                  0x03U
+#define VM_SUB                  0x04U
+#define VM_AND                  0x05U
+#define VM_OR                   0x06U
+#define VM_XOR                  0x07U
+#define VM_SHL                  0x08U
+#define VM_SHR                  0x09U
+#define VM_RD                   0x10U
+#define VM_WR                   0x11U
+#define VM_XFER                 0x12U
+#define VM_BEQ                  0x20U
+#define VM_BNE                  0x21U
+#define VM_BLO                  0x22U
+#define VM_BHS                  0x23U
+#define VM_BSET                 0x24U
+#define VM_BCLR                 0x25U
+#define VM_JMP                  0x28U
+#define VM_LOOP                 0x29U
+#define VM_DELAY                0x30U
+
+/* RUN request: id sub entry[2] steps[4] argc */
+#define VM_RUN_HEADER           9U
+/* RUN response: id status exit ack pc[2] steps[4] */
+#define VM_RESULT_HEADER        10U
+
+/* state of a run */
+typedef struct vm_run_t
+{
+    uint32_t ulReg[DAP_VM_REGS];
+    uint32_t ulPc;              // offset of the current instruction
+    uint32_t ulSteps;           // instructions executed
+    uint8_t ucAck;              // acknowledge of the last transfer
+} vm_run_t;
+
+// program memory, kept between runs
+static uint8_t ucVmProgram[DAP_VM_PROGRAM_SIZE];
+
+/*-----------------------------------------------------------*/
+
+/// @brief load a little endian word
+/// @param puc : source
+/// @return value
+static uint32_t prvVmGet32(const uint8_t * puc)
+{
+    return (uint32_t)puc[0] | ((uint32_t)puc[1] << 8) | ((uint32_t)puc[2] << 16) | ((uint32_t)puc[3] << 24);
+}
+
+/// @brief store a little endian word
+/// @param puc : destination
+/// @param ulWord : value
+static void prvVmPut32(uint8_t * puc, uint32_t ulWord)
+{
+    puc[0] = (uint8_t)ulWord;
+    puc[1] = (uint8_t)(ulWord >> 8);
+    puc[2] = (uint8_t)(ulWord >> 16);
+    puc[3] = (uint8_t)(ulWord >> 24);
+}
+
+/// @brief bytes an instruction carries behind op, a and the immediate
+/// @param ucOp : opcode without VM_IMM
+/// @return bytes
+static uint32_t prvVmExtra(uint8_t ucOp)
+{
+    if (ucOp == VM_XFER)
+    {
+        return 1U;
+    }
+    if (((ucOp >= VM_BEQ) && (ucOp <= VM_BCLR)) || (ucOp == VM_JMP) || (ucOp == VM_LOOP))
+    {
+        return 2U;
+    }
+    return 0U;
+}
+
+/// @brief evaluate a branch condition
+/// @param ucOp : branch opcode without VM_IMM
+/// @param ulA : rd
+/// @param ulB : op2
+/// @return true to branch
+static bool prvVmCondition(uint8_t ucOp, uint32_t ulA, uint32_t ulB)
+{
+    switch (ucOp)
+    {
+        case VM_BEQ:    return (ulA == ulB);
+        case VM_BNE:    return (ulA != ulB);
+        case VM_BLO:    return (ulA < ulB);
+        case VM_BHS:    return (ulA >= ulB);
+        case VM_BSET:   return ((ulA & ulB) != 0U);
+        default:        return ((ulA & ulB) == 0U);
+    }
+}
+
+/// @brief execute the program until it stops
+/// @param px : run state, registers and pc set up
+/// @param ulBudget : most instructions to execute
+/// @return exit reason (DAP_VM_EXIT_x)
+static uint8_t prvVmExecute(vm_run_t * px, uint32_t ulBudget)
+{
+    uint32_t ulStartUs = time_us_32();
+
+    for (;;)
+    {
+        uint32_t ulPc = px->ulPc;
+        uint8_t ucOp, ucRd, ucRs;
+        uint32_t ulLen, ulOp2;
+        const uint8_t * pucExtra;
+        uint32_t * pulRd;
+
+        if (px->ulSteps >= ulBudget)
+        {
+            return DAP_VM_EXIT_STEPS;
+        }
+        if ((time_us_32() - ulStartUs) >= DAP_VM_TIME_MAX_US)
+        {
+            return DAP_VM_EXIT_TIME;
+        }
+        // decode, nothing may reach outside the program or the registers
+        if ((ulPc + 2U) > DAP_VM_PROGRAM_SIZE)
+        {
+            return DAP_VM_EXIT_INVALID;
+        }
+        ucOp = ucVmProgram[ulPc];
+        ucRd = ucVmProgram[ulPc + 1U] >> 4;
+        ucRs = ucVmProgram[ulPc + 1U] & 0x0FU;
+        ulLen = 2U + (((ucOp & VM_IMM) != 0U) ? 4U : 0U);
+        pucExtra = &ucVmProgram[ulPc + ulLen];
+        ulLen += prvVmExtra(ucOp & (uint8_t)~VM_IMM);
+        if (((ulPc + ulLen) > DAP_VM_PROGRAM_SIZE) || (ucRd >= DAP_VM_REGS) ||
+            (((ucOp & VM_IMM) == 0U) && (ucRs >= DAP_VM_REGS)))
+        {
+            return DAP_VM_EXIT_INVALID;
+        }
+        ulOp2 = ((ucOp & VM_IMM) != 0U) ? prvVmGet32(&ucVmProgram[ulPc + 2U]) : px->ulReg[ucRs];
+        pulRd = &px->ulReg[ucRd];
+        px->ulSteps += 1U;
+        px->ulPc = ulPc + ulLen;
+
+        switch (ucOp & (uint8_t)~VM_IMM)
+        {
+            case VM_END:
+                px->ulPc = ulPc;
+                return DAP_VM_EXIT_END;
+            case VM_FAIL:
+                px->ulPc = ulPc;
+                return DAP_VM_EXIT_FAIL;
+            case VM_MOV:
+                *pulRd = ulOp2;
+                break;
+            case VM_ADD:
+                *pulRd += ulOp2;
+                break;
+            case VM_SUB:
+                *pulRd -= ulOp2;
+                break;
+            case VM_AND:
+                *pulRd &= ulOp2;
+                break;
+            case VM_OR:
+                *pulRd |= ulOp2;
+                break;
+            case VM_XOR:
+                *pulRd ^= ulOp2;
+                break;
+            case VM_SHL:
+                *pulRd <<= (ulOp2 & 31U);
+                break;
+            case VM_SHR:
+                *pulRd >>= (ulOp2 & 31U);
+                break;
+            case VM_RD:
+                px->ucAck = ucTargetReadWord(ulOp2, pulRd);
+                break;
+            case VM_WR:
+                px->ucAck = ucTargetWriteWord(*pulRd, ulOp2);
+                break;
+            case VM_XFER:
+                if ((pucExtra[0] & DAP_TRANSFER_RnW) != 0U)
+                {
+                    px->ucAck = ucTargetTransfer(pucExtra[0], pulRd);
+                }
+                else
+                {
+                    px->ucAck = ucTargetTransfer(pucExtra[0], &ulOp2);
+                }
+                break;
+            case VM_BEQ:
+            case VM_BNE:
+            case VM_BLO:
+            case VM_BHS:
+            case VM_BSET:
+            case VM_BCLR:
+                if (prvVmCondition(ucOp & (uint8_t)~VM_IMM, *pulRd, ulOp2))
+                {
+                    px->ulPc = (uint32_t)pucExtra[0] | ((uint32_t)pucExtra[1] << 8);
+                }
+                break;
+            case VM_JMP:
+                px->ulPc = (uint32_t)pucExtra[0] | ((uint32_t)pucExtra[1] << 8);
+                break;
+            case VM_LOOP:
+                *pulRd -= 1U;
+                if (*pulRd != 0U)
+                {
+                    px->ulPc = (uint32_t)pucExtra[0] | ((uint32_t)pucExtra[1] << 8);
+                }
+                break;
+            case VM_DELAY:
+                busy_wait_us_32((ulOp2 < DAP_VM_DELAY_MAX_US) ? ulOp2 : DAP_VM_DELAY_MAX_US);
+                break;
+            default:
+                px->ulPc = ulPc;
+                return DAP_VM_EXIT_INVALID;
+        }
+        if (px->ucAck != DAP_TRANSFER_OK)
+        {
+            px->ulPc = ulPc;
+            return DAP_VM_EXIT_TRANSFER;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a micro-op interpreter command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapVmCommand(const uint8_t * request, uint8_t * response)
+{
+    response[0] = request[0];
+    response[1] = DAP_ERROR;
+
+    switch (request[1])
+    {
+        case DAP_VM_LOAD:
+        {
+            uint32_t ulOffset = (uint32_t)request[2] | ((uint32_t)request[3] << 8);
+            uint32_t ulLen = request[4];
+
+            if ((ulLen > (DAP_PACKET_SIZE - 5U)) || ((ulOffset + ulLen) > DAP_VM_PROGRAM_SIZE))
+            {
+                return ((5U << 16) | 2U);
+            }
+            memcpy(&ucVmProgram[ulOffset], &request[5], ulLen);
+            response[1] = DAP_OK;
+            return (((5U + ulLen) << 16) | 2U);
+        }
+        case DAP_VM_RUN:
+        {
+            vm_run_t xRun;
+            uint32_t ulBudget = prvVmGet32(&request[4]);
+            uint32_t ulArgs = request[8];
+            uint8_t ucExit;
+
+            if ((ulArgs > DAP_VM_REGS) || ((VM_RUN_HEADER + (ulArgs * 4U)) > DAP_PACKET_SIZE))
+            {
+                return ((VM_RUN_HEADER << 16) | 2U);
+            }
+            memset(&xRun, 0x00, sizeof(xRun));
+            for (uint32_t i = 0U; i < ulArgs; i++)
+            {
+                xRun.ulReg[i] = prvVmGet32(&request[VM_RUN_HEADER + (i * 4U)]);
+            }
+            xRun.ulPc = (uint32_t)request[2] | ((uint32_t)request[3] << 8);
+            xRun.ucAck = DAP_TRANSFER_OK;
+
+            vTargetClaim();
+            ucExit = prvVmExecute(&xRun, (ulBudget < DAP_VM_STEPS_MAX) ? ulBudget : DAP_VM_STEPS_MAX);
+
+            response[1] = (ucExit == DAP_VM_EXIT_END) ? DAP_OK : DAP_ERROR;
+            response[2] = ucExit;
+            response[3] = xRun.ucAck;
+            response[4] = (uint8_t)xRun.ulPc;
+            response[5] = (uint8_t)(xRun.ulPc >> 8);
+            prvVmPut32(&response[6], xRun.ulSteps);
+            for (uint32_t i = 0U; i < DAP_VM_REGS; i++)
+            {
+                prvVmPut32(&response[VM_RESULT_HEADER + (i * 4U)], xRun.ulReg[i]);
+            }
+            return (((VM_RUN_HEADER + (ulArgs * 4U)) << 16) | (VM_RESULT_HEADER + (DAP_VM_REGS * 4U)));
+        }
+        default:
+            response[0] = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef DAP_VM_H_
+#define DAP_VM_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Micro-op interpreter (vendor command ID_DAP_VENDOR_VM).
+ *
+ * The host loads a small program once and runs it with arguments as often
+ * as it likes, so polling loops and access sequences run at wire speed
+ * instead of one USB round trip per access.
+ *
+ *  LOAD : id 0x00 offset[2] len code[len]                -> id status
+ *  RUN  : id 0x01 entry[2] steps[4] argc arg[argc][4]
+ *                      -> id status exit ack pc[2] steps[4] r[DAP_VM_REGS][4]
+ *
+ * RUN copies the arguments into r0.., clears the other registers and starts
+ * at entry. It answers DAP_OK when the program reached END; exit tells why
+ * it stopped, ack is the acknowledge of a failed transfer, pc the offset of
+ * the instruction that stopped it and steps the instructions executed.
+ * A run ends after the smaller of steps and DAP_VM_STEPS_MAX instructions or
+ * DAP_VM_TIME_MAX_US, whichever comes first.
+ *
+ * Instructions are op a [imm[4]] [extra], a = rd << 4 | rs. With bit 7 of
+ * op set the second operand (op2) is imm instead of rs. Numbers are little
+ * endian, branch targets are absolute offsets in the program.
+ *
+ *  0x00 END                    stop, DAP_OK
+ *  0x01 FAIL                   stop, DAP_ERROR
+ *  0x02 MOV  rd, op2           rd = op2
+ *  0x03 ADD  rd, op2           rd += op2 (SUB, AND, OR, XOR, SHL, SHR up to 0x09)
+ *  0x10 RD   rd, op2           rd = word at address op2 (MEM-AP)
+ *  0x11 WR   rd, op2           word at address rd = op2
+ *  0x12 XFER rd, op2, req[1]   DP/AP transfer as in DAP_Transfer: reads to rd, writes op2
+ *  0x20 BEQ  rd, op2, target[2]
+ *  0x21 BNE, 0x22 BLO (unsigned <), 0x23 BHS (unsigned >=)
+ *  0x24 BSET rd, op2, target[2]  branch if (rd & op2) != 0
+ *  0x25 BCLR rd, op2, target[2]  branch if (rd & op2) == 0
+ *  0x28 JMP  target[2]
+ *  0x29 LOOP rd, target[2]     branch if --rd != 0
+ *  0x30 DELAY op2              wait op2 microseconds (up to DAP_VM_DELAY_MAX_US)
+ *
+ * SELECT and CSW/TAR of the probe's MEM-AP are put back after a run, AP
+ * registers a program writes on another AP are not.
+ */
+
+/* 1: micro-op interpreter command; 0: not built */
+#ifndef DAP_VM
+    #define DAP_VM                  1
+#endif
+
+/* program memory (bytes) */
+#define DAP_VM_PROGRAM_SIZE         1024U
+/* registers */
+#define DAP_VM_REGS                 8U
+/* instruction budget of one run */
+#define DAP_VM_STEPS_MAX            1000000UL
+/* time budget of one run, the dap thread does nothing else meanwhile */
+#define DAP_VM_TIME_MAX_US          500000UL
+/* longest single delay */
+#define DAP_VM_DELAY_MAX_US         100000UL
+
+/* sub commands */
+#define DAP_VM_LOAD                 0x00U
+#define DAP_VM_RUN                  0x01U
+
+/* exit reasons */
+#define DAP_VM_EXIT_END             0x00U   // END reached
+#define DAP_VM_EXIT_FAIL            0x01U   // FAIL reached
+#define DAP_VM_EXIT_STEPS           0x02U   // instruction budget used up
+#define DAP_VM_EXIT_TIME            0x03U   // time budget used up
+#define DAP_VM_EXIT_TRANSFER        0x04U   // a transfer failed, see ack
+#define DAP_VM_EXIT_INVALID         0x05U   // unknown instruction or outside the program
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a micro-op interpreter command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapVmCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_VM_H_ */
@@ -0,0 +1,387 @@
+#include <string.h>
+#include "dapZip.h"
+#include "dapVendor.h"
+#include "target/target.h"
+#include "prog/programmer.h"
+#include "rp2350.h"
+#include "util.h"
+
+#if (DAP_ZIP != 0)
+
+/*-----------------------------------------------------------*/
+
+/* history window: LZ4 matches reach back 64k, heatshrink 2^window_bits */
+#define ZIP_WINDOW_MASK         (PSRAM_ZIP_SIZE - 1U)
+
+/* heatshrink parameter range */
+#define ZIP_HS_WINDOW_MIN       4U
+#define ZIP_HS_WINDOW_MAX       15U
+#define ZIP_HS_COUNT_MIN        3U
+
+/* decoder states */
+typedef enum zip_state_t
+{
+    ZIP_LZ4_TOKEN = 0,          // next sequence
+    ZIP_LZ4_LITLEN,             // literal length extension
+    ZIP_LZ4_LITERAL,
+    ZIP_LZ4_OFFSET0,            // match offset, low byte
+    ZIP_LZ4_OFFSET1,
+    ZIP_LZ4_MATCHLEN,           // match length extension
+    ZIP_HS_TAG,                 // 1: literal, 0: back reference
+    ZIP_HS_LITERAL,
+    ZIP_HS_INDEX,
+    ZIP_HS_COUNT
+} zip_state_t;
+
+/* stream state */
+typedef struct dap_zip_t
+{
+    bool xOpen;
+    bool xError;                // sticky until the stream is closed
+    uint8_t ucCodec;
+    uint8_t ucDest;
+    zip_state_t eState;
+    uint32_t ulAddr;            // target address of ucOut[0]
+    uint32_t ulSize;            // decoded bytes announced
+    uint32_t ulWritten;         // decoded bytes so far
+    uint32_t ulCrc;             // crc of the flushed bytes
+    uint8_t ucToken;            // LZ4 token of the current sequence
+    uint32_t ulLiteral;         // literals left
+    uint32_t ulMatch;           // match length
+    uint32_t ulOffset;          // match distance
+    uint32_t ulBits;            // heatshrink bit accumulator, msb first
+    uint32_t ulBitCount;
+    uint32_t ulWindowBits;
+    uint32_t ulCountBits;
+    uint8_t * pucWindow;        // last decoded bytes
+    size_t xOut;
+    uint8_t ucOut[DAP_ZIP_OUT_SIZE];
+} dap_zip_t;
+
+static dap_zip_t xZip;
+
+/*-----------------------------------------------------------*/
+
+/// @brief write the collected output to the destination
+static void prvZipFlush(void)
+{
+    bool xOk;
+
+    if (xZip.xOut == 0U)
+    {
+        return;
+    }
+    xZip.ulCrc = ulUtilCrc32(xZip.ulCrc, xZip.ucOut, xZip.xOut);
+    if (xZip.ucDest == DAP_ZIP_DEST_MEMORY)
+    {
+        xOk = (ucTargetWriteMem(xZip.ulAddr, xZip.ucOut, xZip.xOut) == DAP_TRANSFER_OK);
+    }
+    else
+    {
+        xOk = (xProgStreamWrite(xZip.ulAddr, xZip.ucOut, xZip.xOut) == pdPASS);
+    }
+    xZip.ulAddr += xZip.xOut;
+    xZip.xOut = 0U;
+    if (!xOk)
+    {
+        xZip.xError = true;
+    }
+}
+
+/// @brief one decoded byte
+/// @param uc : byte
+static void prvZipPut(uint8_t uc)
+{
+    if (xZip.ulWritten >= xZip.ulSize)
+    {
+        xZip.xError = true;
+        return;
+    }
+    xZip.pucWindow[xZip.ulWritten & ZIP_WINDOW_MASK] = uc;
+    xZip.ulWritten += 1U;
+    xZip.ucOut[xZip.xOut++] = uc;
+    if (xZip.xOut == sizeof(xZip.ucOut))
+    {
+        prvZipFlush();
+    }
+}
+
+/// @brief repeat earlier output
+/// @param ulOffset : distance back
+/// @param ulCount : bytes
+static void prvZipCopy(uint32_t ulOffset, uint32_t ulCount)
+{
+    if ((ulOffset == 0U) || (ulOffset > xZip.ulWritten) || (ulOffset > PSRAM_ZIP_SIZE))
+    {
+        xZip.xError = true;
+        return;
+    }
+    // overlapping copies repeat a pattern, byte by byte is what the encoder meant
+    while ((ulCount-- != 0U) && !xZip.xError)
+    {
+        prvZipPut(xZip.pucWindow[(xZip.ulWritten - ulOffset) & ZIP_WINDOW_MASK]);
+    }
+}
+
+/// @brief decode one byte of an LZ4 block
+/// @param uc : input byte
+static void prvZipLz4(uint8_t uc)
+{
+    switch (xZip.eState)
+    {
+        case ZIP_LZ4_TOKEN:
+            xZip.ucToken = uc;
+            xZip.ulLiteral = uc >> 4;
+            if (xZip.ulLiteral == 15U)
+                xZip.eState = ZIP_LZ4_LITLEN;
+            else if (xZip.ulLiteral != 0U)
+                xZip.eState = ZIP_LZ4_LITERAL;
+            else
+                xZip.eState = ZIP_LZ4_OFFSET0;
+            break;
+        case ZIP_LZ4_LITLEN:
+            xZip.ulLiteral += uc;
+            if (uc != 255U)
+            {
+                xZip.eState = ZIP_LZ4_LITERAL;
+            }
+            break;
+        case ZIP_LZ4_LITERAL:
+            prvZipPut(uc);
+            if (--xZip.ulLiteral == 0U)
+            {
+                xZip.eState = ZIP_LZ4_OFFSET0;
+            }
+            break;
+        case ZIP_LZ4_OFFSET0:
+            xZip.ulOffset = uc;
+            xZip.eState = ZIP_LZ4_OFFSET1;
+            break;
+        case ZIP_LZ4_OFFSET1:
+            xZip.ulOffset |= (uint32_t)uc << 8;
+            xZip.ulMatch = (xZip.ucToken & 0x0FU) + 4U;
+            if ((xZip.ucToken & 0x0FU) == 0x0FU)
+            {
+                xZip.eState = ZIP_LZ4_MATCHLEN;
+                break;
+            }
+            prvZipCopy(xZip.ulOffset, xZip.ulMatch);
+            xZip.eState = ZIP_LZ4_TOKEN;
+            break;
+        case ZIP_LZ4_MATCHLEN:
+            xZip.ulMatch += uc;
+            if (uc != 255U)
+            {
+                prvZipCopy(xZip.ulOffset, xZip.ulMatch);
+                xZip.eState = ZIP_LZ4_TOKEN;
+            }
+            break;
+        default:
+            xZip.xError = true;
+            break;
+    }
+}
+
+/// @brief decode one byte of a heatshrink stream
+/// @param uc : input byte
+static void prvZipHeatshrink(uint8_t uc)
+{
+    xZip.ulBits = (xZip.ulBits << 8) | uc;
+    xZip.ulBitCount += 8U;
+    while (!xZip.xError)
+    {
+        uint32_t ulNeed, ulValue;
+
+        switch (xZip.eState)
+        {
+            case ZIP_HS_TAG:     ulNeed = 1U; break;
+            case ZIP_HS_LITERAL: ulNeed = 8U; break;
+            case ZIP_HS_INDEX:   ulNeed = xZip.ulWindowBits; break;
+            default:             ulNeed = xZip.ulCountBits; break;
+        }
+        if (xZip.ulBitCount < ulNeed)
+        {
+            break;
+        }
+        xZip.ulBitCount -= ulNeed;
+        ulValue = (xZip.ulBits >> xZip.ulBitCount) & ((1UL << ulNeed) - 1U);
+        switch (xZip.eState)
+        {
+            case ZIP_HS_TAG:
+                xZip.eState = (ulValue != 0U) ? ZIP_HS_LITERAL : ZIP_HS_INDEX;
+                break;
+            case ZIP_HS_LITERAL:
+                prvZipPut((uint8_t)ulValue);
+                xZip.eState = ZIP_HS_TAG;
+                break;
+            case ZIP_HS_INDEX:
+                xZip.ulOffset = ulValue + 1U;
+                xZip.eState = ZIP_HS_COUNT;
+                break;
+            default:
+                prvZipCopy(xZip.ulOffset, ulValue + 1U);
+                xZip.eState = ZIP_HS_TAG;
+                break;
+        }
+    }
+}
+
+/// @brief check that the input ended between two symbols
+/// @return true if the stream is complete
+static bool prvZipComplete(void)
+{
+    switch (xZip.ucCodec)
+    {
+        case DAP_ZIP_CODEC_LZ4:
+            // the last sequence of a block has literals only
+            return (xZip.eState == ZIP_LZ4_TOKEN) || (xZip.eState == ZIP_LZ4_OFFSET0);
+        case DAP_ZIP_CODEC_HEATSHRINK:
+            // the encoder pads the last byte with zero bits
+            return true;
+        default:
+            return true;
+    }
+}
+
+/// @brief close the stream
+/// @param xOk : false to drop it
+/// @return true if everything was decoded and written
+static bool prvZipClose(bool xOk)
+{
+    if (!xZip.xOpen)
+    {
+        return false;
+    }
+    if (xOk && !xZip.xError)
+    {
+        prvZipFlush();
+    }
+    xOk = xOk && !xZip.xError && prvZipComplete() && (xZip.ulWritten == xZip.ulSize);
+    if (xZip.ucDest == DAP_ZIP_DEST_FLASH)
+    {
+        vProgStreamEnd(xOk);
+    }
+    xZip.xOpen = false;
+    return xOk;
+}
+
+/// @brief open a stream
+/// @param request : OPEN parameters (behind the sub command)
+/// @return true if open
+static bool prvZipOpen(const uint8_t * request)
+{
+    uint32_t ulAddr = (uint32_t)request[2] | ((uint32_t)request[3] << 8) | ((uint32_t)request[4] << 16) | ((uint32_t)request[5] << 24);
+    uint32_t ulSize = (uint32_t)request[6] | ((uint32_t)request[7] << 8) | ((uint32_t)request[8] << 16) | ((uint32_t)request[9] << 24);
+
+    (void)prvZipClose(false);
+    memset(&xZip, 0x00, sizeof(xZip));
+    xZip.ucCodec = request[0];
+    xZip.ucDest = request[1];
+    xZip.ulAddr = ulAddr;
+    xZip.ulSize = ulSize;
+    xZip.ulWindowBits = request[10];
+    xZip.ulCountBits = request[11];
+    xZip.pucWindow = (uint8_t *)PSRAM_ZIP_BASE;
+    xZip.eState = (xZip.ucCodec == DAP_ZIP_CODEC_HEATSHRINK) ? ZIP_HS_TAG : ZIP_LZ4_TOKEN;
+
+    if ((xZip.ucCodec > DAP_ZIP_CODEC_HEATSHRINK) || (xZip.ucDest > DAP_ZIP_DEST_FLASH))
+    {
+        return false;
+    }
+    if ((xZip.ucCodec == DAP_ZIP_CODEC_HEATSHRINK) &&
+        ((xZip.ulWindowBits < ZIP_HS_WINDOW_MIN) || (xZip.ulWindowBits > ZIP_HS_WINDOW_MAX) ||
+         (xZip.ulCountBits < ZIP_HS_COUNT_MIN) || (xZip.ulCountBits >= xZip.ulWindowBits)))
+    {
+        return false;
+    }
+    if (xZip.ucDest == DAP_ZIP_DEST_FLASH)
+    {
+        // the programmer checks the range on every write; the session has a size and ends the stream itself
+        if ((ulAddr < PROG_FLASH_BASE) || ((ulAddr - PROG_FLASH_BASE) >= PSRAM_IMAGE_SIZE) ||
+            (ulSize > (PSRAM_IMAGE_SIZE - (ulAddr - PROG_FLASH_BASE))) ||
+            (xProgStreamBegin(IMAGE_FORMAT_UNKNOWN) != pdPASS))
+        {
+            return false;
+        }
+    }
+    xZip.xOpen = true;
+    return true;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a compressed upload command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapZipCommand(const uint8_t * request, uint8_t * response)
+{
+    uint32_t ulRequest, ulResponse = 2U;
+    bool xOk;
+
+    response[0] = request[0];
+    switch (request[1])
+    {
+        case DAP_ZIP_OPEN:
+            ulRequest = 14U;
+            xOk = prvZipOpen(&request[2]);
+            break;
+        case DAP_ZIP_DATA:
+            ulRequest = 3U + request[2];
+            xOk = xZip.xOpen && !xZip.xError && (ulRequest <= DAP_PACKET_SIZE);
+            if (!xOk)
+            {
+                break;
+            }
+            if (xZip.ucDest == DAP_ZIP_DEST_MEMORY)
+            {
+                vTargetClaim();
+            }
+            for (uint32_t i = 0U; (i < request[2]) && !xZip.xError; i++)
+            {
+                switch (xZip.ucCodec)
+                {
+                    case DAP_ZIP_CODEC_LZ4:        prvZipLz4(request[3U + i]); break;
+                    case DAP_ZIP_CODEC_HEATSHRINK: prvZipHeatshrink(request[3U + i]); break;
+                    default:                       prvZipPut(request[3U + i]); break;
+                }
+            }
+            xOk = !xZip.xError;
+            break;
+        case DAP_ZIP_CLOSE:
+            ulRequest = 2U;
+            if (xZip.xOpen && (xZip.ucDest == DAP_ZIP_DEST_MEMORY))
+            {
+                vTargetClaim();
+            }
+            xOk = prvZipClose(true);
+            for (uint32_t i = 0U; i < 4U; i++)
+            {
+                response[2U + i] = (uint8_t)(xZip.ulWritten >> (8U * i));
+                response[6U + i] = (uint8_t)(xZip.ulCrc >> (8U * i));
+            }
+            ulResponse = 10U;
+            break;
+        case DAP_ZIP_STATUS:
+        {
+            prog_status_t xStatus;
+
+            ulRequest = 2U;
+            vProgStatus(&xStatus);
+            // a flash stream is still being programmed while the programmer is busy
+            xOk = !xZip.xOpen;
+            response[2] = (uint8_t)xStatus.eResult;
+            ulResponse = 3U;
+            break;
+        }
+        default:
+            response[0] = ID_DAP_Invalid;
+            return ((1U << 16) | 1U);
+    }
+    response[1] = xOk ? DAP_OK : DAP_ERROR;
+    return ((ulRequest << 16) | ulResponse);
+}
+
+/*-----------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef DAP_ZIP_H_
+#define DAP_ZIP_H_
+
+#include <stdint.h>
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Compressed upload (vendor command ID_DAP_VENDOR_ZIP).
+ *
+ * The host opens a stream with a codec and a destination, sends the
+ * compressed bytes in as many DATA commands as it needs and closes it. The
+ * probe decodes while the packets arrive and writes the output straight to
+ * target memory or into the programmer stream, which erases and programs the
+ * flash sector by sector behind the data.
+ *
+ *  OPEN   : id 0x00 codec dest addr[4] size[4] window_bits count_bits -> id status
+ *  DATA   : id 0x01 len data[len]                                     -> id status
+ *  CLOSE  : id 0x02                                  -> id status written[4] crc32[4]
+ *  STATUS : id 0x03                                  -> id status prog_result_t
+ *
+ * codec 0: raw; 1: LZ4, one raw block without frame (the whole image
+ * compressed as a single block); 2: heatshrink with the window and count
+ * bits the encoder used. dest 0: memory (MEM-AP), 1: flash.
+ * Numbers are little endian, crc32 is ulUtilCrc32 of the decoded data.
+ * A failed stream answers DAP_ERROR until it is closed; STATUS reports the
+ * programmer once a flash stream is closed.
+ *
+ * SELECT, CSW and TAR are put back after a memory stream wrote data.
+ */
+
+/* 1: compressed upload command; 0: not built */
+#ifndef DAP_ZIP
+    #define DAP_ZIP                 1
+#endif
+
+/* decoded bytes collected before they are written */
+#define DAP_ZIP_OUT_SIZE            1024U
+
+/* sub commands */
+#define DAP_ZIP_OPEN                0x00U
+#define DAP_ZIP_DATA                0x01U
+#define DAP_ZIP_CLOSE               0x02U
+#define DAP_ZIP_STATUS              0x03U
+
+/* codecs */
+#define DAP_ZIP_CODEC_RAW           0x00U
+#define DAP_ZIP_CODEC_LZ4           0x01U
+#define DAP_ZIP_CODEC_HEATSHRINK    0x02U
+
+/* destinations */
+#define DAP_ZIP_DEST_MEMORY         0x00U
+#define DAP_ZIP_DEST_FLASH          0x01U
+
+/*-----------------------------------------------------------*/
+
+/// @brief process a compressed upload command
+/// @param request : request data
+/// @param response : response data
+/// @return number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits)
+uint32_t ulDapZipCommand(const uint8_t * request, uint8_t * response);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* DAP_ZIP_H_ */
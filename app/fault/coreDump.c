@@ -0,0 +1,244 @@
+#include <string.h>
+#include "coreDump.h"
+#include "target/target.h"
+#include "rp2350.h"
+
+/*-----------------------------------------------------------*/
+
+/* ELF constants */
+#define ELF_EHDR_SIZE           52U
+#define ELF_PHDR_SIZE           32U
+#define ELF_ET_CORE             4U
+#define ELF_EM_ARM              40U
+#define ELF_PT_LOAD             1U
+#define ELF_PT_NOTE             4U
+#define ELF_PF_RWX              7U
+
+/* NT_PRSTATUS note, arm linux struct elf_prstatus */
+#define CORE_NT_PRSTATUS        1U
+#define CORE_NOTE_NAME          "CORE"
+#define CORE_NOTE_NAME_SIZE     8U          // "CORE\0" padded
+#define CORE_PRSTATUS_SIZE      148U
+#define CORE_PRSTATUS_CURSIG    12U
+#define CORE_PRSTATUS_PID       24U
+#define CORE_PRSTATUS_REG       72U
+#define CORE_NOTE_SIZE          (12U + CORE_NOTE_NAME_SIZE + CORE_PRSTATUS_SIZE)
+/* r0-r15, xpsr */
+#define CORE_REGS               17U
+
+/* signals reported */
+#define CORE_SIGTRAP            5U
+#define CORE_SIGSEGV            11U
+
+/* DFSR: halted on a vector catch */
+#define CORE_DFSR_VCATCH        (1UL << 3)
+
+/* headers in front of the data */
+#define CORE_HEADER_MAX         (ELF_EHDR_SIZE + ((1U + CORE_REGIONS_MAX) * ELF_PHDR_SIZE) + CORE_NOTE_SIZE)
+
+/* dump state */
+typedef struct core_t
+{
+    CoreWrite_t xWrite;
+    uint8_t * pucBackup;        // PSRAM_CORE_SIZE bytes
+    core_status_t xStatus;
+    uint8_t ucHeader[CORE_HEADER_MAX];
+    uint32_t ulChunk[CORE_CHUNK_SIZE / 4U];
+} core_t;
+
+static core_t xCore;
+
+/*-----------------------------------------------------------*/
+
+/// @brief store a little endian half word
+/// @param puc : destination
+/// @param usData : value
+static void prvCorePut16(uint8_t * puc, uint16_t usData)
+{
+    puc[0] = (uint8_t)usData;
+    puc[1] = (uint8_t)(usData >> 8);
+}
+
+/// @brief store a little endian word
+/// @param puc : destination
+/// @param ulData : value
+static void prvCorePut32(uint8_t * puc, uint32_t ulData)
+{
+    puc[0] = (uint8_t)ulData;
+    puc[1] = (uint8_t)(ulData >> 8);
+    puc[2] = (uint8_t)(ulData >> 16);
+    puc[3] = (uint8_t)(ulData >> 24);
+}
+
+/// @brief write file bytes and keep them in the backup
+/// @param puc : data
+/// @param xLen : bytes
+static void prvCoreOut(const uint8_t * puc, size_t xLen)
+{
+    uint32_t ulRoom = PSRAM_CORE_SIZE - xCore.xStatus.ulStored;
+    uint32_t ulCopy = (xLen < ulRoom) ? (uint32_t)xLen : ulRoom;
+
+    memcpy(&xCore.pucBackup[xCore.xStatus.ulStored], puc, ulCopy);
+    xCore.xStatus.ulStored += ulCopy;
+    xCore.xStatus.ulBytes += (uint32_t)xLen;
+    (void)xCore.xWrite((uint8_t *)puc, (int)xLen);
+}
+
+/// @brief build ELF header, program headers and the register note
+/// @param pxRegion : memory regions, aligned
+/// @param xRegions : number of regions
+/// @param pulReg : r0-r15, xpsr
+/// @param ulSignal : pr_cursig
+/// @return header bytes
+static size_t prvCoreHeader(const core_region_t * pxRegion, size_t xRegions, const uint32_t * pulReg, uint32_t ulSignal)
+{
+    uint8_t * puc = xCore.ucHeader;
+    uint32_t ulPhnum = 1U + (uint32_t)xRegions;
+    uint32_t ulNote = ELF_EHDR_SIZE + (ulPhnum * ELF_PHDR_SIZE);
+    uint32_t ulOffset = ulNote + CORE_NOTE_SIZE;
+    uint8_t * pucDesc;
+
+    memset(puc, 0x00, CORE_HEADER_MAX);
+    // ELFCLASS32, ELFDATA2LSB, EV_CURRENT
+    memcpy(puc, "\x7F" "ELF\x01\x01\x01", 7U);
+    prvCorePut16(&puc[16], ELF_ET_CORE);
+    prvCorePut16(&puc[18], ELF_EM_ARM);
+    prvCorePut32(&puc[20], 1U);
+    prvCorePut32(&puc[28], ELF_EHDR_SIZE);
+    prvCorePut16(&puc[40], ELF_EHDR_SIZE);
+    prvCorePut16(&puc[42], ELF_PHDR_SIZE);
+    prvCorePut16(&puc[44], (uint16_t)ulPhnum);
+    puc += ELF_EHDR_SIZE;
+
+    prvCorePut32(&puc[0], ELF_PT_NOTE);
+    prvCorePut32(&puc[4], ulNote);
+    prvCorePut32(&puc[16], CORE_NOTE_SIZE);
+    prvCorePut32(&puc[28], 4U);
+    puc += ELF_PHDR_SIZE;
+    for (size_t i = 0U; i < xRegions; i++)
+    {
+        prvCorePut32(&puc[0], ELF_PT_LOAD);
+        prvCorePut32(&puc[4], ulOffset);
+        prvCorePut32(&puc[8], pxRegion[i].ulAddr);
+        prvCorePut32(&puc[12], pxRegion[i].ulAddr);
+        prvCorePut32(&puc[16], pxRegion[i].ulSize);
+        prvCorePut32(&puc[20], pxRegion[i].ulSize);
+        prvCorePut32(&puc[24], ELF_PF_RWX);
+        prvCorePut32(&puc[28], 4U);
+        ulOffset += pxRegion[i].ulSize;
+        puc += ELF_PHDR_SIZE;
+    }
+
+    prvCorePut32(&puc[0], sizeof(CORE_NOTE_NAME));
+    prvCorePut32(&puc[4], CORE_PRSTATUS_SIZE);
+    prvCorePut32(&puc[8], CORE_NT_PRSTATUS);
+    memcpy(&puc[12], CORE_NOTE_NAME, sizeof(CORE_NOTE_NAME));
+    pucDesc = &puc[12U + CORE_NOTE_NAME_SIZE];
+    prvCorePut16(&pucDesc[CORE_PRSTATUS_CURSIG], (uint16_t)ulSignal);
+    prvCorePut32(&pucDesc[CORE_PRSTATUS_PID], 1U);
+    for (uint32_t i = 0U; i < CORE_REGS; i++)
+    {
+        prvCorePut32(&pucDesc[CORE_PRSTATUS_REG + (i * 4U)], pulReg[i]);
+    }
+    // orig_r0
+    prvCorePut32(&pucDesc[CORE_PRSTATUS_REG + (CORE_REGS * 4U)], pulReg[0]);
+
+    return ulNote + CORE_NOTE_SIZE;
+}
+
+/// @brief halt, read the registers and write the file
+/// @param pxRegion : memory regions, aligned
+/// @param xRegions : number of regions
+/// @return acknowledge
+static uint8_t prvCoreDump(const core_region_t * pxRegion, size_t xRegions)
+{
+    uint32_t ulReg[CORE_REGS];
+    uint8_t ucReg[CORE_REGS];
+    uint32_t ulDfsr;
+
+    TARGET_TRY(ucTargetAttach());
+    // a fault halt has to be seen before our own halt
+    TARGET_TRY(ucTargetReadWord(TARGET_DFSR, &ulDfsr));
+    TARGET_TRY(ucTargetHalt());
+    for (uint32_t i = 0U; i < CORE_REGS; i++)
+    {
+        ucReg[i] = (uint8_t)i;
+    }
+    TARGET_TRY(ucTargetReadRegs(ucReg, CORE_REGS, ulReg));
+    prvCoreOut(xCore.ucHeader, prvCoreHeader(pxRegion, xRegions, ulReg,
+                                             ((ulDfsr & CORE_DFSR_VCATCH) != 0U) ? CORE_SIGSEGV : CORE_SIGTRAP));
+
+    for (size_t i = 0U; i < xRegions; i++)
+    {
+        for (uint32_t ulDone = 0U; ulDone < pxRegion[i].ulSize; )
+        {
+            uint32_t ulLen = pxRegion[i].ulSize - ulDone;
+            if (ulLen > CORE_CHUNK_SIZE)
+            {
+                ulLen = CORE_CHUNK_SIZE;
+            }
+            TARGET_TRY(ucTargetReadBlock(pxRegion[i].ulAddr + ulDone, xCore.ulChunk, ulLen / 4U));
+            prvCoreOut((const uint8_t *)xCore.ulChunk, ulLen);
+            ulDone += ulLen;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief halt the target and write a core file of the given regions
+/// @param pxRegion : memory regions
+/// @param xRegions : number of regions (up to CORE_REGIONS_MAX)
+/// @param xWrite : output function
+/// @param pulBytes : bytes written output
+/// @return acknowledge of the failing transfer or DAP_TRANSFER_OK; the file is cut short on failure
+uint8_t ucCoreDump(const core_region_t * pxRegion, size_t xRegions, CoreWrite_t xWrite, uint32_t * pulBytes)
+{
+    core_region_t xRegion[CORE_REGIONS_MAX];
+    uint8_t ucAck;
+
+    if (xRegions > CORE_REGIONS_MAX)
+    {
+        xRegions = CORE_REGIONS_MAX;
+    }
+    for (size_t i = 0U; i < xRegions; i++)
+    {
+        xRegion[i].ulAddr = pxRegion[i].ulAddr & ~3UL;
+        xRegion[i].ulSize = (pxRegion[i].ulSize + (pxRegion[i].ulAddr & 3U) + 3U) & ~3UL;
+    }
+    xCore.xWrite = xWrite;
+    xCore.pucBackup = (uint8_t *)PSRAM_CORE_BASE;
+    xCore.xStatus.ulBytes = 0U;
+    xCore.xStatus.ulStored = 0U;
+
+    // one session for the whole dump, a host request still gets in between two blocks
+    vTargetAcquire();
+    ucAck = prvCoreDump(xRegion, xRegions);
+    vTargetRelease();
+
+    xCore.xStatus.xComplete = (ucAck == DAP_TRANSFER_OK) && (xCore.xStatus.ulStored == xCore.xStatus.ulBytes);
+    *pulBytes = xCore.xStatus.ulBytes;
+    return ucAck;
+}
+
+/// @brief write the backup of the last core file again
+/// @param xWrite : output function
+/// @return bytes written
+size_t xCoreExport(CoreWrite_t xWrite)
+{
+    if (xCore.xStatus.ulStored != 0U)
+    {
+        (void)xWrite(xCore.pucBackup, (int)xCore.xStatus.ulStored);
+    }
+    return xCore.xStatus.ulStored;
+}
+
+/// @brief get the backup state
+/// @param px : output
+void vCoreStatus(core_status_t * px)
+{
+    *px = xCore.xStatus;
+}
+
+/*-----------------------------------------------------------*/
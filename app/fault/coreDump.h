@@ -0,0 +1,79 @@
+#ifndef CORE_DUMP_H_
+#define CORE_DUMP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * ELF core dump: the target is halted and an ELF32 core file (ET_CORE,
+ * EM_ARM) is generated while it is written out, nothing is buffered as a
+ * whole. Every byte also goes into a psram window (PSRAM_CORE_BASE) as a
+ * backup that can be exported again later.
+ *
+ * File layout (little endian):
+ *      ELF header
+ *      program headers: PT_NOTE, one PT_LOAD per region
+ *      note "CORE" NT_PRSTATUS, arm linux layout: pr_reg = r0-r15, xpsr, r0;
+ *           pr_cursig 11 (SIGSEGV) when the core was halted on a fault
+ *           vector catch, 5 (SIGTRAP) otherwise
+ *      region data in program header order
+ *
+ * Regions are word aligned (address rounded down, size rounded up).
+ */
+
+/* most memory regions in one dump */
+#define CORE_REGIONS_MAX        8U
+/* bytes read from the target at once */
+#define CORE_CHUNK_SIZE         1024U
+
+/* memory region */
+typedef struct core_region_t
+{
+    uint32_t ulAddr;
+    uint32_t ulSize;            // bytes
+} core_region_t;
+
+/* backup state, for display */
+typedef struct core_status_t
+{
+    uint32_t ulBytes;           // size of the last core file
+    uint32_t ulStored;          // bytes of it in the backup
+    bool xComplete;             // the backup holds the whole file
+} core_status_t;
+
+/* Prototype of the output function */
+typedef int (* CoreWrite_t)(uint8_t *, int);
+
+/*-----------------------------------------------------------*/
+
+/// @brief halt the target and write a core file of the given regions
+/// @param pxRegion : memory regions
+/// @param xRegions : number of regions (up to CORE_REGIONS_MAX)
+/// @param xWrite : output function
+/// @param pulBytes : bytes written output
+/// @return acknowledge of the failing transfer or DAP_TRANSFER_OK; the file is cut short on failure
+uint8_t ucCoreDump(const core_region_t * pxRegion, size_t xRegions, CoreWrite_t xWrite, uint32_t * pulBytes);
+
+/// @brief write the backup of the last core file again
+/// @param xWrite : output function
+/// @return bytes written
+size_t xCoreExport(CoreWrite_t xWrite);
+
+/// @brief get the backup state
+/// @param px : output
+void vCoreStatus(core_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CORE_DUMP_H_ */
@@ -0,0 +1,242 @@
+#include <string.h>
+#include "faultWatch.h"
+#include "target/target.h"
+#include "rp2350.h"
+
+/*-----------------------------------------------------------*/
+
+/* DEMCR fault vector catches: VC_MMERR .. VC_SFERR (ARMv6-M: VC_HARDERR only, the others are RAZ/WI) */
+#define FAULT_DEMCR_VC          0x00000FF0UL
+/* DFSR: halted on a vector catch */
+#define FAULT_DFSR_VCATCH       (1UL << 3)
+
+/* CFSR, HFSR, DFSR, MMFAR, BFAR, AFSR follow each other */
+#define FAULT_CFSR              0xE000ED28UL
+#define FAULT_STATUS_DFSR       2U
+
+/* stack bytes read at once, reading stops at the first that fails (end of RAM) */
+#define FAULT_STACK_CHUNK       64U
+
+/* one slot more than kept: a snapshot is recorded into the spare slot and only
+   counted once all its reads went through, the stored ones stay intact meanwhile */
+#define FAULT_SLOTS             (FAULT_SNAPSHOTS + 1U)
+
+/* fault watch state */
+typedef struct fault_t
+{
+    TaskHandle_t xTask;
+    fault_status_t xStatus;
+    bool xCatch;                        // catches written to the target
+    uint32_t ulRearm;                   // polls until the catches are written again
+    uint32_t ulNext;                    // slot of the next snapshot, never a stored one
+    fault_snapshot_t * pxStore;         // FAULT_SLOTS slots in psram
+} fault_t;
+
+static fault_t xFault = { .xStatus = { .ulStackSize = FAULT_STACK_DEFAULT } };
+
+/*-----------------------------------------------------------*/
+
+/// @brief enable halting debug and the fault vector catches
+/// @return acknowledge
+static uint8_t prvFaultArm(void)
+{
+    uint32_t ulData;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulData));
+    if ((ulData & FAULT_DEMCR_VC) != FAULT_DEMCR_VC)
+    {
+        TARGET_TRY(ucTargetWriteWord(TARGET_DEMCR, ulData | FAULT_DEMCR_VC));
+    }
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulData));
+    if ((ulData & TARGET_DHCSR_C_DEBUGEN) == 0U)
+    {
+        // keep the control bits, a halted core stays halted
+        TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN |
+                                                   (ulData & (TARGET_DHCSR_C_HALT | TARGET_DHCSR_C_MASKINTS))));
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief record the state of a core halted on a fault vector
+/// @param ulDfsr : DFSR read at the halt
+/// @return acknowledge
+static uint8_t prvFaultRecord(uint32_t ulDfsr)
+{
+    fault_snapshot_t * px = &xFault.pxStore[xFault.ulNext];
+    uint8_t ucReg[FAULT_REGS];
+    uint32_t ulLr, ulSize;
+
+    for (uint32_t i = 0U; i <= TARGET_REG_PSP; i++)
+    {
+        ucReg[i] = (uint8_t)i;
+    }
+    ucReg[FAULT_REGS - 1U] = TARGET_REG_SPECIAL;
+    TARGET_TRY(ucTargetReadRegs(ucReg, FAULT_REGS, px->ulReg));
+    if (ucTargetReadBlock(FAULT_CFSR, px->ulStatus, FAULT_STATUS_REGS) != DAP_TRANSFER_OK)
+    {
+        // ARMv6-M: no configurable fault status registers
+        memset(px->ulStatus, 0x00, sizeof(px->ulStatus));
+        px->ulStatus[FAULT_STATUS_DFSR] = ulDfsr;
+    }
+    // the exception frame went to the stack EXC_RETURN names
+    ulLr = px->ulReg[TARGET_REG_LR];
+    px->ulStackAddr = ((((ulLr >> 24) == 0xFFU) && ((ulLr & 4U) != 0U)) ? px->ulReg[TARGET_REG_PSP]
+                                                                         : px->ulReg[TARGET_REG_MSP]) & ~3UL;
+    ulSize = 0U;
+    while (ulSize < xFault.xStatus.ulStackSize)
+    {
+        uint32_t ulChunk = xFault.xStatus.ulStackSize - ulSize;
+        if (ulChunk > FAULT_STACK_CHUNK)
+        {
+            ulChunk = FAULT_STACK_CHUNK;
+        }
+        if (ucTargetReadBlock(px->ulStackAddr + ulSize, &px->ulStack[ulSize / 4U], ulChunk / 4U) != DAP_TRANSFER_OK)
+        {
+            break;
+        }
+        ulSize += ulChunk;
+    }
+    px->ulStackSize = ulSize;
+    xFault.xStatus.ulFaults += 1U;
+    px->ulNumber = xFault.xStatus.ulFaults;
+    px->ulTimeMs = (uint32_t)(time_us_64() / 1000U);
+    // the oldest snapshot drops out, its slot is the next spare
+    xFault.ulNext = (xFault.ulNext + 1U) % FAULT_SLOTS;
+    if (xFault.xStatus.ulStored < FAULT_SNAPSHOTS)
+    {
+        xFault.xStatus.ulStored += 1U;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief one poll: keep the catches armed, record a fault halt
+/// @return acknowledge
+static uint8_t prvFaultPoll(void)
+{
+    uint32_t ulData;
+
+    if (!xFault.xStatus.xLinkUp)
+    {
+        TARGET_TRY(ucTargetAttach());
+        xFault.xStatus.xLinkUp = true;
+        xFault.ulRearm = 0U;
+    }
+    if (xFault.ulRearm == 0U)
+    {
+        TARGET_TRY(prvFaultArm());
+        xFault.xCatch = true;
+        xFault.ulRearm = FAULT_REARM_POLLS;
+    }
+    xFault.ulRearm -= 1U;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulData));
+    if ((ulData & TARGET_DHCSR_S_HALT) == 0U)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(ucTargetReadWord(TARGET_DFSR, &ulData));
+    if ((ulData & FAULT_DFSR_VCATCH) == 0U)
+    {
+        // halted by a host or a breakpoint
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(prvFaultRecord(ulData));
+    // recorded once, the core stays halted for a host
+    return ucTargetWriteWord(TARGET_DFSR, FAULT_DFSR_VCATCH);
+}
+
+/// @brief take the fault vector catches out again
+/// @return acknowledge
+static uint8_t prvFaultDisarm(void)
+{
+    uint32_t ulData;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulData));
+    return ucTargetWriteWord(TARGET_DEMCR, ulData & ~FAULT_DEMCR_VC);
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief set up the snapshot store
+void vFaultInit(void)
+{
+    xFault.pxStore = (fault_snapshot_t *)PSRAM_FAULT_BASE;
+}
+
+/// @brief fault watch thread
+/// @param pv : unused
+void vFaultTask(void * pv)
+{
+    uint8_t ucAck;
+
+    (void)pv;
+    xFault.xTask = xTaskGetCurrentTaskHandle();
+
+    do
+    {
+        (void)xTaskNotifyWait(0U, 0xFFFFFFFFUL, NULL, xFault.xStatus.xArmed ? pdMS_TO_TICKS(FAULT_POLL_MS) : portMAX_DELAY);
+        if (!xFault.xStatus.xArmed)
+        {
+            if (xFault.xCatch)
+            {
+                // best effort, the target may be gone
+                vTargetAcquire();
+                (void)prvFaultDisarm();
+                vTargetRelease();
+                xFault.xCatch = false;
+            }
+            continue;
+        }
+        vTargetAcquire();
+        ucAck = prvFaultPoll();
+        vTargetRelease();
+        xFault.xStatus.ulPolls += 1U;
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            // attach again at the next poll, only a DPIDR read while the host owns the port
+            xFault.xStatus.xLinkUp = false;
+        }
+    } while (true);
+}
+
+/// @brief start or stop watching
+/// @param xArm : true to watch
+/// @param ulStackSize : stack bytes per snapshot, capped at FAULT_STACK_MAX
+void vFaultWatch(bool xArm, uint32_t ulStackSize)
+{
+    xFault.xStatus.ulStackSize = ((ulStackSize < FAULT_STACK_MAX) ? ulStackSize : FAULT_STACK_MAX) & ~3UL;
+    xFault.xStatus.xArmed = xArm;
+    // the catches go in with the first poll
+    xFault.ulRearm = 0U;
+    if (xFault.xTask != NULL)
+    {
+        xTaskNotify(xFault.xTask, 0U, eNoAction);
+    }
+}
+
+/// @brief get a stored snapshot
+/// @param ulIndex : 0 for the newest
+/// @return snapshot, NULL if there is none
+const fault_snapshot_t * pxFaultSnapshot(uint32_t ulIndex)
+{
+    if (ulIndex >= xFault.xStatus.ulStored)
+    {
+        return NULL;
+    }
+    return &xFault.pxStore[(xFault.ulNext + FAULT_SLOTS - 1U - ulIndex) % FAULT_SLOTS];
+}
+
+/// @brief drop all snapshots
+void vFaultClear(void)
+{
+    xFault.xStatus.ulStored = 0U;
+}
+
+/// @brief get the watch state
+/// @param px : output
+void vFaultStatus(fault_status_t * px)
+{
+    *px = xFault.xStatus;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,106 @@
+#ifndef FAULT_WATCH_H_
+#define FAULT_WATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Fault watch: the probe arms the fault vector catches (DEMCR VC_xxx) and
+ * polls DHCSR every FAULT_POLL_MS. When the core halts on a fault vector
+ * (DFSR VCATCH) it records the core registers, the fault status registers
+ * and the top of the stack the exception frame went to into psram, then
+ * leaves the core halted for a host to attach.
+ *
+ * A poll is one DHCSR read under the link lock, so it runs alongside the
+ * dap host and the other services. The catches are applied again every
+ * FAULT_REARM_POLLS polls in case a host cleared DEMCR.
+ *
+ * The last FAULT_SNAPSHOTS snapshots are kept until they are cleared or
+ * the probe is powered off.
+ */
+
+/* fault watch task name */
+#define FAULT_TASK_NAME         "fault"
+/* fault watch task stack size(32-bit word) */
+#define FAULT_TASK_STACK_SIZE   256U
+
+/* DHCSR poll period (ms) */
+#define FAULT_POLL_MS           100U
+/* polls between two writes of the vector catches */
+#define FAULT_REARM_POLLS       10U
+
+/* stack bytes recorded */
+#define FAULT_STACK_DEFAULT     256U
+#define FAULT_STACK_MAX         4096U
+
+/* snapshots kept (psram window PSRAM_FAULT_BASE) */
+#define FAULT_SNAPSHOTS         8U
+
+/* core registers: r0-r12, sp, lr, pc, xpsr, msp, psp, CONTROL|FAULTMASK|BASEPRI|PRIMASK */
+#define FAULT_REGS              20U
+/* fault status registers: CFSR, HFSR, DFSR, MMFAR, BFAR, AFSR */
+#define FAULT_STATUS_REGS       6U
+
+/* recorded fault */
+typedef struct fault_snapshot_t
+{
+    uint32_t ulNumber;                      // faults seen since boot, 1 for the first
+    uint32_t ulTimeMs;                      // probe uptime
+    uint32_t ulReg[FAULT_REGS];
+    uint32_t ulStatus[FAULT_STATUS_REGS];
+    uint32_t ulStackAddr;                   // first recorded stack word
+    uint32_t ulStackSize;                   // bytes recorded, 0 if the stack was not readable
+    uint32_t ulStack[FAULT_STACK_MAX / 4U];
+} fault_snapshot_t;
+
+/* watch state, for display */
+typedef struct fault_status_t
+{
+    bool xArmed;                // watching
+    bool xLinkUp;               // target reachable at the last poll
+    uint32_t ulStackSize;       // stack bytes recorded per snapshot
+    uint32_t ulPolls;           // polls since boot
+    uint32_t ulFaults;          // faults seen since boot
+    uint32_t ulStored;          // snapshots available
+} fault_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief set up the snapshot store
+void vFaultInit(void);
+
+/// @brief fault watch thread
+/// @param pv : unused
+void vFaultTask(void * pv);
+
+/// @brief start or stop watching
+/// @param xArm : true to watch
+/// @param ulStackSize : stack bytes per snapshot, capped at FAULT_STACK_MAX
+void vFaultWatch(bool xArm, uint32_t ulStackSize);
+
+/// @brief get a stored snapshot
+/// @param ulIndex : 0 for the newest
+/// @return snapshot, NULL if there is none
+const fault_snapshot_t * pxFaultSnapshot(uint32_t ulIndex);
+
+/// @brief drop all snapshots
+void vFaultClear(void);
+
+/// @brief get the watch state
+/// @param px : output
+void vFaultStatus(fault_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* FAULT_WATCH_H_ */
@@ -0,0 +1,740 @@
+#include <string.h>
+#include <stdio.h>
+#include "gdbServer.h"
+#include "target/target.h"
+
+/*-----------------------------------------------------------*/
+
+/* number of registers in the g packet */
+#define GDB_NUM_REGS            19U
+
+/* packet receive result for a ^C outside of a packet */
+#define GDB_INTERRUPT           (-2)
+
+/* register description */
+static const char cTargetXml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<architecture>arm</architecture>"
+    "<feature name=\"org.gnu.gdb.arm.m-profile\">"
+    "<reg name=\"r0\" bitsize=\"32\" regnum=\"0\"/>"
+    "<reg name=\"r1\" bitsize=\"32\"/>"
+    "<reg name=\"r2\" bitsize=\"32\"/>"
+    "<reg name=\"r3\" bitsize=\"32\"/>"
+    "<reg name=\"r4\" bitsize=\"32\"/>"
+    "<reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/>"
+    "<reg name=\"r7\" bitsize=\"32\"/>"
+    "<reg name=\"r8\" bitsize=\"32\"/>"
+    "<reg name=\"r9\" bitsize=\"32\"/>"
+    "<reg name=\"r10\" bitsize=\"32\"/>"
+    "<reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"xpsr\" bitsize=\"32\"/>"
+    "</feature>"
+    "<feature name=\"org.gnu.gdb.arm.m-system\">"
+    "<reg name=\"msp\" bitsize=\"32\" regnum=\"17\" type=\"data_ptr\"/>"
+    "<reg name=\"psp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "</feature>"
+    "</target>";
+
+/* server state */
+typedef struct gdb_server_t
+{
+    const gdb_t * px;           // interface
+    uint8_t ucIn[64];           // input bytes not consumed yet
+    int lInLen;
+    int lInPos;
+    bool xNoAck;                // QStartNoAckMode
+    bool xLinkUp;               // swd link connected
+    bool xRunning;              // target resumed by 'c'
+    char cPacket[GDB_PACKET_SIZE + 1];
+    char cReply[GDB_PACKET_SIZE + 4];
+    uint8_t ucMem[GDB_PACKET_SIZE];      // X payload, binary bytes up to a whole packet
+} gdb_server_t;
+
+static gdb_server_t xGdb;
+
+static const char cHex[] = "0123456789abcdef";
+
+/*-----------------------------------------------------------*/
+
+/// @brief next input byte
+/// @param xTimeout : ticks to wait
+/// @return byte, -1 on timeout
+static int prvGetc(TickType_t xTimeout)
+{
+    if (xGdb.lInPos >= xGdb.lInLen)
+    {
+        xGdb.lInPos = 0;
+        xGdb.lInLen = xGdb.px->r(xGdb.ucIn, (int)sizeof(xGdb.ucIn), xTimeout);
+        if (xGdb.lInLen <= 0)
+        {
+            xGdb.lInLen = 0;
+            return -1;
+        }
+    }
+    return xGdb.ucIn[xGdb.lInPos++];
+}
+
+/// @brief value of a hex digit
+/// @param c : character
+/// @return 0..15, -1 if not a hex digit
+static int prvHexDigit(int c)
+{
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return -1;
+}
+
+/// @brief parse a hex number and advance
+/// @param ppc : string pointer
+/// @return value
+static uint32_t prvParseHex(const char ** ppc)
+{
+    uint32_t ulValue = 0U;
+    int lDigit;
+
+    while ((lDigit = prvHexDigit(**ppc)) >= 0)
+    {
+        ulValue = (ulValue << 4) | (uint32_t)lDigit;
+        (*ppc)++;
+    }
+    return ulValue;
+}
+
+/// @brief append bytes as hex
+/// @param pc : output
+/// @param puc : bytes
+/// @param xLen : number of bytes
+/// @return end of output
+static char * prvPutHex(char * pc, const uint8_t * puc, size_t xLen)
+{
+    while (xLen--)
+    {
+        *pc++ = cHex[*puc >> 4];
+        *pc++ = cHex[*puc++ & 0x0FU];
+    }
+    *pc = '\0';
+    return pc;
+}
+
+/// @brief send a packet, waits for the acknowledge unless in no-ack mode
+/// @param pcData : payload
+static void prvSend(const char * pcData)
+{
+    size_t xLen = strlen(pcData);
+    uint8_t ucSum = 0U;
+    char cTail[3];
+
+    for (size_t i = 0; i < xLen; i++)
+    {
+        ucSum += (uint8_t)pcData[i];
+    }
+    cTail[0] = '#';
+    cTail[1] = cHex[ucSum >> 4];
+    cTail[2] = cHex[ucSum & 0x0FU];
+
+    for (int lTry = 0; lTry < 3; lTry++)
+    {
+        xGdb.px->w((uint8_t *)"$", 1);
+        xGdb.px->w((uint8_t *)pcData, (int)xLen);
+        xGdb.px->w((uint8_t *)cTail, 3);
+        if (xGdb.xNoAck || (prvGetc(pdMS_TO_TICKS(1000)) != '-'))
+        {
+            break;
+        }
+    }
+}
+
+/// @brief receive a packet into cPacket
+/// @return payload length, GDB_INTERRUPT for ^C
+static int prvReceive(void)
+{
+    int c, lLen;
+    uint8_t ucSum;
+    bool xOverflow;
+
+    for (;;)
+    {
+        c = prvGetc(portMAX_DELAY);
+        if (c == 0x03)
+        {
+            return GDB_INTERRUPT;
+        }
+        if (c != '$')
+        {
+            // acknowledges and noise
+            continue;
+        }
+        lLen = 0;
+        ucSum = 0U;
+        xOverflow = false;
+        // an oversized packet is read up to its checksum and dropped
+        while (((c = prvGetc(portMAX_DELAY)) != '#') && (c >= 0))
+        {
+            if (lLen < (int)GDB_PACKET_SIZE)
+            {
+                xGdb.cPacket[lLen++] = (char)c;
+                ucSum += (uint8_t)c;
+            }
+            else
+            {
+                xOverflow = true;
+            }
+        }
+        if (c < 0)
+        {
+            // the connection went away in the middle of the packet
+            continue;
+        }
+        xGdb.cPacket[lLen] = '\0';
+        c = prvHexDigit(prvGetc(portMAX_DELAY)) << 4;
+        c |= prvHexDigit(prvGetc(portMAX_DELAY));
+        if (xOverflow)
+        {
+            // without acknowledges gdb never resends, the empty reply fails the command
+            if (xGdb.xNoAck)
+            {
+                prvSend("");
+            }
+            else
+            {
+                xGdb.px->w((uint8_t *)"-", 1);
+            }
+            continue;
+        }
+        // a new connection opens with qSupported, acknowledged until it asks otherwise
+        if (strncmp(xGdb.cPacket, "qSupported", 10) == 0)
+        {
+            xGdb.xNoAck = false;
+        }
+        if (xGdb.xNoAck)
+        {
+            return lLen;
+        }
+        if ((uint8_t)c == ucSum)
+        {
+            xGdb.px->w((uint8_t *)"+", 1);
+            return lLen;
+        }
+        xGdb.px->w((uint8_t *)"-", 1);
+    }
+}
+
+/// @brief reply for a transfer result
+/// @param ucAck : acknowledge
+static void prvSendResult(uint8_t ucAck)
+{
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        prvSend("OK");
+        return;
+    }
+    // no or broken acknowledge: reconnect with the next request
+    if ((ucAck != DAP_TRANSFER_FAULT) && (ucAck != DAP_TRANSFER_WAIT))
+    {
+        xGdb.xLinkUp = false;
+    }
+    prvSend("E01");
+}
+
+/// @brief connect the link if needed, the link must be acquired
+/// @return acknowledge
+static uint8_t prvLink(void)
+{
+    uint8_t ucAck;
+
+    if (xGdb.xLinkUp)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    ucAck = ucTargetConnect(NULL);
+    xGdb.xLinkUp = (ucAck == DAP_TRANSFER_OK);
+    return ucAck;
+}
+
+/// @brief report why the target stopped
+/// @param lSignal : signal number
+static void prvStopReply(int lSignal)
+{
+    uint32_t ulAddr;
+    target_watch_t eKind;
+    static const char * const pcWatch[] = { "watch", "rwatch", "awatch" };
+
+    vTargetAcquire();
+    if ((lSignal == 5) && (ucTargetWatchHit(&ulAddr, &eKind) == DAP_TRANSFER_OK))
+    {
+        vTargetRelease();
+        snprintf(xGdb.cReply, sizeof(xGdb.cReply), "T05%s:%08lx;", pcWatch[eKind], (unsigned long)ulAddr);
+        prvSend(xGdb.cReply);
+        return;
+    }
+    vTargetRelease();
+    snprintf(xGdb.cReply, sizeof(xGdb.cReply), "S%02x", lSignal);
+    prvSend(xGdb.cReply);
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief 'q' and 'Q' packets
+static void prvQuery(void)
+{
+    const char * pc = xGdb.cPacket;
+
+    if (strncmp(pc, "qSupported", 10) == 0)
+    {
+        snprintf(xGdb.cReply, sizeof(xGdb.cReply), "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", (unsigned int)GDB_PACKET_SIZE);
+        prvSend(xGdb.cReply);
+    }
+    else if (strcmp(pc, "QStartNoAckMode") == 0)
+    {
+        prvSend("OK");
+        xGdb.xNoAck = true;
+    }
+    else if (strncmp(pc, "qXfer:features:read:target.xml:", 31) == 0)
+    {
+        uint32_t ulOffset, ulLen;
+        size_t xLeft;
+
+        pc += 31;
+        ulOffset = prvParseHex(&pc);
+        pc++;
+        ulLen = prvParseHex(&pc);
+        if (ulOffset >= sizeof(cTargetXml) - 1U)
+        {
+            prvSend("l");
+            return;
+        }
+        xLeft = sizeof(cTargetXml) - 1U - ulOffset;
+        if (ulLen > GDB_PACKET_SIZE - 2U)
+        {
+            ulLen = GDB_PACKET_SIZE - 2U;
+        }
+        xGdb.cReply[0] = (xLeft > ulLen) ? 'm' : 'l';
+        xLeft = (xLeft > ulLen) ? ulLen : xLeft;
+        memcpy(&xGdb.cReply[1], &cTargetXml[ulOffset], xLeft);
+        xGdb.cReply[1 + xLeft] = '\0';
+        prvSend(xGdb.cReply);
+    }
+    else if (strcmp(pc, "qAttached") == 0)
+    {
+        prvSend("1");
+    }
+    else if (strcmp(pc, "qC") == 0)
+    {
+        prvSend("QC1");
+    }
+    else if (strcmp(pc, "qfThreadInfo") == 0)
+    {
+        prvSend("m1");
+    }
+    else if (strcmp(pc, "qsThreadInfo") == 0)
+    {
+        prvSend("l");
+    }
+    else if (strncmp(pc, "qRcmd,", 6) == 0)
+    {
+        // monitor command, hex encoded
+        char cCmd[32];
+        size_t xLen = 0;
+        uint8_t ucAck;
+
+        pc += 6;
+        while ((prvHexDigit(pc[0]) >= 0) && (prvHexDigit(pc[1]) >= 0) && (xLen < sizeof(cCmd) - 1U))
+        {
+            cCmd[xLen++] = (char)((prvHexDigit(pc[0]) << 4) | prvHexDigit(pc[1]));
+            pc += 2;
+        }
+        cCmd[xLen] = '\0';
+        vTargetAcquire();
+        ucAck = prvLink();
+        if (ucAck == DAP_TRANSFER_OK)
+        {
+            if (strcmp(cCmd, "reset halt") == 0)
+                ucAck = ucTargetReset(true);
+            else if (strcmp(cCmd, "reset") == 0)
+                ucAck = ucTargetReset(false);
+            else if (strcmp(cCmd, "halt") == 0)
+                ucAck = ucTargetHalt();
+            else
+                ucAck = DAP_TRANSFER_ERROR;
+        }
+        vTargetRelease();
+        prvSendResult(ucAck);
+    }
+    else
+    {
+        prvSend("");
+    }
+}
+
+/// @brief 'g': all registers
+static void prvReadRegisters(void)
+{
+    uint32_t ulRegs[GDB_NUM_REGS];
+    uint8_t ucReg[GDB_NUM_REGS];
+    uint8_t ucAck;
+
+    // gdb register n is REGSEL n
+    for (uint32_t i = 0U; i < GDB_NUM_REGS; i++)
+    {
+        ucReg[i] = (uint8_t)i;
+    }
+    vTargetAcquire();
+    ucAck = prvLink();
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        ucAck = ucTargetReadRegs(ucReg, GDB_NUM_REGS, ulRegs);
+    }
+    vTargetRelease();
+    if (ucAck != DAP_TRANSFER_OK)
+    {
+        prvSendResult(ucAck);
+        return;
+    }
+    // target byte order is little endian, as is ours
+    prvPutHex(xGdb.cReply, (const uint8_t *)ulRegs, sizeof(ulRegs));
+    prvSend(xGdb.cReply);
+}
+
+/// @brief 'G': all registers
+static void prvWriteRegisters(void)
+{
+    const char * pc = &xGdb.cPacket[1];
+    uint8_t ucAck;
+
+    vTargetAcquire();
+    ucAck = prvLink();
+    for (uint32_t i = 0U; (i < GDB_NUM_REGS) && (ucAck == DAP_TRANSFER_OK) && (strlen(pc) >= 8U); i++)
+    {
+        uint32_t ulValue = 0U;
+        for (uint32_t b = 0U; b < 4U; b++, pc += 2)
+        {
+            ulValue |= (uint32_t)((prvHexDigit(pc[0]) << 4) | prvHexDigit(pc[1])) << (b * 8U);
+        }
+        ucAck = ucTargetWriteReg(i, ulValue);
+    }
+    vTargetRelease();
+    prvSendResult(ucAck);
+}
+
+/// @brief 'p' and 'P': one register
+/// @param xWrite : true for 'P'
+static void prvRegister(bool xWrite)
+{
+    const char * pc = &xGdb.cPacket[1];
+    uint32_t ulReg = prvParseHex(&pc);
+    uint32_t ulValue = 0U;
+    uint8_t ucAck;
+
+    if (ulReg >= GDB_NUM_REGS)
+    {
+        prvSend("E00");
+        return;
+    }
+    if (xWrite && (*pc++ == '='))
+    {
+        for (uint32_t b = 0U; (b < 4U) && (prvHexDigit(pc[0]) >= 0); b++, pc += 2)
+        {
+            ulValue |= (uint32_t)((prvHexDigit(pc[0]) << 4) | prvHexDigit(pc[1])) << (b * 8U);
+        }
+    }
+    vTargetAcquire();
+    ucAck = prvLink();
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        ucAck = xWrite ? ucTargetWriteReg(ulReg, ulValue) : ucTargetReadReg(ulReg, &ulValue);
+    }
+    vTargetRelease();
+    if (xWrite || (ucAck != DAP_TRANSFER_OK))
+    {
+        prvSendResult(ucAck);
+        return;
+    }
+    prvPutHex(xGdb.cReply, (const uint8_t *)&ulValue, sizeof(ulValue));
+    prvSend(xGdb.cReply);
+}
+
+/// @brief 'm': read memory
+static void prvReadMemory(void)
+{
+    const char * pc = &xGdb.cPacket[1];
+    uint32_t ulAddr = prvParseHex(&pc);
+    uint32_t ulLen;
+    uint8_t ucAck;
+
+    pc++;
+    ulLen = prvParseHex(&pc);
+    // the reply carries two hex digits per byte
+    if (ulLen > (GDB_PACKET_SIZE / 2U))
+    {
+        ulLen = GDB_PACKET_SIZE / 2U;
+    }
+    vTargetAcquire();
+    ucAck = prvLink();
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        ucAck = ucTargetReadMem(ulAddr, xGdb.ucMem, ulLen);
+    }
+    vTargetRelease();
+    if (ucAck != DAP_TRANSFER_OK)
+    {
+        prvSendResult(ucAck);
+        return;
+    }
+    prvPutHex(xGdb.cReply, xGdb.ucMem, ulLen);
+    prvSend(xGdb.cReply);
+}
+
+/// @brief 'M' (hex) and 'X' (binary): write memory
+/// @param lLen : packet length
+/// @param xBinary : true for 'X'
+static void prvWriteMemory(int lLen, bool xBinary)
+{
+    const char * pc = &xGdb.cPacket[1];
+    const char * pcEnd = &xGdb.cPacket[lLen];
+    uint32_t ulAddr = prvParseHex(&pc);
+    uint32_t ulLen, n = 0U;
+    uint8_t ucAck;
+
+    pc++;
+    ulLen = prvParseHex(&pc);
+    pc++;
+    if (ulLen > sizeof(xGdb.ucMem))
+    {
+        prvSend("E02");
+        return;
+    }
+    while ((n < ulLen) && (pc < pcEnd))
+    {
+        if (xBinary)
+        {
+            // '}' escapes the next byte
+            uint8_t uc = (uint8_t)*pc++;
+            if ((uc == '}') && (pc < pcEnd))
+            {
+                uc = (uint8_t)*pc++ ^ 0x20U;
+            }
+            xGdb.ucMem[n++] = uc;
+        }
+        else
+        {
+            xGdb.ucMem[n++] = (uint8_t)((prvHexDigit(pc[0]) << 4) | prvHexDigit(pc[1]));
+            pc += 2;
+        }
+    }
+    vTargetAcquire();
+    ucAck = prvLink();
+    if ((ucAck == DAP_TRANSFER_OK) && (n != 0U))
+    {
+        ucAck = ucTargetWriteMem(ulAddr, xGdb.ucMem, n);
+    }
+    vTargetRelease();
+    prvSendResult(ucAck);
+}
+
+/// @brief 'Z' and 'z': break and watch points
+/// @param xSet : true for 'Z'
+static void prvDebugPoint(bool xSet)
+{
+    const char * pc = &xGdb.cPacket[1];
+    uint32_t ulType = prvParseHex(&pc);
+    uint32_t ulAddr, ulKind;
+    uint8_t ucAck;
+
+    pc++;
+    ulAddr = prvParseHex(&pc);
+    pc++;
+    ulKind = prvParseHex(&pc);
+    if (ulType > 4U)
+    {
+        prvSend("");
+        return;
+    }
+    vTargetAcquire();
+    ucAck = prvLink();
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        // software breakpoints are placed in the FPB as well, flash cannot be patched
+        if (ulType <= 1U)
+            ucAck = ucTargetBreakpoint(ulAddr, xSet);
+        else
+            ucAck = ucTargetWatchpoint(ulAddr, ulKind, (target_watch_t)(ulType - 2U), xSet);
+    }
+    vTargetRelease();
+    prvSendResult(ucAck);
+}
+
+/// @brief 'c' and 's': continue and step, optionally from a new address
+/// @param xStep : true for 's'
+static void prvResume(bool xStep)
+{
+    const char * pc = &xGdb.cPacket[1];
+    uint8_t ucAck;
+
+    vTargetAcquire();
+    ucAck = prvLink();
+    if ((ucAck == DAP_TRANSFER_OK) && (*pc != '\0'))
+    {
+        ucAck = ucTargetWriteReg(TARGET_REG_PC, prvParseHex(&pc));
+    }
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        ucAck = xStep ? ucTargetStep() : ucTargetResume();
+    }
+    vTargetRelease();
+    if (ucAck != DAP_TRANSFER_OK)
+    {
+        prvSendResult(ucAck);
+        return;
+    }
+    if (xStep)
+    {
+        prvStopReply(5);
+        return;
+    }
+    // the stop reply follows when the target halts or gdb interrupts
+    xGdb.xRunning = true;
+}
+
+/// @brief wait for the running target to stop
+static void prvWaitHalt(void)
+{
+    bool xHalted = false;
+    uint8_t ucAck;
+    int c = prvGetc(pdMS_TO_TICKS(GDB_POLL_MS));
+
+    vTargetAcquire();
+    if (c == 0x03)
+    {
+        ucAck = ucTargetHalt();
+        xHalted = (ucAck == DAP_TRANSFER_OK);
+        vTargetRelease();
+        if (xHalted)
+        {
+            xGdb.xRunning = false;
+            prvStopReply(2);
+        }
+        return;
+    }
+    ucAck = ucTargetIsHalted(&xHalted);
+    vTargetRelease();
+    if ((ucAck == DAP_TRANSFER_OK) && xHalted)
+    {
+        xGdb.xRunning = false;
+        prvStopReply(5);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief gdb server thread
+/// @param pv : gdb task interface
+void vGdbServerTask(void * pv)
+{
+    int lLen;
+    uint8_t ucAck;
+
+    xGdb.px = (const gdb_t *)pv;
+
+    do
+    {
+        if (xGdb.xRunning)
+        {
+            prvWaitHalt();
+            continue;
+        }
+        lLen = prvReceive();
+        if (lLen == GDB_INTERRUPT)
+        {
+            // already halted
+            continue;
+        }
+        switch (xGdb.cPacket[0])
+        {
+            case '?':
+                // a new session: stop the target
+                vTargetAcquire();
+                ucAck = prvLink();
+                if (ucAck == DAP_TRANSFER_OK)
+                {
+                    ucAck = ucTargetHalt();
+                }
+                vTargetRelease();
+                if (ucAck == DAP_TRANSFER_OK)
+                    prvSend("S05");
+                else
+                    prvSendResult(ucAck);
+                break;
+            case 'q':
+            case 'Q':
+                prvQuery();
+                break;
+            case 'H':
+            case 'T':
+                prvSend("OK");
+                break;
+            case 'g':
+                prvReadRegisters();
+                break;
+            case 'G':
+                prvWriteRegisters();
+                break;
+            case 'p':
+                prvRegister(false);
+                break;
+            case 'P':
+                prvRegister(true);
+                break;
+            case 'm':
+                prvReadMemory();
+                break;
+            case 'M':
+                prvWriteMemory(lLen, false);
+                break;
+            case 'X':
+                prvWriteMemory(lLen, true);
+                break;
+            case 'Z':
+                prvDebugPoint(true);
+                break;
+            case 'z':
+                prvDebugPoint(false);
+                break;
+            case 'c':
+                prvResume(false);
+                break;
+            case 's':
+                prvResume(true);
+                break;
+            case 'D':
+            case 'k':
+                // leave the target running without our debug points
+                vTargetAcquire();
+                ucAck = ucTargetClearDebugPoints();
+                if (ucAck == DAP_TRANSFER_OK)
+                {
+                    ucAck = ucTargetResume();
+                }
+                vTargetRelease();
+                if (xGdb.cPacket[0] == 'D')
+                {
+                    prvSendResult(ucAck);
+                }
+                xGdb.xNoAck = false;
+                break;
+            default:
+                // not supported
+                prvSend("");
+                break;
+        }
+    } while (true);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,55 @@
+#ifndef GDB_SERVER_H_
+#define GDB_SERVER_H_
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * GDB remote serial protocol server, talks to the target through the probe's
+ * own SWD engine (target/target.h).
+ *
+ * Register layout (target.xml): r0-r12, sp, lr, pc, xpsr, msp, psp.
+ * Breakpoints (Z0/Z1) use the FPB, watchpoints (Z2/Z3/Z4) the DWT.
+ * monitor commands: "reset", "reset halt", "halt".
+ */
+
+/* gdb task name */
+#define GDB_TASK_NAME           "gdb"
+/* gdb task stack size(32-bit word) */
+#define GDB_TASK_STACK_SIZE     512U
+/* largest packet (PacketSize) */
+#define GDB_PACKET_SIZE         1024U
+/* halt detection poll period while the target runs (ms) */
+#define GDB_POLL_MS             10U
+
+/* Prototype of the read function: buffer, size, timeout; returns bytes read */
+typedef int (* GdbRead_t)(uint8_t *, int, TickType_t);
+/* Prototype of the write function: buffer, size */
+typedef int (* GdbWrite_t)(uint8_t *, int);
+
+/* gdb task interface */
+typedef struct gdb_t
+{
+    GdbRead_t r;
+    GdbWrite_t w;
+} gdb_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief gdb server thread
+/// @param pv : gdb task interface
+void vGdbServerTask(void * pv);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* GDB_SERVER_H_ */
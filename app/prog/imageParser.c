@@ -0,0 +1,565 @@
+#include <string.h>
+#include "imageParser.h"
+
+/*-----------------------------------------------------------*/
+
+/* UF2 block layout (little endian words) */
+#define UF2_MAGIC_START0        0U
+#define UF2_MAGIC_START1        4U
+#define UF2_FLAGS               8U
+#define UF2_TARGET_ADDR         12U
+#define UF2_PAYLOAD_SIZE        16U
+#define UF2_NUM_BLOCKS          24U
+#define UF2_DATA                32U
+#define UF2_DATA_MAX            476U
+#define UF2_MAGIC_END           508U
+
+/* ELF32 header and program header fields */
+#define ELF_HEADER_SIZE         52U
+#define ELF_CLASS               4U
+#define ELF_DATA                5U
+#define ELF_PHOFF               28U
+#define ELF_PHENTSIZE           42U
+#define ELF_PHNUM               44U
+#define ELF_CLASS32             1U
+#define ELF_DATA_LSB            1U
+#define ELF_PH_TYPE             0U
+#define ELF_PH_OFFSET           4U
+#define ELF_PH_PADDR            12U
+#define ELF_PH_FILESZ           16U
+#define ELF_PH_SIZE             32U
+#define ELF_PT_LOAD             1U
+
+/*-----------------------------------------------------------*/
+
+/// @brief little endian word, any alignment
+/// @param puc : data
+/// @return value
+static uint32_t prvLe32(const uint8_t * puc)
+{
+    return (uint32_t)puc[0] | ((uint32_t)puc[1] << 8) | ((uint32_t)puc[2] << 16) | ((uint32_t)puc[3] << 24);
+}
+
+/// @brief little endian half word
+/// @param puc : data
+/// @return value
+static uint32_t prvLe16(const uint8_t * puc)
+{
+    return (uint32_t)puc[0] | ((uint32_t)puc[1] << 8);
+}
+
+/// @brief hand out the pending run
+/// @param px : parser
+static void prvRunFlush(image_parser_t * px)
+{
+    if (px->xRun.xLen != 0U)
+    {
+        px->pxData(px->pvContext, px->xRun.ulAddr, px->xRun.puc, px->xRun.xLen);
+        px->xRun.xLen = 0U;
+    }
+}
+
+/// @brief add a record: merged with the pending run if it follows it in address and memory,
+///        split at the alignment boundary
+/// @param px : parser
+/// @param ulAddr : target address
+/// @param puc : data
+/// @param xLen : bytes
+static void prvRunAdd(image_parser_t * px, uint32_t ulAddr, const uint8_t * puc, size_t xLen)
+{
+    while (xLen != 0U)
+    {
+        size_t xPart = xLen;
+
+        if (px->ulAlign != 0U)
+        {
+            size_t xRoom = px->ulAlign - (ulAddr & (px->ulAlign - 1U));
+            if (xPart > xRoom)
+            {
+                xPart = xRoom;
+            }
+        }
+        if ((px->xRun.xLen != 0U) &&
+            ((px->xRun.ulAddr + px->xRun.xLen) == ulAddr) && ((px->xRun.puc + px->xRun.xLen) == puc))
+        {
+            px->xRun.xLen += xPart;
+        }
+        else
+        {
+            prvRunFlush(px);
+            px->xRun.ulAddr = ulAddr;
+            px->xRun.puc = puc;
+            px->xRun.xLen = xPart;
+        }
+        ulAddr += xPart;
+        puc += xPart;
+        xLen -= xPart;
+        // a full sector goes out at once
+        if ((px->ulAlign != 0U) && ((ulAddr & (px->ulAlign - 1U)) == 0U))
+        {
+            prvRunFlush(px);
+        }
+    }
+}
+
+/// @brief value of a hex digit
+/// @param c : character
+/// @return 0..15, -1 if not a hex digit
+static int prvHexDigit(char c)
+{
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return -1;
+}
+
+/// @brief merge HEX record data in the run buffer
+/// @param px : parser
+/// @param ulAddr : target address
+/// @param puc : data
+/// @param xLen : bytes
+static void prvHexData(image_parser_t * px, uint32_t ulAddr, const uint8_t * puc, size_t xLen)
+{
+    while (xLen != 0U)
+    {
+        size_t xPart = IMAGE_HEX_RUN_SIZE - px->xRun.xLen;
+
+        // not following the run or no room: start over
+        if ((px->xRun.xLen != 0U) && (((px->xRun.ulAddr + px->xRun.xLen) != ulAddr) || (xPart == 0U)))
+        {
+            prvRunFlush(px);
+            xPart = IMAGE_HEX_RUN_SIZE;
+        }
+        if (xPart > xLen)
+        {
+            xPart = xLen;
+        }
+        // stop at the boundary, the run is handed out there and the buffer starts over
+        if (px->ulAlign != 0U)
+        {
+            size_t xRoom = px->ulAlign - (ulAddr & (px->ulAlign - 1U));
+            if (xPart > xRoom)
+            {
+                xPart = xRoom;
+            }
+        }
+        memcpy(&px->ucHexRun[px->xRun.xLen], puc, xPart);
+        prvRunAdd(px, ulAddr, &px->ucHexRun[px->xRun.xLen], xPart);
+        ulAddr += xPart;
+        puc += xPart;
+        xLen -= xPart;
+    }
+}
+
+/// @brief decode one Intel HEX line
+/// @param px : parser, the line is in cLine
+/// @return parser state
+static image_result_t prvHexLine(image_parser_t * px)
+{
+    uint8_t ucRecord[4U + 255U + 1U];
+    size_t xBytes;
+    uint8_t ucSum = 0U;
+    uint32_t ulOffset;
+
+    // blank lines and trailing spaces are fine
+    if (px->xLen == 0U)
+    {
+        return IMAGE_RESULT_MORE;
+    }
+    if ((px->u.cLine[0] != ':') || ((px->xLen & 1U) == 0U) || (px->xLen < 11U))
+    {
+        return IMAGE_RESULT_ERROR;
+    }
+    xBytes = (px->xLen - 1U) / 2U;
+    for (size_t i = 0U; i < xBytes; i++)
+    {
+        int lHigh = prvHexDigit(px->u.cLine[1U + (i * 2U)]);
+        int lLow = prvHexDigit(px->u.cLine[2U + (i * 2U)]);
+        if ((lHigh < 0) || (lLow < 0))
+        {
+            return IMAGE_RESULT_ERROR;
+        }
+        ucRecord[i] = (uint8_t)((lHigh << 4) | lLow);
+        ucSum += ucRecord[i];
+    }
+    // count, address, type, data, checksum
+    if ((ucSum != 0U) || (xBytes != (5U + ucRecord[0])))
+    {
+        return IMAGE_RESULT_ERROR;
+    }
+    ulOffset = ((uint32_t)ucRecord[1] << 8) | ucRecord[2];
+    switch (ucRecord[3])
+    {
+        case 0x00:
+            prvHexData(px, px->ulAddr + ulOffset, &ucRecord[4], ucRecord[0]);
+            break;
+        case 0x01:
+            prvRunFlush(px);
+            return IMAGE_RESULT_DONE;
+        case 0x02:
+            // extended segment address
+            px->ulAddr = (((uint32_t)ucRecord[4] << 8) | ucRecord[5]) << 4;
+            break;
+        case 0x04:
+            // extended linear address
+            px->ulAddr = (((uint32_t)ucRecord[4] << 8) | ucRecord[5]) << 16;
+            break;
+        default:
+            // start addresses
+            break;
+    }
+    return IMAGE_RESULT_MORE;
+}
+
+/// @brief feed Intel HEX text
+/// @param px : parser
+/// @param puc : data
+/// @param xLen : bytes
+/// @return parser state
+static image_result_t prvHexFeed(image_parser_t * px, const uint8_t * puc, size_t xLen)
+{
+    for (size_t i = 0U; (i < xLen) && (px->eResult == IMAGE_RESULT_MORE); i++)
+    {
+        char c = (char)puc[i];
+
+        if ((c == '\n') || (c == '\r'))
+        {
+            px->eResult = prvHexLine(px);
+            px->xLen = 0U;
+        }
+        else if ((c == ' ') || (c == '\t'))
+        {
+            continue;
+        }
+        else if ((c == '\0') || (c == 0x1A))
+        {
+            // padding behind the text in the last sector
+            continue;
+        }
+        else if (px->xLen < IMAGE_HEX_LINE_MAX)
+        {
+            px->u.cLine[px->xLen++] = c;
+        }
+        else
+        {
+            px->eResult = IMAGE_RESULT_ERROR;
+        }
+    }
+    return px->eResult;
+}
+
+/// @brief decode one UF2 block
+/// @param px : parser
+/// @param puc : block, any alignment
+/// @return parser state
+static image_result_t prvUf2Block(image_parser_t * px, const uint8_t * puc)
+{
+    uint32_t ulPayload = prvLe32(&puc[UF2_PAYLOAD_SIZE]);
+
+    if ((prvLe32(&puc[UF2_MAGIC_START0]) != IMAGE_UF2_MAGIC_START0) || (prvLe32(&puc[UF2_MAGIC_START1]) != IMAGE_UF2_MAGIC_START1) ||
+        (prvLe32(&puc[UF2_MAGIC_END]) != IMAGE_UF2_MAGIC_END) || (ulPayload > UF2_DATA_MAX))
+    {
+        // not a block: file system data in between, skipped
+        return IMAGE_RESULT_MORE;
+    }
+    if ((prvLe32(&puc[UF2_FLAGS]) & IMAGE_UF2_FLAG_NOFLASH) == 0U)
+    {
+        prvRunAdd(px, prvLe32(&puc[UF2_TARGET_ADDR]), &puc[UF2_DATA], ulPayload);
+    }
+    px->ulNumBlocks = prvLe32(&puc[UF2_NUM_BLOCKS]);
+    px->ulBlocks += 1U;
+    return (px->ulBlocks >= px->ulNumBlocks) ? IMAGE_RESULT_DONE : IMAGE_RESULT_MORE;
+}
+
+/// @brief feed UF2 blocks
+/// @param px : parser
+/// @param puc : data
+/// @param xLen : bytes
+/// @return parser state
+static image_result_t prvUf2Feed(image_parser_t * px, const uint8_t * puc, size_t xLen)
+{
+    while ((xLen != 0U) && (px->eResult == IMAGE_RESULT_MORE))
+    {
+        size_t xCopy;
+
+        // whole blocks in the input are decoded in place
+        if ((px->xLen == 0U) && (xLen >= IMAGE_UF2_BLOCK_SIZE))
+        {
+            px->eResult = prvUf2Block(px, puc);
+            puc += IMAGE_UF2_BLOCK_SIZE;
+            xLen -= IMAGE_UF2_BLOCK_SIZE;
+            continue;
+        }
+        xCopy = IMAGE_UF2_BLOCK_SIZE - px->xLen;
+        if (xCopy > xLen)
+        {
+            xCopy = xLen;
+        }
+        memcpy(&px->u.ucBlock[px->xLen], puc, xCopy);
+        px->xLen += xCopy;
+        puc += xCopy;
+        xLen -= xCopy;
+        if (px->xLen == IMAGE_UF2_BLOCK_SIZE)
+        {
+            px->eResult = prvUf2Block(px, px->u.ucBlock);
+            px->xLen = 0U;
+            // the assembly buffer is reused by the next block
+            prvRunFlush(px);
+        }
+    }
+    return px->eResult;
+}
+
+/// @brief hand out the loadable bytes of a piece of the file
+/// @param px : parser
+/// @param ulOffset : file offset of the piece
+/// @param puc : data
+/// @param xLen : bytes
+static void prvElfData(image_parser_t * px, uint32_t ulOffset, const uint8_t * puc, size_t xLen)
+{
+    uint32_t ulEnd = ulOffset + (uint32_t)xLen;
+
+    for (uint32_t i = 0U; i < px->ulSegments; i++)
+    {
+        const image_segment_t * pxSeg = &px->xSegment[i];
+        uint32_t ulFrom = (ulOffset > pxSeg->ulOffset) ? ulOffset : pxSeg->ulOffset;
+        uint32_t ulTo = pxSeg->ulOffset + pxSeg->ulSize;
+
+        if (ulTo > ulEnd)
+        {
+            ulTo = ulEnd;
+        }
+        if (ulFrom < ulTo)
+        {
+            prvRunAdd(px, pxSeg->ulAddr + (ulFrom - pxSeg->ulOffset), &puc[ulFrom - ulOffset], ulTo - ulFrom);
+        }
+    }
+}
+
+/// @brief read the program headers from the assembly buffer
+/// @param px : parser
+/// @return parser state
+static image_result_t prvElfHeaders(image_parser_t * px)
+{
+    const uint8_t * pucTable = &px->u.ucElf[prvLe32(&px->u.ucElf[ELF_PHOFF])];
+    uint32_t ulEntry = prvLe16(&px->u.ucElf[ELF_PHENTSIZE]);
+    uint32_t ulCount = prvLe16(&px->u.ucElf[ELF_PHNUM]);
+
+    px->ulSegments = 0U;
+    px->ulEnd = 0U;
+    for (uint32_t i = 0U; i < ulCount; i++)
+    {
+        const uint8_t * pucEntry = &pucTable[i * ulEntry];
+        image_segment_t xSeg;
+        uint32_t j;
+
+        xSeg.ulOffset = prvLe32(&pucEntry[ELF_PH_OFFSET]);
+        xSeg.ulAddr = prvLe32(&pucEntry[ELF_PH_PADDR]);
+        xSeg.ulSize = prvLe32(&pucEntry[ELF_PH_FILESZ]);
+        if ((prvLe32(&pucEntry[ELF_PH_TYPE]) != ELF_PT_LOAD) || (xSeg.ulSize == 0U))
+        {
+            continue;
+        }
+        if ((px->ulSegments == IMAGE_ELF_MAX_SEGMENTS) || ((xSeg.ulOffset + xSeg.ulSize) < xSeg.ulOffset))
+        {
+            return IMAGE_RESULT_ERROR;
+        }
+        // kept in file order, so a piece of the file comes out in ascending runs
+        for (j = px->ulSegments; (j > 0U) && (px->xSegment[j - 1U].ulOffset > xSeg.ulOffset); j--)
+        {
+            px->xSegment[j] = px->xSegment[j - 1U];
+        }
+        px->xSegment[j] = xSeg;
+        px->ulSegments += 1U;
+        if ((xSeg.ulOffset + xSeg.ulSize) > px->ulEnd)
+        {
+            px->ulEnd = xSeg.ulOffset + xSeg.ulSize;
+        }
+    }
+    return (px->ulSegments == 0U) ? IMAGE_RESULT_ERROR : IMAGE_RESULT_MORE;
+}
+
+/// @brief bytes of the file holding the ELF header and the program header table
+/// @param px : parser, the ELF header is in the assembly buffer
+/// @return bytes, 0 if not a usable ELF file
+static size_t prvElfHeaderSize(const image_parser_t * px)
+{
+    uint32_t ulOffset = prvLe32(&px->u.ucElf[ELF_PHOFF]);
+    uint32_t ulEntry = prvLe16(&px->u.ucElf[ELF_PHENTSIZE]);
+    uint32_t ulCount = prvLe16(&px->u.ucElf[ELF_PHNUM]);
+
+    if ((px->u.ucElf[ELF_CLASS] != ELF_CLASS32) || (px->u.ucElf[ELF_DATA] != ELF_DATA_LSB) ||
+        (ulEntry < ELF_PH_SIZE) || (ulOffset < ELF_HEADER_SIZE) || (ulOffset > IMAGE_ELF_HEADER_MAX) ||
+        ((ulEntry * ulCount) > (IMAGE_ELF_HEADER_MAX - ulOffset)))
+    {
+        return 0U;
+    }
+    return ulOffset + (ulEntry * ulCount);
+}
+
+/// @brief feed an ELF file
+/// @param px : parser
+/// @param puc : data
+/// @param xLen : bytes
+/// @return parser state
+static image_result_t prvElfFeed(image_parser_t * px, const uint8_t * puc, size_t xLen)
+{
+    // headers first: collected in the assembly buffer
+    while (px->ulSegments == 0U)
+    {
+        size_t xNeed = ELF_HEADER_SIZE;
+        size_t xCopy;
+
+        if (px->xLen >= ELF_HEADER_SIZE)
+        {
+            xNeed = prvElfHeaderSize(px);
+            if (xNeed == 0U)
+            {
+                px->eResult = IMAGE_RESULT_ERROR;
+                return px->eResult;
+            }
+        }
+        if (px->xLen >= xNeed)
+        {
+            px->eResult = prvElfHeaders(px);
+            if (px->eResult != IMAGE_RESULT_MORE)
+            {
+                return px->eResult;
+            }
+            // a segment may start inside the headers
+            prvElfData(px, 0U, px->u.ucElf, px->xLen);
+            prvRunFlush(px);
+            px->ulOffset = (uint32_t)px->xLen;
+            break;
+        }
+        if (xLen == 0U)
+        {
+            return px->eResult;
+        }
+        xCopy = xNeed - px->xLen;
+        if (xCopy > xLen)
+        {
+            xCopy = xLen;
+        }
+        memcpy(&px->u.ucElf[px->xLen], puc, xCopy);
+        px->xLen += xCopy;
+        puc += xCopy;
+        xLen -= xCopy;
+    }
+    prvElfData(px, px->ulOffset, puc, xLen);
+    px->ulOffset += (uint32_t)xLen;
+    if (px->ulOffset >= px->ulEnd)
+    {
+        px->eResult = IMAGE_RESULT_DONE;
+    }
+    return px->eResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief guess the format from the first bytes of a file
+/// @param puc : file start
+/// @param xLen : bytes (8 decide UF2 and BIN, 11 HEX, ELF needs its 52 byte header)
+/// @return format, IMAGE_FORMAT_UNKNOWN if nothing matches
+image_format_t eImageParserDetect(const uint8_t * puc, size_t xLen)
+{
+    uint32_t ulWord[2];
+
+    if ((xLen >= ELF_HEADER_SIZE) && (memcmp(puc, "\x7F" "ELF", 4U) == 0))
+    {
+        return IMAGE_FORMAT_ELF;
+    }
+    if (xLen >= 8U)
+    {
+        memcpy(ulWord, puc, sizeof(ulWord));
+        if ((ulWord[0] == IMAGE_UF2_MAGIC_START0) && (ulWord[1] == IMAGE_UF2_MAGIC_START1))
+        {
+            return IMAGE_FORMAT_UF2;
+        }
+    }
+    if ((xLen >= 11U) && (puc[0] == ':') && (prvHexDigit((char)puc[1]) >= 0) && (prvHexDigit((char)puc[2]) >= 0))
+    {
+        return IMAGE_FORMAT_HEX;
+    }
+    // a raw image has to start with a vector table: stack in RAM, thumb reset handler in flash
+    if (xLen >= 8U)
+    {
+        if (((ulWord[0] & 0xF0000000UL) == 0x20000000UL) &&
+            ((ulWord[1] & 0xF0000001UL) == 0x10000001UL))
+        {
+            return IMAGE_FORMAT_BIN;
+        }
+    }
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+/// @brief start a file
+/// @param px : parser
+/// @param eFormat : file format
+/// @param ulBase : BIN load address
+/// @param ulAlign : runs do not cross this boundary (power of 2, 0: no limit)
+/// @param pxData : data output
+/// @param pv : data output context
+void vImageParserInit(image_parser_t * px, image_format_t eFormat, uint32_t ulBase, uint32_t ulAlign, ImageData_t pxData, void * pv)
+{
+    px->eFormat = eFormat;
+    px->eResult = (eFormat == IMAGE_FORMAT_UNKNOWN) ? IMAGE_RESULT_ERROR : IMAGE_RESULT_MORE;
+    px->pxData = pxData;
+    px->pvContext = pv;
+    px->ulAlign = ulAlign;
+    px->xRun.xLen = 0U;
+    px->ulAddr = (eFormat == IMAGE_FORMAT_BIN) ? ulBase : 0U;
+    px->ulOffset = 0U;
+    px->xLen = 0U;
+    px->ulBlocks = 0U;
+    px->ulNumBlocks = 0U;
+    px->ulSegments = 0U;
+    px->ulEnd = 0U;
+}
+
+/// @brief feed the next piece of the file
+/// @param px : parser
+/// @param puc : data
+/// @param xLen : bytes
+/// @return parser state after this piece
+image_result_t eImageParserFeed(image_parser_t * px, const uint8_t * puc, size_t xLen)
+{
+    if (px->eResult != IMAGE_RESULT_MORE)
+    {
+        return px->eResult;
+    }
+    switch (px->eFormat)
+    {
+        case IMAGE_FORMAT_BIN:
+            prvRunAdd(px, px->ulAddr, puc, xLen);
+            px->ulAddr += xLen;
+            break;
+        case IMAGE_FORMAT_HEX:
+            (void)prvHexFeed(px, puc, xLen);
+            break;
+        case IMAGE_FORMAT_UF2:
+            (void)prvUf2Feed(px, puc, xLen);
+            break;
+        case IMAGE_FORMAT_ELF:
+            (void)prvElfFeed(px, puc, xLen);
+            break;
+        default:
+            px->eResult = IMAGE_RESULT_ERROR;
+            break;
+    }
+    // views into the input do not outlive this call, HEX runs are held until the next record
+    if (px->eFormat != IMAGE_FORMAT_HEX)
+    {
+        prvRunFlush(px);
+    }
+    return px->eResult;
+}
+
+/// @brief hand out the data still held back, for files without an end marker (BIN)
+/// @param px : parser
+void vImageParserFlush(image_parser_t * px)
+{
+    prvRunFlush(px);
+}
+
+/*-----------------------------------------------------------*/
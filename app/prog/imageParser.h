@@ -0,0 +1,142 @@
+#ifndef IMAGE_PARSER_H_
+#define IMAGE_PARSER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Incremental image decoder: the file is fed in chunks of any size as it
+ * arrives, decoded data is handed to the data callback as (address, bytes)
+ * runs without buffering the whole file.
+ *
+ * BIN : raw bytes from a base address
+ * HEX : Intel HEX, record types 00, 01, 02, 04 (03/05 are ignored)
+ * UF2 : 512 byte blocks, blocks flagged "not main flash" are skipped
+ * ELF : 32 bit little endian, PT_LOAD segments at their physical address;
+ *       the program headers have to be in the first IMAGE_ELF_HEADER_MAX bytes
+ *
+ * Runs never cross an ulAlign boundary (the flash sector), adjacent records
+ * are merged into one run. BIN, UF2 and ELF runs are views into the fed
+ * buffer (or the block assembly buffer when a UF2 block was split), valid
+ * during the callback only; HEX records are merged in a decode buffer.
+ */
+
+/* longest Intel HEX line: ':' + count, address, type, 255 data bytes, checksum */
+#define IMAGE_HEX_LINE_MAX      (1U + ((4U + 255U + 1U) * 2U) + 2U)
+/* UF2 block */
+#define IMAGE_UF2_BLOCK_SIZE    512U
+#define IMAGE_UF2_MAGIC_START0  0x0A324655UL
+#define IMAGE_UF2_MAGIC_START1  0x9E5D5157UL
+#define IMAGE_UF2_MAGIC_END     0x0AB16F30UL
+#define IMAGE_UF2_FLAG_NOFLASH  0x00000001UL
+/* ELF: header and program header table assembly */
+#define IMAGE_ELF_MAX_SEGMENTS  16U
+#define IMAGE_ELF_HEADER_MAX    (52U + (IMAGE_ELF_MAX_SEGMENTS * 32U))
+/* HEX: merged run buffer */
+#define IMAGE_HEX_RUN_SIZE      512U
+
+/* file formats */
+typedef enum image_format_t
+{
+    IMAGE_FORMAT_UNKNOWN = 0,
+    IMAGE_FORMAT_BIN,
+    IMAGE_FORMAT_HEX,
+    IMAGE_FORMAT_UF2,
+    IMAGE_FORMAT_ELF
+} image_format_t;
+
+/* feed result */
+typedef enum image_result_t
+{
+    IMAGE_RESULT_MORE = 0,      // waiting for more input
+    IMAGE_RESULT_DONE,          // end of image seen (HEX end record, last UF2 block, last ELF segment)
+    IMAGE_RESULT_ERROR          // malformed input, the parser stops
+} image_result_t;
+
+/* Prototype of the data output: context, address, data, bytes */
+typedef void (* ImageData_t)(void *, uint32_t, const uint8_t *, size_t);
+
+/* run waiting to be merged with the next record */
+typedef struct image_run_t
+{
+    uint32_t ulAddr;
+    const uint8_t * puc;
+    size_t xLen;
+} image_run_t;
+
+/* ELF loadable segment */
+typedef struct image_segment_t
+{
+    uint32_t ulOffset;          // file offset
+    uint32_t ulAddr;            // physical address
+    uint32_t ulSize;            // bytes in the file
+} image_segment_t;
+
+/* parser state */
+typedef struct image_parser_t
+{
+    image_format_t eFormat;
+    image_result_t eResult;
+    ImageData_t pxData;         // data output
+    void * pvContext;           // data output context
+    uint32_t ulAlign;           // runs do not cross this boundary (power of 2, 0: no limit)
+    image_run_t xRun;           // pending run
+    uint32_t ulAddr;            // BIN: next address; HEX: upper address bits
+    uint32_t ulOffset;          // ELF: file offset of the next byte
+    size_t xLen;                // bytes in the assembly buffer
+    uint32_t ulBlocks;          // UF2: blocks seen
+    uint32_t ulNumBlocks;       // UF2: blocks in the file
+    uint32_t ulSegments;        // ELF: loadable segments, 0 until the headers are in
+    uint32_t ulEnd;             // ELF: file offset behind the last segment
+    image_segment_t xSegment[IMAGE_ELF_MAX_SEGMENTS];
+    uint8_t ucHexRun[IMAGE_HEX_RUN_SIZE];
+    union
+    {
+        char cLine[IMAGE_HEX_LINE_MAX + 1U];
+        uint8_t ucBlock[IMAGE_UF2_BLOCK_SIZE];
+        uint8_t ucElf[IMAGE_ELF_HEADER_MAX];
+    } u;
+} image_parser_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief guess the format from the first bytes of a file
+/// @param puc : file start
+/// @param xLen : bytes (8 decide UF2 and BIN, 11 HEX, ELF needs its 52 byte header)
+/// @return format, IMAGE_FORMAT_UNKNOWN if nothing matches
+image_format_t eImageParserDetect(const uint8_t * puc, size_t xLen);
+
+/// @brief start a file
+/// @param px : parser
+/// @param eFormat : file format
+/// @param ulBase : BIN load address
+/// @param ulAlign : runs do not cross this boundary (power of 2, 0: no limit)
+/// @param pxData : data output
+/// @param pv : data output context
+void vImageParserInit(image_parser_t * px, image_format_t eFormat, uint32_t ulBase, uint32_t ulAlign, ImageData_t pxData, void * pv);
+
+/// @brief feed the next piece of the file
+/// @param px : parser
+/// @param puc : data
+/// @param xLen : bytes
+/// @return parser state after this piece
+image_result_t eImageParserFeed(image_parser_t * px, const uint8_t * puc, size_t xLen);
+
+/// @brief hand out the data still held back, for files without an end marker (BIN)
+/// @param px : parser
+void vImageParserFlush(image_parser_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* IMAGE_PARSER_H_ */
@@ -0,0 +1,874 @@
+#include <string.h>
+#include "programmer.h"
+#include "target/target.h"
+#include "rp2350.h"
+#include "util.h"
+
+/*-----------------------------------------------------------*/
+
+/* target RAM layout: return breakpoint, crc code, stack, two data buffers */
+#define PROG_RAM_STUB           (PROG_RAM_BASE + 0x0000UL)
+#define PROG_RAM_CRC_CODE       (PROG_RAM_BASE + 0x0100UL)
+#define PROG_RAM_STACK          (PROG_RAM_BASE + 0x1000UL)
+#define PROG_RAM_BUFFER(n)      (PROG_RAM_BASE + 0x1000UL + ((n) * PROG_CHUNK_SIZE))
+/* sector crcs: results and table in the data buffers, used before anything is programmed */
+#define PROG_RAM_CRC_OUT        PROG_RAM_BUFFER(0)
+#define PROG_RAM_CRC_TABLE      PROG_RAM_BUFFER(1)
+
+/* boot rom: lookup function pointers (16 bit) */
+#define ROM_RP2040_FUNC_TABLE   0x14UL
+#define ROM_RP2040_LOOKUP       0x18UL
+#define ROM_RP2350_LOOKUP       0x16UL
+/* RP2350 lookup flag: arm secure function */
+#define ROM_RP2350_FUNC_ARM_SEC 0x0004UL
+/* rom function codes */
+#define ROM_CODE(c1, c2)        ((uint32_t)(c1) | ((uint32_t)(c2) << 8))
+
+/* CPUID part numbers */
+#define CPUID_PARTNO(x)         (((x) >> 4) & 0xFFFUL)
+#define CPUID_CORTEX_M0P        0xC60UL
+#define CPUID_CORTEX_M33        0xD21UL
+
+/* erase: 64k block command where possible */
+#define FLASH_BLOCK_SIZE        (1UL << 16)
+#define FLASH_BLOCK_CMD         0xD8UL
+
+/* time limits of the rom calls (ms) */
+#define PROG_CALL_TIMEOUT_MS    100U
+#define PROG_ERASE_MS_PER_SECT  50U
+#define PROG_CHUNK_TIMEOUT_MS   1000U
+#define PROG_CRC_MS_PER_SECT    100U
+
+/* a raw image stream ends, any other stream fails, when no data came for this long (ms) */
+#define PROG_STREAM_IDLE_MS     1500U
+
+/* sectors in the staging area */
+#define PROG_SECTORS            (PSRAM_IMAGE_SIZE / PROG_SECTOR_SIZE)
+
+/* task notification bits */
+#define PROG_EVENT_RUN          (1UL << 0)  // program the staged image
+#define PROG_EVENT_DATA         (1UL << 1)  // stream opened, sector complete or stream closed
+
+/* xPSR with the thumb bit */
+#define XPSR_THUMB              0x01000000UL
+
+/* rom functions used */
+enum
+{
+    ROM_CONNECT = 0,            // connect_internal_flash
+    ROM_EXIT_XIP,               // flash_exit_xip
+    ROM_ERASE,                  // flash_range_erase
+    ROM_PROGRAM,                // flash_range_program
+    ROM_FLUSH_CACHE,            // flash_flush_cache
+    ROM_ENTER_XIP,              // flash_enter_cmd_xip
+    ROM_NUMBER
+};
+
+static const uint32_t ulRomCode[ROM_NUMBER] =
+{
+    ROM_CODE('I', 'F'), ROM_CODE('E', 'X'), ROM_CODE('R', 'E'),
+    ROM_CODE('R', 'P'), ROM_CODE('F', 'C'), ROM_CODE('C', 'X'),
+};
+
+/*
+ * Target side crc32 of flash sectors (thumb, runs on M0+ and M33), same crc
+ * as ulUtilCrc32:
+ *  void crc_sectors(const uint8_t * flash, uint32_t sectors, uint32_t * out, uint32_t * table)
+ * builds the 1 KB table first, then one crc per 4 KB sector.
+ */
+static const uint32_t ulCrcStub[] =
+{
+    0x4F10B5F0UL, 0x46252400UL, 0x086D2608UL, 0x407DD300UL, 0xD1FA3E01UL, 0x519D00A6UL,
+    0x2CFF3401UL, 0x2400D9F3UL, 0x250143E4UL, 0x7806032DUL, 0x40663001UL, 0x00B6B2F6UL,
+    0x0A24599EUL, 0x3D014074UL, 0x43E4D1F5UL, 0x3901C210UL, 0xBDF0D1EDUL, 0xEDB88320UL,
+};
+
+/* programmer state */
+typedef struct prog_t
+{
+    TaskHandle_t xTask;
+    uint8_t * pucImage;         // staging area in psram, mirrors the flash from PROG_FLASH_BASE
+    prog_status_t xStatus;
+    uint32_t ulRom[ROM_NUMBER]; // rom function addresses of the current target
+    // stream
+    volatile bool xStream;      // a stream is open
+    volatile bool xStreamEnd;   // no more data will come
+    bool xStreamError;          // the file was malformed
+    bool xStreamIdleEnd;        // a raw image, the stream ends when the data stops
+    int32_t lCurrent;           // sector being filled, -1 if none
+    uint32_t ulLow;             // lowest and highest sector written
+    uint32_t ulHigh;
+    uint32_t ulTouched[PROG_SECTORS / 32U];     // sectors written
+    uint32_t ulPending[PROG_SECTORS / 32U];     // sectors complete, not programmed yet
+    uint32_t ulChanged[PROG_SECTORS / 32U];     // sectors whose flash differs from the image
+} prog_t;
+
+static prog_t xProg = { .xStatus = { .xVerify = true, .xDelta = true } };
+
+/*-----------------------------------------------------------*/
+
+/// @brief staging area of a flash address
+/// @param ulAddr : target flash address
+/// @return psram pointer
+static inline uint8_t * prvImage(uint32_t ulAddr)
+{
+    return xProg.pucImage + (ulAddr - PROG_FLASH_BASE);
+}
+
+/// @brief start a function on the halted target, it returns into a breakpoint
+/// @param ulFunc : function address
+/// @param pulArgs : r0..r3
+/// @param xArgs : number of arguments
+/// @return acknowledge
+static uint8_t prvCallStart(uint32_t ulFunc, const uint32_t * pulArgs, size_t xArgs)
+{
+    for (size_t i = 0U; i < xArgs; i++)
+    {
+        TARGET_TRY(ucTargetWriteReg(i, pulArgs[i]));
+    }
+    TARGET_TRY(ucTargetWriteReg(TARGET_REG_SP, PROG_RAM_STACK));
+    TARGET_TRY(ucTargetWriteReg(TARGET_REG_LR, PROG_RAM_STUB | 1U));
+    TARGET_TRY(ucTargetWriteReg(TARGET_REG_PC, ulFunc & ~1UL));
+    TARGET_TRY(ucTargetWriteReg(TARGET_REG_XPSR, XPSR_THUMB));
+    return ucTargetResume();
+}
+
+/// @brief wait for the function started by prvCallStart
+/// @param ulTimeoutMs : time limit
+/// @param pulResult : r0 output, may be NULL
+/// @return acknowledge, DAP_TRANSFER_ERROR on timeout
+static uint8_t prvCallWait(uint32_t ulTimeoutMs, uint32_t * pulResult)
+{
+    TickType_t xStart = xTaskGetTickCount();
+    bool xHalted = false;
+    uint8_t ucAck;
+
+    do
+    {
+        ucAck = ucTargetIsHalted(&xHalted);
+        if ((ucAck != DAP_TRANSFER_OK) || xHalted)
+        {
+            break;
+        }
+        vTaskDelay(1);
+        // the target runs on its own, a host request may go first
+        vTargetYield();
+    } while ((xTaskGetTickCount() - xStart) < pdMS_TO_TICKS(ulTimeoutMs));
+
+    if ((ucAck == DAP_TRANSFER_OK) && !xHalted)
+    {
+        (void)ucTargetHalt();
+        return DAP_TRANSFER_ERROR;
+    }
+    if ((ucAck == DAP_TRANSFER_OK) && (pulResult != NULL))
+    {
+        ucAck = ucTargetReadReg(0U, pulResult);
+    }
+    return ucAck;
+}
+
+/// @brief call a function on the target and wait for it
+/// @param ulFunc : function address
+/// @param pulArgs : r0..r3
+/// @param xArgs : number of arguments
+/// @param ulTimeoutMs : time limit
+/// @param pulResult : r0 output, may be NULL
+/// @return acknowledge
+static uint8_t prvCall(uint32_t ulFunc, const uint32_t * pulArgs, size_t xArgs, uint32_t ulTimeoutMs, uint32_t * pulResult)
+{
+    TARGET_TRY(prvCallStart(ulFunc, pulArgs, xArgs));
+    return prvCallWait(ulTimeoutMs, pulResult);
+}
+
+/// @brief find the rom flash functions of the target
+/// @return acknowledge, DAP_TRANSFER_ERROR for an unknown device or missing function
+static uint8_t prvRomLookup(void)
+{
+    uint32_t ulCpuid, ulArgs[2];
+    uint8_t ucHeader[8];
+    uint16_t usTable, usLookup;
+    bool xRp2350;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_CPUID, &ulCpuid));
+    TARGET_TRY(ucTargetReadMem(ROM_RP2040_FUNC_TABLE, ucHeader, sizeof(ucHeader)));
+    if (CPUID_PARTNO(ulCpuid) == CPUID_CORTEX_M33)
+        xRp2350 = true;
+    else if (CPUID_PARTNO(ulCpuid) == CPUID_CORTEX_M0P)
+        xRp2350 = false;
+    else
+        return DAP_TRANSFER_ERROR;
+
+    // RP2040: lookup(table, code); RP2350: lookup(code, flags)
+    usTable = (uint16_t)(ucHeader[0] | (ucHeader[1] << 8));
+    if (xRp2350)
+        usLookup = (uint16_t)(ucHeader[ROM_RP2350_LOOKUP - ROM_RP2040_FUNC_TABLE] | (ucHeader[ROM_RP2350_LOOKUP - ROM_RP2040_FUNC_TABLE + 1U] << 8));
+    else
+        usLookup = (uint16_t)(ucHeader[ROM_RP2040_LOOKUP - ROM_RP2040_FUNC_TABLE] | (ucHeader[ROM_RP2040_LOOKUP - ROM_RP2040_FUNC_TABLE + 1U] << 8));
+
+    for (uint32_t i = 0U; i < ROM_NUMBER; i++)
+    {
+        ulArgs[0] = xRp2350 ? ulRomCode[i] : usTable;
+        ulArgs[1] = xRp2350 ? ROM_RP2350_FUNC_ARM_SEC : ulRomCode[i];
+        TARGET_TRY(prvCall(usLookup, ulArgs, 2U, PROG_CALL_TIMEOUT_MS, &xProg.ulRom[i]));
+        if (xProg.ulRom[i] == 0U)
+        {
+            return DAP_TRANSFER_ERROR;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief compare the target flash with the staged image
+/// @param ulAddr : first address
+/// @param ulSize : bytes
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when it differs
+static uint8_t prvVerify(uint32_t ulAddr, uint32_t ulSize)
+{
+    uint32_t ulWords[PROG_PAGE_SIZE / 4U];
+    const uint8_t * puc = prvImage(ulAddr);
+
+    for (uint32_t ulOffset = 0U; ulOffset < ulSize; ulOffset += sizeof(ulWords))
+    {
+        uint32_t ulLen = ((ulSize - ulOffset) < sizeof(ulWords)) ? (ulSize - ulOffset) : sizeof(ulWords);
+
+        TARGET_TRY(ucTargetReadBlock(ulAddr + ulOffset, ulWords, (ulLen + 3U) / 4U));
+        if (memcmp(ulWords, puc + ulOffset, ulLen) != 0)
+        {
+            return DAP_TRANSFER_MISMATCH;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief halt the target and prepare its flash for the rom functions
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvSessionBegin(const char ** ppcError)
+{
+    *ppcError = "connect";
+    TARGET_TRY(ucTargetConnect(NULL));
+    *ppcError = "reset halt";
+    TARGET_TRY(ucTargetReset(true));
+    // return breakpoint: bkpt #0
+    *ppcError = "target ram";
+    TARGET_TRY(ucTargetWriteWord(PROG_RAM_STUB, 0xBE00BE00UL));
+    TARGET_TRY(ucTargetWriteBlock(PROG_RAM_CRC_CODE, ulCrcStub, sizeof(ulCrcStub) / 4U));
+    *ppcError = "rom lookup";
+    TARGET_TRY(prvRomLookup());
+    *ppcError = "flash connect";
+    TARGET_TRY(prvCall(xProg.ulRom[ROM_CONNECT], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL));
+    return prvCall(xProg.ulRom[ROM_EXIT_XIP], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL);
+}
+
+/// @brief bring the flash back into XIP mode
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvSessionEnd(const char ** ppcError)
+{
+    *ppcError = "flash xip";
+    TARGET_TRY(prvCall(xProg.ulRom[ROM_FLUSH_CACHE], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL));
+    return prvCall(xProg.ulRom[ROM_ENTER_XIP], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL);
+}
+
+/// @brief mark the sectors whose flash content differs from the staged image in ulChanged,
+///        the crcs are computed by the target, the flash is out of XIP mode before and after
+/// @param ulFirst : first sector
+/// @param ulCount : sectors
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvDelta(uint32_t ulFirst, uint32_t ulCount, const char ** ppcError)
+{
+    uint32_t ulCrc[PROG_PAGE_SIZE / 4U];
+    uint32_t ulArgs[4];
+
+    if (!xProg.xStatus.xDelta)
+    {
+        for (uint32_t i = ulFirst; i < (ulFirst + ulCount); i++)
+        {
+            xProg.ulChanged[i / 32U] |= (1UL << (i % 32U));
+        }
+        return DAP_TRANSFER_OK;
+    }
+    // read through XIP in rom command mode, without lines cached before an erase
+    *ppcError = "flash xip";
+    TARGET_TRY(prvCall(xProg.ulRom[ROM_FLUSH_CACHE], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL));
+    TARGET_TRY(prvCall(xProg.ulRom[ROM_ENTER_XIP], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL));
+    *ppcError = "flash crc";
+    ulArgs[0] = PROG_FLASH_BASE + (ulFirst * PROG_SECTOR_SIZE);
+    ulArgs[1] = ulCount;
+    ulArgs[2] = PROG_RAM_CRC_OUT;
+    ulArgs[3] = PROG_RAM_CRC_TABLE;
+    TARGET_TRY(prvCall(PROG_RAM_CRC_CODE | 1U, ulArgs, 4U, PROG_CALL_TIMEOUT_MS + (ulCount * PROG_CRC_MS_PER_SECT), NULL));
+    *ppcError = "flash connect";
+    TARGET_TRY(prvCall(xProg.ulRom[ROM_EXIT_XIP], NULL, 0U, PROG_CALL_TIMEOUT_MS, NULL));
+
+    *ppcError = "flash crc";
+    for (uint32_t ulDone = 0U; ulDone < ulCount; ulDone += PROG_PAGE_SIZE / 4U)
+    {
+        uint32_t ulLen = ((ulCount - ulDone) < (PROG_PAGE_SIZE / 4U)) ? (ulCount - ulDone) : (PROG_PAGE_SIZE / 4U);
+
+        TARGET_TRY(ucTargetReadBlock(PROG_RAM_CRC_OUT + (ulDone * 4U), ulCrc, ulLen));
+        for (uint32_t i = 0U; i < ulLen; i++)
+        {
+            uint32_t ulSector = ulFirst + ulDone + i;
+            uint32_t ulBit = 1UL << (ulSector % 32U);
+
+            if (ulCrc[i] != ulUtilCrc32(0U, xProg.pucImage + (ulSector * PROG_SECTOR_SIZE), PROG_SECTOR_SIZE))
+                xProg.ulChanged[ulSector / 32U] |= ulBit;
+            else
+                xProg.ulChanged[ulSector / 32U] &= ~ulBit;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief erase and program a range of the staged image
+/// @param ulOffset : flash offset (sector aligned)
+/// @param ulSize : bytes to program (page multiple)
+/// @param ulErase : bytes to erase (sector multiple)
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvProgramRange(uint32_t ulOffset, uint32_t ulSize, uint32_t ulErase, const char ** ppcError)
+{
+    const uint8_t * pucImage = xProg.pucImage + ulOffset;
+    uint32_t ulArgs[4];
+    uint32_t ulChunk, ulNext;
+
+    // the first chunk is transferred while the flash erases
+    *ppcError = "erase";
+    ulArgs[0] = ulOffset;
+    ulArgs[1] = ulErase;
+    ulArgs[2] = FLASH_BLOCK_SIZE;
+    ulArgs[3] = FLASH_BLOCK_CMD;
+    TARGET_TRY(prvCallStart(xProg.ulRom[ROM_ERASE], ulArgs, 4U));
+    ulChunk = (ulSize < PROG_CHUNK_SIZE) ? ulSize : PROG_CHUNK_SIZE;
+    *ppcError = "target ram";
+    TARGET_TRY(ucTargetWriteBlock(PROG_RAM_BUFFER(0), (const uint32_t *)pucImage, ulChunk / 4U));
+    *ppcError = "erase";
+    TARGET_TRY(prvCallWait(PROG_CALL_TIMEOUT_MS + (ulErase / PROG_SECTOR_SIZE) * PROG_ERASE_MS_PER_SECT, NULL));
+
+    // program one buffer while the next chunk goes into the other
+    for (uint32_t ulPos = 0U, n = 0U; ulPos < ulSize; ulPos += ulChunk, n ^= 1U)
+    {
+        ulChunk = ((ulSize - ulPos) < PROG_CHUNK_SIZE) ? (ulSize - ulPos) : PROG_CHUNK_SIZE;
+        *ppcError = "program";
+        ulArgs[0] = ulOffset + ulPos;
+        ulArgs[1] = PROG_RAM_BUFFER(n);
+        ulArgs[2] = ulChunk;
+        TARGET_TRY(prvCallStart(xProg.ulRom[ROM_PROGRAM], ulArgs, 3U));
+        ulNext = ulPos + ulChunk;
+        if (ulNext < ulSize)
+        {
+            uint32_t ulNextChunk = ((ulSize - ulNext) < PROG_CHUNK_SIZE) ? (ulSize - ulNext) : PROG_CHUNK_SIZE;
+            *ppcError = "target ram";
+            TARGET_TRY(ucTargetWriteBlock(PROG_RAM_BUFFER(n ^ 1U), (const uint32_t *)(pucImage + ulNext), ulNextChunk / 4U));
+        }
+        *ppcError = "program";
+        TARGET_TRY(prvCallWait(PROG_CHUNK_TIMEOUT_MS, NULL));
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief flash the staged image into the target, sectors that already hold the image are left alone
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvProgram(const char ** ppcError)
+{
+    uint32_t ulFirst = (xProg.xStatus.ulImageAddr - PROG_FLASH_BASE) / PROG_SECTOR_SIZE;
+    uint32_t ulCount = (xProg.xStatus.ulImageSize + PROG_SECTOR_SIZE - 1U) / PROG_SECTOR_SIZE;
+    // programming works in pages, the staging area is padded with 0xff to the sector end
+    uint32_t ulLimit = (xProg.xStatus.ulImageAddr - PROG_FLASH_BASE) +
+                       ((xProg.xStatus.ulImageSize + PROG_PAGE_SIZE - 1U) & ~(PROG_PAGE_SIZE - 1U));
+
+    TARGET_TRY(prvSessionBegin(ppcError));
+    TARGET_TRY(prvDelta(ulFirst, ulCount, ppcError));
+
+    // runs of changed sectors, each erased and programmed in one go
+    for (uint32_t i = ulFirst; i < (ulFirst + ulCount); )
+    {
+        uint32_t ulEnd = i;
+        uint32_t ulOffset, ulErase, ulSize;
+
+        while ((ulEnd < (ulFirst + ulCount)) && ((xProg.ulChanged[ulEnd / 32U] & (1UL << (ulEnd % 32U))) != 0U))
+        {
+            ulEnd++;
+        }
+        if (ulEnd == i)
+        {
+            xProg.xStatus.ulSkipped += 1U;
+            i++;
+            continue;
+        }
+        ulOffset = i * PROG_SECTOR_SIZE;
+        ulErase = (ulEnd - i) * PROG_SECTOR_SIZE;
+        ulSize = ((ulOffset + ulErase) < ulLimit) ? ulErase : (ulLimit - ulOffset);
+        TARGET_TRY(prvProgramRange(ulOffset, ulSize, ulErase, ppcError));
+        i = ulEnd;
+    }
+
+    TARGET_TRY(prvSessionEnd(ppcError));
+    if (xProg.xStatus.xVerify)
+    {
+        *ppcError = "verify";
+        TARGET_TRY(prvVerify(xProg.xStatus.ulImageAddr, xProg.xStatus.ulImageSize));
+    }
+    *ppcError = "reset run";
+    TARGET_TRY(ucTargetReset(false));
+    *ppcError = NULL;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief erase and program one sector of the stream unless the flash holds it already,
+///        the data goes over while it erases
+/// @param ulSector : sector index
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvProgramSector(uint32_t ulSector, const char ** ppcError)
+{
+    uint32_t ulOffset = ulSector * PROG_SECTOR_SIZE;
+    uint32_t ulArgs[4];
+
+    TARGET_TRY(prvDelta(ulSector, 1U, ppcError));
+    if ((xProg.ulChanged[ulSector / 32U] & (1UL << (ulSector % 32U))) == 0U)
+    {
+        xProg.xStatus.ulSkipped += 1U;
+        return DAP_TRANSFER_OK;
+    }
+    *ppcError = "erase";
+    ulArgs[0] = ulOffset;
+    ulArgs[1] = PROG_SECTOR_SIZE;
+    ulArgs[2] = FLASH_BLOCK_SIZE;
+    ulArgs[3] = FLASH_BLOCK_CMD;
+    TARGET_TRY(prvCallStart(xProg.ulRom[ROM_ERASE], ulArgs, 4U));
+    *ppcError = "target ram";
+    TARGET_TRY(ucTargetWriteBlock(PROG_RAM_BUFFER(0), (const uint32_t *)(xProg.pucImage + ulOffset), PROG_SECTOR_SIZE / 4U));
+    *ppcError = "erase";
+    TARGET_TRY(prvCallWait(PROG_CALL_TIMEOUT_MS + PROG_ERASE_MS_PER_SECT, NULL));
+    *ppcError = "program";
+    ulArgs[1] = PROG_RAM_BUFFER(0);
+    ulArgs[2] = PROG_SECTOR_SIZE;
+    TARGET_TRY(prvCallStart(xProg.ulRom[ROM_PROGRAM], ulArgs, 3U));
+    return prvCallWait(PROG_CHUNK_TIMEOUT_MS, NULL);
+}
+
+/// @brief take the lowest sector that is complete and not programmed yet
+/// @return sector index, -1 if there is none
+static int32_t prvStreamNext(void)
+{
+    int32_t lSector = -1;
+
+    taskENTER_CRITICAL();
+    for (uint32_t i = 0U; i < PROG_SECTORS / 32U; i++)
+    {
+        if (xProg.ulPending[i] != 0U)
+        {
+            uint32_t ulBit = (uint32_t)__builtin_ctz(xProg.ulPending[i]);
+            xProg.ulPending[i] &= ~(1UL << ulBit);
+            lSector = (int32_t)((i * 32U) + ulBit);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return lSector;
+}
+
+/// @brief close the sector being filled, the lock is held by the caller
+static void prvStreamClose(void)
+{
+    if (xProg.lCurrent >= 0)
+    {
+        xProg.ulPending[xProg.lCurrent / 32] |= (1UL << (xProg.lCurrent % 32));
+        xProg.lCurrent = -1;
+    }
+}
+
+/// @brief finish a stream whose sectors are through: XIP, verify, reset
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvStreamFinish(const char ** ppcError)
+{
+    TARGET_TRY(prvSessionEnd(ppcError));
+    if (xProg.xStatus.xVerify)
+    {
+        *ppcError = "verify";
+        for (uint32_t i = xProg.ulLow; i <= xProg.ulHigh; i++)
+        {
+            if ((xProg.ulTouched[i / 32U] & (1UL << (i % 32U))) != 0U)
+            {
+                TARGET_TRY(prvVerify(PROG_FLASH_BASE + (i * PROG_SECTOR_SIZE), PROG_SECTOR_SIZE));
+            }
+        }
+    }
+    *ppcError = "reset run";
+    TARGET_TRY(ucTargetReset(false));
+    *ppcError = NULL;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief program the sectors of a stream as they arrive, the link is taken
+///        for each step and is free while the data comes
+/// @param ppcError : failing step output
+/// @return acknowledge
+static uint8_t prvStream(const char ** ppcError)
+{
+    uint32_t ulEvents;
+    uint8_t ucAck;
+    int32_t lSector;
+
+    vTargetAcquire();
+    ucAck = prvSessionBegin(ppcError);
+    vTargetRelease();
+    while (true)
+    {
+        lSector = prvStreamNext();
+        if (lSector >= 0)
+        {
+            // after a failure the rest of the file is only drained
+            if (ucAck == DAP_TRANSFER_OK)
+            {
+                vTargetAcquire();
+                ucAck = prvProgramSector((uint32_t)lSector, ppcError);
+                vTargetRelease();
+            }
+            continue;
+        }
+        if (xProg.xStreamEnd)
+        {
+            break;
+        }
+        // a raw image has no end marker, it ends when the data stops; any other file stopped early
+        if (pdFALSE == xTaskNotifyWait(0U, PROG_EVENT_DATA, &ulEvents, pdMS_TO_TICKS(PROG_STREAM_IDLE_MS)))
+        {
+            taskENTER_CRITICAL();
+            if (!xProg.xStreamIdleEnd)
+            {
+                memset(xProg.ulPending, 0x00, sizeof(xProg.ulPending));
+                xProg.lCurrent = -1;
+                xProg.xStreamError = true;
+            }
+            prvStreamClose();
+            xProg.xStreamEnd = true;
+            taskEXIT_CRITICAL();
+        }
+    }
+    if (ucAck != DAP_TRANSFER_OK)
+    {
+        return ucAck;
+    }
+    if (xProg.xStreamError || (xProg.ulLow > xProg.ulHigh))
+    {
+        *ppcError = "image";
+        return DAP_TRANSFER_ERROR;
+    }
+    vTargetAcquire();
+    ucAck = prvStreamFinish(ppcError);
+    vTargetRelease();
+    return ucAck;
+}
+
+/// @brief turn the streamed sectors into the staged image for later runs
+static void prvStreamImage(void)
+{
+    uint32_t ulAddr = PROG_FLASH_BASE + (xProg.ulLow * PROG_SECTOR_SIZE);
+    uint32_t ulSize = (xProg.ulHigh + 1U - xProg.ulLow) * PROG_SECTOR_SIZE;
+
+    // gaps between the records read as erased flash
+    for (uint32_t i = xProg.ulLow; i <= xProg.ulHigh; i++)
+    {
+        if ((xProg.ulTouched[i / 32U] & (1UL << (i % 32U))) == 0U)
+        {
+            memset(xProg.pucImage + (i * PROG_SECTOR_SIZE), 0xFF, PROG_SECTOR_SIZE);
+        }
+    }
+    xProg.xStatus.ulImageAddr = ulAddr;
+    xProg.xStatus.ulImageSize = ulSize;
+    xProg.xStatus.ulImageCrc = ulUtilCrc32(0U, prvImage(ulAddr), ulSize);
+    xProg.xStatus.xImageValid = true;
+}
+
+/// @brief start button edge
+static void prvButtonIrq(void)
+{
+    BaseType_t xWoken = pdFALSE;
+
+    if ((gpio_get_irq_event_mask(PROG_BUTTON_PIN) & GPIO_IRQ_EDGE_FALL) != 0U)
+    {
+        gpio_acknowledge_irq(PROG_BUTTON_PIN, GPIO_IRQ_EDGE_FALL);
+        if ((xProg.xTask != NULL) && xProg.xStatus.xImageValid)
+        {
+            xTaskNotifyFromISR(xProg.xTask, PROG_EVENT_RUN, eSetBits, &xWoken);
+        }
+    }
+    portYIELD_FROM_ISR(xWoken);
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief set up the image store and the start button
+void vProgInit(void)
+{
+    xProg.pucImage = (uint8_t *)PSRAM_IMAGE_BASE;
+    gpio_init(PROG_BUTTON_PIN);
+    gpio_set_dir(PROG_BUTTON_PIN, GPIO_IN);
+    gpio_pull_up(PROG_BUTTON_PIN);
+    gpio_add_raw_irq_handler(PROG_BUTTON_PIN, prvButtonIrq);
+    gpio_set_irq_enabled(PROG_BUTTON_PIN, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+/// @brief programmer thread
+/// @param pv : unused
+void vProgTask(void * pv)
+{
+    const char * pcError;
+    uint32_t ulStartUs, ulEvents;
+    uint8_t ucAck;
+    bool xStream;
+
+    (void)pv;
+    xProg.xTask = xTaskGetCurrentTaskHandle();
+
+    do
+    {
+        (void)xTaskNotifyWait(0U, PROG_EVENT_RUN | PROG_EVENT_DATA, &ulEvents, portMAX_DELAY);
+        xStream = xProg.xStream;
+        if (!xStream && (((ulEvents & PROG_EVENT_RUN) == 0U) || !xProg.xStatus.xImageValid))
+        {
+            continue;
+        }
+        xProg.xStatus.eResult = PROG_RESULT_BUSY;
+        xProg.xStatus.ulSkipped = 0U;
+        ulStartUs = time_us_32();
+        if (xStream)
+        {
+            ucAck = prvStream(&pcError);
+        }
+        else
+        {
+            // a run from the staged image owns the link, a host on the dap interface waits
+            vTargetAcquire();
+            ucAck = prvProgram(&pcError);
+            vTargetRelease();
+        }
+        if (xStream)
+        {
+            // a good file stays staged for further runs, even if this target failed
+            if (!xProg.xStreamError && (xProg.ulLow <= xProg.ulHigh))
+            {
+                prvStreamImage();
+            }
+            xProg.xStream = false;
+        }
+        xProg.xStatus.ulLastMs = (time_us_32() - ulStartUs) / 1000U;
+        xProg.xStatus.pcError = pcError;
+        if (ucAck == DAP_TRANSFER_OK)
+        {
+            xProg.xStatus.ulPassed += 1U;
+            xProg.xStatus.eResult = PROG_RESULT_PASS;
+        }
+        else
+        {
+            xProg.xStatus.ulFailed += 1U;
+            xProg.xStatus.eResult = PROG_RESULT_FAIL;
+        }
+        // contact bounce and a button held through the run
+        vTaskDelay(pdMS_TO_TICKS(PROG_BUTTON_HOLDOFF_MS));
+        (void)xTaskNotifyWait(0U, PROG_EVENT_RUN, &ulEvents, 0);
+    } while (true);
+}
+
+/// @brief start staging a new image, the previous one is dropped
+/// @param ulAddr : target flash address (sector aligned)
+/// @param ulSize : image bytes
+/// @return pdPASS : ready for data; pdFAIL : bad address or too large
+BaseType_t xProgImageBegin(uint32_t ulAddr, uint32_t ulSize)
+{
+    if ((xProg.xStatus.eResult == PROG_RESULT_BUSY) || xProg.xStream || (ulAddr < PROG_FLASH_BASE) ||
+        ((ulAddr & (PROG_SECTOR_SIZE - 1U)) != 0U) || (ulSize == 0U) ||
+        ((ulAddr - PROG_FLASH_BASE) >= PSRAM_IMAGE_SIZE) || (ulSize > (PSRAM_IMAGE_SIZE - (ulAddr - PROG_FLASH_BASE))))
+    {
+        return pdFAIL;
+    }
+    xProg.xStatus.xImageValid = false;
+    xProg.xStatus.ulImageAddr = ulAddr;
+    xProg.xStatus.ulImageSize = ulSize;
+    xProg.xStatus.ulImageCrc = 0U;
+    return pdPASS;
+}
+
+/// @brief store image data
+/// @param ulOffset : offset in the image
+/// @param puc : data
+/// @param xLen : bytes
+/// @return pdPASS : stored; pdFAIL : out of the image
+BaseType_t xProgImageWrite(uint32_t ulOffset, const uint8_t * puc, size_t xLen)
+{
+    if (xProg.xStatus.xImageValid || (ulOffset > xProg.xStatus.ulImageSize) ||
+        (xLen > (xProg.xStatus.ulImageSize - ulOffset)))
+    {
+        return pdFAIL;
+    }
+    memcpy(prvImage(xProg.xStatus.ulImageAddr) + ulOffset, puc, xLen);
+    return pdPASS;
+}
+
+/// @brief check the staged image and arm the programmer
+/// @param ulCrc : expected crc32 of the image
+/// @return pdPASS : image valid; pdFAIL : crc mismatch
+BaseType_t xProgImageCommit(uint32_t ulCrc)
+{
+    uint32_t ulSize = xProg.xStatus.ulImageSize;
+    uint8_t * pucImage = prvImage(xProg.xStatus.ulImageAddr);
+
+    if ((ulSize == 0U) || (ulUtilCrc32(0U, pucImage, ulSize) != ulCrc))
+    {
+        return pdFAIL;
+    }
+    // the last page is programmed as a whole, the last sector is compared as a whole
+    memset(pucImage + ulSize, 0xFF, ((ulSize + PROG_SECTOR_SIZE - 1U) & ~(PROG_SECTOR_SIZE - 1U)) - ulSize);
+    xProg.xStatus.ulImageCrc = ulCrc;
+    xProg.xStatus.xImageValid = true;
+    return pdPASS;
+}
+
+/// @brief read back after programming or not
+/// @param xVerify : true to verify
+void vProgSetVerify(bool xVerify)
+{
+    xProg.xStatus.xVerify = xVerify;
+}
+
+/// @brief skip sectors whose flash content matches the image or not
+/// @param xDelta : true to compare first
+void vProgSetDelta(bool xDelta)
+{
+    xProg.xStatus.xDelta = xDelta;
+}
+
+/// @brief start a run
+/// @return pdPASS : started; pdFAIL : no valid image or already running
+BaseType_t xProgStart(void)
+{
+    if ((xProg.xTask == NULL) || !xProg.xStatus.xImageValid || (xProg.xStatus.eResult == PROG_RESULT_BUSY))
+    {
+        return pdFAIL;
+    }
+    xTaskNotify(xProg.xTask, PROG_EVENT_RUN, eSetBits);
+    return pdPASS;
+}
+
+/// @brief open a stream: the target is programmed sector by sector while the file arrives
+/// @param eFormat : file format, a raw image (IMAGE_FORMAT_BIN) ends when the data stops, any other
+///                  stream is closed with vProgStreamEnd and fails if the data stops first
+/// @return pdPASS : open; pdFAIL : busy
+BaseType_t xProgStreamBegin(image_format_t eFormat)
+{
+    if ((xProg.xTask == NULL) || xProg.xStream || (xProg.xStatus.eResult == PROG_RESULT_BUSY))
+    {
+        return pdFAIL;
+    }
+    memset(xProg.ulTouched, 0x00, sizeof(xProg.ulTouched));
+    memset(xProg.ulPending, 0x00, sizeof(xProg.ulPending));
+    xProg.lCurrent = -1;
+    xProg.ulLow = PROG_SECTORS;
+    xProg.ulHigh = 0U;
+    xProg.xStreamEnd = false;
+    xProg.xStreamError = false;
+    xProg.xStreamIdleEnd = (IMAGE_FORMAT_BIN == eFormat);
+    xProg.xStatus.xImageValid = false;
+    xProg.xStream = true;
+    xTaskNotify(xProg.xTask, PROG_EVENT_DATA, eSetBits);
+    return pdPASS;
+}
+
+/// @brief stage stream data, a sector is programmed once the data moves past it
+/// @param ulAddr : target flash address
+/// @param puc : data
+/// @param xLen : bytes
+/// @return pdPASS : stored; pdFAIL : no open stream or outside the flash window
+BaseType_t xProgStreamWrite(uint32_t ulAddr, const uint8_t * puc, size_t xLen)
+{
+    bool xClosed, xFresh;
+
+    if (!xProg.xStream || xProg.xStreamEnd || (ulAddr < PROG_FLASH_BASE) ||
+        ((ulAddr - PROG_FLASH_BASE) > PSRAM_IMAGE_SIZE) || (xLen > (PSRAM_IMAGE_SIZE - (ulAddr - PROG_FLASH_BASE))))
+    {
+        return pdFAIL;
+    }
+    while (xLen != 0U)
+    {
+        uint32_t ulSector = (ulAddr - PROG_FLASH_BASE) / PROG_SECTOR_SIZE;
+        size_t xCopy = PROG_SECTOR_SIZE - ((ulAddr - PROG_FLASH_BASE) % PROG_SECTOR_SIZE);
+
+        if (xCopy > xLen)
+        {
+            xCopy = xLen;
+        }
+        taskENTER_CRITICAL();
+        xClosed = (xProg.lCurrent != (int32_t)ulSector) && (xProg.lCurrent >= 0);
+        if (xProg.lCurrent != (int32_t)ulSector)
+        {
+            prvStreamClose();
+            xProg.lCurrent = (int32_t)ulSector;
+        }
+        xFresh = ((xProg.ulTouched[ulSector / 32U] & (1UL << (ulSector % 32U))) == 0U);
+        xProg.ulTouched[ulSector / 32U] |= (1UL << (ulSector % 32U));
+        taskEXIT_CRITICAL();
+
+        // bytes the file does not cover read as erased flash
+        if (xFresh)
+        {
+            memset(xProg.pucImage + (ulSector * PROG_SECTOR_SIZE), 0xFF, PROG_SECTOR_SIZE);
+        }
+        memcpy(prvImage(ulAddr), puc, xCopy);
+        if (ulSector < xProg.ulLow)
+            xProg.ulLow = ulSector;
+        if (ulSector > xProg.ulHigh)
+            xProg.ulHigh = ulSector;
+        if (xClosed)
+        {
+            xTaskNotify(xProg.xTask, PROG_EVENT_DATA, eSetBits);
+        }
+        ulAddr += xCopy;
+        puc += xCopy;
+        xLen -= xCopy;
+    }
+    return pdPASS;
+}
+
+/// @brief close the stream
+/// @param xOk : false if the file was malformed, nothing more is programmed
+void vProgStreamEnd(bool xOk)
+{
+    if (!xProg.xStream)
+    {
+        return;
+    }
+    taskENTER_CRITICAL();
+    if (!xOk)
+    {
+        memset(xProg.ulPending, 0x00, sizeof(xProg.ulPending));
+        xProg.lCurrent = -1;
+        xProg.xStreamError = true;
+    }
+    prvStreamClose();
+    xProg.xStreamEnd = true;
+    taskEXIT_CRITICAL();
+    xTaskNotify(xProg.xTask, PROG_EVENT_DATA, eSetBits);
+}
+
+/// @brief check for an open stream
+/// @return true while a stream is open and takes data
+bool xProgStreamActive(void)
+{
+    return xProg.xStream && !xProg.xStreamEnd;
+}
+
+/// @brief get the programmer state
+/// @param px : output
+void vProgStatus(prog_status_t * px)
+{
+    *px = xProg.xStatus;
+}
+
+/*-----------------------------------------------------------*/
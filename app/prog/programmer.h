@@ -0,0 +1,153 @@
+#ifndef PROGRAMMER_H_
+#define PROGRAMMER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "imageParser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Stand-alone programmer: an image is staged once in psram and checked with
+ * its crc32, then every trigger (cli "prog run" or the button) flashes it into
+ * the connected target without a host.
+ *
+ * The flash is written by the target's own boot rom (RP2040 / RP2350): the
+ * rom functions are called through the debug registers, the image goes into
+ * two target RAM buffers so the next chunk is transferred while the previous
+ * one is programmed.
+ *
+ * A stream (drag and drop) programs the target sector by sector while the file
+ * is still arriving; once it is through, the file is the staged image.
+ *
+ * Delta mode: the target computes a crc32 of every flash sector first, only
+ * sectors that differ from the image are erased and programmed.
+ * The staging area mirrors the target flash from PROG_FLASH_BASE.
+ */
+
+/* programmer task name */
+#define PROG_TASK_NAME          "prog"
+/* programmer task stack size(32-bit word) */
+#define PROG_TASK_STACK_SIZE    512U
+
+/* start button: active low, internal pull-up */
+#ifndef PROG_BUTTON_PIN
+    #define PROG_BUTTON_PIN     21
+#endif
+/* button triggers are ignored for this long after a run (ms) */
+#define PROG_BUTTON_HOLDOFF_MS  300U
+
+/* flash window of the target (XIP) */
+#define PROG_FLASH_BASE         0x10000000UL
+/* flash erase and program granularity */
+#define PROG_SECTOR_SIZE        4096U
+#define PROG_PAGE_SIZE          256U
+
+/* target RAM used while programming */
+#define PROG_RAM_BASE           0x20000000UL
+/* bytes handed to one flash_range_program call */
+#define PROG_CHUNK_SIZE         0x4000U
+
+/* result of the last run */
+typedef enum prog_result_t
+{
+    PROG_RESULT_NONE = 0,       // nothing run yet
+    PROG_RESULT_BUSY,           // running
+    PROG_RESULT_PASS,
+    PROG_RESULT_FAIL
+} prog_result_t;
+
+/* programmer state, for display */
+typedef struct prog_status_t
+{
+    bool xImageValid;           // staged and crc checked
+    uint32_t ulImageAddr;       // target flash address
+    uint32_t ulImageSize;       // bytes
+    uint32_t ulImageCrc;        // crc32
+    bool xVerify;               // read back after programming
+    bool xDelta;                // leave sectors alone that hold the image already
+    prog_result_t eResult;      // last run
+    const char * pcError;       // step that failed in the last run
+    uint32_t ulLastMs;          // duration of the last run
+    uint32_t ulSkipped;         // unchanged sectors in the last run
+    uint32_t ulPassed;          // runs since boot
+    uint32_t ulFailed;
+} prog_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief set up the image store and the start button
+void vProgInit(void);
+
+/// @brief programmer thread
+/// @param pv : unused
+void vProgTask(void * pv);
+
+/// @brief start staging a new image, the previous one is dropped
+/// @param ulAddr : target flash address (sector aligned)
+/// @param ulSize : image bytes
+/// @return pdPASS : ready for data; pdFAIL : bad address or too large
+BaseType_t xProgImageBegin(uint32_t ulAddr, uint32_t ulSize);
+
+/// @brief store image data
+/// @param ulOffset : offset in the image
+/// @param puc : data
+/// @param xLen : bytes
+/// @return pdPASS : stored; pdFAIL : out of the image
+BaseType_t xProgImageWrite(uint32_t ulOffset, const uint8_t * puc, size_t xLen);
+
+/// @brief check the staged image and arm the programmer
+/// @param ulCrc : expected crc32 of the image
+/// @return pdPASS : image valid; pdFAIL : crc mismatch
+BaseType_t xProgImageCommit(uint32_t ulCrc);
+
+/// @brief read back after programming or not
+/// @param xVerify : true to verify
+void vProgSetVerify(bool xVerify);
+
+/// @brief skip sectors whose flash content matches the image or not
+/// @param xDelta : true to compare first
+void vProgSetDelta(bool xDelta);
+
+/// @brief start a run
+/// @return pdPASS : started; pdFAIL : no valid image or already running
+BaseType_t xProgStart(void);
+
+/// @brief open a stream: the target is programmed sector by sector while the file arrives
+/// @param eFormat : file format, a raw image (IMAGE_FORMAT_BIN) ends when the data stops, any other
+///                  stream is closed with vProgStreamEnd and fails if the data stops first
+/// @return pdPASS : open; pdFAIL : busy
+BaseType_t xProgStreamBegin(image_format_t eFormat);
+
+/// @brief stage stream data, a sector is programmed once the data moves past it
+/// @param ulAddr : target flash address
+/// @param puc : data
+/// @param xLen : bytes
+/// @return pdPASS : stored; pdFAIL : no open stream or outside the flash window
+BaseType_t xProgStreamWrite(uint32_t ulAddr, const uint8_t * puc, size_t xLen);
+
+/// @brief close the stream
+/// @param xOk : false if the file was malformed, nothing more is programmed
+void vProgStreamEnd(bool xOk);
+
+/// @brief check for an open stream
+/// @return true while a stream is open and takes data
+bool xProgStreamActive(void);
+
+/// @brief get the programmer state
+/// @param px : output
+void vProgStatus(prog_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PROGRAMMER_H_ */
@@ -0,0 +1,325 @@
+#include <string.h>
+#include "semihost.h"
+#include "target/target.h"
+#include "rp2350.h"
+
+/*-----------------------------------------------------------*/
+
+/* BKPT 0xAB */
+#define SEMI_BKPT               0xBEABU
+/* DFSR: halted on a breakpoint instruction */
+#define SEMI_DFSR_BKPT          (1UL << 1)
+
+/* operations in r0 */
+#define SEMI_SYS_OPEN           0x01U
+#define SEMI_SYS_WRITEC         0x03U
+#define SEMI_SYS_WRITE0         0x04U
+#define SEMI_SYS_WRITE          0x05U
+#define SEMI_SYS_ISTTY          0x09U
+#define SEMI_SYS_CLOCK          0x10U
+#define SEMI_SYS_TIME           0x11U
+
+/* console handles, SYS_OPEN ":tt" with mode 0-3, 4-7, 8-11 */
+#define SEMI_HANDLE_STDIN       1U
+#define SEMI_HANDLE_STDOUT      2U
+#define SEMI_HANDLE_STDERR      3U
+
+/* r0, r1, pc */
+#define SEMI_REGS               3U
+
+/* service state */
+typedef struct semi_state_t
+{
+    const semi_t * pxInterface;
+    TaskHandle_t xTask;
+    semi_status_t xStatus;
+    bool xPassed;               // the current halt is left to a host
+    uint64_t ullStartUs;        // SYS_CLOCK origin
+    uint64_t ullEpochUs;        // uptime when ulEpoch was set
+    uint32_t ulEpoch;
+    uint8_t ucChunk[SEMI_CHUNK_SIZE];
+} semi_state_t;
+
+static semi_state_t xSemi;
+
+/*-----------------------------------------------------------*/
+
+/// @brief copy target memory to the console
+/// @param ulAddr : address
+/// @param ulLen : bytes
+/// @return acknowledge
+static uint8_t prvSemiOut(uint32_t ulAddr, uint32_t ulLen)
+{
+    while (ulLen != 0U)
+    {
+        uint32_t ulChunk = (ulLen < SEMI_CHUNK_SIZE) ? ulLen : SEMI_CHUNK_SIZE;
+
+        TARGET_TRY(ucTargetReadMem(ulAddr, xSemi.ucChunk, ulChunk));
+        (void)xSemi.pxInterface->w(xSemi.ucChunk, (int)ulChunk);
+        xSemi.xStatus.ulBytes += ulChunk;
+        ulAddr += ulChunk;
+        ulLen -= ulChunk;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief copy a zero terminated string to the console
+/// @param ulAddr : address
+/// @return acknowledge
+static uint8_t prvSemiString(uint32_t ulAddr)
+{
+    for (uint32_t ulDone = 0U; ulDone < SEMI_STRING_MAX; )
+    {
+        // never read across a chunk boundary, memory past the string may not exist
+        uint32_t ulChunk = SEMI_CHUNK_SIZE - (ulAddr % SEMI_CHUNK_SIZE);
+        const uint8_t * pucEnd;
+
+        TARGET_TRY(ucTargetReadMem(ulAddr, xSemi.ucChunk, ulChunk));
+        pucEnd = (const uint8_t *)memchr(xSemi.ucChunk, 0, ulChunk);
+        if (pucEnd != NULL)
+        {
+            ulChunk = (uint32_t)(pucEnd - xSemi.ucChunk);
+        }
+        if (ulChunk != 0U)
+        {
+            (void)xSemi.pxInterface->w(xSemi.ucChunk, (int)ulChunk);
+            xSemi.xStatus.ulBytes += ulChunk;
+        }
+        if (pucEnd != NULL)
+        {
+            break;
+        }
+        ulAddr += ulChunk;
+        ulDone += ulChunk;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief service one call
+/// @param ulOp : r0
+/// @param ulParam : r1
+/// @param pulResult : r0 to return
+/// @param pxServiced : false when the call is left to a host
+/// @return acknowledge
+static uint8_t prvSemiCall(uint32_t ulOp, uint32_t ulParam, uint32_t * pulResult, bool * pxServiced)
+{
+    uint32_t ulBlock[3];
+    char cName[4];
+
+    *pulResult = ulOp;
+    *pxServiced = true;
+    switch (ulOp)
+    {
+    case SEMI_SYS_OPEN:
+        // name, mode, name length
+        TARGET_TRY(ucTargetReadMem(ulParam, (uint8_t *)ulBlock, 12U));
+        *pxServiced = false;
+        if ((ulBlock[2] == 3U) && (ulBlock[1] < 12U))
+        {
+            TARGET_TRY(ucTargetReadMem(ulBlock[0], (uint8_t *)cName, 3U));
+            if (memcmp(cName, ":tt", 3U) == 0)
+            {
+                *pulResult = (ulBlock[1] < 4U) ? SEMI_HANDLE_STDIN : ((ulBlock[1] < 8U) ? SEMI_HANDLE_STDOUT : SEMI_HANDLE_STDERR);
+                *pxServiced = true;
+            }
+        }
+        break;
+
+    case SEMI_SYS_WRITEC:
+        TARGET_TRY(prvSemiOut(ulParam, 1U));
+        break;
+
+    case SEMI_SYS_WRITE0:
+        TARGET_TRY(prvSemiString(ulParam));
+        break;
+
+    case SEMI_SYS_WRITE:
+        // handle, buffer, length; r0 = bytes not written
+        TARGET_TRY(ucTargetReadMem(ulParam, (uint8_t *)ulBlock, 12U));
+        if ((ulBlock[0] != SEMI_HANDLE_STDOUT) && (ulBlock[0] != SEMI_HANDLE_STDERR))
+        {
+            *pxServiced = false;
+            break;
+        }
+        // a bad length must not keep the link busy, the caller retries the rest
+        *pulResult = (ulBlock[2] > SEMI_WRITE_MAX) ? (ulBlock[2] - SEMI_WRITE_MAX) : 0U;
+        TARGET_TRY(prvSemiOut(ulBlock[1], ulBlock[2] - *pulResult));
+        break;
+
+    case SEMI_SYS_ISTTY:
+        TARGET_TRY(ucTargetReadMem(ulParam, (uint8_t *)ulBlock, 4U));
+        *pxServiced = (ulBlock[0] >= SEMI_HANDLE_STDIN) && (ulBlock[0] <= SEMI_HANDLE_STDERR);
+        *pulResult = 1U;
+        break;
+
+    case SEMI_SYS_CLOCK:
+        // centiseconds
+        *pulResult = (uint32_t)((time_us_64() - xSemi.ullStartUs) / 10000U);
+        break;
+
+    case SEMI_SYS_TIME:
+        *pulResult = xSemi.ulEpoch + (uint32_t)((time_us_64() - xSemi.ullEpochUs) / 1000000U);
+        break;
+
+    default:
+        *pxServiced = false;
+        break;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief enable halting debug, without it BKPT escalates to HardFault
+/// @return acknowledge
+static uint8_t prvSemiEnable(void)
+{
+    uint32_t ulData;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulData));
+    if ((ulData & TARGET_DHCSR_C_DEBUGEN) == 0U)
+    {
+        // keep the control bits, a halted core stays halted
+        TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN |
+                                                   (ulData & (TARGET_DHCSR_C_HALT | TARGET_DHCSR_C_MASKINTS))));
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief one poll: service a pending call
+/// @param pxCalled : true when a call was serviced
+/// @return acknowledge
+static uint8_t prvSemiPoll(bool * pxCalled)
+{
+    static const uint8_t ucReg[SEMI_REGS] = { 0U, 1U, TARGET_REG_PC };
+    uint32_t ulReg[SEMI_REGS];
+    uint32_t ulData, ulResult;
+    uint16_t usInsn;
+    bool xServiced;
+
+    *pxCalled = false;
+    if (!xSemi.xStatus.xLinkUp)
+    {
+        TARGET_TRY(ucTargetAttach());
+        TARGET_TRY(prvSemiEnable());
+        xSemi.xStatus.xLinkUp = true;
+    }
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulData));
+    if ((ulData & TARGET_DHCSR_S_HALT) == 0U)
+    {
+        xSemi.xPassed = false;
+        return DAP_TRANSFER_OK;
+    }
+    if (xSemi.xPassed)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    // a halt that is not ours is looked at once only, until the core runs again
+    TARGET_TRY(ucTargetReadWord(TARGET_DFSR, &ulData));
+    if ((ulData & SEMI_DFSR_BKPT) == 0U)
+    {
+        xSemi.xPassed = true;
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(ucTargetReadRegs(ucReg, SEMI_REGS, ulReg));
+    TARGET_TRY(ucTargetReadMem(ulReg[2], (uint8_t *)&usInsn, 2U));
+    if (usInsn != SEMI_BKPT)
+    {
+        xSemi.xPassed = true;
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(prvSemiCall(ulReg[0], ulReg[1], &ulResult, &xServiced));
+    if (!xServiced)
+    {
+        xSemi.xPassed = true;
+        xSemi.xStatus.ulPassed += 1U;
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(ucTargetWriteReg(0U, ulResult));
+    TARGET_TRY(ucTargetWriteReg(TARGET_REG_PC, ulReg[2] + 2U));
+    // DFSR is write-one-to-clear, a stale BKPT bit would make the next halt look like a call
+    TARGET_TRY(ucTargetWriteWord(TARGET_DFSR, SEMI_DFSR_BKPT));
+    TARGET_TRY(ucTargetResume());
+    xSemi.xStatus.ulCalls += 1U;
+    *pxCalled = true;
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief semihosting thread
+/// @param pv : semihosting task interface
+void vSemiTask(void * pv)
+{
+    uint32_t ulBurst = 0U;
+    bool xCalled;
+    uint8_t ucAck;
+
+    xSemi.pxInterface = (const semi_t *)pv;
+    xSemi.xTask = xTaskGetCurrentTaskHandle();
+
+    do
+    {
+        // right after a call the next one is close, poll again without sleeping
+        if (ulBurst == 0U)
+        {
+            (void)xTaskNotifyWait(0U, 0xFFFFFFFFUL, NULL, xSemi.xStatus.xRunning ? pdMS_TO_TICKS(SEMI_POLL_MS) : portMAX_DELAY);
+        }
+        else
+        {
+            taskYIELD();
+        }
+        if (!xSemi.xStatus.xRunning)
+        {
+            ulBurst = 0U;
+            continue;
+        }
+        vTargetAcquire();
+        ucAck = prvSemiPoll(&xCalled);
+        vTargetRelease();
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            // attach again at the next poll, only a DPIDR read while the host owns the port
+            xSemi.xStatus.xLinkUp = false;
+            xCalled = false;
+        }
+        ulBurst = (xCalled && (ulBurst < (SEMI_BURST - 1U))) ? (ulBurst + 1U) : 0U;
+    } while (true);
+}
+
+/// @brief switch the service on or off
+/// @param xRun : true to service calls
+void vSemiRun(bool xRun)
+{
+    if (xRun && !xSemi.xStatus.xRunning)
+    {
+        xSemi.ullStartUs = time_us_64();
+        xSemi.xStatus.ulCalls = 0U;
+        xSemi.xStatus.ulBytes = 0U;
+        xSemi.xStatus.ulPassed = 0U;
+        xSemi.xPassed = false;
+        // connect and enable halting debug with the first poll
+        xSemi.xStatus.xLinkUp = false;
+    }
+    xSemi.xStatus.xRunning = xRun;
+    if (xSemi.xTask != NULL)
+    {
+        xTaskNotify(xSemi.xTask, 0U, eNoAction);
+    }
+}
+
+/// @brief set the time SYS_TIME reports
+/// @param ulEpoch : seconds since 1970-01-01 00:00:00 UTC
+void vSemiSetTime(uint32_t ulEpoch)
+{
+    xSemi.ullEpochUs = time_us_64();
+    xSemi.ulEpoch = ulEpoch;
+}
+
+/// @brief get the service state
+/// @param px : output
+void vSemiStatus(semi_status_t * px)
+{
+    *px = xSemi.xStatus;
+    px->ulTime = xSemi.ulEpoch + (uint32_t)((time_us_64() - xSemi.ullEpochUs) / 1000000U);
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,96 @@
+#ifndef SEMIHOST_H_
+#define SEMIHOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Semihosting service: while on, the probe polls DHCSR every SEMI_POLL_MS.
+ * When the core halts on a breakpoint (DFSR BKPT) at a BKPT 0xAB, the
+ * call in r0 is serviced by the probe and the core resumes at once, no
+ * host debugger round trip involved:
+ *
+ *      SYS_OPEN    ":tt" only, gives the console handles
+ *      SYS_WRITEC  SYS_WRITE0  SYS_WRITE (console handles)
+ *      SYS_ISTTY   SYS_CLOCK   SYS_TIME
+ *
+ * Console output goes to the write function of the task interface (a cdc
+ * port). Any other call, or a write to another handle, leaves the core
+ * halted for a host debugger to service.
+ *
+ * SYS_CLOCK counts from the moment the service was switched on. SYS_TIME
+ * counts from the epoch given with vSemiSetTime(), from 0 otherwise.
+ *
+ * A call is serviced in one link session. A dap host request that comes in
+ * meanwhile still gets in between two blocks and may see the core halted
+ * on the BKPT.
+ */
+
+/* semihosting task name */
+#define SEMI_TASK_NAME          "semi"
+/* semihosting task stack size(32-bit word) */
+#define SEMI_TASK_STACK_SIZE    256U
+
+/* DHCSR poll period while no call came in (ms) */
+#define SEMI_POLL_MS            1U
+/* calls serviced back to back before the task sleeps one poll period */
+#define SEMI_BURST              64U
+/* console bytes read from the target at once */
+#define SEMI_CHUNK_SIZE         256U
+/* longest SYS_WRITE0 string */
+#define SEMI_STRING_MAX         4096U
+/* most bytes of one SYS_WRITE, the rest is returned as not written */
+#define SEMI_WRITE_MAX          4096U
+
+/* Prototype of the console write function: buffer, size */
+typedef int (* SemiWrite_t)(uint8_t *, int);
+
+/* semihosting task interface */
+typedef struct semi_t
+{
+    SemiWrite_t w;
+} semi_t;
+
+/* service state, for display */
+typedef struct semi_status_t
+{
+    bool xRunning;
+    bool xLinkUp;               // target reachable at the last poll
+    uint32_t ulCalls;           // calls serviced since switched on
+    uint32_t ulBytes;           // console bytes written
+    uint32_t ulPassed;          // calls left to a host debugger
+    uint32_t ulTime;            // what SYS_TIME returns now
+} semi_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief semihosting thread
+/// @param pv : semihosting task interface
+void vSemiTask(void * pv);
+
+/// @brief switch the service on or off
+/// @param xRun : true to service calls
+void vSemiRun(bool xRun);
+
+/// @brief set the time SYS_TIME reports
+/// @param ulEpoch : seconds since 1970-01-01 00:00:00 UTC
+void vSemiSetTime(uint32_t ulEpoch);
+
+/// @brief get the service state
+/// @param px : output
+void vSemiStatus(semi_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SEMIHOST_H_ */
@@ -0,0 +1,458 @@
+#include <string.h>
+#include "swclkTune.h"
+#include "target.h"
+#include "dap/DAP_config.h"
+#include "probe.h"
+
+/*-----------------------------------------------------------*/
+
+/* DPIDR read request */
+#define SWCLK_DPIDR_READ        (0x00U | DAP_TRANSFER_RnW)
+
+/* tuner state */
+typedef struct swclk_tune_t
+{
+    swclk_tune_status_t xStatus;
+    bool xTuning;                       // connects leave the clock alone
+    bool xRam;
+    uint32_t ulRamAddr;
+    uint32_t ulDpidr;                   // reference of the target tuned
+    uint32_t ulNext;                    // entry replaced when the cache is full
+    swclk_tune_entry_t xEntry[SWCLK_TUNE_ENTRIES];
+    uint32_t ulSaved[SWCLK_TUNE_WORDS]; // target RAM content
+    uint32_t ulPattern[SWCLK_TUNE_WORDS];
+    uint32_t ulRead[SWCLK_TUNE_WORDS];
+} swclk_tune_t;
+
+static swclk_tune_t xTune = { .xStatus = { .xAuto = true } };
+
+/*-----------------------------------------------------------*/
+
+/// @brief set the clock, the swd engine takes it with its next transfer
+/// @param ulDelay : clock_delay
+static void prvSwclkSet(uint32_t ulDelay)
+{
+    DAP_Data.fast_clock = 0U;
+    DAP_Data.clock_delay = ulDelay;
+}
+
+/// @brief SWDIO sample point in use
+/// @return sample point, 0 without the pio engine
+static uint32_t prvSwclkSampleGet(void)
+{
+#if (USE_PIO_SWD == 0)
+    return probe_get_sample();
+#else
+    return 0U;
+#endif
+}
+
+/// @brief set the SWDIO sample point, the next read takes it
+/// @param ulPoint : sample point
+/// @return true when set
+static bool prvSwclkSampleSet(uint32_t ulPoint)
+{
+#if (USE_PIO_SWD == 0)
+    return probe_set_sample(xprobeHandle.pio, xprobeHandle.pinBase, ulPoint);
+#else
+    (void)ulPoint;
+    return false;
+#endif
+}
+
+/// @brief RAM words of a round: walking ones on even words, a scrambled count on odd ones
+/// @param ulRound : round
+static void prvSwclkPattern(uint32_t ulRound)
+{
+    for (uint32_t i = 0U; i < SWCLK_TUNE_WORDS; i++)
+    {
+        xTune.ulPattern[i] = ((i & 1U) == 0U) ? (1UL << ((i + ulRound) & 31U))
+                                              : (0xAAAAAAAAUL ^ ((i + (ulRound * SWCLK_TUNE_WORDS)) * 0x9E3779B9UL));
+    }
+}
+
+/// @brief connect at a clock and run the stress pattern
+/// @param ulDelay : clock_delay
+/// @param ulRounds : DPIDR reads and RAM rounds
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when data came back wrong
+static uint8_t prvSwclkStress(uint32_t ulDelay, uint32_t ulRounds)
+{
+    uint32_t ulData;
+
+    prvSwclkSet(ulDelay);
+    TARGET_TRY(ucTargetConnect(&ulData));
+    if (ulData != xTune.ulDpidr)
+    {
+        return DAP_TRANSFER_MISMATCH;
+    }
+    for (uint32_t r = 0U; r < ulRounds; r++)
+    {
+        TARGET_TRY(ucTargetTransfer(SWCLK_DPIDR_READ, &ulData));
+        if (ulData != xTune.ulDpidr)
+        {
+            return DAP_TRANSFER_MISMATCH;
+        }
+    }
+    for (uint32_t r = 0U; xTune.xRam && (r < ulRounds); r++)
+    {
+        prvSwclkPattern(r);
+        TARGET_TRY(ucTargetWriteBlock(xTune.ulRamAddr, xTune.ulPattern, SWCLK_TUNE_WORDS));
+        TARGET_TRY(ucTargetReadBlock(xTune.ulRamAddr, xTune.ulRead, SWCLK_TUNE_WORDS));
+        if (memcmp(xTune.ulPattern, xTune.ulRead, sizeof(xTune.ulRead)) != 0)
+        {
+            return DAP_TRANSFER_MISMATCH;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief one search step
+/// @param ulDelay : clock_delay
+/// @param ulRounds : DPIDR reads and RAM rounds
+/// @return true when the clock passed
+static bool prvSwclkStep(uint32_t ulDelay, uint32_t ulRounds)
+{
+    bool xPass = (prvSwclkStress(ulDelay, ulRounds) == DAP_TRANSFER_OK);
+
+    xTune.xStatus.ulSteps += 1U;
+    xTune.xStatus.ulFailed += xPass ? 0U : 1U;
+    return xPass;
+}
+
+/// @brief put a result into the cache
+/// @param px : result
+static void prvSwclkCache(const swclk_tune_entry_t * px)
+{
+    uint32_t i;
+
+    for (i = 0U; i < xTune.xStatus.ulEntries; i++)
+    {
+        if ((xTune.xEntry[i].ulDpidr == px->ulDpidr) && (xTune.xEntry[i].ulTargetId == px->ulTargetId))
+        {
+            break;
+        }
+    }
+    if (i == xTune.xStatus.ulEntries)
+    {
+        if (xTune.xStatus.ulEntries < SWCLK_TUNE_ENTRIES)
+        {
+            xTune.xStatus.ulEntries += 1U;
+        }
+        else
+        {
+            i = xTune.ulNext;
+            xTune.ulNext = (xTune.ulNext + 1U) % SWCLK_TUNE_ENTRIES;
+        }
+    }
+    xTune.xEntry[i] = *px;
+}
+
+/// @brief back to a clock known to work and put the RAM content back,
+///        on every exit once it is saved
+/// @param ulDelay : clock_delay
+/// @return acknowledge
+static uint8_t prvSwclkRestore(uint32_t ulDelay)
+{
+    prvSwclkSet(ulDelay);
+    TARGET_TRY(ucTargetConnect(NULL));
+    if (xTune.xRam)
+    {
+        TARGET_TRY(ucTargetWriteBlock(xTune.ulRamAddr, xTune.ulSaved, SWCLK_TUNE_WORDS));
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief the binary search and the margin, the references are taken
+/// @param ulStart : clock_delay in use, the slowest clock tried
+/// @param px : result output
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when the clock in use fails
+static uint8_t prvSwclkBisect(uint32_t ulStart, swclk_tune_entry_t * px)
+{
+    uint32_t ulLow = SWCLK_TUNE_DELAY_MIN;
+    uint32_t ulHigh = ulStart;
+    uint32_t ulDelay;
+
+    if (!prvSwclkStep(ulStart, SWCLK_TUNE_ROUNDS))
+    {
+        return DAP_TRANSFER_MISMATCH;
+    }
+    // the fastest passing clock, assuming every slower one passes too
+    while (ulLow < ulHigh)
+    {
+        uint32_t ulMid = ulLow + ((ulHigh - ulLow) / 2U);
+
+        if (prvSwclkStep(ulMid, SWCLK_TUNE_ROUNDS))
+        {
+            ulHigh = ulMid;
+        }
+        else
+        {
+            ulLow = ulMid + 1U;
+        }
+    }
+    px->ulFastest = ulHigh;
+    // the margin, then halve the clock until the longer pattern passes
+    ulDelay = ((((ulHigh + 1U) * (100U + SWCLK_TUNE_MARGIN_PCT)) + 99U) / 100U) - 1U;
+    while ((ulDelay < ulStart) && !prvSwclkStep(ulDelay, SWCLK_TUNE_ROUNDS * SWCLK_TUNE_VERIFY))
+    {
+        ulDelay = (ulDelay * 2U) + 1U;
+    }
+    if (ulDelay > ulStart)
+    {
+        ulDelay = ulStart;
+    }
+    px->ulDelay = ulDelay;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief the search, the link is held
+/// @param ulStart : clock_delay in use, the slowest clock tried
+/// @param px : result output
+/// @return acknowledge
+static uint8_t prvSwclkSearch(uint32_t ulStart, swclk_tune_entry_t * px)
+{
+    uint8_t ucAck, ucRestore;
+
+    // references at the clock in use
+    prvSwclkSet(ulStart);
+    TARGET_TRY(ucTargetConnect(&xTune.ulDpidr));
+    TARGET_TRY(ucTargetReadTargetId(xTune.ulDpidr, &px->ulTargetId));
+    px->ulDpidr = xTune.ulDpidr;
+    if (xTune.xRam)
+    {
+        TARGET_TRY(ucTargetReadBlock(xTune.ulRamAddr, xTune.ulSaved, SWCLK_TUNE_WORDS));
+    }
+    ucAck = prvSwclkBisect(ulStart, px);
+    ucRestore = prvSwclkRestore((ucAck == DAP_TRANSFER_OK) ? px->ulDelay : ulStart);
+    return (ucAck != DAP_TRANSFER_OK) ? ucAck : ucRestore;
+}
+
+#if (USE_PIO_SWD == 0)
+/// @brief the sample point calibration, the link is held
+/// @param ulDelay : clock_delay in use
+/// @param px : result output
+/// @return acknowledge
+static uint8_t prvSwclkEye(uint32_t ulDelay, swclk_sample_t * px)
+{
+    uint32_t ulStart = prvSwclkSampleGet();
+    uint32_t ulTargetId;
+    uint32_t ulRun = 0U, ulBest = 0U, ulEnd = 0U;
+
+    // references at the point in use
+    prvSwclkSet(ulDelay);
+    TARGET_TRY(ucTargetConnect(&xTune.ulDpidr));
+    TARGET_TRY(ucTargetReadTargetId(xTune.ulDpidr, &ulTargetId));
+    if (xTune.xRam)
+    {
+        TARGET_TRY(ucTargetReadBlock(xTune.ulRamAddr, xTune.ulSaved, SWCLK_TUNE_WORDS));
+    }
+    // every point in time order, the eye is the longest run that passes
+    for (uint32_t p = 0U; p < PROBE_SAMPLE_POINTS; p++)
+    {
+        (void)prvSwclkSampleSet(p);
+        if (prvSwclkStep(ulDelay, SWCLK_TUNE_ROUNDS))
+        {
+            px->ulPass |= 1UL << p;
+            ulRun += 1U;
+            if (ulRun > ulBest)
+            {
+                ulBest = ulRun;
+                ulEnd = p;
+            }
+        }
+        else
+        {
+            ulRun = 0U;
+        }
+    }
+    xTune.xStatus.ulEye = px->ulPass;
+    // its middle, the later one of two; the point in use when none passed
+    px->ulPoint = (ulBest == 0U) ? ulStart : (ulEnd - ((ulBest - 1U) / 2U));
+    (void)prvSwclkSampleSet(px->ulPoint);
+    TARGET_TRY(prvSwclkRestore(ulDelay));
+    if (ulBest == 0U)
+    {
+        return DAP_TRANSFER_MISMATCH;
+    }
+    // a point only holds for the clock it was found at
+    for (uint32_t i = 0U; i < xTune.xStatus.ulEntries; i++)
+    {
+        if ((xTune.xEntry[i].ulDpidr == xTune.ulDpidr) && (xTune.xEntry[i].ulTargetId == ulTargetId) &&
+            (xTune.xEntry[i].ulDelay == ulDelay))
+        {
+            xTune.xEntry[i].ulSample = px->ulPoint;
+            px->xCached = true;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+/// @brief search the fastest reliable clock of the connected target and cache it
+/// @param xRam : run the RAM pattern as well
+/// @param ulRamAddr : target RAM for the pattern, SWCLK_TUNE_WORDS words (word aligned)
+/// @param px : result output
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when the clock in use fails the pattern
+uint8_t ucSwclkTune(bool xRam, uint32_t ulRamAddr, swclk_tune_entry_t * px)
+{
+    uint32_t ulStart, ulFast;
+    uint8_t ucAck;
+
+    // the whole search in one hold of the link, the host must not see the trial clocks
+    vTargetLock();
+    vTargetClaim();
+    ulStart = DAP_Data.clock_delay;
+    ulFast = DAP_Data.fast_clock;
+    xTune.xTuning = true;
+    xTune.xRam = xRam;
+    xTune.ulRamAddr = ulRamAddr & ~3UL;
+    xTune.xStatus.ulSteps = 0U;
+    xTune.xStatus.ulFailed = 0U;
+    memset(px, 0, sizeof(*px));
+    px->ulSample = prvSwclkSampleGet();
+    ucAck = prvSwclkSearch((ulStart < SWCLK_TUNE_DELAY_MIN) ? SWCLK_TUNE_DELAY_MIN : ulStart, px);
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        prvSwclkCache(px);
+    }
+    // the host's link state goes back at the host's clock
+    DAP_Data.clock_delay = ulStart;
+    DAP_Data.fast_clock = ulFast;
+    xTune.xTuning = false;
+    vTargetUnlock();
+    return ucAck;
+}
+
+/// @brief find the middle of the SWDIO eye of the connected target on the clock in use
+/// @param xRam : run the RAM pattern as well
+/// @param ulRamAddr : target RAM for the pattern, SWCLK_TUNE_WORDS words (word aligned)
+/// @param px : result output
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when no point passes, DAP_TRANSFER_ERROR without the pio engine
+uint8_t ucSwclkSample(bool xRam, uint32_t ulRamAddr, swclk_sample_t * px)
+{
+    memset(px, 0, sizeof(*px));
+#if (USE_PIO_SWD == 0)
+    uint32_t ulStart, ulFast;
+    uint8_t ucAck;
+
+    vTargetLock();
+    vTargetClaim();
+    ulStart = DAP_Data.clock_delay;
+    ulFast = DAP_Data.fast_clock;
+    xTune.xTuning = true;
+    xTune.xRam = xRam;
+    xTune.ulRamAddr = ulRamAddr & ~3UL;
+    xTune.xStatus.ulSteps = 0U;
+    xTune.xStatus.ulFailed = 0U;
+    px->ulDelay = (ulStart < SWCLK_TUNE_DELAY_MIN) ? SWCLK_TUNE_DELAY_MIN : ulStart;
+    ucAck = prvSwclkEye(px->ulDelay, px);
+    DAP_Data.clock_delay = ulStart;
+    DAP_Data.fast_clock = ulFast;
+    xTune.xTuning = false;
+    vTargetUnlock();
+    // the session end put the host's point back, the one found is the host's from now on
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        (void)xSwclkSampleSet(px->ulPoint);
+    }
+    return ucAck;
+#else
+    // the bit-bang engine samples where its port read lands
+    (void)xRam;
+    (void)ulRamAddr;
+    return DAP_TRANSFER_ERROR;
+#endif
+}
+
+/// @brief set the SWDIO sample point by hand
+/// @param ulPoint : sample point
+/// @return pdPASS : set; pdFAIL : no such point or no pio engine
+BaseType_t xSwclkSampleSet(uint32_t ulPoint)
+{
+    bool xSet;
+
+    vTargetLock();
+    xSet = prvSwclkSampleSet(ulPoint);
+    vTargetUnlock();
+    return xSet ? pdPASS : pdFAIL;
+}
+
+/// @brief switch to the cached clock of a target, called by ucTargetConnect()
+/// @param ulDpidr : DPIDR read by the connect
+void vSwclkTuneApply(uint32_t ulDpidr)
+{
+    uint32_t ulTargetId;
+
+    if (!xTune.xStatus.xAuto || xTune.xTuning || (xTune.xStatus.ulEntries == 0U))
+    {
+        return;
+    }
+    if (ucTargetReadTargetId(ulDpidr, &ulTargetId) != DAP_TRANSFER_OK)
+    {
+        return;
+    }
+    for (uint32_t i = 0U; i < xTune.xStatus.ulEntries; i++)
+    {
+        if ((xTune.xEntry[i].ulDpidr == ulDpidr) && (xTune.xEntry[i].ulTargetId == ulTargetId))
+        {
+            prvSwclkSet(xTune.xEntry[i].ulDelay);
+            (void)prvSwclkSampleSet(xTune.xEntry[i].ulSample);
+            xTune.xStatus.ulApplied += 1U;
+            break;
+        }
+    }
+}
+
+/// @brief switch cache lookups on connect on or off
+/// @param xAuto : true to switch to cached clocks
+void vSwclkTuneAuto(bool xAuto)
+{
+    xTune.xStatus.xAuto = xAuto;
+}
+
+/// @brief get a cached target
+/// @param ulIndex : entry
+/// @param px : output
+/// @return pdPASS : got it; pdFAIL : no such entry
+BaseType_t xSwclkTuneEntry(uint32_t ulIndex, swclk_tune_entry_t * px)
+{
+    if (ulIndex >= xTune.xStatus.ulEntries)
+    {
+        return pdFAIL;
+    }
+    *px = xTune.xEntry[ulIndex];
+    return pdPASS;
+}
+
+/// @brief drop all cached targets
+void vSwclkTuneClear(void)
+{
+    xTune.xStatus.ulEntries = 0U;
+    xTune.ulNext = 0U;
+}
+
+/// @brief get the tuner state
+/// @param px : output
+void vSwclkTuneStatus(swclk_tune_status_t * px)
+{
+    *px = xTune.xStatus;
+    px->ulSample = prvSwclkSampleGet();
+}
+
+/// @brief clock of a clock_delay value
+/// @param ulDelay : clock_delay
+/// @return SWCLK (kHz)
+uint32_t ulSwclkTuneKhz(uint32_t ulDelay)
+{
+#if (USE_PIO_SWD == 0)
+    // the pio engine derives its clock divider from clock_delay (sw_dp_pio.c)
+    return CPU_CLOCK / (2000U * (ulDelay + 1U));
+#else
+    // bit-bang: two delay loops and the port writes per clock
+    return (CPU_CLOCK / 2000U) / ((ulDelay * DELAY_SLOW_CYCLES) + IO_PORT_WRITE_CYCLES);
+#endif
+}
+
+/*-----------------------------------------------------------*/
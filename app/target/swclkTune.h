@@ -0,0 +1,143 @@
+#ifndef SWCLK_TUNE_H_
+#define SWCLK_TUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * SWCLK auto-tune: binary search for the fastest clock the link carries
+ * without errors, between SWCLK_TUNE_DELAY_MIN and the clock in use (which
+ * has to work). Every step connects at the candidate clock and runs a
+ * stress pattern:
+ *
+ *      SWCLK_TUNE_ROUNDS DPIDR reads compared with the reference
+ *      SWCLK_TUNE_WORDS words written to target RAM and read back per
+ *      round, when a RAM address is given (its content is put back, the
+ *      target should not use it meanwhile)
+ *
+ * Any acknowledge but OK fails the step, a parity error included. The
+ * clock settled on is the fastest that passed, slowed down by
+ * SWCLK_TUNE_MARGIN_PCT, and has to pass SWCLK_TUNE_VERIFY times the
+ * pattern again. It is cached keyed by DPIDR and TARGETID (0 before DPv2):
+ * ucTargetConnect() switches to the cached clock of the target it found,
+ * for the rest of the service or vendor command session; the host's clock
+ * comes back at its end (target.h). The cache is kept in ram until the
+ * probe restarts.
+ *
+ * Clocks are handled as DAP_Data.clock_delay values, a higher one is
+ * slower. The tune holds the link from start to end, the dap host waits,
+ * and leaves the clock as it found it.
+ *
+ * SWDIO sample point (pio engine only, probe.h): ucSwclkSample() runs the
+ * pattern at each of the PROBE_SAMPLE_POINTS points on the clock in use and
+ * settles on the middle of the longest run that passed, the middle of the
+ * eye. Over long cabling the eye moves past the posedge, a later point lets
+ * the search above reach a faster clock: calibrate, tune, calibrate again
+ * at the clock found. The point is cached with the clock of the target
+ * when the two match and applied with it on connect.
+ */
+
+/* cached targets */
+#define SWCLK_TUNE_ENTRIES      8U
+/* fastest clock tried */
+#define SWCLK_TUNE_DELAY_MIN    1U
+/* DPIDR reads and RAM rounds per step */
+#define SWCLK_TUNE_ROUNDS       64U
+#define SWCLK_TUNE_WORDS        64U
+/* clock period added to the fastest passing one, 25 % gives 80 % of its clock */
+#define SWCLK_TUNE_MARGIN_PCT   25U
+/* pattern repeats on the clock settled on */
+#define SWCLK_TUNE_VERIFY       4U
+
+/* cached clock of a target */
+typedef struct swclk_tune_entry_t
+{
+    uint32_t ulDpidr;
+    uint32_t ulTargetId;
+    uint32_t ulDelay;                   // clock_delay settled on
+    uint32_t ulFastest;                 // clock_delay of the fastest step passed
+    uint32_t ulSample;                  // SWDIO sample point
+} swclk_tune_entry_t;
+
+/* sample point calibration result */
+typedef struct swclk_sample_t
+{
+    uint32_t ulDelay;                   // clock_delay calibrated at
+    uint32_t ulPass;                    // bit per sample point that passed
+    uint32_t ulPoint;                   // point settled on
+    bool xCached;                       // stored in the cache entry of the target
+} swclk_sample_t;
+
+/* tuner state, for display */
+typedef struct swclk_tune_status_t
+{
+    bool xAuto;                         // connects switch to the cached clock
+    uint32_t ulEntries;                 // cached targets
+    uint32_t ulSteps;                   // steps of the last tune
+    uint32_t ulFailed;                  // steps of the last tune that failed
+    uint32_t ulApplied;                 // connects that switched to a cached clock
+    uint32_t ulSample;                  // SWDIO sample point in use
+    uint32_t ulEye;                     // points that passed the last calibration
+} swclk_tune_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief search the fastest reliable clock of the connected target and cache it
+/// @param xRam : run the RAM pattern as well
+/// @param ulRamAddr : target RAM for the pattern, SWCLK_TUNE_WORDS words (word aligned)
+/// @param px : result output
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when the clock in use fails the pattern
+uint8_t ucSwclkTune(bool xRam, uint32_t ulRamAddr, swclk_tune_entry_t * px);
+
+/// @brief find the middle of the SWDIO eye of the connected target on the clock in use
+/// @param xRam : run the RAM pattern as well
+/// @param ulRamAddr : target RAM for the pattern, SWCLK_TUNE_WORDS words (word aligned)
+/// @param px : result output
+/// @return acknowledge, DAP_TRANSFER_MISMATCH when no point passes, DAP_TRANSFER_ERROR without the pio engine
+uint8_t ucSwclkSample(bool xRam, uint32_t ulRamAddr, swclk_sample_t * px);
+
+/// @brief set the SWDIO sample point by hand
+/// @param ulPoint : sample point
+/// @return pdPASS : set; pdFAIL : no such point or no pio engine
+BaseType_t xSwclkSampleSet(uint32_t ulPoint);
+
+/// @brief switch to the cached clock of a target, called by ucTargetConnect()
+/// @param ulDpidr : DPIDR read by the connect
+void vSwclkTuneApply(uint32_t ulDpidr);
+
+/// @brief switch cache lookups on connect on or off
+/// @param xAuto : true to switch to cached clocks
+void vSwclkTuneAuto(bool xAuto);
+
+/// @brief get a cached target
+/// @param ulIndex : entry
+/// @param px : output
+/// @return pdPASS : got it; pdFAIL : no such entry
+BaseType_t xSwclkTuneEntry(uint32_t ulIndex, swclk_tune_entry_t * px);
+
+/// @brief drop all cached targets
+void vSwclkTuneClear(void);
+
+/// @brief get the tuner state
+/// @param px : output
+void vSwclkTuneStatus(swclk_tune_status_t * px);
+
+/// @brief clock of a clock_delay value
+/// @param ulDelay : clock_delay
+/// @return SWCLK (kHz)
+uint32_t ulSwclkTuneKhz(uint32_t ulDelay);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SWCLK_TUNE_H_ */
@@ -0,0 +1,1123 @@
+#include <string.h>
+#include "target.h"
+#include "dap/DAP_config.h"
+#include "dap/dapReadAhead.h"
+#include "swclkTune.h"
+#include "semphr.h"
+
+/*-----------------------------------------------------------*/
+
+/* DP registers */
+#define DP_DPIDR                0x00U
+#define DP_CTRL_STAT            0x04U
+#define DP_TARGETID             0x04U   // bank 2, DPv2
+#define DP_BANK_TARGETID        0x02UL
+
+/* CTRL/STAT power up request and acknowledge */
+#define DP_CTRL_PWRUPREQ        ((1UL << 30) | (1UL << 28))
+#define DP_CTRL_PWRUPACK        ((1UL << 31) | (1UL << 29))
+
+/* ABORT: clear all sticky errors */
+#define DP_ABORT_CLEAR_ALL      0x1EUL
+
+/* MEM-AP registers */
+#define AP_CSW                  0x00U
+#define AP_TAR                  0x04U
+#define AP_DRW                  0x0CU
+#define AP_BD0                  0x10U
+#define AP_BD1                  0x14U
+#define AP_BD2                  0x18U
+
+/* CSW: debug master, HPROT data/privileged, single auto increment */
+#define AP_CSW_BASE             0x23000050UL
+#define AP_CSW_SIZE_8           0x00UL
+#define AP_CSW_SIZE_16          0x01UL
+#define AP_CSW_SIZE_32          0x02UL
+
+/* TAR auto increment is only guaranteed inside 1k */
+#define TAR_PAGE                0x400UL
+
+/* AIRCR: VECTKEY | SYSRESETREQ */
+#define AIRCR_SYSRESETREQ       0x05FA0004UL
+
+/* polls of DHCSR before giving up */
+#define TARGET_POLL_COUNT       100U
+
+/* largest number of comparators handled */
+#define TARGET_MAX_BREAK        16U
+#define TARGET_MAX_WATCH        8U
+
+/* words on the stack for unaligned memory accesses */
+#define TARGET_CHUNK_WORDS      32U
+
+/* swd clock settings a session may change */
+typedef struct target_clock_t
+{
+    uint32_t ulDelay;           // DAP_Data.clock_delay
+    uint32_t ulFast;            // DAP_Data.fast_clock
+    uint32_t ulSample;          // SWDIO sample point (pio engine)
+} target_clock_t;
+
+/* link and debug unit state */
+typedef struct target_t
+{
+    SemaphoreHandle_t xLock;
+    volatile uint32_t ulHostWaiting;    // dap host requests waiting for the link
+    bool xService;              // link held by a service, gives way to the host
+    bool xSession;              // link state to put back for the host
+    bool xHostPort;             // the host connected the debug port (DAP_Connect)
+    bool xHostSelectValid;
+    uint32_t ulHostSelect;      // SELECT at the start of the session
+    target_clock_t xHostClock;  // clock at the start of the session
+    bool xApSaved;              // ulHostCsw and ulHostTar are valid
+    uint32_t ulHostCsw;
+    uint32_t ulHostTar;
+    uint32_t ulAp;              // SELECT value of the MEM-AP, bank 0
+    bool xCswValid;
+    uint32_t ulCsw;             // CSW in the target
+    bool xUnitsKnown;           // FPB and DWT probed
+    uint32_t ulFpbRev;          // 0: FPBv1; 1: FPBv2
+    uint32_t ulNumBreak;
+    uint32_t ulNumWatch;
+    bool xDwtV8;                // ARMv8-M DWT function encoding
+    uint32_t ulBreak[TARGET_MAX_BREAK];     // address | 1 when in use
+    uint32_t ulWatch[TARGET_MAX_WATCH];     // address | 1 when in use
+    target_watch_t eWatch[TARGET_MAX_WATCH];
+} target_t;
+
+static target_t xTarget = { .ulAp = TARGET_DEFAULT_AP };
+
+target_wire_t xTargetWire;
+
+/*-----------------------------------------------------------*/
+
+/// @brief single swd transfer with the configured WAIT retries, sticky errors are cleared on FAULT
+/// @param ulRequest : transfer request
+/// @param pulData : data
+/// @return acknowledge
+static uint8_t prvTransfer(uint32_t ulRequest, uint32_t * pulData)
+{
+    unsigned int retry = DAP_Data.transfer.retry_count;
+    unsigned int abort = DP_ABORT_CLEAR_ALL;
+    uint8_t ucAck;
+
+    do {
+        ucAck = SWD_Transfer(ulRequest, (unsigned int *)pulData);
+    } while ((ucAck == DAP_TRANSFER_WAIT) && retry--);
+
+    if (ucAck == DAP_TRANSFER_FAULT)
+    {
+        (void)SWD_Transfer(DP_ABORT, &abort);
+        xTarget.xCswValid = false;
+    }
+    else if (ucAck != DAP_TRANSFER_OK)
+    {
+        // the link may be lost, nothing cached can be trusted
+        xTargetWire.xSelectValid = false;
+        xTarget.xCswValid = false;
+    }
+    return ucAck;
+}
+
+/// @brief keep CSW and TAR of the MEM-AP before the session changes them
+/// @return acknowledge
+static uint8_t prvApSave(void)
+{
+    uint32_t ulSelect = xTarget.ulAp;
+
+    if (!xTargetWire.xSelectValid || (xTargetWire.ulSelect != ulSelect))
+    {
+        TARGET_TRY(prvTransfer(DP_SELECT, &ulSelect));
+    }
+    // posted reads: TAR returns CSW, RDBUFF returns TAR
+    TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL));
+    TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_TAR, &xTarget.ulHostCsw));
+    TARGET_TRY(prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, &xTarget.ulHostTar));
+    // the CSW write is saved when the session wants the host's setting
+    xTarget.ulCsw = xTarget.ulHostCsw;
+    xTarget.xCswValid = true;
+    xTarget.xApSaved = true;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief point SELECT at a bank of the MEM-AP
+/// @param ulReg : AP register address
+/// @return acknowledge
+static uint8_t prvSelect(uint32_t ulReg)
+{
+    uint32_t ulSelect = xTarget.ulAp | (ulReg & 0xF0U);
+
+    // bank 0 holds CSW and TAR, the host may cache both
+    if (xTarget.xSession && !xTarget.xApSaved && ((ulReg & 0xF0U) == 0U))
+    {
+        TARGET_TRY(prvApSave());
+    }
+    if (xTargetWire.xSelectValid && (xTargetWire.ulSelect == ulSelect))
+    {
+        return DAP_TRANSFER_OK;
+    }
+    return prvTransfer(DP_SELECT, &ulSelect);
+}
+
+/// @brief write an AP register
+/// @param ulReg : register address
+/// @param ulData : data
+/// @return acknowledge
+static uint8_t prvApWrite(uint32_t ulReg, uint32_t ulData)
+{
+    TARGET_TRY(prvSelect(ulReg));
+    return prvTransfer(DAP_TRANSFER_APnDP | (ulReg & 0x0CU), &ulData);
+}
+
+/// @brief set CSW access size
+/// @param ulSize : AP_CSW_SIZE_x
+/// @return acknowledge
+static uint8_t prvCsw(uint32_t ulSize)
+{
+    uint32_t ulCsw = AP_CSW_BASE | ulSize;
+
+    if (xTarget.xCswValid && (xTarget.ulCsw == ulCsw))
+    {
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(prvApWrite(AP_CSW, ulCsw));
+    xTarget.ulCsw = ulCsw;
+    xTarget.xCswValid = true;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief write one byte with a byte sized access
+/// @param ulAddr : address
+/// @param uc : data
+/// @return acknowledge
+static uint8_t prvWriteByte(uint32_t ulAddr, uint8_t uc)
+{
+    TARGET_TRY(prvCsw(AP_CSW_SIZE_8));
+    TARGET_TRY(prvApWrite(AP_TAR, ulAddr));
+    return prvApWrite(AP_DRW, (uint32_t)uc << ((ulAddr & 3U) * 8U));
+}
+
+/// @brief read core registers through the banked data registers, TAR must point at DHCSR
+/// @param pucReg : registers (DCRSR REGSEL)
+/// @param xRegs : number of registers
+/// @param pulOut : data output
+/// @return acknowledge
+static uint8_t prvBankReadRegs(const uint8_t * pucReg, size_t xRegs, uint32_t * pulOut)
+{
+    uint32_t ulDhcsr;
+
+    for (size_t r = 0U; r < xRegs; r++)
+    {
+        uint32_t i;
+
+        TARGET_TRY(prvApWrite(AP_BD1, pucReg[r]));
+        // DHCSR is read before DCRDR, S_REGRDY in it vouches for the data
+        for (i = 0U; i < TARGET_POLL_COUNT; i++)
+        {
+            TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | (AP_BD0 & 0x0CU), NULL));
+            TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | (AP_BD2 & 0x0CU), &ulDhcsr));
+            TARGET_TRY(prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, &pulOut[r]));
+            if ((ulDhcsr & TARGET_DHCSR_S_REGRDY) != 0U)
+            {
+                break;
+            }
+        }
+        if (i == TARGET_POLL_COUNT)
+        {
+            return DAP_TRANSFER_ERROR;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief read FPB and DWT configuration once
+/// @return acknowledge
+static uint8_t prvProbeUnits(void)
+{
+    uint32_t ulData;
+
+    if (xTarget.xUnitsKnown)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(ucTargetReadWord(TARGET_FP_CTRL, &ulData));
+    xTarget.ulFpbRev = ulData >> 28;
+    xTarget.ulNumBreak = ((ulData >> 8) & 0x70U) | ((ulData >> 4) & 0x0FU);
+    if (xTarget.ulNumBreak > TARGET_MAX_BREAK)
+    {
+        xTarget.ulNumBreak = TARGET_MAX_BREAK;
+    }
+    TARGET_TRY(ucTargetReadWord(TARGET_DWT_CTRL, &ulData));
+    xTarget.ulNumWatch = ulData >> 28;
+    if (xTarget.ulNumWatch > TARGET_MAX_WATCH)
+    {
+        xTarget.ulNumWatch = TARGET_MAX_WATCH;
+    }
+    // ARMv8-M DWT_FUNCTION carries an ID field, reserved (zero) on ARMv7-M
+    xTarget.xDwtV8 = false;
+    if (xTarget.ulNumWatch != 0U)
+    {
+        TARGET_TRY(ucTargetReadWord(TARGET_DWT_FUNCTION(0), &ulData));
+        xTarget.xDwtV8 = ((ulData >> 27) != 0U);
+    }
+    memset(xTarget.ulBreak, 0x00, sizeof(xTarget.ulBreak));
+    memset(xTarget.ulWatch, 0x00, sizeof(xTarget.ulWatch));
+    xTarget.xUnitsKnown = true;
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief get the swd clock settings
+/// @param px : output
+static void prvClockGet(target_clock_t * px)
+{
+    px->ulDelay = DAP_Data.clock_delay;
+    px->ulFast = DAP_Data.fast_clock;
+#if (USE_PIO_SWD == 0)
+    px->ulSample = probe_get_sample();
+#else
+    px->ulSample = 0U;
+#endif
+}
+
+/// @brief set the swd clock settings, the swd engine takes them with its next transfer
+/// @param px : settings
+static void prvClockSet(const target_clock_t * px)
+{
+    DAP_Data.clock_delay = px->ulDelay;
+    DAP_Data.fast_clock = px->ulFast;
+#if (USE_PIO_SWD == 0)
+    if (probe_get_sample() != px->ulSample)
+    {
+        (void)probe_set_sample(xprobeHandle.pio, xprobeHandle.pinBase, px->ulSample);
+    }
+#endif
+}
+
+/// @brief start a session: the host's read-ahead is flushed, its SELECT and clock noted
+static void prvSessionStart(void)
+{
+#if (DAP_READAHEAD != 0)
+    vDapReadAheadFlush();
+#endif
+    xTarget.xHostSelectValid = xTargetWire.xSelectValid;
+    xTarget.ulHostSelect = xTargetWire.ulSelect;
+    // a connect may switch to the clock cached for the target (swclkTune.h)
+    prvClockGet(&xTarget.xHostClock);
+    // the host may have moved CSW, it is read back before the first bank 0 access
+    xTarget.xCswValid = false;
+    xTarget.xApSaved = false;
+    xTarget.xSession = true;
+}
+
+/// @brief end a session: CSW, TAR, SELECT and the clock go back to what the host left, best effort
+static void prvSessionEnd(void)
+{
+    uint32_t ulSelect = xTarget.ulHostSelect;
+
+    if (xTarget.xApSaved)
+    {
+        if (!xTarget.xCswValid || (xTarget.ulCsw != xTarget.ulHostCsw))
+        {
+            (void)prvApWrite(AP_CSW, xTarget.ulHostCsw);
+        }
+        (void)prvApWrite(AP_TAR, xTarget.ulHostTar);
+    }
+    if (xTarget.xHostSelectValid && (!xTargetWire.xSelectValid || (xTargetWire.ulSelect != ulSelect)))
+    {
+        (void)prvTransfer(DP_SELECT, &ulSelect);
+    }
+    prvClockSet(&xTarget.xHostClock);
+    xTarget.xApSaved = false;
+    xTarget.xSession = false;
+}
+
+/// @brief take the link in a gap of the host's requests
+static void prvServiceTake(void)
+{
+    do
+    {
+        // the host goes first, a service starts only while no request waits
+        while (xTarget.ulHostWaiting != 0U)
+        {
+            vTaskDelay(1);
+        }
+        xSemaphoreTake(xTarget.xLock, portMAX_DELAY);
+        if (xTarget.ulHostWaiting == 0U)
+        {
+            break;
+        }
+        xSemaphoreGive(xTarget.xLock);
+    } while (true);
+    xTarget.xService = true;
+}
+
+/// @brief let a waiting host request in, at a transaction boundary of a service
+static void prvServiceYield(void)
+{
+    target_clock_t xClock;
+
+    if (!xTarget.xService || (xTarget.ulHostWaiting == 0U))
+    {
+        return;
+    }
+    // the host runs at its own clock, the service goes on at the one it had
+    prvClockGet(&xClock);
+    prvSessionEnd();
+    xTarget.xService = false;
+    xSemaphoreGive(xTarget.xLock);
+    prvServiceTake();
+    prvSessionStart();
+    prvClockSet(&xClock);
+}
+
+/// @brief read words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data output
+/// @param xCount : words
+/// @param xYield : let a waiting host in between two 1k pages
+/// @return acknowledge
+static uint8_t prvReadWords(uint32_t ulAddr, uint32_t * pulData, size_t xCount, bool xYield)
+{
+    while (xCount != 0U)
+    {
+        size_t xChunk = (TAR_PAGE - (ulAddr & (TAR_PAGE - 1U))) / 4U;
+        if (xChunk > xCount)
+        {
+            xChunk = xCount;
+        }
+        if (xYield)
+        {
+            prvServiceYield();
+        }
+        TARGET_TRY(prvCsw(AP_CSW_SIZE_32));
+        TARGET_TRY(prvApWrite(AP_TAR, ulAddr));
+        // posted reads: each DRW read returns the previous one, RDBUFF the last
+        TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL));
+        for (size_t i = 0U; i < xChunk; i++)
+        {
+            uint32_t ulRequest = (i == (xChunk - 1U)) ? (DP_RDBUFF | DAP_TRANSFER_RnW)
+                                                      : (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW);
+            TARGET_TRY(prvTransfer(ulRequest, pulData++));
+        }
+        ulAddr += xChunk * 4U;
+        xCount -= xChunk;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief write words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data
+/// @param xCount : words
+/// @param xYield : let a waiting host in between two 1k pages
+/// @return acknowledge
+static uint8_t prvWriteWords(uint32_t ulAddr, const uint32_t * pulData, size_t xCount, bool xYield)
+{
+    while (xCount != 0U)
+    {
+        size_t xChunk = (TAR_PAGE - (ulAddr & (TAR_PAGE - 1U))) / 4U;
+        if (xChunk > xCount)
+        {
+            xChunk = xCount;
+        }
+        if (xYield && xTarget.xService && (xTarget.ulHostWaiting != 0U))
+        {
+            // posted writes must be through before the link changes hands
+            TARGET_TRY(prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL));
+            prvServiceYield();
+        }
+        TARGET_TRY(prvCsw(AP_CSW_SIZE_32));
+        TARGET_TRY(prvApWrite(AP_TAR, ulAddr));
+        for (size_t i = 0U; i < xChunk; i++)
+        {
+            uint32_t ulData = *pulData++;
+            TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | AP_DRW, &ulData));
+        }
+        ulAddr += xChunk * 4U;
+        xCount -= xChunk;
+    }
+    // writes are posted, RDBUFF reports the last one
+    return prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the link lock
+void vTargetInit(void)
+{
+    xTarget.xLock = xSemaphoreCreateMutex();
+}
+
+/// @brief take the link for the dap thread, ahead of the services
+void vTargetLock(void)
+{
+    taskENTER_CRITICAL();
+    xTarget.ulHostWaiting += 1U;
+    taskEXIT_CRITICAL();
+    xSemaphoreTake(xTarget.xLock, portMAX_DELAY);
+    taskENTER_CRITICAL();
+    xTarget.ulHostWaiting -= 1U;
+    taskEXIT_CRITICAL();
+}
+
+/// @brief give the link back, link state a vendor command moved is put back first
+void vTargetUnlock(void)
+{
+    if (xTarget.xSession)
+    {
+        prvSessionEnd();
+    }
+    xSemaphoreGive(xTarget.xLock);
+}
+
+/// @brief take the link for a probe service in a gap of the host's requests,
+///        the host's read-ahead is flushed and its link state kept
+void vTargetAcquire(void)
+{
+    prvServiceTake();
+    prvSessionStart();
+}
+
+/// @brief use the link from a dap command that holds it already (vendor commands),
+///        the host's read-ahead is flushed and its link state kept
+void vTargetClaim(void)
+{
+    if (!xTarget.xSession)
+    {
+        prvSessionStart();
+    }
+}
+
+/// @brief give the link back after vTargetAcquire, the host's link state is put back
+void vTargetRelease(void)
+{
+    prvSessionEnd();
+    xTarget.xService = false;
+    xSemaphoreGive(xTarget.xLock);
+}
+
+/// @brief let a waiting host request in, between two transactions of a service
+void vTargetYield(void)
+{
+    prvServiceYield();
+}
+
+/// @brief note the host's DAP_Connect and DAP_Disconnect, called by the dap thread
+/// @param xOpen : true when the host connected the debug port
+void vTargetHostPort(bool xOpen)
+{
+    xTarget.xHostPort = xOpen;
+}
+
+/// @brief check for a host session on the debug port
+/// @return true between the host's DAP_Connect and DAP_Disconnect
+bool xTargetHostPort(void)
+{
+    return xTarget.xHostPort;
+}
+
+/// @brief bring the link up for a service: the connect sequence while no host
+///        session owns the port, otherwise a DPIDR read on the host's link
+/// @return acknowledge
+uint8_t ucTargetAttach(void)
+{
+    uint32_t ulData;
+
+    if (!xTarget.xHostPort)
+    {
+        return ucTargetConnect(NULL);
+    }
+    // line reset, JTAG-to-SWD and power up would pull the link from under the host
+    return prvTransfer(DP_DPIDR | DAP_TRANSFER_RnW, &ulData);
+}
+
+/// @brief select the MEM-AP used by the services
+/// @param ulSelect : SELECT value of bank 0 (ADIv5: APSEL << 24; ADIv6: AP base address)
+void vTargetSetAp(uint32_t ulSelect)
+{
+    xTarget.ulAp = ulSelect & ~0xFFUL;
+    xTarget.xCswValid = false;
+    xTarget.xUnitsKnown = false;
+}
+
+/// @brief bring up the swd link: reset sequences, DPIDR, debug power,
+///        then the SWCLK cached for the target (swclkTune.h)
+/// @param pulDpidr : DPIDR output, may be NULL
+/// @return acknowledge
+uint8_t ucTargetConnect(uint32_t * pulDpidr)
+{
+    static const uint8_t ucOnes[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    static const uint8_t ucJtagToSwd[] = { 0x9E, 0xE7 };
+    static const uint8_t ucZero[] = { 0x00 };
+    // dormant to swd: selection alert, 4 idle cycles and the swd activation code
+    static const uint8_t ucAlert[] = { 0x92, 0xF3, 0x09, 0x62, 0x95, 0x2D, 0x85, 0x86,
+                                       0xE9, 0xAF, 0xDD, 0xE3, 0xA2, 0x0E, 0xBC, 0x19 };
+    static const uint8_t ucActivate[] = { 0xA0, 0x01 };
+    uint32_t ulData, ulDpidr;
+    uint8_t ucAck;
+
+    PORT_SWD_SETUP();
+    DAP_Data.debug_port = DAP_PORT_SWD;
+    xTargetWire.xSelectValid = false;
+    xTarget.xCswValid = false;
+    xTarget.xUnitsKnown = false;
+
+    SWJ_Sequence(51U, ucOnes);
+    SWJ_Sequence(16U, ucJtagToSwd);
+    SWJ_Sequence(51U, ucOnes);
+    SWJ_Sequence(8U, ucZero);
+    ucAck = prvTransfer(DP_DPIDR | DAP_TRANSFER_RnW, &ulData);
+    if (ucAck != DAP_TRANSFER_OK)
+    {
+        // the target may sleep in dormant state
+        SWJ_Sequence(8U, ucOnes);
+        SWJ_Sequence(128U, ucAlert);
+        SWJ_Sequence(12U, ucActivate);
+        SWJ_Sequence(51U, ucOnes);
+        SWJ_Sequence(8U, ucZero);
+        TARGET_TRY(prvTransfer(DP_DPIDR | DAP_TRANSFER_RnW, &ulData));
+    }
+    ulDpidr = ulData;
+    if (pulDpidr != NULL)
+    {
+        *pulDpidr = ulDpidr;
+    }
+
+    ulData = DP_ABORT_CLEAR_ALL;
+    TARGET_TRY(prvTransfer(DP_ABORT, &ulData));
+    ulData = 0U;
+    TARGET_TRY(prvTransfer(DP_SELECT, &ulData));
+    ulData = DP_CTRL_PWRUPREQ;
+    TARGET_TRY(prvTransfer(DP_CTRL_STAT, &ulData));
+    for (uint32_t i = 0U; i < TARGET_POLL_COUNT; i++)
+    {
+        TARGET_TRY(prvTransfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &ulData));
+        if ((ulData & DP_CTRL_PWRUPACK) == DP_CTRL_PWRUPACK)
+        {
+            // a target tuned before runs at its own clock from here on
+            vSwclkTuneApply(ulDpidr);
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief read TARGETID, the link is up
+/// @param ulDpidr : DPIDR of the target
+/// @param pulTargetId : TARGETID output, 0 before DPv2
+/// @return acknowledge
+uint8_t ucTargetReadTargetId(uint32_t ulDpidr, uint32_t * pulTargetId)
+{
+    uint32_t ulData = DP_BANK_TARGETID;
+
+    *pulTargetId = 0U;
+    if (((ulDpidr >> 12) & 0x0FUL) < 2UL)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    TARGET_TRY(prvTransfer(DP_SELECT, &ulData));
+    TARGET_TRY(prvTransfer(DP_TARGETID | DAP_TRANSFER_RnW, pulTargetId));
+    // bank 0 again, the next AP access selects its AP
+    ulData = 0U;
+    return prvTransfer(DP_SELECT, &ulData);
+}
+
+/// @brief raw DP or AP register transfer, AP reads return their own data (RDBUFF is read behind them)
+/// @param ulRequest : transfer request (DAP_TRANSFER_APnDP, DAP_TRANSFER_RnW, A2/A3)
+/// @param pulData : data, read into or written from
+/// @return acknowledge
+uint8_t ucTargetTransfer(uint32_t ulRequest, uint32_t * pulData)
+{
+    ulRequest &= (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+    // the caller may move CSW and TAR behind our back, keep the host's first (SELECT is seen on the wire)
+    if (xTarget.xSession && !xTarget.xApSaved)
+    {
+        TARGET_TRY(prvApSave());
+    }
+    xTarget.xCswValid = false;
+    if ((ulRequest & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW)) == (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW))
+    {
+        TARGET_TRY(prvTransfer(ulRequest, NULL));
+        ulRequest = DP_RDBUFF | DAP_TRANSFER_RnW;
+    }
+    return prvTransfer(ulRequest, pulData);
+}
+
+/// @brief read a word, the link stays with the caller
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data output
+/// @return acknowledge
+uint8_t ucTargetReadWord(uint32_t ulAddr, uint32_t * pulData)
+{
+    return prvReadWords(ulAddr, pulData, 1U, false);
+}
+
+/// @brief write a word, the link stays with the caller
+/// @param ulAddr : address (word aligned)
+/// @param ulData : data
+/// @return acknowledge
+uint8_t ucTargetWriteWord(uint32_t ulAddr, uint32_t ulData)
+{
+    return prvWriteWords(ulAddr, &ulData, 1U, false);
+}
+
+/// @brief read words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data output
+/// @param xCount : words
+/// @return acknowledge
+uint8_t ucTargetReadBlock(uint32_t ulAddr, uint32_t * pulData, size_t xCount)
+{
+    return prvReadWords(ulAddr, pulData, xCount, true);
+}
+
+/// @brief write words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data
+/// @param xCount : words
+/// @return acknowledge
+uint8_t ucTargetWriteBlock(uint32_t ulAddr, const uint32_t * pulData, size_t xCount)
+{
+    return prvWriteWords(ulAddr, pulData, xCount, true);
+}
+
+/// @brief read bytes at any alignment
+/// @param ulAddr : address
+/// @param puc : data output
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetReadMem(uint32_t ulAddr, uint8_t * puc, size_t xLen)
+{
+    uint32_t ulWords[TARGET_CHUNK_WORDS];
+
+    while (xLen != 0U)
+    {
+        uint32_t ulOffset = ulAddr & 3U;
+        size_t xBytes = (sizeof(ulWords) - ulOffset < xLen) ? (sizeof(ulWords) - ulOffset) : xLen;
+        size_t xCount = (ulOffset + xBytes + 3U) / 4U;
+
+        TARGET_TRY(ucTargetReadBlock(ulAddr - ulOffset, ulWords, xCount));
+        memcpy(puc, (uint8_t *)ulWords + ulOffset, xBytes);
+        puc += xBytes;
+        ulAddr += xBytes;
+        xLen -= xBytes;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief read exactly the given bytes, each access as wide as alignment and length allow
+/// @param ulAddr : address
+/// @param puc : data output
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetReadExact(uint32_t ulAddr, uint8_t * puc, size_t xLen)
+{
+    while (xLen != 0U)
+    {
+        uint32_t ulData;
+        size_t xSize = 1U;
+
+        if (((ulAddr & 3U) == 0U) && (xLen >= 4U))
+        {
+            xSize = 4U;
+        }
+        else if (((ulAddr & 1U) == 0U) && (xLen >= 2U))
+        {
+            xSize = 2U;
+        }
+        TARGET_TRY(prvCsw((xSize == 4U) ? AP_CSW_SIZE_32 : ((xSize == 2U) ? AP_CSW_SIZE_16 : AP_CSW_SIZE_8)));
+        TARGET_TRY(prvApWrite(AP_TAR, ulAddr));
+        // posted read, RDBUFF returns it, narrow data sits on its own byte lanes
+        TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW, NULL));
+        TARGET_TRY(prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, &ulData));
+        ulData >>= (ulAddr & 3U) * 8U;
+        memcpy(puc, &ulData, xSize);
+        puc += xSize;
+        ulAddr += xSize;
+        xLen -= xSize;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief write bytes at any alignment, unaligned head and tail use byte accesses
+/// @param ulAddr : address
+/// @param puc : data
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetWriteMem(uint32_t ulAddr, const uint8_t * puc, size_t xLen)
+{
+    uint32_t ulWords[TARGET_CHUNK_WORDS];
+
+    while ((xLen != 0U) && ((ulAddr & 3U) != 0U))
+    {
+        TARGET_TRY(prvWriteByte(ulAddr++, *puc++));
+        xLen--;
+    }
+    while (xLen >= 4U)
+    {
+        size_t xCount = (xLen / 4U < TARGET_CHUNK_WORDS) ? (xLen / 4U) : TARGET_CHUNK_WORDS;
+
+        memcpy(ulWords, puc, xCount * 4U);
+        TARGET_TRY(ucTargetWriteBlock(ulAddr, ulWords, xCount));
+        puc += xCount * 4U;
+        ulAddr += xCount * 4U;
+        xLen -= xCount * 4U;
+    }
+    while (xLen != 0U)
+    {
+        TARGET_TRY(prvWriteByte(ulAddr++, *puc++));
+        xLen--;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief read a core register, the core must be halted
+/// @param ulReg : register number (DCRSR REGSEL)
+/// @param pulData : data output
+/// @return acknowledge
+uint8_t ucTargetReadReg(uint32_t ulReg, uint32_t * pulData)
+{
+    uint32_t ulDhcsr;
+
+    TARGET_TRY(ucTargetWriteWord(TARGET_DCRSR, ulReg));
+    for (uint32_t i = 0U; i < TARGET_POLL_COUNT; i++)
+    {
+        TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulDhcsr));
+        if ((ulDhcsr & TARGET_DHCSR_S_REGRDY) != 0U)
+        {
+            return ucTargetReadWord(TARGET_DCRDR, pulData);
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief write a core register, the core must be halted
+/// @param ulReg : register number (DCRSR REGSEL)
+/// @param ulData : data
+/// @return acknowledge
+uint8_t ucTargetWriteReg(uint32_t ulReg, uint32_t ulData)
+{
+    uint32_t ulDhcsr;
+
+    TARGET_TRY(ucTargetWriteWord(TARGET_DCRDR, ulData));
+    // REGWnR
+    TARGET_TRY(ucTargetWriteWord(TARGET_DCRSR, ulReg | (1UL << 16)));
+    for (uint32_t i = 0U; i < TARGET_POLL_COUNT; i++)
+    {
+        TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulDhcsr));
+        if ((ulDhcsr & TARGET_DHCSR_S_REGRDY) != 0U)
+        {
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief read several core registers in one sequence, the core must be halted
+/// @param pucReg : registers (DCRSR REGSEL)
+/// @param xRegs : number of registers
+/// @param pulData : data output, one word per register
+/// @return acknowledge
+uint8_t ucTargetReadRegs(const uint8_t * pucReg, size_t xRegs, uint32_t * pulData)
+{
+    TARGET_TRY(prvCsw(AP_CSW_SIZE_32));
+    // TAR on DHCSR: BD0 = DHCSR, BD1 = DCRSR, BD2 = DCRDR, no TAR write per register
+    TARGET_TRY(prvApWrite(AP_TAR, TARGET_DHCSR));
+    return prvBankReadRegs(pucReg, xRegs, pulData);
+}
+
+/// @brief halt the core and wait for it
+/// @return acknowledge
+uint8_t ucTargetHalt(void)
+{
+    bool xHalted;
+
+    TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN | TARGET_DHCSR_C_HALT));
+    for (uint32_t i = 0U; i < TARGET_POLL_COUNT; i++)
+    {
+        TARGET_TRY(ucTargetIsHalted(&xHalted));
+        if (xHalted)
+        {
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief let the core run
+/// @return acknowledge
+uint8_t ucTargetResume(void)
+{
+    // clear the halt reasons so the next stop reports fresh ones
+    TARGET_TRY(ucTargetWriteWord(TARGET_DFSR, 0x1FU));
+    return ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN);
+}
+
+/// @brief execute one instruction with interrupts masked
+/// @return acknowledge
+uint8_t ucTargetStep(void)
+{
+    bool xHalted;
+    uint8_t ucAck = DAP_TRANSFER_ERROR;
+
+    // C_MASKINTS may only change while halted
+    TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN |
+                                               TARGET_DHCSR_C_HALT | TARGET_DHCSR_C_MASKINTS));
+    TARGET_TRY(ucTargetWriteWord(TARGET_DFSR, 0x1FU));
+    TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN |
+                                               TARGET_DHCSR_C_STEP | TARGET_DHCSR_C_MASKINTS));
+    for (uint32_t i = 0U; i < TARGET_POLL_COUNT; i++)
+    {
+        TARGET_TRY(ucTargetIsHalted(&xHalted));
+        if (xHalted)
+        {
+            ucAck = DAP_TRANSFER_OK;
+            break;
+        }
+    }
+    TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN | TARGET_DHCSR_C_HALT));
+    return ucAck;
+}
+
+/// @brief single-step the halted core with interrupts masked and sample core registers after every step
+/// @param pucReg : registers to sample (DCRSR REGSEL)
+/// @param xRegs : number of registers
+/// @param pulOut : samples output, xRegs words per step
+/// @param xSteps : steps
+/// @param pxDone : steps done output
+/// @return acknowledge, DAP_TRANSFER_ERROR when the core did not halt after a step
+uint8_t ucTargetStepTrace(const uint8_t * pucReg, size_t xRegs, uint32_t * pulOut, size_t xSteps, size_t * pxDone)
+{
+    const uint32_t ulStep = TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN | TARGET_DHCSR_C_STEP | TARGET_DHCSR_C_MASKINTS;
+    uint32_t ulDhcsr;
+    uint8_t ucAck = DAP_TRANSFER_OK;
+
+    *pxDone = 0U;
+    // C_MASKINTS may only change while halted
+    TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN |
+                                               TARGET_DHCSR_C_HALT | TARGET_DHCSR_C_MASKINTS));
+    TARGET_TRY(ucTargetWriteWord(TARGET_DFSR, 0x1FU));
+    // TAR on DHCSR: BD0 = DHCSR, BD1 = DCRSR, BD2 = DCRDR, no TAR write per access
+    TARGET_TRY(prvApWrite(AP_TAR, TARGET_DHCSR));
+    for (size_t n = 0U; n < xSteps; n++)
+    {
+        uint32_t i;
+
+        TARGET_TRY(prvApWrite(AP_BD0, ulStep));
+        for (i = 0U; i < TARGET_POLL_COUNT; i++)
+        {
+            TARGET_TRY(prvTransfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | (AP_BD0 & 0x0CU), NULL));
+            TARGET_TRY(prvTransfer(DP_RDBUFF | DAP_TRANSFER_RnW, &ulDhcsr));
+            if ((ulDhcsr & TARGET_DHCSR_S_HALT) != 0U)
+            {
+                break;
+            }
+        }
+        if (i == TARGET_POLL_COUNT)
+        {
+            // still running, halted again below
+            ucAck = DAP_TRANSFER_ERROR;
+            break;
+        }
+        TARGET_TRY(prvBankReadRegs(pucReg, xRegs, pulOut));
+        pulOut += xRegs;
+        *pxDone += 1U;
+    }
+    TARGET_TRY(prvApWrite(AP_BD0, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN | TARGET_DHCSR_C_HALT));
+    return ucAck;
+}
+
+/// @brief check if the core is halted
+/// @param pxHalted : state output
+/// @return acknowledge
+uint8_t ucTargetIsHalted(bool * pxHalted)
+{
+    uint32_t ulDhcsr;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DHCSR, &ulDhcsr));
+    *pxHalted = ((ulDhcsr & TARGET_DHCSR_S_HALT) != 0U);
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief reset the core through AIRCR
+/// @param xHalt : true to stop at the reset vector
+/// @return acknowledge
+uint8_t ucTargetReset(bool xHalt)
+{
+    uint32_t ulDemcr, ulDhcsr;
+    uint8_t ucAck;
+
+    TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulDemcr));
+    if (xHalt)
+    {
+        TARGET_TRY(ucTargetWriteWord(TARGET_DHCSR, TARGET_DHCSR_DBGKEY | TARGET_DHCSR_C_DEBUGEN));
+        TARGET_TRY(ucTargetWriteWord(TARGET_DEMCR, ulDemcr | TARGET_DEMCR_VC_CORERESET));
+    }
+    // the write may not be acknowledged while the system resets
+    (void)ucTargetWriteWord(TARGET_AIRCR, AIRCR_SYSRESETREQ);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    xTargetWire.xSelectValid = false;
+    xTarget.xCswValid = false;
+    // S_RESET_ST is sticky, this read clears it
+    ucAck = ucTargetReadWord(TARGET_DHCSR, &ulDhcsr);
+    if ((ucAck == DAP_TRANSFER_OK) && xHalt)
+    {
+        ucAck = ucTargetHalt();
+        TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulDemcr));
+        TARGET_TRY(ucTargetWriteWord(TARGET_DEMCR, ulDemcr & ~TARGET_DEMCR_VC_CORERESET));
+    }
+    return ucAck;
+}
+
+/// @brief set or clear a FPB breakpoint
+/// @param ulAddr : instruction address
+/// @param xSet : true to set, false to clear
+/// @return acknowledge, DAP_TRANSFER_ERROR when no comparator is free or found
+uint8_t ucTargetBreakpoint(uint32_t ulAddr, bool xSet)
+{
+    uint32_t ulComp;
+
+    TARGET_TRY(prvProbeUnits());
+    ulAddr &= ~1UL;
+    for (uint32_t i = 0U; i < xTarget.ulNumBreak; i++)
+    {
+        if (!xSet && (xTarget.ulBreak[i] == (ulAddr | 1U)))
+        {
+            xTarget.ulBreak[i] = 0U;
+            return ucTargetWriteWord(TARGET_FP_COMP(i), 0U);
+        }
+        if (xSet && (xTarget.ulBreak[i] == 0U))
+        {
+            if (xTarget.ulFpbRev == 0U)
+            {
+                // FPBv1 only covers the code region, REPLACE selects the halfword
+                if (ulAddr >= 0x20000000UL)
+                {
+                    return DAP_TRANSFER_ERROR;
+                }
+                ulComp = (ulAddr & 0x1FFFFFFCUL) | (((ulAddr & 2U) != 0U) ? (2UL << 30) : (1UL << 30)) | 1U;
+            }
+            else
+            {
+                ulComp = ulAddr | 1U;
+            }
+            // KEY | ENABLE
+            TARGET_TRY(ucTargetWriteWord(TARGET_FP_CTRL, 0x3U));
+            TARGET_TRY(ucTargetWriteWord(TARGET_FP_COMP(i), ulComp));
+            xTarget.ulBreak[i] = ulAddr | 1U;
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief set or clear a DWT watchpoint
+/// @param ulAddr : data address
+/// @param ulLen : bytes (power of 2)
+/// @param eKind : access kind
+/// @param xSet : true to set, false to clear
+/// @return acknowledge, DAP_TRANSFER_ERROR when no comparator is free or found
+uint8_t ucTargetWatchpoint(uint32_t ulAddr, uint32_t ulLen, target_watch_t eKind, bool xSet)
+{
+    uint32_t ulDemcr, ulFunction, ulSize;
+
+    TARGET_TRY(prvProbeUnits());
+    if ((ulLen == 0U) || ((ulLen & (ulLen - 1U)) != 0U) || ((ulAddr & (ulLen - 1U)) != 0U) ||
+        (xTarget.xDwtV8 && (ulLen > 4U)))
+    {
+        return DAP_TRANSFER_ERROR;
+    }
+    ulSize = (uint32_t)__builtin_ctz(ulLen);
+    for (uint32_t i = 0U; i < xTarget.ulNumWatch; i++)
+    {
+        if (!xSet && (xTarget.ulWatch[i] == (ulAddr | 1U)))
+        {
+            xTarget.ulWatch[i] = 0U;
+            return ucTargetWriteWord(TARGET_DWT_FUNCTION(i), 0U);
+        }
+        if (xSet && (xTarget.ulWatch[i] == 0U))
+        {
+            if (xTarget.xDwtV8)
+            {
+                // ACTION = debug event, MATCH = data address write/read/access, DATAVSIZE
+                static const uint32_t ulMatch[] = { 0x5U, 0x6U, 0x4U };
+                ulFunction = (1UL << 4) | ulMatch[eKind] | (ulSize << 10);
+            }
+            else
+            {
+                // watchpoint on write/read/access, the range comes from MASK
+                static const uint32_t ulMatch[] = { 0x6U, 0x5U, 0x7U };
+                ulFunction = ulMatch[eKind];
+                TARGET_TRY(ucTargetWriteWord(TARGET_DWT_MASK(i), ulSize));
+            }
+            // the DWT needs TRCENA
+            TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulDemcr));
+            TARGET_TRY(ucTargetWriteWord(TARGET_DEMCR, ulDemcr | TARGET_DEMCR_TRCENA));
+            TARGET_TRY(ucTargetWriteWord(TARGET_DWT_COMP(i), ulAddr));
+            TARGET_TRY(ucTargetWriteWord(TARGET_DWT_FUNCTION(i), ulFunction));
+            xTarget.ulWatch[i] = ulAddr | 1U;
+            xTarget.eWatch[i] = eKind;
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief find the watchpoint that halted the core (DWT MATCHED)
+/// @param pulAddr : watched address output
+/// @param peKind : access kind output
+/// @return acknowledge, DAP_TRANSFER_ERROR when no watchpoint matched
+uint8_t ucTargetWatchHit(uint32_t * pulAddr, target_watch_t * peKind)
+{
+    uint32_t ulFunction;
+
+    if (!xTarget.xUnitsKnown)
+    {
+        return DAP_TRANSFER_ERROR;
+    }
+    for (uint32_t i = 0U; i < xTarget.ulNumWatch; i++)
+    {
+        if (xTarget.ulWatch[i] == 0U)
+        {
+            continue;
+        }
+        // MATCHED clears on read
+        TARGET_TRY(ucTargetReadWord(TARGET_DWT_FUNCTION(i), &ulFunction));
+        if ((ulFunction & (1UL << 24)) != 0U)
+        {
+            *pulAddr = xTarget.ulWatch[i] & ~1UL;
+            *peKind = xTarget.eWatch[i];
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+/// @brief clear all breakpoints and watchpoints set through this module
+/// @return acknowledge
+uint8_t ucTargetClearDebugPoints(void)
+{
+    if (!xTarget.xUnitsKnown)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    for (uint32_t i = 0U; i < xTarget.ulNumBreak; i++)
+    {
+        if (xTarget.ulBreak[i] != 0U)
+        {
+            TARGET_TRY(ucTargetWriteWord(TARGET_FP_COMP(i), 0U));
+            xTarget.ulBreak[i] = 0U;
+        }
+    }
+    for (uint32_t i = 0U; i < xTarget.ulNumWatch; i++)
+    {
+        if (xTarget.ulWatch[i] != 0U)
+        {
+            TARGET_TRY(ucTargetWriteWord(TARGET_DWT_FUNCTION(i), 0U));
+            xTarget.ulWatch[i] = 0U;
+        }
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,316 @@
+#ifndef TARGET_H_
+#define TARGET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "dap/DAP.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Target access on top of the SWD engine, for the services running on the
+ * probe (gdb server, programmer, ...). All functions return the SWD
+ * acknowledge of the failing transfer or DAP_TRANSFER_OK.
+ *
+ * The link is shared with the CMSIS-DAP host: the dap thread holds it with
+ * vTargetLock() while it executes a command, services hold it with
+ * vTargetAcquire() around their accesses.
+ *
+ * The host goes first. A service only gets the link while no host request
+ * waits, and block accesses give it back between two 1k TAR pages when one
+ * comes in. Word and core register accesses keep it, a service that polls
+ * calls vTargetYield() between two of its transactions. The host's link
+ * state is kept over a service or vendor command session: SELECT is
+ * followed on the wire (SWD_Transfer reports every write), CSW and TAR of
+ * the MEM-AP are read before the session first touches bank 0, and all
+ * three are written back when the link is handed to the host again. So is
+ * the SWCLK (and SWDIO sample point) the host set, a connect in the session
+ * may have switched to the target's cached one.
+ *
+ * Between the host's DAP_Connect and DAP_Disconnect the port is the host's:
+ * a polling service brings the link up with ucTargetAttach(), which leaves
+ * the connect sequence to the host and only checks the link is there.
+ */
+
+/* Cortex-M debug registers */
+#define TARGET_DHCSR                0xE000EDF0UL
+#define TARGET_DCRSR                0xE000EDF4UL
+#define TARGET_DCRDR                0xE000EDF8UL
+#define TARGET_DEMCR                0xE000EDFCUL
+#define TARGET_DFSR                 0xE000ED30UL
+#define TARGET_AIRCR                0xE000ED0CUL
+#define TARGET_CPUID                0xE000ED00UL
+#define TARGET_FP_CTRL              0xE0002000UL
+#define TARGET_FP_COMP(n)           (0xE0002008UL + ((n) * 4UL))
+#define TARGET_DWT_CTRL             0xE0001000UL
+#define TARGET_DWT_COMP(n)          (0xE0001020UL + ((n) * 16UL))
+#define TARGET_DWT_MASK(n)          (0xE0001024UL + ((n) * 16UL))
+#define TARGET_DWT_FUNCTION(n)      (0xE0001028UL + ((n) * 16UL))
+
+/* DHCSR bits */
+#define TARGET_DHCSR_DBGKEY         0xA05F0000UL
+#define TARGET_DHCSR_C_DEBUGEN      (1UL << 0)
+#define TARGET_DHCSR_C_HALT         (1UL << 1)
+#define TARGET_DHCSR_C_STEP         (1UL << 2)
+#define TARGET_DHCSR_C_MASKINTS     (1UL << 3)
+#define TARGET_DHCSR_S_REGRDY       (1UL << 16)
+#define TARGET_DHCSR_S_HALT         (1UL << 17)
+#define TARGET_DHCSR_S_RESET_ST     (1UL << 25)
+
+/* DEMCR bits */
+#define TARGET_DEMCR_VC_CORERESET   (1UL << 0)
+#define TARGET_DEMCR_TRCENA         (1UL << 24)
+
+/* core register numbers (DCRSR REGSEL) */
+#define TARGET_REG_SP               13U
+#define TARGET_REG_LR               14U
+#define TARGET_REG_PC               15U
+#define TARGET_REG_XPSR             16U
+#define TARGET_REG_MSP              17U
+#define TARGET_REG_PSP              18U
+#define TARGET_REG_SPECIAL          20U     // CONTROL, FAULTMASK, BASEPRI, PRIMASK
+#define TARGET_REG_FPSCR            33U
+#define TARGET_REG_S(n)             (64U + (n))
+
+/* default MEM-AP (SELECT value of bank 0): ADIv5 AP 0 */
+#ifndef TARGET_DEFAULT_AP
+    #define TARGET_DEFAULT_AP       0x00000000UL
+#endif
+
+/* return the acknowledge unless the access went through */
+#define TARGET_TRY(x)               do { uint8_t _ack = (x); if (_ack != DAP_TRANSFER_OK) return _ack; } while (0)
+
+/* DP SELECT as it is in the target, whoever wrote it */
+typedef struct target_wire_t
+{
+    bool xSelectValid;
+    uint32_t ulSelect;
+} target_wire_t;
+
+extern target_wire_t xTargetWire;
+
+/// @brief follow DP SELECT writes, called by SWD_Transfer for every transfer
+/// @param ulRequest : transfer request
+/// @param ulData : written data
+/// @param ucAck : transfer result
+static inline void vTargetWire(uint32_t ulRequest, uint32_t ulData, uint8_t ucAck)
+{
+    if ((ulRequest & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) != DP_SELECT)
+    {
+        return;
+    }
+    if (ucAck == DAP_TRANSFER_OK)
+    {
+        xTargetWire.ulSelect = ulData;
+        xTargetWire.xSelectValid = true;
+    }
+    else if ((ucAck != DAP_TRANSFER_WAIT) && (ucAck != DAP_TRANSFER_FAULT))
+    {
+        // no telling whether the write went in
+        xTargetWire.xSelectValid = false;
+    }
+}
+
+/* watchpoint kinds */
+typedef enum target_watch_t
+{
+    TARGET_WATCH_WRITE = 0,
+    TARGET_WATCH_READ,
+    TARGET_WATCH_ACCESS
+} target_watch_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the link lock
+void vTargetInit(void);
+
+/// @brief take the link for the dap thread, ahead of the services
+void vTargetLock(void);
+
+/// @brief give the link back, link state a vendor command moved is put back first
+void vTargetUnlock(void);
+
+/// @brief take the link for a probe service in a gap of the host's requests,
+///        the host's read-ahead is flushed and its link state kept
+void vTargetAcquire(void);
+
+/// @brief give the link back after vTargetAcquire, the host's link state is put back
+void vTargetRelease(void);
+
+/// @brief let a waiting host request in, between two transactions of a service
+void vTargetYield(void);
+
+/// @brief note the host's DAP_Connect and DAP_Disconnect, called by the dap thread
+/// @param xOpen : true when the host connected the debug port
+void vTargetHostPort(bool xOpen);
+
+/// @brief check for a host session on the debug port
+/// @return true between the host's DAP_Connect and DAP_Disconnect
+bool xTargetHostPort(void);
+
+/// @brief bring the link up for a service: the connect sequence while no host
+///        session owns the port, otherwise a DPIDR read on the host's link
+/// @return acknowledge
+uint8_t ucTargetAttach(void);
+
+/// @brief use the link from a dap command that holds it already (vendor commands),
+///        the host's read-ahead is flushed and its link state kept
+void vTargetClaim(void);
+
+/// @brief select the MEM-AP used by the services
+/// @param ulSelect : SELECT value of bank 0 (ADIv5: APSEL << 24; ADIv6: AP base address)
+void vTargetSetAp(uint32_t ulSelect);
+
+/// @brief bring up the swd link: reset sequences, DPIDR, debug power,
+///        then the SWCLK cached for the target (swclkTune.h)
+/// @param pulDpidr : DPIDR output, may be NULL
+/// @return acknowledge
+uint8_t ucTargetConnect(uint32_t * pulDpidr);
+
+/// @brief read TARGETID, the link is up
+/// @param ulDpidr : DPIDR of the target
+/// @param pulTargetId : TARGETID output, 0 before DPv2
+/// @return acknowledge
+uint8_t ucTargetReadTargetId(uint32_t ulDpidr, uint32_t * pulTargetId);
+
+/// @brief raw DP or AP register transfer, AP reads return their own data (RDBUFF is read behind them)
+/// @param ulRequest : transfer request (DAP_TRANSFER_APnDP, DAP_TRANSFER_RnW, A2/A3)
+/// @param pulData : data, read into or written from
+/// @return acknowledge
+uint8_t ucTargetTransfer(uint32_t ulRequest, uint32_t * pulData);
+
+/// @brief read a word, the link stays with the caller
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data output
+/// @return acknowledge
+uint8_t ucTargetReadWord(uint32_t ulAddr, uint32_t * pulData);
+
+/// @brief write a word, the link stays with the caller
+/// @param ulAddr : address (word aligned)
+/// @param ulData : data
+/// @return acknowledge
+uint8_t ucTargetWriteWord(uint32_t ulAddr, uint32_t ulData);
+
+/// @brief read words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data output
+/// @param xCount : words
+/// @return acknowledge
+uint8_t ucTargetReadBlock(uint32_t ulAddr, uint32_t * pulData, size_t xCount);
+
+/// @brief write words using TAR auto increment
+/// @param ulAddr : address (word aligned)
+/// @param pulData : data
+/// @param xCount : words
+/// @return acknowledge
+uint8_t ucTargetWriteBlock(uint32_t ulAddr, const uint32_t * pulData, size_t xCount);
+
+/// @brief read bytes at any alignment
+/// @param ulAddr : address
+/// @param puc : data output
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetReadMem(uint32_t ulAddr, uint8_t * puc, size_t xLen);
+
+/// @brief read exactly the given bytes, each access as wide as alignment and length allow
+///        (byte, halfword or word), for registers that must not be read wider than asked
+/// @param ulAddr : address
+/// @param puc : data output
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetReadExact(uint32_t ulAddr, uint8_t * puc, size_t xLen);
+
+/// @brief write bytes at any alignment, unaligned head and tail use byte accesses
+/// @param ulAddr : address
+/// @param puc : data
+/// @param xLen : bytes
+/// @return acknowledge
+uint8_t ucTargetWriteMem(uint32_t ulAddr, const uint8_t * puc, size_t xLen);
+
+/// @brief read a core register, the core must be halted
+/// @param ulReg : register number (DCRSR REGSEL)
+/// @param pulData : data output
+/// @return acknowledge
+uint8_t ucTargetReadReg(uint32_t ulReg, uint32_t * pulData);
+
+/// @brief write a core register, the core must be halted
+/// @param ulReg : register number (DCRSR REGSEL)
+/// @param ulData : data
+/// @return acknowledge
+uint8_t ucTargetWriteReg(uint32_t ulReg, uint32_t ulData);
+
+/// @brief read several core registers in one sequence, the core must be halted
+/// @param pucReg : registers (DCRSR REGSEL)
+/// @param xRegs : number of registers
+/// @param pulData : data output, one word per register
+/// @return acknowledge
+uint8_t ucTargetReadRegs(const uint8_t * pucReg, size_t xRegs, uint32_t * pulData);
+
+/// @brief halt the core and wait for it
+/// @return acknowledge
+uint8_t ucTargetHalt(void);
+
+/// @brief let the core run
+/// @return acknowledge
+uint8_t ucTargetResume(void);
+
+/// @brief execute one instruction with interrupts masked
+/// @return acknowledge
+uint8_t ucTargetStep(void);
+
+/// @brief single-step the halted core with interrupts masked and sample core registers after every step
+/// @param pucReg : registers to sample (DCRSR REGSEL)
+/// @param xRegs : number of registers
+/// @param pulOut : samples output, xRegs words per step
+/// @param xSteps : steps
+/// @param pxDone : steps done output
+/// @return acknowledge, DAP_TRANSFER_ERROR when the core did not halt after a step
+uint8_t ucTargetStepTrace(const uint8_t * pucReg, size_t xRegs, uint32_t * pulOut, size_t xSteps, size_t * pxDone);
+
+/// @brief check if the core is halted
+/// @param pxHalted : state output
+/// @return acknowledge
+uint8_t ucTargetIsHalted(bool * pxHalted);
+
+/// @brief reset the core through AIRCR
+/// @param xHalt : true to stop at the reset vector
+/// @return acknowledge
+uint8_t ucTargetReset(bool xHalt);
+
+/// @brief set or clear a FPB breakpoint
+/// @param ulAddr : instruction address
+/// @param xSet : true to set, false to clear
+/// @return acknowledge, DAP_TRANSFER_ERROR when no comparator is free or found
+uint8_t ucTargetBreakpoint(uint32_t ulAddr, bool xSet);
+
+/// @brief set or clear a DWT watchpoint
+/// @param ulAddr : data address
+/// @param ulLen : bytes (power of 2)
+/// @param eKind : access kind
+/// @param xSet : true to set, false to clear
+/// @return acknowledge, DAP_TRANSFER_ERROR when no comparator is free or found
+uint8_t ucTargetWatchpoint(uint32_t ulAddr, uint32_t ulLen, target_watch_t eKind, bool xSet);
+
+/// @brief find the watchpoint that halted the core (DWT MATCHED)
+/// @param pulAddr : watched address output
+/// @param peKind : access kind output
+/// @return acknowledge, DAP_TRANSFER_ERROR when no watchpoint matched
+uint8_t ucTargetWatchHit(uint32_t * pulAddr, target_watch_t * peKind);
+
+/// @brief clear all breakpoints and watchpoints set through this module
+/// @return acknowledge
+uint8_t ucTargetClearDebugPoints(void);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* TARGET_H_ */
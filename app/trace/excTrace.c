@@ -0,0 +1,203 @@
+#include <string.h>
+#include "excTrace.h"
+#include "task.h"
+
+/*-----------------------------------------------------------*/
+
+/* active exception */
+typedef struct exc_trace_frame_t
+{
+    uint32_t ulNumber;
+    uint64_t ullEntry;                  // time of entry
+} exc_trace_frame_t;
+
+/* tracker state */
+typedef struct exc_trace_t
+{
+    exc_trace_status_t xStatus;
+    uint32_t ulDepth;                   // frames on the stack
+    exc_trace_frame_t xStack[EXC_TRACE_DEPTH];
+    exc_trace_stats_t xStats[EXC_TRACE_NUMBERS];
+} exc_trace_t;
+
+static exc_trace_t xExc;
+
+/*-----------------------------------------------------------*/
+
+/// @brief account one residence
+/// @param ulNumber : exception number
+/// @param ulCycles : entry to exit
+static void prvExcTraceResidence(uint32_t ulNumber, uint32_t ulCycles)
+{
+    exc_trace_stats_t * px;
+    uint32_t ulBin = 0U;
+
+    if (ulNumber >= EXC_TRACE_NUMBERS)
+    {
+        return;
+    }
+    px = &xExc.xStats[ulNumber];
+    if (ulCycles != 0U)
+    {
+        // bit length of the residence, less the width of bin 0
+        ulBin = 32U - (uint32_t)__builtin_clz(ulCycles);
+        ulBin = (ulBin > EXC_TRACE_BIN_SHIFT) ? (ulBin - EXC_TRACE_BIN_SHIFT) : 0U;
+        if (ulBin >= EXC_TRACE_BINS)
+        {
+            ulBin = EXC_TRACE_BINS - 1U;
+        }
+    }
+    px->ulBin[ulBin] += 1U;
+    px->ullSum += ulCycles;
+    if (ulCycles < px->ulMin)
+    {
+        px->ulMin = ulCycles;
+    }
+    if (ulCycles > px->ulMax)
+    {
+        px->ulMax = ulCycles;
+    }
+}
+
+/// @brief an exception was entered
+/// @param ulNumber : exception number
+/// @param ullTime : time of entry
+static void prvExcTraceEnter(uint32_t ulNumber, uint64_t ullTime)
+{
+    uint32_t ulDepth;
+
+    if (xExc.ulDepth == EXC_TRACE_DEPTH)
+    {
+        // deeper than tracked, the oldest frame gives way
+        memmove(&xExc.xStack[0], &xExc.xStack[1], (EXC_TRACE_DEPTH - 1U) * sizeof(exc_trace_frame_t));
+        xExc.ulDepth -= 1U;
+        xExc.xStatus.ulUnmatched += 1U;
+    }
+    xExc.xStack[xExc.ulDepth].ulNumber = ulNumber;
+    xExc.xStack[xExc.ulDepth].ullEntry = ullTime;
+    xExc.ulDepth += 1U;
+    ulDepth = xExc.ulDepth;
+    if (ulDepth > xExc.xStatus.ulMaxDepth)
+    {
+        xExc.xStatus.ulMaxDepth = ulDepth;
+    }
+    if (ulNumber >= EXC_TRACE_NUMBERS)
+    {
+        xExc.xStatus.ulUntracked += 1U;
+        return;
+    }
+    xExc.xStats[ulNumber].ulEntries += 1U;
+    if (ulDepth > xExc.xStats[ulNumber].ulMaxDepth)
+    {
+        xExc.xStats[ulNumber].ulMaxDepth = ulDepth;
+    }
+}
+
+/// @brief an exception was left
+/// @param ulNumber : exception number
+/// @param ullTime : time of exit
+static void prvExcTraceExit(uint32_t ulNumber, uint64_t ullTime)
+{
+    uint32_t ulFrame = xExc.ulDepth;
+
+    // the innermost frame of the number, frames above it missed their exit
+    while ((ulFrame != 0U) && (xExc.xStack[ulFrame - 1U].ulNumber != ulNumber))
+    {
+        ulFrame--;
+    }
+    if (ulFrame == 0U)
+    {
+        xExc.xStatus.ulUnmatched += 1U;
+        return;
+    }
+    xExc.xStatus.ulUnmatched += xExc.ulDepth - ulFrame;
+    xExc.ulDepth = ulFrame - 1U;
+    prvExcTraceResidence(ulNumber, (uint32_t)(ullTime - xExc.xStack[ulFrame - 1U].ullEntry));
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief one exception trace packet
+/// @param ulNumber : exception number
+/// @param ulFunction : EXC_TRACE_ENTER, EXC_TRACE_EXIT or EXC_TRACE_RETURN
+/// @param ullTime : timestamp clock cycles
+void vExcTraceEvent(uint32_t ulNumber, uint32_t ulFunction, uint64_t ullTime)
+{
+    taskENTER_CRITICAL();
+    xExc.xStatus.ulEvents += 1U;
+    switch (ulFunction)
+    {
+    case EXC_TRACE_ENTER:
+        prvExcTraceEnter(ulNumber, ullTime);
+        break;
+    case EXC_TRACE_EXIT:
+        prvExcTraceExit(ulNumber, ullTime);
+        break;
+    case EXC_TRACE_RETURN:
+        // back in thread mode nothing can be active any more
+        if ((ulNumber == 0U) && (xExc.ulDepth != 0U))
+        {
+            xExc.xStatus.ulUnmatched += xExc.ulDepth;
+            xExc.ulDepth = 0U;
+        }
+        break;
+    default:
+        break;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/// @brief packets were lost, the nesting stack is dropped
+void vExcTraceLost(void)
+{
+    taskENTER_CRITICAL();
+    if (xExc.ulDepth != 0U)
+    {
+        xExc.xStatus.ulLost += 1U;
+        xExc.ulDepth = 0U;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/// @brief get the statistics of an exception number
+/// @param ulNumber : exception number
+/// @param px : output
+/// @return pdPASS : got them; pdFAIL : number not tracked
+BaseType_t xExcTraceGet(uint32_t ulNumber, exc_trace_stats_t * px)
+{
+    if (ulNumber >= EXC_TRACE_NUMBERS)
+    {
+        return pdFAIL;
+    }
+    taskENTER_CRITICAL();
+    *px = xExc.xStats[ulNumber];
+    taskEXIT_CRITICAL();
+    if (px->ulEntries == 0U)
+    {
+        px->ulMin = 0U;
+    }
+    return pdPASS;
+}
+
+/// @brief get the tracker state
+/// @param px : output
+void vExcTraceStatus(exc_trace_status_t * px)
+{
+    taskENTER_CRITICAL();
+    *px = xExc.xStatus;
+    taskEXIT_CRITICAL();
+}
+
+/// @brief clear all statistics
+void vExcTraceClear(void)
+{
+    taskENTER_CRITICAL();
+    memset(&xExc, 0, sizeof(xExc));
+    for (uint32_t i = 0U; i < EXC_TRACE_NUMBERS; i++)
+    {
+        xExc.xStats[i].ulMin = UINT32_MAX;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
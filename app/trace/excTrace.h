@@ -0,0 +1,94 @@
+#ifndef EXC_TRACE_H_
+#define EXC_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Exception trace statistics: the ITM demultiplexer (itm.h) hands every
+ * DWT exception trace packet in with the local timestamp that follows it.
+ * Entries and exits are matched on a nesting stack, per exception number:
+ *
+ *      entries, shortest, longest and summed residence (entry to exit,
+ *      nested exceptions included, in timestamp clock cycles), deepest
+ *      nesting seen at entry (1 = taken from thread mode) and a residence
+ *      histogram of EXC_TRACE_BINS bins, bin 0 below 2^EXC_TRACE_BIN_SHIFT
+ *      cycles, every further bin twice as wide, the last one open ended
+ *
+ * An overflow loses packets, the stack is dropped then and exits without
+ * their entry are counted only. The target needs DWT_CTRL.EXCTRCENA and
+ * ITM_TCR.TSENA, 'swo on <baud> <cpu hz>' sets both.
+ */
+
+/* exception numbers with statistics: 16 system exceptions and 80 irqs */
+#define EXC_TRACE_NUMBERS       96U
+/* residence histogram */
+#define EXC_TRACE_BINS          12U
+#define EXC_TRACE_BIN_SHIFT     6U
+/* nesting levels tracked */
+#define EXC_TRACE_DEPTH         16U
+
+/* DWT exception trace functions */
+#define EXC_TRACE_ENTER         1U
+#define EXC_TRACE_EXIT          2U
+#define EXC_TRACE_RETURN        3U
+
+/* statistics of one exception number */
+typedef struct exc_trace_stats_t
+{
+    uint32_t ulEntries;
+    uint32_t ulMin;                     // shortest residence (cycles)
+    uint32_t ulMax;                     // longest residence (cycles)
+    uint64_t ullSum;                    // summed residence (cycles)
+    uint32_t ulMaxDepth;                // deepest nesting at entry
+    uint32_t ulBin[EXC_TRACE_BINS];     // residence histogram
+} exc_trace_stats_t;
+
+/* tracker state, for display */
+typedef struct exc_trace_status_t
+{
+    uint32_t ulEvents;                  // exception trace packets
+    uint32_t ulUnmatched;               // exits without their entry, entries without their exit
+    uint32_t ulLost;                    // stacks dropped on overflow
+    uint32_t ulUntracked;               // entries of numbers from EXC_TRACE_NUMBERS on
+    uint32_t ulMaxDepth;                // deepest nesting seen
+} exc_trace_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief one exception trace packet
+/// @param ulNumber : exception number
+/// @param ulFunction : EXC_TRACE_ENTER, EXC_TRACE_EXIT or EXC_TRACE_RETURN
+/// @param ullTime : timestamp clock cycles
+void vExcTraceEvent(uint32_t ulNumber, uint32_t ulFunction, uint64_t ullTime);
+
+/// @brief packets were lost, the nesting stack is dropped
+void vExcTraceLost(void);
+
+/// @brief get the statistics of an exception number
+/// @param ulNumber : exception number
+/// @param px : output
+/// @return pdPASS : got them; pdFAIL : number not tracked
+BaseType_t xExcTraceGet(uint32_t ulNumber, exc_trace_stats_t * px);
+
+/// @brief get the tracker state
+/// @param px : output
+void vExcTraceStatus(exc_trace_status_t * px);
+
+/// @brief clear all statistics
+void vExcTraceClear(void);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* EXC_TRACE_H_ */
@@ -0,0 +1,482 @@
+#include <string.h>
+#include "itm.h"
+#include "excTrace.h"
+#include "rp2350.h"
+
+/*-----------------------------------------------------------*/
+
+/* header table entry: kind in the high nibble, payload bytes in the low one */
+#define ITM_ENTRY(kind, size)   ((uint8_t)(((kind) << 4) | (size)))
+#define ITM_ENTRY_KIND(e)       ((e) >> 4)
+#define ITM_ENTRY_SIZE(e)       ((e) & 0x0FU)
+
+/* header kinds */
+#define ITM_KIND_SYNC           0U      // 0x00, zeros then 0x80
+#define ITM_KIND_OVERFLOW       1U      // 0x70
+#define ITM_KIND_TIME           2U      // local timestamp, header only
+#define ITM_KIND_TIME_CONT      3U      // local timestamp, continuation bytes follow
+#define ITM_KIND_EXT            4U      // extension, header only
+#define ITM_KIND_EXT_CONT       5U      // extension, continuation bytes follow
+#define ITM_KIND_SOFTWARE       6U      // instrumentation, port in bits 7:3
+#define ITM_KIND_HARDWARE       7U      // DWT, discriminator in bits 7:3
+#define ITM_KIND_GLOBAL         8U      // global timestamp, continuation bytes follow
+#define ITM_KIND_RESERVED       9U
+
+/* continuation bit of timestamp and extension payload bytes */
+#define ITM_CONTINUE            0x80U
+/* payload bits of a continuation byte */
+#define ITM_CONTINUE_BITS       7U
+/* last byte of a sync packet */
+#define ITM_SYNC_END            0x80U
+
+/* DWT discriminators */
+#define ITM_DWT_EVENT           0U
+#define ITM_DWT_EXCEPTION       1U
+#define ITM_DWT_PC_SAMPLE       2U
+#define ITM_DWT_DATA_FIRST      8U
+#define ITM_DWT_DATA_LAST       23U
+
+/* exception trace packets waiting for the timestamp that follows them */
+#define ITM_EXC_PENDING         8U
+
+/* parser state */
+typedef enum
+{
+    ITM_STATE_HEADER = 0,
+    ITM_STATE_PAYLOAD,                  // source packet payload
+    ITM_STATE_CONTINUE,                 // up to a byte without the continuation bit
+    ITM_STATE_SYNC,                     // zeros of a sync packet
+    ITM_STATE_LOST,                     // up to the next sync packet
+} itm_state_t;
+
+/* port stream, single writer (the parser) and single reader */
+typedef struct itm_stream_t
+{
+    uint8_t * puc;                      // ITM_STREAM_SIZE bytes
+    volatile uint32_t ulHead;           // next byte written
+    volatile uint32_t ulTail;           // next byte read
+    uint8_t ucPort;
+} itm_stream_t;
+
+/* demultiplexer state */
+typedef struct itm_t
+{
+    ItmWrite_t xConsole;
+    itm_state_t eState;
+    uint8_t ucHeader;
+    uint8_t ucSize;                     // payload bytes of the current packet
+    uint8_t ucCount;                    // payload bytes received
+    uint8_t ucPayload[4];
+    bool xLocal;                        // continuation bytes carry a local timestamp
+    uint8_t ucShift;                    // timestamp bits received
+    uint32_t ulDelta;                   // local timestamp value
+    uint64_t ullTime;                   // sum of the local timestamps
+    uint32_t ulPending;
+    uint16_t usPending[ITM_EXC_PENDING];    // number, function in bits 13:12
+    uint8_t ucPortStream[ITM_PORTS];    // stream of each port
+    itm_stream_t xStream[ITM_STREAMS];
+    itm_stats_t xStats;
+    size_t xConsoleLen;
+    uint8_t ucConsole[ITM_CONSOLE_SIZE];
+} itm_t;
+
+static itm_t xItm;
+static uint8_t ucItmTable[256];
+
+STATIC_ASSERT((ITM_STREAM_SIZE & (ITM_STREAM_SIZE - 1U)) == 0U, "ITM_STREAM_SIZE must be a power of two");
+
+/*-----------------------------------------------------------*/
+
+/// @brief fill the header table
+static void prvItmTable(void)
+{
+    static const uint8_t ucSourceSize[4] = { 0U, 1U, 2U, 4U };
+
+    for (uint32_t h = 0U; h < 256U; h++)
+    {
+        uint8_t ucEntry;
+
+        if ((h & 0x03U) != 0U)
+        {
+            ucEntry = ITM_ENTRY(((h & 0x04U) != 0U) ? ITM_KIND_HARDWARE : ITM_KIND_SOFTWARE, ucSourceSize[h & 0x03U]);
+        }
+        else if (h == 0x00U)
+        {
+            ucEntry = ITM_ENTRY(ITM_KIND_SYNC, 0U);
+        }
+        else if (h == 0x70U)
+        {
+            ucEntry = ITM_ENTRY(ITM_KIND_OVERFLOW, 0U);
+        }
+        else if ((h & 0x8FU) == 0x00U)
+        {
+            // 0TTT0000, local timestamp format 2
+            ucEntry = ITM_ENTRY(ITM_KIND_TIME, 0U);
+        }
+        else if ((h & 0xCFU) == 0xC0U)
+        {
+            // 11TC0000, local timestamp format 1
+            ucEntry = ITM_ENTRY(ITM_KIND_TIME_CONT, 0U);
+        }
+        else if ((h == 0x94U) || (h == 0xB4U))
+        {
+            ucEntry = ITM_ENTRY(ITM_KIND_GLOBAL, 0U);
+        }
+        else if ((h & 0x08U) != 0U)
+        {
+            // CEEE1S00
+            ucEntry = ITM_ENTRY(((h & ITM_CONTINUE) != 0U) ? ITM_KIND_EXT_CONT : ITM_KIND_EXT, 0U);
+        }
+        else
+        {
+            ucEntry = ITM_ENTRY(ITM_KIND_RESERVED, 0U);
+        }
+        ucItmTable[h] = ucEntry;
+    }
+}
+
+/// @brief write the collected console bytes
+static void prvItmFlush(void)
+{
+    if ((xItm.xConsoleLen != 0U) && (xItm.xConsole != NULL))
+    {
+        (void)xItm.xConsole(xItm.ucConsole, (int)xItm.xConsoleLen);
+        xItm.xStats.ulConsole += (uint32_t)xItm.xConsoleLen;
+    }
+    xItm.xConsoleLen = 0U;
+}
+
+/// @brief append to a stream
+/// @param px : stream
+/// @param puc : bytes
+/// @param xLen : count
+static void prvItmStreamPut(itm_stream_t * px, const uint8_t * puc, size_t xLen)
+{
+    uint32_t ulHead = px->ulHead;
+    uint32_t ulTail = px->ulTail;
+
+    for (size_t i = 0U; i < xLen; i++)
+    {
+        uint32_t ulNext = (ulHead + 1U) & (ITM_STREAM_SIZE - 1U);
+
+        if (ulNext == ulTail)
+        {
+            xItm.xStats.ulDropped += (uint32_t)(xLen - i);
+            break;
+        }
+        px->puc[ulHead] = puc[i];
+        ulHead = ulNext;
+    }
+    // the bytes are in place before the reader can see them
+    px->ulHead = ulHead;
+}
+
+/// @brief hand the exception trace packets waiting to the statistics
+static void prvItmExcFlush(void)
+{
+    for (uint32_t i = 0U; i < xItm.ulPending; i++)
+    {
+        vExcTraceEvent(xItm.usPending[i] & 0x1FFU, (uint32_t)xItm.usPending[i] >> 12, xItm.ullTime);
+    }
+    xItm.ulPending = 0U;
+}
+
+/// @brief a local timestamp, it gives the time of the packets before it
+/// @param ulDelta : timestamp clock cycles since the previous one
+static void prvItmTime(uint32_t ulDelta)
+{
+    xItm.xStats.ulTimestamp += 1U;
+    xItm.ullTime += ulDelta;
+    prvItmExcFlush();
+}
+
+/// @brief a complete source packet
+static void prvItmPacket(void)
+{
+    uint32_t ulId = (uint32_t)xItm.ucHeader >> 3;
+
+    if ((xItm.ucHeader & 0x04U) == 0U)
+    {
+        uint8_t ucStream = xItm.ucPortStream[ulId];
+
+        xItm.xStats.ulPort[ulId] += 1U;
+        if (ulId == ITM_CONSOLE_PORT)
+        {
+            if ((xItm.xConsoleLen + xItm.ucSize) > ITM_CONSOLE_SIZE)
+            {
+                prvItmFlush();
+            }
+            memcpy(&xItm.ucConsole[xItm.xConsoleLen], xItm.ucPayload, xItm.ucSize);
+            xItm.xConsoleLen += xItm.ucSize;
+        }
+        if (ucStream != ITM_STREAM_OFF)
+        {
+            prvItmStreamPut(&xItm.xStream[ucStream], xItm.ucPayload, xItm.ucSize);
+        }
+        return;
+    }
+    switch (ulId)
+    {
+    case ITM_DWT_EVENT:
+        for (uint32_t i = 0U; i < ITM_EVENTS; i++)
+        {
+            xItm.xStats.ulEvent[i] += ((uint32_t)xItm.ucPayload[0] >> i) & 1U;
+        }
+        break;
+    case ITM_DWT_EXCEPTION:
+        xItm.xStats.ulException += 1U;
+        if (xItm.ulPending == ITM_EXC_PENDING)
+        {
+            // no timestamps coming, the time stands still
+            prvItmExcFlush();
+        }
+        xItm.usPending[xItm.ulPending++] = (uint16_t)(xItm.ucPayload[0] | ((xItm.ucPayload[1] & 0x31U) << 8));
+        break;
+    case ITM_DWT_PC_SAMPLE:
+        xItm.xStats.ulPcSample += 1U;
+        break;
+    default:
+        if ((ulId >= ITM_DWT_DATA_FIRST) && (ulId <= ITM_DWT_DATA_LAST))
+        {
+            xItm.xStats.ulDataTrace += 1U;
+        }
+        else
+        {
+            xItm.xStats.ulReserved += 1U;
+        }
+        break;
+    }
+}
+
+/// @brief a header byte
+/// @param uc : header
+static void prvItmHeader(uint8_t uc)
+{
+    uint8_t ucEntry = ucItmTable[uc];
+
+    switch (ITM_ENTRY_KIND(ucEntry))
+    {
+    case ITM_KIND_SOFTWARE:
+    case ITM_KIND_HARDWARE:
+        xItm.ucHeader = uc;
+        xItm.ucSize = ITM_ENTRY_SIZE(ucEntry);
+        xItm.ucCount = 0U;
+        xItm.eState = ITM_STATE_PAYLOAD;
+        break;
+    case ITM_KIND_SYNC:
+        xItm.eState = ITM_STATE_SYNC;
+        break;
+    case ITM_KIND_OVERFLOW:
+        xItm.xStats.ulOverflow += 1U;
+        prvItmExcFlush();
+        vExcTraceLost();
+        break;
+    case ITM_KIND_TIME:
+        prvItmTime(((uint32_t)uc >> 4) & 0x07U);
+        break;
+    case ITM_KIND_TIME_CONT:
+        xItm.xLocal = true;
+        xItm.ucShift = 0U;
+        xItm.ulDelta = 0U;
+        xItm.eState = ITM_STATE_CONTINUE;
+        break;
+    case ITM_KIND_GLOBAL:
+        xItm.xStats.ulTimestamp += 1U;
+        xItm.xLocal = false;
+        xItm.eState = ITM_STATE_CONTINUE;
+        break;
+    case ITM_KIND_EXT:
+        xItm.xStats.ulExtension += 1U;
+        break;
+    case ITM_KIND_EXT_CONT:
+        xItm.xStats.ulExtension += 1U;
+        xItm.xLocal = false;
+        xItm.eState = ITM_STATE_CONTINUE;
+        break;
+    default:
+        xItm.xStats.ulReserved += 1U;
+        xItm.eState = ITM_STATE_LOST;
+        break;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief set the parser to wait for a header, clear the counters and the streams
+/// @param xConsole : console write function, NULL drops port 0
+void vItmInit(ItmWrite_t xConsole)
+{
+    prvItmTable();
+    memset(&xItm, 0, sizeof(xItm));
+    xItm.xConsole = xConsole;
+    xItm.eState = ITM_STATE_HEADER;
+    vExcTraceClear();
+    memset(xItm.ucPortStream, ITM_STREAM_OFF, sizeof(xItm.ucPortStream));
+    for (uint32_t s = 0U; s < ITM_STREAMS; s++)
+    {
+        xItm.xStream[s].puc = (uint8_t *)(PSRAM_ITM_BASE + (s * ITM_STREAM_SIZE));
+        xItm.xStream[s].ucPort = ITM_STREAM_OFF;
+    }
+}
+
+/// @brief parse captured SWO bytes, the console is written before it returns
+/// @param puc : bytes
+/// @param xLen : count
+void vItmFeed(const uint8_t * puc, size_t xLen)
+{
+    size_t i = 0U;
+
+    xItm.xStats.ulBytes += (uint32_t)xLen;
+    while (i < xLen)
+    {
+        uint8_t uc = puc[i];
+
+        switch (xItm.eState)
+        {
+        case ITM_STATE_HEADER:
+            prvItmHeader(uc);
+            break;
+        case ITM_STATE_PAYLOAD:
+            xItm.ucPayload[xItm.ucCount++] = uc;
+            if (xItm.ucCount == xItm.ucSize)
+            {
+                prvItmPacket();
+                xItm.eState = ITM_STATE_HEADER;
+            }
+            break;
+        case ITM_STATE_CONTINUE:
+            if (xItm.xLocal && (xItm.ucShift < 32U))
+            {
+                xItm.ulDelta |= ((uint32_t)uc & 0x7FU) << xItm.ucShift;
+                xItm.ucShift += ITM_CONTINUE_BITS;
+            }
+            if ((uc & ITM_CONTINUE) == 0U)
+            {
+                if (xItm.xLocal)
+                {
+                    prvItmTime(xItm.ulDelta);
+                }
+                xItm.eState = ITM_STATE_HEADER;
+            }
+            break;
+        case ITM_STATE_SYNC:
+            if (uc == ITM_SYNC_END)
+            {
+                xItm.xStats.ulSync += 1U;
+                xItm.eState = ITM_STATE_HEADER;
+            }
+            else if (uc != 0x00U)
+            {
+                // zeros without the end of a sync, take the byte as a header
+                xItm.eState = ITM_STATE_HEADER;
+                continue;
+            }
+            break;
+        default:
+            if (uc == 0x00U)
+            {
+                xItm.eState = ITM_STATE_SYNC;
+            }
+            break;
+        }
+        i++;
+    }
+    prvItmFlush();
+}
+
+/// @brief map a stream to a stimulus port, the stream is emptied
+/// @param ulStream : stream
+/// @param ulPort : stimulus port, ITM_STREAM_OFF to unmap
+/// @return pdPASS : mapped; pdFAIL : no such stream or port
+BaseType_t xItmStream(uint32_t ulStream, uint32_t ulPort)
+{
+    itm_stream_t * px;
+
+    if ((ulStream >= ITM_STREAMS) || ((ulPort >= ITM_PORTS) && (ulPort != ITM_STREAM_OFF)))
+    {
+        return pdFAIL;
+    }
+    px = &xItm.xStream[ulStream];
+    taskENTER_CRITICAL();
+    if (px->ucPort != ITM_STREAM_OFF)
+    {
+        xItm.ucPortStream[px->ucPort] = ITM_STREAM_OFF;
+    }
+    if (ulPort != ITM_STREAM_OFF)
+    {
+        // a port feeds one stream, it leaves the one it fed before
+        uint8_t ucOld = xItm.ucPortStream[ulPort];
+        if (ucOld != ITM_STREAM_OFF)
+        {
+            xItm.xStream[ucOld].ucPort = ITM_STREAM_OFF;
+        }
+        xItm.ucPortStream[ulPort] = (uint8_t)ulStream;
+    }
+    px->ucPort = (uint8_t)ulPort;
+    px->ulHead = 0U;
+    px->ulTail = 0U;
+    taskEXIT_CRITICAL();
+    return pdPASS;
+}
+
+/// @brief get the port a stream is mapped to
+/// @param ulStream : stream
+/// @return stimulus port, ITM_STREAM_OFF when not mapped
+uint32_t ulItmStreamPort(uint32_t ulStream)
+{
+    return (ulStream < ITM_STREAMS) ? xItm.xStream[ulStream].ucPort : ITM_STREAM_OFF;
+}
+
+/// @brief take bytes from a stream, oldest first
+/// @param ulStream : stream
+/// @param puc : output
+/// @param xMax : most bytes to take
+/// @return bytes taken
+size_t xItmRead(uint32_t ulStream, uint8_t * puc, size_t xMax)
+{
+    itm_stream_t * px;
+    uint32_t ulHead, ulTail;
+    size_t n = 0U;
+
+    if (ulStream >= ITM_STREAMS)
+    {
+        return 0U;
+    }
+    px = &xItm.xStream[ulStream];
+    ulHead = px->ulHead;
+    ulTail = px->ulTail;
+    while ((n < xMax) && (ulTail != ulHead))
+    {
+        puc[n++] = px->puc[ulTail];
+        ulTail = (ulTail + 1U) & (ITM_STREAM_SIZE - 1U);
+    }
+    px->ulTail = ulTail;
+    return n;
+}
+
+/// @brief bytes waiting in a stream
+/// @param ulStream : stream
+/// @return bytes
+size_t xItmPending(uint32_t ulStream)
+{
+    if (ulStream >= ITM_STREAMS)
+    {
+        return 0U;
+    }
+    return (xItm.xStream[ulStream].ulHead - xItm.xStream[ulStream].ulTail) & (ITM_STREAM_SIZE - 1U);
+}
+
+/// @brief get the counters
+/// @param px : output
+void vItmStats(itm_stats_t * px)
+{
+    *px = xItm.xStats;
+}
+
+/// @brief clear the counters
+void vItmClear(void)
+{
+    memset(&xItm.xStats, 0, sizeof(xItm.xStats));
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,123 @@
+#ifndef ITM_H_
+#define ITM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * ITM/DWT packet demultiplexer. The SWO byte stream is parsed by a state
+ * machine driven by a 256 entry header table, one lookup per header and no
+ * per packet branching on the header bits, so it keeps up with the fastest
+ * SWO rate the capture takes:
+ *
+ *      instrumentation port 0      -> console write function (a cdc port)
+ *      ports mapped to a stream    -> ring in psram (PSRAM_ITM_BASE), the
+ *                                     host drains it with ID_DAP_VENDOR_ITM
+ *      DWT event counter wraps     -> counters per event
+ *      DWT exception trace         -> per exception statistics (excTrace.h),
+ *                                     timed by the local timestamp after it
+ *      overflow, sync, timestamps,
+ *      PC samples, data trace      -> counters
+ *
+ * After a reserved header the parser drops bytes up to the next sync
+ * packet. Stream bytes that find a full ring are dropped and counted.
+ */
+
+/* stimulus ports */
+#define ITM_PORTS               32U
+/* port written to the console */
+#define ITM_CONSOLE_PORT        0U
+/* console bytes collected before a write */
+#define ITM_CONSOLE_SIZE        256U
+/* port streams and their ring size */
+#define ITM_STREAMS             4U
+#define ITM_STREAM_SIZE         (PSRAM_ITM_SIZE / ITM_STREAMS)
+/* stream not mapped to a port */
+#define ITM_STREAM_OFF          0xFFU
+
+/* DWT event counter packet bits */
+#define ITM_EVENT_CPI           0U
+#define ITM_EVENT_EXC           1U
+#define ITM_EVENT_SLEEP         2U
+#define ITM_EVENT_LSU           3U
+#define ITM_EVENT_FOLD          4U
+#define ITM_EVENT_CYC           5U
+#define ITM_EVENTS              6U
+
+/* Prototype of the console write function: buffer, size */
+typedef int (* ItmWrite_t)(uint8_t *, int);
+
+/* parser counters, for display */
+typedef struct itm_stats_t
+{
+    uint32_t ulBytes;                   // stream bytes parsed
+    uint32_t ulSync;                    // synchronisation packets
+    uint32_t ulOverflow;                // overflow packets
+    uint32_t ulTimestamp;               // local and global timestamp packets
+    uint32_t ulExtension;               // extension packets
+    uint32_t ulReserved;                // reserved headers, bytes dropped to the next sync
+    uint32_t ulPort[ITM_PORTS];         // instrumentation packets per port
+    uint32_t ulConsole;                 // console bytes written
+    uint32_t ulDropped;                 // stream bytes lost to a full ring
+    uint32_t ulEvent[ITM_EVENTS];       // DWT event counter wraps
+    uint32_t ulException;               // exception trace packets
+    uint32_t ulPcSample;                // periodic PC samples
+    uint32_t ulDataTrace;               // data trace packets
+} itm_stats_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief set the parser to wait for a header, clear the counters and the streams
+/// @param xConsole : console write function, NULL drops port 0
+void vItmInit(ItmWrite_t xConsole);
+
+/// @brief parse captured SWO bytes, the console is written before it returns
+/// @param puc : bytes
+/// @param xLen : count
+void vItmFeed(const uint8_t * puc, size_t xLen);
+
+/// @brief map a stream to a stimulus port, the stream is emptied
+/// @param ulStream : stream
+/// @param ulPort : stimulus port, ITM_STREAM_OFF to unmap
+/// @return pdPASS : mapped; pdFAIL : no such stream or port
+BaseType_t xItmStream(uint32_t ulStream, uint32_t ulPort);
+
+/// @brief get the port a stream is mapped to
+/// @param ulStream : stream
+/// @return stimulus port, ITM_STREAM_OFF when not mapped
+uint32_t ulItmStreamPort(uint32_t ulStream);
+
+/// @brief take bytes from a stream, oldest first
+/// @param ulStream : stream
+/// @param puc : output
+/// @param xMax : most bytes to take
+/// @return bytes taken
+size_t xItmRead(uint32_t ulStream, uint8_t * puc, size_t xMax);
+
+/// @brief bytes waiting in a stream
+/// @param ulStream : stream
+/// @return bytes
+size_t xItmPending(uint32_t ulStream);
+
+/// @brief get the counters
+/// @param px : output
+void vItmStats(itm_stats_t * px);
+
+/// @brief clear the counters
+void vItmClear(void);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ITM_H_ */
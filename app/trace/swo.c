@@ -0,0 +1,234 @@
+#include <string.h>
+#include "swo.h"
+#include "target/target.h"
+#include "rp2350.h"
+#include "semphr.h"
+#include "hardware/uart.h"
+
+/*-----------------------------------------------------------*/
+
+/* target trace registers */
+#define SWO_TPIU_CSPSR          0xE0040004UL    // current port size
+#define SWO_TPIU_ACPR           0xE0040010UL    // prescaler
+#define SWO_TPIU_SPPR           0xE00400F0UL    // pin protocol
+#define SWO_TPIU_FFCR           0xE0040304UL    // formatter control
+#define SWO_ITM_TER             0xE0000E00UL    // stimulus port enables
+#define SWO_ITM_TCR             0xE0000E80UL
+#define SWO_ITM_LAR             0xE0000FB0UL
+#define SWO_ITM_UNLOCK          0xC5ACCE55UL
+#define SWO_SPPR_NRZ            2UL
+#define SWO_FFCR_TRIGIN         (1UL << 8)      // formatter off, trigger on
+#define SWO_TCR_ITMENA          (1UL << 0)
+#define SWO_TCR_TSENA           (1UL << 1)
+#define SWO_TCR_SYNCENA         (1UL << 2)
+#define SWO_TCR_DWTENA          (1UL << 3)
+#define SWO_TCR_BUSID           (1UL << 16)
+#define SWO_DWT_EXCTRCENA       (1UL << 16)
+
+/* transfers per dma run, then the channel is started again */
+#define SWO_DMA_COUNT           0x0FFFFFFFUL
+
+#if (SWO_PIN >= 0)
+/* a uart rx pin: 1, 5, 9, 13 ...; uart0 on 0-3 and 12-19, uart1 on 4-11 and 20-27 */
+STATIC_ASSERT((SWO_PIN & 3) == 1, "SWO_PIN must be a uart rx pin");
+#define SWO_CAPTURE_UART        UART_INSTANCE(((SWO_PIN + 4) >> 3) & 1)
+#endif
+
+/* capture state */
+typedef struct swo_state_t
+{
+    TaskHandle_t xTask;
+    SemaphoreHandle_t xLock;            // task against start and stop
+    swo_status_t xStatus;
+    int lChannel;                       // dma channel, -1 before the first start
+    uint32_t ulRead;                    // bytes of the current dma run taken
+} swo_state_t;
+
+static swo_state_t xSwo = { .lChannel = -1 };
+
+/*-----------------------------------------------------------*/
+
+#if (SWO_PIN >= 0)
+
+/* dma ring, aligned to its size for the dma ring wrap */
+static uint8_t ucSwoRing[SWO_RING_SIZE] __attribute__((aligned(SWO_RING_SIZE)));
+
+/// @brief set up the target trace output
+/// @param ulBaud : swo baud rate
+/// @param ulCpuHz : trace clock
+/// @return acknowledge
+static uint8_t prvSwoTarget(uint32_t ulBaud, uint32_t ulCpuHz)
+{
+    uint32_t ulData;
+
+    TARGET_TRY(ucTargetAttach());
+    TARGET_TRY(ucTargetReadWord(TARGET_DEMCR, &ulData));
+    TARGET_TRY(ucTargetWriteWord(TARGET_DEMCR, ulData | TARGET_DEMCR_TRCENA));
+    TARGET_TRY(ucTargetWriteWord(SWO_TPIU_CSPSR, 1UL));
+    TARGET_TRY(ucTargetWriteWord(SWO_TPIU_ACPR, (ulCpuHz / ulBaud) - 1UL));
+    TARGET_TRY(ucTargetWriteWord(SWO_TPIU_SPPR, SWO_SPPR_NRZ));
+    TARGET_TRY(ucTargetWriteWord(SWO_TPIU_FFCR, SWO_FFCR_TRIGIN));
+    TARGET_TRY(ucTargetWriteWord(SWO_ITM_LAR, SWO_ITM_UNLOCK));
+    TARGET_TRY(ucTargetWriteWord(SWO_ITM_TCR, SWO_TCR_BUSID | SWO_TCR_DWTENA | SWO_TCR_SYNCENA | SWO_TCR_TSENA | SWO_TCR_ITMENA));
+    TARGET_TRY(ucTargetWriteWord(SWO_ITM_TER, 0xFFFFFFFFUL));
+    // exception trace, the statistics of excTrace.h live on it
+    TARGET_TRY(ucTargetReadWord(TARGET_DWT_CTRL, &ulData));
+    TARGET_TRY(ucTargetWriteWord(TARGET_DWT_CTRL, ulData | SWO_DWT_EXCTRCENA));
+    return DAP_TRANSFER_OK;
+}
+
+/// @brief start a dma run into the ring
+static void prvSwoArm(void)
+{
+    dma_channel_config c = dma_channel_get_default_config((uint)xSwo.lChannel);
+
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, SWO_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(SWO_CAPTURE_UART, false));
+    xSwo.ulRead = 0U;
+    dma_channel_configure((uint)xSwo.lChannel, &c, ucSwoRing, &uart_get_hw(SWO_CAPTURE_UART)->dr, SWO_DMA_COUNT, true);
+}
+
+/// @brief hand what came in to the parser
+static void prvSwoPoll(void)
+{
+    bool xDone = !dma_channel_is_busy((uint)xSwo.lChannel);
+    uint32_t ulWritten = SWO_DMA_COUNT - (dma_hw->ch[xSwo.lChannel].transfer_count & SWO_DMA_COUNT);
+    uint32_t ulNew = ulWritten - xSwo.ulRead;
+
+    if (ulNew > SWO_RING_SIZE)
+    {
+        // the dma went round the ring, the oldest bytes are gone
+        xSwo.xStatus.ulOverrun += ulNew - SWO_RING_SIZE;
+        xSwo.ulRead = ulWritten - SWO_RING_SIZE;
+        ulNew = SWO_RING_SIZE;
+    }
+    while (ulNew != 0U)
+    {
+        uint32_t ulOffset = xSwo.ulRead & (SWO_RING_SIZE - 1U);
+        uint32_t ulLen = SWO_RING_SIZE - ulOffset;
+
+        if (ulLen > ulNew)
+        {
+            ulLen = ulNew;
+        }
+        vItmFeed(&ucSwoRing[ulOffset], ulLen);
+        xSwo.ulRead += ulLen;
+        xSwo.xStatus.ulBytes += ulLen;
+        ulNew -= ulLen;
+    }
+    if (xDone)
+    {
+        prvSwoArm();
+    }
+}
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the capture (stopped)
+void vSwoInit(void)
+{
+    xSwo.xLock = xSemaphoreCreateMutex();
+}
+
+/// @brief swo thread
+/// @param pv : swo task interface
+void vSwoTask(void * pv)
+{
+    vItmInit(((const swo_t *)pv)->w);
+    xSwo.xTask = xTaskGetCurrentTaskHandle();
+
+    do
+    {
+        (void)xTaskNotifyWait(0U, 0xFFFFFFFFUL, NULL, xSwo.xStatus.xRunning ? pdMS_TO_TICKS(SWO_POLL_MS) : portMAX_DELAY);
+#if (SWO_PIN >= 0)
+        xSemaphoreTake(xSwo.xLock, portMAX_DELAY);
+        if (xSwo.xStatus.xRunning)
+        {
+            prvSwoPoll();
+        }
+        xSemaphoreGive(xSwo.xLock);
+#endif
+    } while (true);
+}
+
+/// @brief start the capture
+/// @param ulBaud : swo baud rate
+/// @param ulCpuHz : target trace clock to set the target up as well, 0 to leave it alone
+/// @return pdPASS : started; pdFAIL : no SWO_PIN, bad baud rate or target not reachable
+BaseType_t xSwoStart(uint32_t ulBaud, uint32_t ulCpuHz)
+{
+#if (SWO_PIN >= 0)
+    uint8_t ucAck = DAP_TRANSFER_OK;
+
+    if ((ulBaud == 0U) || (ulBaud > SWO_BAUD_MAX) || ((ulCpuHz != 0U) && (ulCpuHz < ulBaud)))
+    {
+        return pdFAIL;
+    }
+    if (ulCpuHz != 0U)
+    {
+        vTargetAcquire();
+        ucAck = prvSwoTarget(ulBaud, ulCpuHz);
+        vTargetRelease();
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            return pdFAIL;
+        }
+    }
+    vSwoStop();
+    xSemaphoreTake(xSwo.xLock, portMAX_DELAY);
+    if (xSwo.lChannel < 0)
+    {
+        xSwo.lChannel = dma_claim_unused_channel(true);
+    }
+    xSwo.xStatus.ulBaud = uart_init(SWO_CAPTURE_UART, ulBaud);
+    uart_set_format(SWO_CAPTURE_UART, 8U, 1U, UART_PARITY_NONE);
+    uart_set_fifo_enabled(SWO_CAPTURE_UART, true);
+    gpio_set_function(SWO_PIN, GPIO_FUNC_UART);
+    xSwo.xStatus.ulBytes = 0U;
+    xSwo.xStatus.ulOverrun = 0U;
+    prvSwoArm();
+    xSwo.xStatus.xRunning = true;
+    xSemaphoreGive(xSwo.xLock);
+    if (xSwo.xTask != NULL)
+    {
+        xTaskNotify(xSwo.xTask, 0U, eNoAction);
+    }
+    return pdPASS;
+#else
+    (void)ulBaud;
+    (void)ulCpuHz;
+    return pdFAIL;
+#endif
+}
+
+/// @brief stop the capture
+void vSwoStop(void)
+{
+#if (SWO_PIN >= 0)
+    xSemaphoreTake(xSwo.xLock, portMAX_DELAY);
+    if (xSwo.xStatus.xRunning)
+    {
+        // what is in the ring still goes to the parser
+        prvSwoPoll();
+        dma_channel_abort((uint)xSwo.lChannel);
+        uart_deinit(SWO_CAPTURE_UART);
+        gpio_set_function(SWO_PIN, GPIO_FUNC_NULL);
+        xSwo.xStatus.xRunning = false;
+    }
+    xSemaphoreGive(xSwo.xLock);
+#endif
+}
+
+/// @brief get the capture state
+/// @param px : output
+void vSwoStatus(swo_status_t * px)
+{
+    *px = xSwo.xStatus;
+}
+
+/*-----------------------------------------------------------*/
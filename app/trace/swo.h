@@ -0,0 +1,88 @@
+#ifndef SWO_H_
+#define SWO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "itm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * SWO capture: the target's SWO (NRZ, 8N1) is received by a uart whose rx
+ * pin is SWO_PIN (top cmakelists.txt, -1 when the board has none). A dma
+ * channel copies the uart into a ring in sram, the task takes what came in
+ * every SWO_POLL_MS and hands it to the ITM demultiplexer (itm.h), which
+ * writes stimulus port 0 to the console of the task interface.
+ *
+ * With the target cpu clock given, xSwoStart() sets up the target as well:
+ * DEMCR.TRCENA, TPIU in NRZ mode without formatter at the requested baud
+ * rate, ITM on with sync, local timestamps and DWT packets, all stimulus
+ * ports enabled, DWT exception trace on.
+ */
+
+#ifndef SWO_PIN
+    #define SWO_PIN             -1
+#endif
+
+/* swo task name */
+#define SWO_TASK_NAME           "swo"
+/* swo task stack size(32-bit word) */
+#define SWO_TASK_STACK_SIZE     256U
+
+/* capture poll period (ms) */
+#define SWO_POLL_MS             1U
+/* dma ring size, 2^SWO_RING_BITS bytes: more than SWO_POLL_MS at SWO_BAUD_MAX */
+#define SWO_RING_BITS           14U
+#define SWO_RING_SIZE           (1U << SWO_RING_BITS)
+/* fastest baud rate the uart samples reliably (clk_peri / 16) */
+#define SWO_BAUD_MAX            (150000000U / 16U)
+
+/* swo task interface */
+typedef struct swo_t
+{
+    ItmWrite_t w;                       // console for stimulus port 0
+} swo_t;
+
+/* capture state, for display */
+typedef struct swo_status_t
+{
+    bool xRunning;
+    uint32_t ulBaud;                    // uart baud rate as set
+    uint32_t ulBytes;                   // bytes captured since start
+    uint32_t ulOverrun;                 // bytes lost to a ring overrun
+} swo_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the capture (stopped)
+void vSwoInit(void);
+
+/// @brief swo thread
+/// @param pv : swo task interface
+void vSwoTask(void * pv);
+
+/// @brief start the capture
+/// @param ulBaud : swo baud rate
+/// @param ulCpuHz : target trace clock to set the target up as well, 0 to leave it alone
+/// @return pdPASS : started; pdFAIL : no SWO_PIN, bad baud rate or target not reachable
+BaseType_t xSwoStart(uint32_t ulBaud, uint32_t ulCpuHz);
+
+/// @brief stop the capture
+void vSwoStop(void);
+
+/// @brief get the capture state
+/// @param px : output
+void vSwoStatus(swo_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SWO_H_ */
@@ -0,0 +1,295 @@
+#include <string.h>
+#include "memWatch.h"
+#include "target/target.h"
+#include "rp2350.h"
+#include "semphr.h"
+
+/*-----------------------------------------------------------*/
+
+/* log entries */
+#define MWATCH_LOG_ENTRIES      (PSRAM_MWATCH_LOG_SIZE / sizeof(mwatch_change_t))
+
+/* watched region */
+typedef struct mwatch_region_t
+{
+    uint32_t ulAddr;
+    uint32_t ulSize;            // bytes, whole words
+    uint32_t ulOffset;          // words into the baseline
+    bool xBaseline;             // baseline taken
+} mwatch_region_t;
+
+/* memory watch state */
+typedef struct mwatch_t
+{
+    TaskHandle_t xTask;
+    SemaphoreHandle_t xLock;    // task against configuration
+    mwatch_status_t xStatus;
+    mwatch_region_t xRegion[MWATCH_REGIONS];
+    uint32_t * pulBaseline;     // PSRAM_MWATCH_SIZE bytes
+    mwatch_change_t * pxLog;    // MWATCH_LOG_ENTRIES
+    uint32_t ulHead;            // next entry written
+    uint32_t ulTail;            // next entry read
+    uint32_t ulChunk[MWATCH_CHUNK_SIZE / 4U];
+} mwatch_t;
+
+static mwatch_t xWatch = { .xStatus = { .ulPeriodMs = MWATCH_PERIOD_DEFAULT } };
+
+/*-----------------------------------------------------------*/
+
+/// @brief log a changed word
+/// @param ulTimeMs : time stamp
+/// @param ulAddr : word address
+/// @param ulOld : baseline value
+/// @param ulNew : value read
+static void prvMemWatchLog(uint32_t ulTimeMs, uint32_t ulAddr, uint32_t ulOld, uint32_t ulNew)
+{
+    uint32_t ulNext = (xWatch.ulHead + 1U) % MWATCH_LOG_ENTRIES;
+    mwatch_change_t * px = &xWatch.pxLog[xWatch.ulHead];
+
+    if (ulNext == xWatch.ulTail)
+    {
+        xWatch.xStatus.ulDropped += 1U;
+        return;
+    }
+    px->ulTimeMs = ulTimeMs;
+    px->ulAddr = ulAddr;
+    px->ulOld = ulOld;
+    px->ulNew = ulNew;
+    // the entry is complete before the reader can see it
+    taskENTER_CRITICAL();
+    xWatch.ulHead = ulNext;
+    taskEXIT_CRITICAL();
+    xWatch.xStatus.ulChanges += 1U;
+}
+
+/// @brief compare words read with their baseline, log and take over the differences
+/// @param ulAddr : target address of the first word
+/// @param pulNew : words read
+/// @param pulBase : baseline
+/// @param xWords : words
+/// @param ulTimeMs : time stamp
+static void prvMemWatchCompare(uint32_t ulAddr, const uint32_t * pulNew, uint32_t * pulBase, size_t xWords, uint32_t ulTimeMs)
+{
+    size_t i = 0U;
+
+    // four words per test, nothing changed is by far the common case
+    for (; (i + 4U) <= xWords; i += 4U)
+    {
+        if (((pulNew[i] ^ pulBase[i]) | (pulNew[i + 1U] ^ pulBase[i + 1U]) |
+             (pulNew[i + 2U] ^ pulBase[i + 2U]) | (pulNew[i + 3U] ^ pulBase[i + 3U])) == 0U)
+        {
+            continue;
+        }
+        for (size_t j = i; j < (i + 4U); j++)
+        {
+            if (pulNew[j] != pulBase[j])
+            {
+                prvMemWatchLog(ulTimeMs, ulAddr + (j * 4U), pulBase[j], pulNew[j]);
+                pulBase[j] = pulNew[j];
+            }
+        }
+    }
+    for (; i < xWords; i++)
+    {
+        if (pulNew[i] != pulBase[i])
+        {
+            prvMemWatchLog(ulTimeMs, ulAddr + (i * 4U), pulBase[i], pulNew[i]);
+            pulBase[i] = pulNew[i];
+        }
+    }
+}
+
+/// @brief read all regions once
+/// @return acknowledge
+static uint8_t prvMemWatchPass(void)
+{
+    uint8_t ucAck = DAP_TRANSFER_OK;
+
+    if (!xWatch.xStatus.xLinkUp)
+    {
+        vTargetAcquire();
+        ucAck = ucTargetAttach();
+        vTargetRelease();
+        if (ucAck != DAP_TRANSFER_OK)
+        {
+            return ucAck;
+        }
+        xWatch.xStatus.xLinkUp = true;
+    }
+    for (uint32_t r = 0U; r < xWatch.xStatus.ulRegions; r++)
+    {
+        mwatch_region_t * px = &xWatch.xRegion[r];
+
+        for (uint32_t ulDone = 0U; ulDone < px->ulSize; )
+        {
+            uint32_t ulLen = px->ulSize - ulDone;
+            uint32_t * pulBase = &xWatch.pulBaseline[px->ulOffset + (ulDone / 4U)];
+            if (ulLen > MWATCH_CHUNK_SIZE)
+            {
+                ulLen = MWATCH_CHUNK_SIZE;
+            }
+            // the link is given back between chunks
+            vTargetAcquire();
+            ucAck = ucTargetReadBlock(px->ulAddr + ulDone, xWatch.ulChunk, ulLen / 4U);
+            vTargetRelease();
+            if (ucAck != DAP_TRANSFER_OK)
+            {
+                return ucAck;
+            }
+            if (px->xBaseline)
+            {
+                prvMemWatchCompare(px->ulAddr + ulDone, xWatch.ulChunk, pulBase, ulLen / 4U, (uint32_t)(time_us_64() / 1000U));
+            }
+            else
+            {
+                memcpy(pulBase, xWatch.ulChunk, ulLen);
+            }
+            ulDone += ulLen;
+        }
+        px->xBaseline = true;
+    }
+    return DAP_TRANSFER_OK;
+}
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the watch (stopped, no regions)
+void vMemWatchInit(void)
+{
+    xWatch.xLock = xSemaphoreCreateMutex();
+    xWatch.pulBaseline = (uint32_t *)PSRAM_MWATCH_BASE;
+    xWatch.pxLog = (mwatch_change_t *)PSRAM_MWATCH_LOG_BASE;
+}
+
+/// @brief memory watch thread
+/// @param pv : unused
+void vMemWatchTask(void * pv)
+{
+    uint32_t ulStartUs;
+    uint8_t ucAck;
+
+    (void)pv;
+    xWatch.xTask = xTaskGetCurrentTaskHandle();
+
+    do
+    {
+        (void)xTaskNotifyWait(0U, 0xFFFFFFFFUL, NULL,
+                              xWatch.xStatus.xRunning ? pdMS_TO_TICKS(xWatch.xStatus.ulPeriodMs) : portMAX_DELAY);
+        if (!xWatch.xStatus.xRunning)
+        {
+            continue;
+        }
+        ulStartUs = time_us_32();
+        xSemaphoreTake(xWatch.xLock, portMAX_DELAY);
+        ucAck = prvMemWatchPass();
+        xSemaphoreGive(xWatch.xLock);
+        if (ucAck == DAP_TRANSFER_OK)
+        {
+            xWatch.xStatus.ulPasses += 1U;
+            xWatch.xStatus.ulLastPassMs = (time_us_32() - ulStartUs) / 1000U;
+        }
+        else
+        {
+            // connect again with the next pass
+            xWatch.xStatus.xLinkUp = false;
+        }
+    } while (true);
+}
+
+/// @brief add a region, its baseline is taken with the next pass
+/// @param ulAddr : address (rounded down to a word)
+/// @param ulSize : bytes (rounded up to words)
+/// @return pdPASS : added; pdFAIL : too many regions or no baseline space left
+BaseType_t xMemWatchAdd(uint32_t ulAddr, uint32_t ulSize)
+{
+    BaseType_t xResult = pdFAIL;
+    uint32_t ulWords = (ulSize + (ulAddr & 3U) + 3U) / 4U;
+
+    xSemaphoreTake(xWatch.xLock, portMAX_DELAY);
+    if ((ulWords != 0U) && (xWatch.xStatus.ulRegions < MWATCH_REGIONS) &&
+        (ulWords <= ((PSRAM_MWATCH_SIZE - xWatch.xStatus.ulBytes) / 4U)))
+    {
+        mwatch_region_t * px = &xWatch.xRegion[xWatch.xStatus.ulRegions];
+        px->ulAddr = ulAddr & ~3UL;
+        px->ulSize = ulWords * 4U;
+        px->ulOffset = xWatch.xStatus.ulBytes / 4U;
+        px->xBaseline = false;
+        xWatch.xStatus.ulBytes += px->ulSize;
+        xWatch.xStatus.ulRegions += 1U;
+        xResult = pdPASS;
+    }
+    xSemaphoreGive(xWatch.xLock);
+    return xResult;
+}
+
+/// @brief drop all regions and the log
+void vMemWatchClear(void)
+{
+    xSemaphoreTake(xWatch.xLock, portMAX_DELAY);
+    xWatch.xStatus.ulRegions = 0U;
+    xWatch.xStatus.ulBytes = 0U;
+    xWatch.xStatus.ulChanges = 0U;
+    xWatch.xStatus.ulDropped = 0U;
+    taskENTER_CRITICAL();
+    xWatch.ulHead = 0U;
+    xWatch.ulTail = 0U;
+    taskEXIT_CRITICAL();
+    xSemaphoreGive(xWatch.xLock);
+}
+
+/// @brief start or stop the passes
+/// @param xRun : true to run
+/// @param ulPeriodMs : period between two passes, at least MWATCH_PERIOD_MIN
+void vMemWatchRun(bool xRun, uint32_t ulPeriodMs)
+{
+    xWatch.xStatus.ulPeriodMs = (ulPeriodMs < MWATCH_PERIOD_MIN) ? MWATCH_PERIOD_MIN : ulPeriodMs;
+    if (xRun && !xWatch.xStatus.xRunning)
+    {
+        xWatch.xStatus.ulPasses = 0U;
+    }
+    xWatch.xStatus.xRunning = xRun;
+    if (xWatch.xTask != NULL)
+    {
+        xTaskNotify(xWatch.xTask, 0U, eNoAction);
+    }
+}
+
+/// @brief take logged changes, oldest first
+/// @param px : output
+/// @param xMax : most changes to take
+/// @return changes taken
+size_t xMemWatchRead(mwatch_change_t * px, size_t xMax)
+{
+    uint32_t ulHead, ulTail;
+    size_t n = 0U;
+
+    taskENTER_CRITICAL();
+    ulHead = xWatch.ulHead;
+    ulTail = xWatch.ulTail;
+    taskEXIT_CRITICAL();
+    while ((n < xMax) && (ulTail != ulHead))
+    {
+        px[n++] = xWatch.pxLog[ulTail];
+        ulTail = (ulTail + 1U) % MWATCH_LOG_ENTRIES;
+    }
+    taskENTER_CRITICAL();
+    xWatch.ulTail = ulTail;
+    taskEXIT_CRITICAL();
+    return n;
+}
+
+/// @brief get the watch state
+/// @param px : output
+void vMemWatchStatus(mwatch_status_t * px)
+{
+    uint32_t ulHead, ulTail;
+
+    taskENTER_CRITICAL();
+    ulHead = xWatch.ulHead;
+    ulTail = xWatch.ulTail;
+    taskEXIT_CRITICAL();
+    *px = xWatch.xStatus;
+    px->ulPending = (ulHead + MWATCH_LOG_ENTRIES - ulTail) % MWATCH_LOG_ENTRIES;
+}
+
+/*-----------------------------------------------------------*/
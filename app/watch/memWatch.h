@@ -0,0 +1,103 @@
+#ifndef MEM_WATCH_H_
+#define MEM_WATCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Memory watch: registered target regions are read every period and
+ * compared word by word with a baseline copy in psram (PSRAM_MWATCH_BASE).
+ * Only words that changed are logged, with a timestamp, into a ring
+ * (PSRAM_MWATCH_LOG_BASE) the host drains; the baseline follows the target.
+ *
+ * The first pass over a region fills its baseline and reports nothing. The
+ * link is taken per chunk of MWATCH_CHUNK_SIZE bytes, so the dap host and
+ * the other services get it between two chunks. When the log is full new
+ * changes are dropped and counted.
+ */
+
+/* memory watch task name */
+#define MWATCH_TASK_NAME        "mwatch"
+/* memory watch task stack size(32-bit word) */
+#define MWATCH_TASK_STACK_SIZE  256U
+
+/* most regions */
+#define MWATCH_REGIONS          8U
+/* bytes read and compared at once */
+#define MWATCH_CHUNK_SIZE       1024U
+/* default and shortest period between two passes (ms) */
+#define MWATCH_PERIOD_DEFAULT   100U
+#define MWATCH_PERIOD_MIN       10U
+
+/* logged change */
+typedef struct mwatch_change_t
+{
+    uint32_t ulTimeMs;          // probe uptime of the pass that saw it
+    uint32_t ulAddr;            // word address
+    uint32_t ulOld;
+    uint32_t ulNew;
+} mwatch_change_t;
+
+/* watch state, for display */
+typedef struct mwatch_status_t
+{
+    bool xRunning;
+    bool xLinkUp;               // target reachable at the last pass
+    uint32_t ulPeriodMs;
+    uint32_t ulRegions;
+    uint32_t ulBytes;           // watched bytes
+    uint32_t ulPasses;          // complete passes since start
+    uint32_t ulLastPassMs;      // duration of the last pass
+    uint32_t ulChanges;         // changes logged since start
+    uint32_t ulPending;         // changes not read yet
+    uint32_t ulDropped;         // changes lost to a full log
+} mwatch_status_t;
+
+/*-----------------------------------------------------------*/
+
+/// @brief create the watch (stopped, no regions)
+void vMemWatchInit(void);
+
+/// @brief memory watch thread
+/// @param pv : unused
+void vMemWatchTask(void * pv);
+
+/// @brief add a region, its baseline is taken with the next pass
+/// @param ulAddr : address (rounded down to a word)
+/// @param ulSize : bytes (rounded up to words)
+/// @return pdPASS : added; pdFAIL : too many regions or no baseline space left
+BaseType_t xMemWatchAdd(uint32_t ulAddr, uint32_t ulSize);
+
+/// @brief drop all regions and the log
+void vMemWatchClear(void);
+
+/// @brief start or stop the passes
+/// @param xRun : true to run
+/// @param ulPeriodMs : period between two passes, at least MWATCH_PERIOD_MIN
+void vMemWatchRun(bool xRun, uint32_t ulPeriodMs);
+
+/// @brief take logged changes, oldest first
+/// @param px : output
+/// @param xMax : most changes to take
+/// @return changes taken
+size_t xMemWatchRead(mwatch_change_t * px, size_t xMax);
+
+/// @brief get the watch state
+/// @param px : output
+void vMemWatchStatus(mwatch_status_t * px);
+
+/*-----------------------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* MEM_WATCH_H_ */
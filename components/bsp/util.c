@@ -139,4 +139,36 @@ NumberBase eUtilGetNumberBase(const char *str)
         p++;
     }
     return BASE_DECIMAL;
-}
\ No newline at end of file
+}
+
+/// @brief CRC-32 (IEEE 802.3, reflected, as used by zlib), can be computed in pieces
+/// @param crc : result of the previous piece, 0 for the first one
+/// @param data : data pointer
+/// @param len : data bytes
+/// @return crc of all pieces so far
+uint32_t ulUtilCrc32(uint32_t crc, const void *data, size_t len)
+{
+    static uint32_t table[256];
+    const uint8_t *p = (const uint8_t *)data;
+
+    // build the table on first use
+    if (0U == table[1])
+    {
+        for (uint32_t i = 0; i < 256U; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1U) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc = table[(crc ^ *p++) & 0xFFU] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -36,6 +36,13 @@ int lUtilCheckAndFindOneLocal(uint n);
 /// @return Base (2/8/10/16), invalid returns BASE_INVALID(-1)
 NumberBase eUtilGetNumberBase(const char *str);
 
+/// @brief CRC-32 (IEEE 802.3, reflected, as used by zlib), can be computed in pieces
+/// @param crc : result of the previous piece, 0 for the first one
+/// @param data : data pointer
+/// @param len : data bytes
+/// @return crc of all pieces so far
+uint32_t ulUtilCrc32(uint32_t crc, const void *data, size_t len);
+
 
 #ifdef __cplusplus
 }
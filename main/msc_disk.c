@@ -0,0 +1,299 @@
+/*
+ * Drag and drop programming: a small FAT12 volume on the MSC interface.
+ *
+ * The volume holds STATUS.TXT only. Data sectors written by the host are
+ * decoded as they arrive (UF2, Intel HEX, ELF, or a raw image starting with a
+ * vector table) and handed to the programmer stream, which flashes the
+ * target while the copy is still running. FAT and root directory writes are
+ * kept in RAM so the host sees a consistent volume.
+ */
+
+#include <tusb.h>
+#include "rp2350.h"
+#include "prog/imageParser.h"
+
+#if CFG_TUD_MSC
+
+/*-----------------------------------------------------------*/
+
+/* geometry: 8 MB, 4 KB clusters, one FAT */
+#define DISK_SECTOR_SIZE        512U
+#define DISK_SECTOR_COUNT       16384U
+#define DISK_SECTORS_PER_CLUSTER 8U
+#define DISK_FAT_SECTORS        6U
+#define DISK_ROOT_ENTRIES       32U
+#define DISK_ROOT_SECTORS       ((DISK_ROOT_ENTRIES * 32U) / DISK_SECTOR_SIZE)
+
+/* layout (lba) */
+#define DISK_LBA_FAT            1U
+#define DISK_LBA_ROOT           (DISK_LBA_FAT + DISK_FAT_SECTORS)
+#define DISK_LBA_DATA           (DISK_LBA_ROOT + DISK_ROOT_SECTORS)
+
+/* STATUS.TXT: first cluster (2), fixed size */
+#define DISK_STATUS_LBA         DISK_LBA_DATA
+#define DISK_STATUS_SIZE        256U
+
+/* volume serial */
+#define DISK_VOLUME_ID          0x50524F42UL
+
+/* boot sector */
+static const uint8_t ucBootSector[62] =
+{
+    0xEB, 0x3C, 0x90,                                   // jump
+    'M', 'S', 'W', 'I', 'N', '4', '.', '1',             // oem name
+    U16_TO_U8S_LE(DISK_SECTOR_SIZE),                    // bytes per sector
+    DISK_SECTORS_PER_CLUSTER,                           // sectors per cluster
+    U16_TO_U8S_LE(1),                                   // reserved sectors
+    1,                                                  // number of FATs
+    U16_TO_U8S_LE(DISK_ROOT_ENTRIES),                   // root entries
+    U16_TO_U8S_LE(DISK_SECTOR_COUNT),                   // total sectors
+    0xF8,                                               // media
+    U16_TO_U8S_LE(DISK_FAT_SECTORS),                    // sectors per FAT
+    U16_TO_U8S_LE(1),                                   // sectors per track
+    U16_TO_U8S_LE(1),                                   // heads
+    U32_TO_U8S_LE(0),                                   // hidden sectors
+    U32_TO_U8S_LE(0),                                   // total sectors (32 bit)
+    0x80, 0x00, 0x29,                                   // drive, reserved, boot signature
+    U32_TO_U8S_LE(DISK_VOLUME_ID),                      // volume id
+    'P', 'R', 'O', 'B', 'E', ' ', ' ', ' ', ' ', ' ', ' ',  // volume label
+    'F', 'A', 'T', '1', '2', ' ', ' ', ' '              // file system
+};
+
+/* disk state */
+typedef struct msc_disk_t
+{
+    uint8_t ucFat[DISK_FAT_SECTORS * DISK_SECTOR_SIZE];
+    uint8_t ucRoot[DISK_ROOT_SECTORS * DISK_SECTOR_SIZE];
+    bool xFile;                 // a file is being decoded
+    uint32_t ulFileLba;         // its first sector
+    image_parser_t xParser;
+} msc_disk_t;
+
+static msc_disk_t xDisk;
+
+/*-----------------------------------------------------------*/
+
+/// @brief fill in the empty volume: label and STATUS.TXT
+static void prvDiskFormat(void)
+{
+    static const uint8_t ucFatHead[] = { 0xF8, 0xFF, 0xFF, 0xFF, 0x0F };
+    uint8_t * pucEntry;
+
+    memset(xDisk.ucFat, 0x00, sizeof(xDisk.ucFat));
+    memset(xDisk.ucRoot, 0x00, sizeof(xDisk.ucRoot));
+    // media, end of chain, STATUS.TXT in cluster 2
+    memcpy(xDisk.ucFat, ucFatHead, sizeof(ucFatHead));
+    // volume label
+    pucEntry = &xDisk.ucRoot[0];
+    memcpy(pucEntry, "PROBE      ", 11);
+    pucEntry[11] = 0x08;
+    // STATUS.TXT, read only
+    pucEntry = &xDisk.ucRoot[32];
+    memcpy(pucEntry, "STATUS  TXT", 11);
+    pucEntry[11] = 0x01;
+    pucEntry[26] = 2;
+    pucEntry[28] = (uint8_t)(DISK_STATUS_SIZE & 0xFFU);
+    pucEntry[29] = (uint8_t)(DISK_STATUS_SIZE >> 8);
+}
+
+/// @brief STATUS.TXT content
+/// @param pc : sector buffer
+static void prvDiskStatus(char * pc)
+{
+    prog_status_t xStatus;
+    static const char * const pcResult[] = { "none", "busy", "pass", "FAIL" };
+    int lLen;
+
+    vProgStatus(&xStatus);
+    lLen = snprintf(pc, DISK_STATUS_SIZE,
+                    "Drop a UF2, HEX, ELF or BIN file to program the target.\r\n"
+                    "Last run: %s%s%s, %lu ms\r\nPassed: %lu, failed: %lu\r\n",
+                    pcResult[xStatus.eResult],
+                    (PROG_RESULT_FAIL == xStatus.eResult) ? " at " : "",
+                    ((PROG_RESULT_FAIL == xStatus.eResult) && (NULL != xStatus.pcError)) ? xStatus.pcError : "",
+                    (unsigned long)xStatus.ulLastMs, (unsigned long)xStatus.ulPassed, (unsigned long)xStatus.ulFailed);
+    // the directory entry has a fixed size, pad with spaces
+    if ((lLen > 0) && (lLen < (int)DISK_STATUS_SIZE))
+    {
+        memset(pc + lLen, ' ', DISK_STATUS_SIZE - (size_t)lLen);
+    }
+}
+
+/// @brief decoded record of the file being copied
+/// @param pv : unused
+/// @param ulAddr : target address
+/// @param puc : data
+/// @param xLen : bytes
+static void prvDiskData(void * pv, uint32_t ulAddr, const uint8_t * puc, size_t xLen)
+{
+    (void)pv;
+    // records outside the flash window (RAM, OTP) are not programmed
+    (void)xProgStreamWrite(ulAddr, puc, xLen);
+}
+
+/// @brief a data sector from the host
+/// @param ulLba : sector
+/// @param puc : data
+static void prvDiskDataSector(uint32_t ulLba, const uint8_t * puc)
+{
+    image_format_t eFormat;
+    image_result_t eResult;
+
+    // the previous file ended (idle time for a raw image)
+    if (xDisk.xFile && !xProgStreamActive())
+    {
+        xDisk.xFile = false;
+    }
+    if (!xDisk.xFile)
+    {
+        // only the start of an image opens a stream, other files are ignored
+        eFormat = eImageParserDetect(puc, DISK_SECTOR_SIZE);
+        if ((IMAGE_FORMAT_UNKNOWN == eFormat) || (pdPASS != xProgStreamBegin(eFormat)))
+        {
+            return;
+        }
+        vImageParserInit(&xDisk.xParser, eFormat, PROG_FLASH_BASE, PROG_SECTOR_SIZE, prvDiskData, NULL);
+        xDisk.xFile = true;
+        xDisk.ulFileLba = ulLba;
+    }
+    // a raw image is placed by its position in the file, assuming it is not fragmented
+    if (IMAGE_FORMAT_BIN == xDisk.xParser.eFormat)
+    {
+        if (ulLba < xDisk.ulFileLba)
+        {
+            return;
+        }
+        xDisk.xParser.ulAddr = PROG_FLASH_BASE + ((ulLba - xDisk.ulFileLba) * DISK_SECTOR_SIZE);
+    }
+    eResult = eImageParserFeed(&xDisk.xParser, puc, DISK_SECTOR_SIZE);
+    if (IMAGE_RESULT_MORE != eResult)
+    {
+        vProgStreamEnd(IMAGE_RESULT_DONE == eResult);
+        xDisk.xFile = false;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+// Invoked when received SCSI_CMD_INQUIRY
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+    (void) lun;
+
+    memcpy(vendor_id, "RPi     ", 8);
+    memcpy(product_id, "Probe Storage   ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+    // first access: build the volume
+    if (0U == xDisk.ucFat[0])
+    {
+        prvDiskFormat();
+    }
+}
+
+// Invoked when received Test Unit Ready command
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+    (void) lun;
+
+    if (0U == xDisk.ucFat[0])
+    {
+        prvDiskFormat();
+    }
+    return true;
+}
+
+// Invoked when received SCSI_CMD_READ_CAPACITY_10 and SCSI_CMD_READ_FORMAT_CAPACITY
+void tud_msc_capacity_cb(uint8_t lun, uint32_t * block_count, uint16_t * block_size)
+{
+    (void) lun;
+
+    *block_count = DISK_SECTOR_COUNT;
+    *block_size = DISK_SECTOR_SIZE;
+}
+
+// Invoked when received Start Stop Unit command
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
+{
+    (void) lun;
+    (void) power_condition;
+    (void) start;
+    (void) load_eject;
+
+    return true;
+}
+
+// Callback invoked when received READ10 command
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void * buffer, uint32_t bufsize)
+{
+    uint8_t * puc = (uint8_t *)buffer;
+
+    (void) lun;
+
+    if ((lba >= DISK_SECTOR_COUNT) || (0U != offset) || (bufsize < DISK_SECTOR_SIZE))
+    {
+        return -1;
+    }
+    memset(puc, 0x00, DISK_SECTOR_SIZE);
+    if (0U == lba)
+    {
+        memcpy(puc, ucBootSector, sizeof(ucBootSector));
+        puc[510] = 0x55;
+        puc[511] = 0xAA;
+    }
+    else if (lba < DISK_LBA_ROOT)
+    {
+        memcpy(puc, &xDisk.ucFat[(lba - DISK_LBA_FAT) * DISK_SECTOR_SIZE], DISK_SECTOR_SIZE);
+    }
+    else if (lba < DISK_LBA_DATA)
+    {
+        memcpy(puc, &xDisk.ucRoot[(lba - DISK_LBA_ROOT) * DISK_SECTOR_SIZE], DISK_SECTOR_SIZE);
+    }
+    else if (DISK_STATUS_LBA == lba)
+    {
+        prvDiskStatus((char *)puc);
+    }
+    return DISK_SECTOR_SIZE;
+}
+
+// Callback invoked when received WRITE10 command
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t * buffer, uint32_t bufsize)
+{
+    (void) lun;
+
+    if ((lba >= DISK_SECTOR_COUNT) || (0U != offset) || (bufsize < DISK_SECTOR_SIZE))
+    {
+        return -1;
+    }
+    if ((lba >= DISK_LBA_FAT) && (lba < DISK_LBA_ROOT))
+    {
+        memcpy(&xDisk.ucFat[(lba - DISK_LBA_FAT) * DISK_SECTOR_SIZE], buffer, DISK_SECTOR_SIZE);
+    }
+    else if ((lba >= DISK_LBA_ROOT) && (lba < DISK_LBA_DATA))
+    {
+        memcpy(&xDisk.ucRoot[(lba - DISK_LBA_ROOT) * DISK_SECTOR_SIZE], buffer, DISK_SECTOR_SIZE);
+    }
+    else if (lba >= (DISK_STATUS_LBA + DISK_SECTORS_PER_CLUSTER))
+    {
+        prvDiskDataSector(lba, buffer);
+    }
+    return DISK_SECTOR_SIZE;
+}
+
+// Callback invoked when received an SCSI command not in built-in list below
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void * buffer, uint16_t bufsize)
+{
+    (void) buffer;
+    (void) bufsize;
+
+    switch (scsi_cmd[0])
+    {
+        case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+            return 0;
+        default:
+            // Set Sense = Invalid Command Operation
+            tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+            return -1;
+    }
+}
+
+#endif /* CFG_TUD_MSC */
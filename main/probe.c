@@ -55,9 +55,23 @@ struct _probe {
     // PIO offset
     uint offset;
     uint initted;
+    // read routine and sample point in use
+    uint read_cmd;
+    uint sample;
 };
 
-static struct _probe probe;
+static struct _probe probe = {
+    .read_cmd = probe_offset_read_cmd,
+    .sample = PROBE_SAMPLE_DEFAULT,
+};
+
+// Read routine of each pair of sample points
+static const uint8_t probe_sample_cmd[PROBE_SAMPLE_POINTS / 2] = {
+    probe_offset_read_early_cmd,
+    probe_offset_read_cmd,
+    probe_offset_read_late1_cmd,
+    probe_offset_read_late2_cmd,
+};
 
 void probe_set_swclk_freq(PIO pio, uint sm, uint freq_khz) {
         uint clk_sys_freq_khz = clock_get_hz(clk_sys) / 1000;
@@ -72,6 +86,26 @@ void probe_set_swclk_freq(PIO pio, uint sm, uint freq_khz) {
         pio_sm_set_clkdiv_int_frac(pio, sm, divider << 1, 0);
 }
 
+bool probe_set_sample(PIO pio, uint pinBase, uint point) {
+    if (point >= PROBE_SAMPLE_POINTS)
+        return false;
+    uint32_t mask = 1u << (PROBE_PIN_SWDIO(pinBase) - pio_get_gpio_base(pio));
+    // Odd points skip the 2-flop synchroniser, SWDIO is seen 2 clk_sys fresher
+    if (point & 1)
+        hw_set_bits(&pio->input_sync_bypass, mask);
+    else
+        hw_clear_bits(&pio->input_sync_bypass, mask);
+    // Commands carry the routine address, so queued reads finish unchanged
+    probe.read_cmd = probe_sample_cmd[point >> 1];
+    probe.sample = point;
+    probe_info("Set swdio sample point %d\n", point);
+    return true;
+}
+
+uint probe_get_sample(void) {
+    return probe.sample;
+}
+
 typedef enum probe_pio_command {
     CMD_WRITE = 0,
     CMD_SKIP,
@@ -84,7 +118,7 @@ static inline uint32_t fmt_probe_command(uint bit_count, bool out_en, probe_pio_
         cmd == CMD_WRITE      ? probe.offset + probe_offset_write_cmd :
         cmd == CMD_SKIP       ? probe.offset + probe_offset_get_next_cmd :
         cmd == CMD_TURNAROUND ? probe.offset + probe_offset_turnaround_cmd :
-                                probe.offset + probe_offset_read_cmd;
+                                probe.offset + probe.read_cmd;
     return ((bit_count - 1) & 0xff) | ((uint)out_en << 8) | (cmd_addr << 9);
 }
 
@@ -145,6 +179,8 @@ void probe_init(PIO pio, uint * sm, uint pinBase) {
 
         // Set up divisor
         probe_set_swclk_freq(pio, *sm, 1000);
+        // Sample point kept over a deinit
+        probe_set_sample(pio, pinBase, probe.sample);
 
         // Jump SM to command dispatch routine, and enable it
         pio_sm_exec(pio, *sm, offset + probe_offset_get_next_cmd);
@@ -46,6 +46,16 @@ extern probeInterface_t xprobeHandle;
 
 void probe_set_swclk_freq(PIO pio, uint sm, uint freq_khz);
 
+// SWDIO sample points of reads, in time order: the four read routines a
+// quarter SWCLK period apart, each with the input synchroniser on and then
+// bypassed (2 clk_sys later)
+#define PROBE_SAMPLE_POINTS     8
+#define PROBE_SAMPLE_DEFAULT    2       // read_cmd, on the posedge
+
+// Takes effect with the next read command
+bool probe_set_sample(PIO pio, uint pinBase, uint point);
+uint probe_get_sample(void);
+
 // Bit counts in the range 1..256
 void probe_write_bits(PIO pio, uint sm, uint bit_count, uint32_t data_byte);
 uint32_t probe_read_bits(PIO pio, uint sm, uint bit_count);
@@ -8,4 +8,24 @@
 #define PSRAM_SIZE      (8 * 1024 * 1024)       // psram size (byte)
 #define PSRAM_CSI_PIN   19                      // psram chip select pin
 
+// psram partition, every service owns a fixed window
+#define PSRAM_RECORDER_BASE     (PSRAM_BASE + 0x000000u)    // dap flight recorder ring
+#define PSRAM_RECORDER_SIZE     (1 * 1024 * 1024)
+#define PSRAM_IMAGE_BASE        (PSRAM_BASE + 0x100000u)    // stand-alone programmer image
+#define PSRAM_IMAGE_SIZE        (4 * 1024 * 1024)
+#define PSRAM_ZIP_BASE          (PSRAM_BASE + 0x500000u)    // dap compressed upload history window
+#define PSRAM_ZIP_SIZE          (64 * 1024)
+#define PSRAM_STEP_BASE         (PSRAM_BASE + 0x510000u)    // dap step trace samples
+#define PSRAM_STEP_SIZE         (1 * 1024 * 1024)
+#define PSRAM_FAULT_BASE        (PSRAM_BASE + 0x610000u)    // fault watch snapshots
+#define PSRAM_FAULT_SIZE        (64 * 1024)
+#define PSRAM_CORE_BASE         (PSRAM_BASE + 0x620000u)    // backup of the last core dump
+#define PSRAM_CORE_SIZE         (1 * 1024 * 1024)
+#define PSRAM_MWATCH_BASE       (PSRAM_BASE + 0x720000u)    // memory watch baseline copy
+#define PSRAM_MWATCH_SIZE       (512 * 1024)
+#define PSRAM_MWATCH_LOG_BASE   (PSRAM_BASE + 0x7A0000u)    // memory watch change log
+#define PSRAM_MWATCH_LOG_SIZE   (256 * 1024)
+#define PSRAM_ITM_BASE          (PSRAM_BASE + 0x7E0000u)    // itm stimulus port streams
+#define PSRAM_ITM_SIZE          (64 * 1024)
+
 #endif /* PSRAM_H_ */
@@ -48,13 +48,40 @@ StreamBufferHandle_t hid_rx_streambuf;
 TaskHandle_t dap_taskhandle, tud_taskhandle;
 // pio swd interface
 probeInterface_t xprobeHandle = { .pio = PIO_INSTANCE(PROBE_SM), .pinBase = PROBE_PIN_OFFSET };
-// stearm buffer used by dap thread
-StreamBufferHandle_t dapStreambuf;
+// message buffer used by dap thread, one request per message
+MessageBufferHandle_t dapStreambuf;
 
 /*-----------------------------------------------------------*/
 
 // cli use cdc 0
 #define CLI_USB_CDC_NUMBER       0
+// gdb server use cdc 1
+#define GDB_USB_CDC_NUMBER       1
+// semihosting and itm port 0 console use cdc 2
+#define SEMI_USB_CDC_NUMBER      2
+
+// write to a cdc interface
+static int lCDCWrite(uint8_t itf, uint8_t * puc, int lMaxSize)
+{
+    // vTaskSuspendAll(); // Suspend the scheduler to safely update the write index
+    // the fifo may take only part of a long output (binary exports)
+    while(lMaxSize > 0)
+    {
+        uint32_t ulWritten = tud_cdc_n_write(itf, (uint8_t const *)puc, lMaxSize);
+        tud_cdc_n_write_flush(itf);
+        puc += ulWritten;
+        lMaxSize -= (int)ulWritten;
+        // fifo full: let the usb thread drain it, give up when nobody is listening
+        if((lMaxSize > 0) && (0U == ulWritten))
+        {
+            if(!tud_cdc_n_connected(itf))
+                break;
+            vTaskDelay(1);
+        }
+    }
+    // xTaskResumeAll();
+    return 0; 
+}
 
 // cli data interface
 static int lCLIRead(uint8_t * puc, int lMaxSize) 
@@ -62,20 +89,57 @@ static int lCLIRead(uint8_t * puc, int lMaxSize)
     // receive data from steam-buffer
     return (int)xStreamBufferReceive(cdc_rx_streambuf[CLI_USB_CDC_NUMBER], puc, lMaxSize, portMAX_DELAY);
 }
+static int lCLIReadTimeout(uint8_t * puc, int lMaxSize, TickType_t xTimeout)
+{
+    return (int)xStreamBufferReceive(cdc_rx_streambuf[CLI_USB_CDC_NUMBER], puc, lMaxSize, xTimeout);
+}
 static int lCLIWrite(uint8_t * puc, int lMaxSize) 
 { 
-    // vTaskSuspendAll(); // Suspend the scheduler to safely update the write index
     // use cdc 0
-    tud_cdc_n_write(CLI_USB_CDC_NUMBER, (uint8_t const *)puc, lMaxSize);
-    tud_cdc_n_write_flush(CLI_USB_CDC_NUMBER);
-    // xTaskResumeAll();
-    return 0; 
+    return lCDCWrite(CLI_USB_CDC_NUMBER, puc, lMaxSize);
 }
 
 static const cli_t xCLIInterface =
 {
     .r = lCLIRead,
     .w = lCLIWrite,
+    .rt = lCLIReadTimeout,
+};
+
+// gdb data interface
+static int lGDBRead(uint8_t * puc, int lMaxSize, TickType_t xTimeout)
+{
+    // receive data from steam-buffer
+    return (int)xStreamBufferReceive(cdc_rx_streambuf[GDB_USB_CDC_NUMBER], puc, lMaxSize, xTimeout);
+}
+static int lGDBWrite(uint8_t * puc, int lMaxSize)
+{
+    // use cdc 1
+    return lCDCWrite(GDB_USB_CDC_NUMBER, puc, lMaxSize);
+}
+
+static const gdb_t xGDBInterface =
+{
+    .r = lGDBRead,
+    .w = lGDBWrite,
+};
+
+// semihosting console interface
+static int lSemiWrite(uint8_t * puc, int lMaxSize)
+{
+    // use cdc 2
+    return lCDCWrite(SEMI_USB_CDC_NUMBER, puc, lMaxSize);
+}
+
+static const semi_t xSemiInterface =
+{
+    .w = lSemiWrite,
+};
+
+// itm port 0 shares the semihosting console
+static const swo_t xSwoInterface =
+{
+    .w = lSemiWrite,
 };
 
 /*-----------------------------------------------------------*/
@@ -204,8 +268,12 @@ int main(void)
     xTaskCreateAffinitySet(prvusbThread, "tud", 512UL, NULL, TUD_TASK_PRIO, CORE_NUMBER(0), &tud_taskhandle);
     // dap setup
     DAP_Setup();
-    // creat steam-buffer, used by cdc
-    dapStreambuf = xStreamBufferCreate(DAP_PACKET_SIZE * DAP_PACKET_COUNT, 1);
+    // dap flight recorder, its ring lives in psram
+    vDapRecorderInit();
+    // swd link lock, shared by the dap thread and the probe services
+    vTargetInit();
+    // creat message-buffer, requests queued for the dap thread
+    dapStreambuf = xMessageBufferCreate((DAP_PACKET_SIZE + sizeof(size_t)) * DAP_PACKET_COUNT);
 #if CFG_TUD_HID
     // creat steam-buffer, used by hid rx
     hid_rx_streambuf = xStreamBufferCreate(CFG_TUD_HID_EP_BUFSIZE, 1);
@@ -214,10 +282,26 @@ int main(void)
     xTaskCreate(vdapTask, "dap", 512, (void *)&xDAP_Inf, DAP_TASK_PRIO, NULL);
 #else
     /* Lowest priority thread is debug - need to shuffle buffers before we can toggle swd... */
-    xTaskCreate(dap_thread, "DAP", 512UL, NULL, DAP_TASK_PRIO, &dap_taskhandle);
+    xTaskCreate(dap_thread, "DAP", 1024UL, NULL, DAP_TASK_PRIO, &dap_taskhandle);
 #endif
     // Create the command line task
     xCLIStart( (void * const)&xCLIInterface, NULL, CLI_TASK_PRIO );
+    // gdb server on cdc 1
+    xTaskCreate(vGdbServerTask, GDB_TASK_NAME, GDB_TASK_STACK_SIZE, (void *)&xGDBInterface, GDB_TASK_PRIO, NULL);
+    // stand-alone programmer, image in psram
+    vProgInit();
+    xTaskCreate(vProgTask, PROG_TASK_NAME, PROG_TASK_STACK_SIZE, NULL, PROG_TASK_PRIO, NULL);
+    // fault watch, snapshots in psram
+    vFaultInit();
+    xTaskCreate(vFaultTask, FAULT_TASK_NAME, FAULT_TASK_STACK_SIZE, NULL, FAULT_TASK_PRIO, NULL);
+    // memory watch, baseline and change log in psram
+    vMemWatchInit();
+    xTaskCreate(vMemWatchTask, MWATCH_TASK_NAME, MWATCH_TASK_STACK_SIZE, NULL, MWATCH_TASK_PRIO, NULL);
+    // semihosting service, console on cdc 2
+    xTaskCreate(vSemiTask, SEMI_TASK_NAME, SEMI_TASK_STACK_SIZE, (void *)&xSemiInterface, SEMI_TASK_PRIO, NULL);
+    // swo capture and itm demultiplexer, port 0 on cdc 2, port streams in psram
+    vSwoInit();
+    xTaskCreate(vSwoTask, SWO_TASK_NAME, SWO_TASK_STACK_SIZE, (void *)&xSwoInterface, SWO_TASK_PRIO, NULL);
     
     // Start FreeRTOS scheduler
     vTaskStartScheduler();
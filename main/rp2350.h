@@ -25,8 +25,17 @@
 #include <tusb.h>
 #include "pico/multicore.h"
 #include "stream_buffer.h"
+#include "message_buffer.h"
 #include "dap/DAP_config.h"
 #include "dap/DAP.h"
+#include "dap/dapRecorder.h"
+#include "target/target.h"
+#include "gdb/gdbServer.h"
+#include "prog/programmer.h"
+#include "fault/faultWatch.h"
+#include "watch/memWatch.h"
+#include "semihost/semihost.h"
+#include "trace/swo.h"
 
 
 #ifdef __cplusplus
@@ -86,6 +95,12 @@ do { \
 #define TUD_TASK_PRIO  	(tskIDLE_PRIORITY + 3)
 #define DAP_TASK_PRIO  	(tskIDLE_PRIORITY + 2)
 #define CLI_TASK_PRIO	(tskIDLE_PRIORITY + 2)
+#define GDB_TASK_PRIO	(tskIDLE_PRIORITY + 2)
+#define PROG_TASK_PRIO	(tskIDLE_PRIORITY + 2)
+#define FAULT_TASK_PRIO	(tskIDLE_PRIORITY + 1)
+#define MWATCH_TASK_PRIO	(tskIDLE_PRIORITY + 1)
+#define SEMI_TASK_PRIO	(tskIDLE_PRIORITY + 1)
+#define SWO_TASK_PRIO	(tskIDLE_PRIORITY + 2)
 
 /* swd pin */
 // #define SWCLK_PIN   22	// in top cmakelists.txt
@@ -194,8 +209,8 @@ extern struct lcd_t xLCDdriver;
 extern TaskHandle_t dap_taskhandle, tud_taskhandle;
 // dap thread
 extern void dap_thread(void *ptr);
-// stearm buffer used by dap thread
-extern StreamBufferHandle_t dapStreambuf;
+// message buffer used by dap thread, one request per message
+extern MessageBufferHandle_t dapStreambuf;
 
 
 #ifdef __cplusplus
@@ -27,6 +27,8 @@
 
 #include "dap/DAP_config.h"
 #include "dap/DAP.h"
+#include "dap/dapStats.h"
+#include "target/target.h"
 #include "probe.h"
 #include "hardware/pio.h"
 #include "rp2350.h"
@@ -186,6 +188,8 @@ uint8_t SWD_Transfer (unsigned int request, unsigned int *data) {
         }
       }
     }
+    vDapStatsSwdAck(ack);
+    vTargetWire(request, val, ack);
     return ((uint8_t)ack);
   }
 
@@ -200,6 +204,7 @@ uint8_t SWD_Transfer (unsigned int request, unsigned int *data) {
       probe_write_bits(xprobeHandle.pio, xprobeHandle.sm, 32, 0);
       probe_write_bits(xprobeHandle.pio, xprobeHandle.sm, 1, 0);
     }
+    vDapStatsSwdAck(ack);
     return ((uint8_t)ack);
   }
 
@@ -207,6 +212,8 @@ uint8_t SWD_Transfer (unsigned int request, unsigned int *data) {
   n = DAP_Data.swd_conf.turnaround + 32U + 1U;
   /* Back off data phase */
   probe_read_bits(xprobeHandle.pio, xprobeHandle.sm, n);
+  vDapStatsSwdAck(ack);
+  vTargetWire(request, 0U, ack);
   return ((uint8_t)ack);
 }
 
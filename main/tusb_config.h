@@ -49,13 +49,18 @@
 // Enable vendr
 #define CFG_TUD_VENDOR          (1)
 
-// Enable 2 CDC classes
-#define CFG_TUD_CDC             (1)
+// Enable 3 CDC classes: stdio/cli, gdb server, semihosting console
+#define CFG_TUD_CDC             (3)
 // Set CDC FIFO buffer sizes
 #define CFG_TUD_CDC_RX_BUFSIZE  (1024)
 #define CFG_TUD_CDC_TX_BUFSIZE  (1024)
 #define CFG_TUD_CDC_EP_BUFSIZE  (256)
 
+// Enable MSC (drag and drop programming)
+#define CFG_TUD_MSC             (1)
+// MSC buffer holds one sector
+#define CFG_TUD_MSC_EP_BUFSIZE  (512)
+
 #ifndef CFG_TUD_ENDPOINT0_SIZE
 #define CFG_TUD_ENDPOINT0_SIZE  (64)
 #endif
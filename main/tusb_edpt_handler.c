@@ -7,6 +7,9 @@
 #include "tusb_edpt_handler.h"
 #include "dap/DAP_config.h"
 #include "dap/DAP.h"
+#include "dap/dapStats.h"
+#include "dap/dapRecorder.h"
+#include "dap/dapReadAhead.h"
 #include "rp2350.h"
 #include "FreeRTOS.h"
 #include "task.h"
@@ -20,6 +23,20 @@ static uint8_t _in_ep_addr;
 
 static uint8_t requestBuffer[DAP_PACKET_SIZE];
 static uint8_t responseBuffer[DAP_PACKET_SIZE];
+// bytes of the request received so far, it arrives in endpoint packets
+static uint32_t ulRequestLen;
+// a complete request waits in requestBuffer for room in dapStreambuf, OUT stays parked
+static volatile bool xRequestHeld;
+
+// statistics timestamps: OUT packet arrival and IN transfer start
+static volatile uint32_t ulRequestStampUs;
+static volatile uint32_t ulResponseStampUs;
+
+#if (DAP_RESPONSE_STREAM != 0)
+// response streaming: set while dap_thread executes into responseBuffer, bytes already queued on IN
+static volatile bool xResponseStreaming;
+static uint32_t ulResponseSent;
+#endif
 
 bool is_in_isr(void) {
     // xPortIsInsideInterrupt(): return true is in isr
@@ -38,9 +55,94 @@ bool dap_edpt_deinit(void)
 void dap_edpt_reset(uint8_t __unused rhport)
 {
 	itf_num = 0;
+	ulRequestLen = 0U;
+	xRequestHeld = false;
+}
+
+// arm OUT for the next endpoint packet of the request, one at a time: a request that
+// fills whole packets has no short packet behind it to end the transfer
+static void prvDapOutArm(uint8_t rhport, uint8_t ep_addr)
+{
+	usbd_edpt_xfer(rhport, ep_addr, requestBuffer + ulRequestLen, DAP_USB_EP_SIZE);
+}
+
+// a short packet ends the request, after a full one the request itself tells,
+// a command of unknown length ends with the packet it is in
+static bool prvDapRequestComplete(uint32_t xferred_bytes)
+{
+	uint32_t _len;
+
+	if (xferred_bytes < DAP_USB_EP_SIZE || ulRequestLen >= DAP_PACKET_SIZE)
+	{
+		return true;
+	}
+	_len = DAP_RequestLength(requestBuffer, ulRequestLen);
+	return (_len <= ulRequestLen);
+}
+
+// hand the whole request to dap_thread, OUT is armed again only once it is queued:
+// a host with more requests in flight than DAP_PACKET_COUNT is held off by NAKs
+static void prvDapRequestQueue(void)
+{
+	if (xMessageBufferSend(dapStreambuf, requestBuffer, ulRequestLen, 0) == 0U)
+	{
+		xRequestHeld = true;
+		return;
+	}
+	xRequestHeld = false;
+	ulRequestLen = 0U;
+	prvDapOutArm(_rhport, _out_ep_addr);
+}
+
+// deferred to the usb task by dap_thread after it made room in dapStreambuf
+static void prvDapRequestRetry(void *param)
+{
+	(void)param;
+	if (xRequestHeld)
+	{
+		prvDapRequestQueue();
+	}
+}
+
+// block the dap thread until the IN endpoint is free, woken by the IN completion
+static void prvDapInWait(void)
+{
+	while (usbd_edpt_busy(_rhport, _in_ep_addr))
+	{
+		ulTaskNotifyTake(pdTRUE, 1);
+	}
+}
+
+/// @brief called by DAP_ExecuteCommand whenever the response is final up to a point,
+///        queues the whole endpoint packets that are not sent yet if IN is free
+/// @param response : end of the final part of the response
+void DAP_ResponseProgress(const uint8_t *response)
+{
+#if (DAP_RESPONSE_STREAM != 0)
+	uint32_t _n;
+
+	// only the response of the dap thread is streamed
+	if (!xResponseStreaming || response < responseBuffer || response > &responseBuffer[DAP_PACKET_SIZE])
+	{
+		return;
+	}
+	_n = ((uint32_t)(response - responseBuffer) - ulResponseSent) & ~(DAP_USB_EP_SIZE - 1U);
+	// never wait here, SWD has to keep running
+	if (_n != 0U && !usbd_edpt_busy(_rhport, _in_ep_addr))
+	{
+		if (ulResponseSent == 0U)
+		{
+			ulResponseStampUs = time_us_32();
+		}
+		usbd_edpt_xfer(_rhport, _in_ep_addr, responseBuffer + ulResponseSent, (uint16_t)_n);
+		ulResponseSent += _n;
+	}
+#else
+	(void)response;
+#endif
 }
 
-char * dap_cmd_string[] = {
+char * dap_cmd_string[ID_DAP_ExecuteCommands + 1] = {
 	[ID_DAP_Info               ] = "DAP_Info",
 	[ID_DAP_HostStatus         ] = "DAP_HostStatus",
 	[ID_DAP_Connect            ] = "DAP_Connect",
@@ -99,7 +201,8 @@ uint16_t dap_edpt_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf
 		{
 			_out_ep_addr = ep_addr;
 			// start OUT transfer so stack can receive data into our buffer
-			usbd_edpt_xfer(rhport, ep_addr, requestBuffer, DAP_PACKET_SIZE);
+			ulRequestLen = 0U;
+			prvDapOutArm(rhport, ep_addr);
 		}
 		else if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN)
 		{
@@ -131,7 +234,13 @@ bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t re
 		// IN transfer completed. Only act on successful transfers.
 		if (result == XFER_RESULT_SUCCESS && xferred_bytes > 0u && xferred_bytes <= DAP_PACKET_SIZE)
 		{
-			// nothing to do here: dap_thread triggers IN transfers when it has data to send
+			// dap_thread triggers IN transfers when it has data to send, only record the latency
+			vDapStatsHistogram(DAP_STATS_HIST_USB_IN, time_us_32() - ulResponseStampUs);
+			// wake the dap thread in case it waits for the endpoint
+			if (dap_taskhandle != NULL)
+			{
+				xTaskNotifyGive(dap_taskhandle);
+			}
 			return true;
 		}
 		return (result == XFER_RESULT_SUCCESS);
@@ -141,18 +250,28 @@ bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t re
 	{
 
 		// Only process successful OUT transfers with a valid byte count
-		if (result == XFER_RESULT_SUCCESS && xferred_bytes > 0u && xferred_bytes <= DAP_PACKET_SIZE)
+		if (result == XFER_RESULT_SUCCESS && xferred_bytes <= DAP_USB_EP_SIZE)
 		{
-			// copy received data into the stream buffer for dap_thread
-			xStreamBufferSend(dapStreambuf, requestBuffer, xferred_bytes, 0);
+			// DAP_TransferAbort is out of band: raise the flag now instead of queueing it
+			// behind the transfer it has to cancel, it has no response
+			if (ulRequestLen == 0U && xferred_bytes > 0u && requestBuffer[0] == ID_DAP_TransferAbort)
+			{
+				DAP_TransferAbort = 1U;
+				vDapStatsAbort();
+				vDapRecorderAppend(time_us_32(), 0U, requestBuffer, 1U, responseBuffer, 0U);
+				prvDapOutArm(rhport, ep_addr);
+				return true;
+			}
+			ulRequestLen += xferred_bytes;
+			// a zero-length packet ends a request as well, on its own it is ignored
+			if (ulRequestLen != 0U && prvDapRequestComplete(xferred_bytes))
+			{
+				ulRequestStampUs = time_us_32();
+				prvDapRequestQueue();
+				return true;
+			}
 			// re-arm OUT endpoint to receive next packet
-			usbd_edpt_xfer(rhport, ep_addr, requestBuffer, DAP_PACKET_SIZE);
-			return true;
-		}
-		else if (result == XFER_RESULT_SUCCESS && xferred_bytes == 0u)
-		{
-			// zero-length packet received (possible), re-arm to continue receiving
-			usbd_edpt_xfer(rhport, ep_addr, requestBuffer, DAP_PACKET_SIZE);
+			prvDapOutArm(rhport, ep_addr);
 			return true;
 		}
 		return false;
@@ -163,20 +282,89 @@ bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t re
 	}
 }
 
+#if (DAP_READAHEAD != 0)
+// read-ahead stops as soon as the host sent something
+static bool prvDapRequestPending(void)
+{
+	return xMessageBufferIsEmpty(dapStreambuf) == pdFALSE;
+}
+#endif
+
 void dap_thread(void *ptr)
 {
 	uint32_t n;
 	//  Initialise buffer indices
-	uint8_t DAPRequestBuffer[DAP_PACKET_SIZE];
-	uint8_t DAPResponseBuffer[DAP_PACKET_SIZE];
+	static uint8_t DAPRequestBuffer[DAP_PACKET_SIZE];
 	
 	do
 	{
 		uint32_t _resp_len;
-		_resp_len = (uint32_t)xStreamBufferReceive(dapStreambuf, DAPRequestBuffer, DAP_PACKET_SIZE, portMAX_DELAY);
-		_resp_len = DAP_ExecuteCommand(DAPRequestBuffer, DAPResponseBuffer);
-		memcpy(responseBuffer, DAPResponseBuffer, (uint16_t) _resp_len);
+		uint32_t _idle_us, _start_us, _end_us;
+		_idle_us = time_us_32();
+		_resp_len = (uint32_t)xMessageBufferReceive(dapStreambuf, DAPRequestBuffer, DAP_PACKET_SIZE, portMAX_DELAY);
+		// there is room now for a request that found the buffer full
+		if (xRequestHeld)
+		{
+			usbd_defer_func(prvDapRequestRetry, NULL, false);
+		}
+		// the response is built in place, the previous one must be gone
+		prvDapInWait();
+		_start_us = time_us_32();
+#if (DAP_RESPONSE_STREAM != 0)
+		ulResponseSent = 0U;
+		xResponseStreaming = true;
+		// the probe services share the swd link
+		vTargetLock();
+		_resp_len = DAP_ExecuteCommand(DAPRequestBuffer, responseBuffer);
+		vTargetUnlock();
+		xResponseStreaming = false;
+		_end_us = time_us_32();
+		if (ulResponseSent != 0U)
+		{
+			// the head is on the wire already, queue the rest once it is through
+			prvDapInWait();
+			if ((uint16_t)_resp_len > ulResponseSent)
+			{
+				usbd_edpt_xfer(_rhport, _in_ep_addr, responseBuffer + ulResponseSent, (uint16_t)((uint16_t)_resp_len - ulResponseSent));
+			}
+		}
+		else
+		{
+			ulResponseStampUs = time_us_32();
+			usbd_edpt_xfer(_rhport, _in_ep_addr, responseBuffer, (uint16_t) _resp_len);
+		}
+#else
+		// the probe services share the swd link
+		vTargetLock();
+		_resp_len = DAP_ExecuteCommand(DAPRequestBuffer, responseBuffer);
+		vTargetUnlock();
+		_end_us = time_us_32();
+		ulResponseStampUs = time_us_32();
 		usbd_edpt_xfer(_rhport, _in_ep_addr, responseBuffer, (uint16_t) _resp_len);
+#endif
+		// the host reads a whole DAP packet, a shorter response that fills its last
+		// endpoint packet needs a zero-length packet behind it to end the transfer
+		if (((uint16_t)_resp_len % DAP_USB_EP_SIZE) == 0U && (uint16_t)_resp_len < DAP_PACKET_SIZE)
+		{
+			prvDapInWait();
+			usbd_edpt_xfer(_rhport, _in_ep_addr, NULL, 0);
+		}
+		// link utilization: executing versus waiting for the host
+		vDapStatsLink(_start_us - _idle_us, _end_us - _start_us);
+		vDapStatsHistogram(DAP_STATS_HIST_QUEUE, _start_us - ulRequestStampUs);
+		vDapStatsHistogram(DAP_STATS_HIST_EXEC, _end_us - _start_us);
+		// flight recorder, while the response is on the wire
+		vDapRecorderAppend(ulRequestStampUs, _end_us - _start_us,
+				DAPRequestBuffer, (uint16_t)(_resp_len >> 16), responseBuffer, (uint16_t)_resp_len);
+#if (DAP_READAHEAD != 0)
+		// sequential block reads: fetch the next block while the response is on usb
+		if (!prvDapRequestPending())
+		{
+			vTargetLock();
+			vDapReadAheadRun(prvDapRequestPending);
+			vTargetUnlock();
+		}
+#endif
 	} while (true);
 
 }
@@ -24,6 +24,9 @@ extern "C" {
 
 extern TaskHandle_t dap_taskhandle, tud_taskhandle;
 
+/* Command names, indexed by command id (NULL where no name is known) */
+extern char * dap_cmd_string[ID_DAP_ExecuteCommands + 1];
+
 /* Main DAP loop */
 void dap_thread(void *ptr);
 
@@ -84,11 +84,19 @@ enum {
 #elif (CFG_TUD_CDC == 2)
     STRID_CDC_0,        // 4: CDC Interface 0
     STRID_CDC_1,        // 5: CDC Interface 1
+#elif (CFG_TUD_CDC == 3)
+    STRID_CDC_0,        // 4: CDC Interface 0
+    STRID_CDC_1,        // 5: CDC Interface 1
+    STRID_CDC_2,        // 6: CDC Interface 2
 #endif
 #if CFG_TUD_HID
     STRID_HID,          // 6: HID Interface
 #else
     STRID_VENDOR,       // 6: Vendor Interface
+#endif
+    STRID_RESET,        // 7: Reset Interface
+#if CFG_TUD_MSC
+    STRID_MSC,          // 8: MSC Interface
 #endif
 };
 
@@ -106,18 +114,32 @@ enum {
     ITF_NUM_CDC_0_DATA,
     ITF_NUM_CDC_1,
     ITF_NUM_CDC_1_DATA,
+#elif (CFG_TUD_CDC == 3)
+    ITF_NUM_CDC_0,
+    ITF_NUM_CDC_0_DATA,
+    ITF_NUM_CDC_1,
+    ITF_NUM_CDC_1_DATA,
+    ITF_NUM_CDC_2,
+    ITF_NUM_CDC_2_DATA,
+#endif
+#if CFG_TUD_MSC
+    ITF_NUM_MSC,
 #endif
     ITF_NUM_TOTAL
 };
 
 #if CFG_TUD_HID
 // total length of configuration descriptor
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN + CFG_TUD_MSC * TUD_MSC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
 #else
 // total length of configuration descriptor
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN + CFG_TUD_MSC * TUD_MSC_DESC_LEN + TUD_VENDOR_DESC_LEN)
 #endif
 
+// max packet size of the cdc bulk endpoints, full speed allows 64 at most
+// (CFG_TUD_CDC_EP_BUFSIZE is the stack's transfer buffer, not the packet size)
+#define CDC_EP_SIZE         64
+
 // define endpoint numbers
 #if (CFG_TUD_CDC == 1)
     #define EPNUM_CDC_0_NOTIF   0x81 // notification endpoint for CDC 0
@@ -131,6 +153,23 @@ enum {
     #define EPNUM_CDC_1_NOTIF   0x84 // notification endpoint for CDC 1
     #define EPNUM_CDC_1_OUT     0x05 // out endpoint for CDC 1
     #define EPNUM_CDC_1_IN      0x85 // in endpoint for CDC 1
+#elif (CFG_TUD_CDC == 3)
+    #define EPNUM_CDC_0_NOTIF   0x81 // notification endpoint for CDC 0
+    #define EPNUM_CDC_0_OUT     0x02 // out endpoint for CDC 0
+    #define EPNUM_CDC_0_IN      0x82 // in endpoint for CDC 0
+
+    #define EPNUM_CDC_1_NOTIF   0x84 // notification endpoint for CDC 1
+    #define EPNUM_CDC_1_OUT     0x05 // out endpoint for CDC 1
+    #define EPNUM_CDC_1_IN      0x85 // in endpoint for CDC 1
+
+    #define EPNUM_CDC_2_NOTIF   0x87 // notification endpoint for CDC 2
+    #define EPNUM_CDC_2_OUT     0x08 // out endpoint for CDC 2
+    #define EPNUM_CDC_2_IN      0x88 // in endpoint for CDC 2
+#endif
+
+#if CFG_TUD_MSC
+    #define EPNUM_MSC_OUT       0x03 // out endpoint for MSC
+    #define EPNUM_MSC_IN        0x83 // in endpoint for MSC
 #endif
 
 #if (CFG_TUD_HID || CFG_TUD_VENDOR)
@@ -151,20 +190,33 @@ uint8_t const desc_configuration[] = {
     TUD_VENDOR_DESCRIPTOR(TIF_NUM_VENDOR, STRID_VENDOR, EPNUM_HID_OUT, EPNUM_HID_IN, 64),
 #endif
 #if (CFG_TUD_CDC == 1)
-    // CDC 0: Communication Interface - TODO: get 64 from tusb_config.h
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, STRID_CDC_0, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, 64),
+    // CDC 0: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, STRID_CDC_0, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, CDC_EP_SIZE),
     // CDC 0: Data Interface
     //TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0_DATA, 4, 0x01, 0x02),
 #elif (CFG_TUD_CDC == 2)
-    // CDC 0: Communication Interface - TODO: get 64 from tusb_config.h
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, STRID_CDC_0, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, 64),
+    // CDC 0: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, STRID_CDC_0, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, CDC_EP_SIZE),
     // CDC 0: Data Interface
     //TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0_DATA, 4, 0x01, 0x02),
 
-    // CDC 1: Communication Interface - TODO: get 64 from tusb_config.h
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, STRID_CDC_1, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, 64),
+    // CDC 1: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, STRID_CDC_1, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, CDC_EP_SIZE),
     // CDC 1: Data Interface
     //TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1_DATA, 4, 0x03, 0x04),
+#elif (CFG_TUD_CDC == 3)
+    // CDC 0: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, STRID_CDC_0, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, CDC_EP_SIZE),
+
+    // CDC 1: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, STRID_CDC_1, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, CDC_EP_SIZE),
+
+    // CDC 2: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_2, STRID_CDC_2, EPNUM_CDC_2_NOTIF, 8, EPNUM_CDC_2_OUT, EPNUM_CDC_2_IN, CDC_EP_SIZE),
+#endif
+#if CFG_TUD_MSC
+    // MSC: Interface number, string index, EP Out & EP In address, EP size
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, STRID_MSC, EPNUM_MSC_OUT, EPNUM_MSC_IN, 64),
 #endif
 };
 
@@ -200,14 +252,21 @@ char const *string_desc_arr[] = {
     "Pico SDK stdio",               // 4: CDC Interface 0
 #elif (CFG_TUD_CDC == 2)
     "Pico SDK stdio",               // 4: CDC Interface 0
-    "Custom CDC",                   // 5: CDC Interface 1
+    "GDB Server",                   // 5: CDC Interface 1
+#elif (CFG_TUD_CDC == 3)
+    "Pico SDK stdio",               // 4: CDC Interface 0
+    "GDB Server",                   // 5: CDC Interface 1
+    "Target Console",               // 6: CDC Interface 2
 #endif
 #if CFG_TUD_HID
     "#HID CMSIS-DAP v" DAP_FW_VER,  // 6: HID Interface
 #else
     "#WinUSB CMSIS-DAP v" DAP_FW_VER, // 6: Interface descriptor for Bulk transport
 #endif
-    "RPiReset"                      // 7: Reset Interface
+    "RPiReset",                     // 7: Reset Interface
+#if CFG_TUD_MSC
+    "Probe Storage",                // 8: MSC Interface
+#endif
 };
 
 // buffer to hold the string descriptor during the request | plus 1 for the null terminator